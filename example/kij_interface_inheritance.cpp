@@ -29,16 +29,16 @@ using namespace hmlp;
 /** [Step#0] Define a new SPD matrix type with value type T. */
 template<typename T, class Allocator = std::allocator<T>>
 /** [Step#1] The new class must inherit VirtualMatrix<T, Allocator>. */
-class SparseSPDMatrix : public VirtualMatrix<T, Allocator>, 
+class MySparseMatrix : public VirtualMatrix<T, Allocator>, 
                         public ReadWrite
 {
   public:
 
     /** [Step#2] Define a constructor that inherits VirtualMatrix(). */
-    SparseSPDMatrix( size_t m = 0, size_t n = 0, size_t nnz = 0, bool issymmetric = true )
+    MySparseMatrix( size_t m = 0, size_t n = 0, size_t nnz = 0, bool issymmetric = true )
       : VirtualMatrix<T>( m, n ), K( m, n, nnz, issymmetric )
     {  
-    }; /** end SparseSPDMatrix() */
+    }; /** end MySparseMatrix() */
 
     /** [Step#3] (Optional) initialize the matrix with three vectors (CSC format).*/
     void fromCSC( size_t m, size_t n, size_t nnz, bool issymmetric,
@@ -53,11 +53,8 @@ class SparseSPDMatrix : public VirtualMatrix<T, Allocator>,
     /** [Step#5] implement K( I, J ) operator. */
     Data<T> operator() ( const vector<size_t> &I, const vector<size_t> &J ) override
     {
-      Data<T> KIJ( I.size(), J.size() );
-      for ( size_t j = 0; j < J.size(); j ++ )
-        for ( size_t i = 0; i < I.size(); i ++ )
-          KIJ( i, j ) = (*this)( I[ i ], J[ j ] );
-      return KIJ;
+      /** SparseData merges the sorted I against each column. */
+      return K( I, J );
     };
     
   private:
@@ -65,7 +62,7 @@ class SparseSPDMatrix : public VirtualMatrix<T, Allocator>,
     /** Here we use a sparse data format. */
     SparseData<T> K;
     
-}; /** end class SparseSPDMatrix */
+}; /** end class MySparseMatrix */
 
 
 
@@ -108,9 +105,9 @@ int main( int argc, char *argv[] )
     vector<size_t> row_ind( nnz, 0 );
     for ( size_t i = 0; i < col_ptr.size(); i ++ ) col_ptr[ i ] = i;
     for ( size_t i = 0; i < row_ind.size(); i ++ ) row_ind[ i ] = i;
-    SparseSPDMatrix<T> K1; 
+    MySparseMatrix<T> K1; 
     K1.fromCSC( n, n, nnz /** number of nonzeros */, true /** is symmetric */,
-        vals.data(), col_ptr.data(), row_ind.data() );
+        vals.data(), row_ind.data(), col_ptr.data() );
     printf( "K( 0, 0 ) %E here1\n", K1( 0, 0 ) ); fflush( stdout );
     printf( "K( 1, 0 ) %E here1\n", K1( 1, 0 ) ); fflush( stdout );
     printf( "K( 0, 1 ) %E here1\n", K1( 0, 1 ) ); fflush( stdout );
@@ -122,8 +119,8 @@ int main( int argc, char *argv[] )
     auto KIJ = K1( I, J );
     KIJ.Print();
     /** Create randomized and center splitters. */
-    gofmm::randomsplit<SparseSPDMatrix<T>, 2, T> rkdtsplitter1( K1 );
-    gofmm::centersplit<SparseSPDMatrix<T>, 2, T> splitter1( K1 );
+    gofmm::randomsplit<MySparseMatrix<T>, 2, T> rkdtsplitter1( K1 );
+    gofmm::centersplit<MySparseMatrix<T>, 2, T> splitter1( K1 );
     /** Perform the iterative neighbor search. */
     auto neighbors1 = gofmm::FindNeighbors( K1, rkdtsplitter1, config1 );
 
@@ -0,0 +1,130 @@
+/**
+ *  HMLP (High-Performance Machine Learning Primitives)
+ *
+ *  Copyright (C) 2014-2018, The University of Texas at Austin
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see the LICENSE file.
+ *
+ **/
+
+/** Use GOFMM templates. */
+#include <gofmm.hpp>
+/** Use implicit kernel matrices (only coordinates are stored). */
+#include <containers/KernelMatrix.hpp>
+/** Use STL and HMLP namespaces. */
+using namespace std;
+using namespace hmlp;
+
+/** @brief Relative error of A ~ A( :, skels ) * inv( R11 ) * proj. */
+template<typename T>
+T InterpolationError( Data<T> &A, vector<size_t> &skels, Data<T> &proj, vector<int> &jpvt )
+{
+  size_t m = A.row(), n = A.col(), s = skels.size();
+  if ( !s ) return 1.0;
+  /** P = inv( R11 ) * proj, then scatter the columns with jpvt. */
+  Data<T> R1( s, s, 0.0 ), P = proj, Q( s, n );
+  for ( size_t j = 0; j < s; j ++ )
+    for ( size_t i = 0; i <= j; i ++ ) R1( i, j ) = proj( i, j );
+  xtrsm( "L", "U", "N", "N", s, n, 1.0, R1.data(), s, P.data(), s );
+  for ( size_t j = 0; j < n; j ++ )
+    for ( size_t i = 0; i < s; i ++ ) Q( i, jpvt[ j ] ) = P( i, j );
+  /** E = A - A( :, skels ) * Q. */
+  Data<T> E = A, C( m, s );
+  for ( size_t j = 0; j < s; j ++ )
+    for ( size_t i = 0; i < m; i ++ ) C( i, j ) = A( i, skels[ j ] );
+  xgemm( "N", "N", m, n, s, -1.0, C.data(), m, Q.data(), s, 1.0, E.data(), m );
+  T err = 0, nrm = 0;
+  for ( size_t i = 0; i < A.size(); i ++ ) { err += E[ i ] * E[ i ]; nrm += A[ i ] * A[ i ]; }
+  return std::sqrt( err / nrm );
+};
+
+/**
+ *  @brief In this example, we compare the two interpolative decompositions
+ *         used by the skeletonization (GEQP4 on the sampled block and the
+ *         randomized blocked ID) on the off-diagonal blocks of a Gaussian
+ *         kernel matrix. The block sizes mimic KIJ, which is 2n-by-n for
+ *         n = sl + sr candidate columns.
+ *
+ *         Usage: skeletonization [maximum rank] [tolerance] [repeats]
+ */
+int main( int argc, char *argv[] )
+{
+  try
+  {
+    /** Use double as data type. */
+    using T = double;
+    /** Maximum off-diagonal rank. */
+    size_t s = 512;
+    /** Approximation tolerance. */
+    T stol = 1E-5;
+    /** Number of repeats per block. */
+    size_t repeats = 3;
+    if ( argc > 1 ) sscanf( argv[ 1 ], "%lu", &s );
+    if ( argc > 2 ) sscanf( argv[ 2 ], "%lf", &stol );
+    if ( argc > 3 ) sscanf( argv[ 3 ], "%lu", &repeats );
+
+    /** HMLP API call to initialize the runtime. */
+    HANDLE_ERROR( hmlp_init( &argc, &argv ) );
+
+    printf( "%6s %6s %10s | %8s %6s %9s | %8s %6s %9s\n",
+        "m", "n", "bandwidth", "geqp4", "rank", "error", "rid", "rank", "error" );
+    for ( size_t n = 128; n <= 2 * s; n *= 2 )
+    {
+      size_t m = 2 * n;
+      /** Targets and sources are two (overlapping) clusters in 3D. */
+      Data<T> X( 3, m + n ); X.randn();
+      for ( size_t j = m; j < m + n; j ++ ) X( 0, j ) += 2.0;
+      for ( T h : { 0.5, 1.0, 2.0 } )
+      {
+        kernel_s<T, T> kernel;
+        kernel.type = GAUSSIAN;
+        kernel.scal = -0.5 / ( h * h );
+        KernelMatrix<T> K( m + n, m + n, 3, kernel, X );
+        vector<size_t> I( m ), J( n );
+        for ( size_t i = 0; i < m; i ++ ) I[ i ] = i;
+        for ( size_t j = 0; j < n; j ++ ) J[ j ] = m + j;
+        Data<T> A = K( I, J );
+
+        vector<size_t> skels[ 2 ];
+        Data<T> proj[ 2 ];
+        vector<int> jpvt[ 2 ];
+        double time[ 2 ] = { 0.0, 0.0 };
+        for ( size_t r = 0; r < repeats; r ++ )
+        {
+          double beg = omp_get_wtime();
+          lowrank::id( true, false, m, n, s, stol, A, skels[ 0 ], proj[ 0 ], jpvt[ 0 ] );
+          time[ 0 ] += ( omp_get_wtime() - beg ) / repeats;
+          beg = omp_get_wtime();
+          lowrank::rid( true, false, m, n, s, stol, A, skels[ 1 ], proj[ 1 ], jpvt[ 1 ] );
+          time[ 1 ] += ( omp_get_wtime() - beg ) / repeats;
+        }
+        printf( "%6lu %6lu %10.2lf | %7.4lfs %6lu %9.2E | %7.4lfs %6lu %9.2E\n",
+            m, n, h,
+            time[ 0 ], skels[ 0 ].size(),
+            InterpolationError( A, skels[ 0 ], proj[ 0 ], jpvt[ 0 ] ),
+            time[ 1 ], skels[ 1 ].size(),
+            InterpolationError( A, skels[ 1 ], proj[ 1 ], jpvt[ 1 ] ) );
+      }
+    }
+
+    /** HMLP API call to terminate the runtime. */
+    HANDLE_ERROR( hmlp_finalize() );
+    return 0;
+  }
+  catch ( const exception & e )
+  {
+    cout << e.what() << endl;
+    return -1;
+  }
+}; /** end main() */
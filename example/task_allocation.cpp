@@ -0,0 +1,93 @@
+/**
+ *  HMLP (High-Performance Machine Learning Primitives)
+ *
+ *  Copyright (C) 2014-2018, The University of Texas at Austin
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see the LICENSE file.
+ *
+ **/
+
+/** Use HMLP API calls. */
+#include <hmlp.h>
+/** Use the runtime system (tasks and their allocator). */
+#include <base/runtime.hpp>
+/** Use STL and HMLP namespaces. */
+using namespace std;
+using namespace hmlp;
+
+/** @brief A task of the size of a typical tree task. */
+class EmptyTask : public Task
+{
+  public:
+
+    void *arg = NULL;
+
+    void Execute( Worker* ) {};
+};
+
+/** @brief Time a batch of allocations followed by a batch of deletions. */
+template<typename ALLOCATE, typename DEALLOCATE>
+double NanosecondsPerTask( size_t n_batch, size_t n_repeat,
+    ALLOCATE allocate, DEALLOCATE deallocate )
+{
+  vector<void*> tasks( n_batch );
+  double beg = omp_get_wtime();
+  for ( size_t r = 0; r < n_repeat; r ++ )
+  {
+    for ( auto &task : tasks ) task = allocate();
+    for ( auto &task : tasks ) deallocate( task );
+  }
+  return 1E+9 * ( omp_get_wtime() - beg ) / ( n_batch * n_repeat );
+};
+
+/**
+ *  @brief In this example, we measure a pooled Task allocation plus
+ *         deletion against the same size from the global heap, in a single
+ *         thread. Usage: task_allocation [batch] [repeat]
+ */
+int main( int argc, char *argv[] )
+{
+  try
+  {
+    /** The number of live tasks, e.g. the tasks of one epoch. */
+    size_t n_batch = ( argc > 1 ) ? atol( argv[ 1 ] ) : 4096;
+    /** The number of batches. */
+    size_t n_repeat = ( argc > 2 ) ? atol( argv[ 2 ] ) : 1000;
+    /** Warm up both allocators. */
+    for ( int warmup = 0; warmup < 2; warmup ++ )
+    {
+      double pool = NanosecondsPerTask( n_batch, n_repeat,
+          [] () { return Task::operator new( sizeof(EmptyTask) ); },
+          [] ( void *task ) { Task::operator delete( task, sizeof(EmptyTask) ); } );
+      double heap = NanosecondsPerTask( n_batch, n_repeat,
+          [] () { return ::operator new( sizeof(EmptyTask) ); },
+          [] ( void *task ) { ::operator delete( task ); } );
+      double task = NanosecondsPerTask( n_batch, n_repeat,
+          [] () { return (void*)new EmptyTask(); },
+          [] ( void *task ) { delete (EmptyTask*)task; } );
+      if ( !warmup ) continue;
+      printf( "%lu-byte tasks, %lu per batch: pool %5.1lf ns, heap %5.1lf ns", 
+          sizeof(EmptyTask), n_batch, pool, heap );
+      printf( " (with constructor and destructor %5.1lf ns)\n", task );
+    }
+    /** Return the slabs. */
+    Task::ReleaseSlabs();
+  }
+  catch ( const exception & e )
+  {
+    cout << e.what() << endl;
+    return -1;
+  }
+  return 0;
+}; /** end main() */
@@ -43,6 +43,13 @@
 #include <deque>
 #include <map>
 #include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <type_traits>
+#include <cerrno>
+#include <cstring>
+#include <cctype>
 
 /** std::istringstream */
 #include <iostream>
@@ -121,6 +128,158 @@ using namespace std;
 namespace hmlp
 {
 
+/**
+ *  @brief An allocator that default-initializes on vector::resize( n ), 
+ *         leaving trivial types uninitialized. Storage that is about to be
+ *         overwritten (e.g. by a loader) is first touched by the writer 
+ *         instead of by a serial zero-fill.
+ */ 
+template<typename T, typename A = std::allocator<T>>
+class default_init_allocator : public A
+{
+  public:
+
+    template<typename U>
+    struct rebind
+    {
+      using other = default_init_allocator<U, 
+            typename std::allocator_traits<A>::template rebind_alloc<U>>;
+    };
+
+    using A::A;
+
+    template<typename U>
+    void construct( U *ptr ) noexcept( std::is_nothrow_default_constructible<U>::value )
+    {
+      ::new( static_cast<void*>( ptr ) ) U;
+    };
+
+    template<typename U, typename... Args>
+    void construct( U *ptr, Args&&... args )
+    {
+      std::allocator_traits<A>::construct( static_cast<A&>( *this ), 
+          ptr, std::forward<Args>( args )... );
+    };
+}; /** end class default_init_allocator */
+
+
+/**
+ *  @brief Read bytes [ offset, offset + bytes ) of fd into buffer. The 
+ *         range is split evenly across OpenMP threads, such that each 
+ *         thread reads (and first touches) the part of the buffer that a
+ *         static loop will later assign to it.
+ */ 
+inline hmlpError_t ParallelRead( int fd, char *buffer, size_t bytes, size_t offset = 0 )
+{
+  /** pread() may return less than requested; Linux caps it below 2GB. */
+  const size_t max_bytes_per_call = (size_t)1 << 30;
+  /** Set by any thread and polled by the others to stop early. */
+  std::atomic<bool> failed( false );
+
+  #pragma omp parallel
+  {
+    size_t nt = omp_get_num_threads();
+    size_t tid = omp_get_thread_num();
+    /** Page-aligned partition. */
+    size_t page = 4096;
+    size_t per_thread = ( ( bytes + nt - 1 ) / nt + page - 1 ) / page * page;
+    size_t beg = std::min( bytes, tid * per_thread );
+    size_t end = std::min( bytes, beg + per_thread );
+    while ( beg < end && !failed )
+    {
+      auto rc = pread( fd, buffer + beg, std::min( end - beg, max_bytes_per_call ), offset + beg );
+      if ( rc < 0 && errno == EINTR ) continue;
+      if ( rc <= 0 ) failed = true;
+      else beg += rc;
+    }
+  }
+  return failed ? HMLP_ERROR_EXECUTION_FAILED : HMLP_ERROR_SUCCESS;
+}; /** end ParallelRead() */
+
+
+/**
+ *  @brief Memory-map a text file and split it into non-empty lines in 
+ *         parallel. The mapping is valid until the object is destroyed.
+ */ 
+class TextLines
+{
+  public:
+
+    TextLines( const string &filename )
+    {
+      int fd = open( filename.data(), O_RDONLY, 0 );
+      if ( fd == -1 ) return;
+      struct stat file_stat;
+      if ( fstat( fd, &file_stat ) == 0 && file_stat.st_size > 0 )
+      {
+        bytes = file_stat.st_size;
+        void *buffer = mmap( NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( buffer != MAP_FAILED ) 
+        {
+          text = (const char*)buffer;
+          madvise( buffer, bytes, MADV_SEQUENTIAL );
+        }
+      }
+      close( fd );
+      if ( !text ) return;
+
+      /** Each thread scans its own range for the lines that begin in it. */
+      vector<vector<pair<size_t, size_t>>> local( omp_get_max_threads() );
+      #pragma omp parallel
+      {
+        size_t nt = omp_get_num_threads();
+        size_t tid = omp_get_thread_num();
+        size_t beg = ( bytes * tid ) / nt;
+        size_t end = ( bytes * ( tid + 1 ) ) / nt;
+        /** A line begins at 0 or right after a '\n'. */
+        if ( beg > 0 ) 
+        {
+          auto *newline = (const char*)memchr( text + beg - 1, '\n', bytes - beg + 1 );
+          beg = newline ? newline - text + 1 : bytes;
+        }
+        while ( beg < end )
+        {
+          auto *newline = (const char*)memchr( text + beg, '\n', bytes - beg );
+          size_t line_end = newline ? newline - text : bytes;
+          if ( !IsBlank( beg, line_end ) ) local[ tid ].push_back( make_pair( beg, line_end ) );
+          beg = line_end + 1;
+        }
+      }
+      for ( auto &it : local ) lines.insert( lines.end(), it.begin(), it.end() );
+    };
+
+    ~TextLines() { if ( text ) munmap( (void*)text, bytes ); };
+
+    TextLines( const TextLines& ) = delete;
+
+    TextLines& operator=( const TextLines& ) = delete;
+
+    bool IsOpen() const noexcept { return text; };
+
+    size_t size() const noexcept { return lines.size(); };
+
+    /** Return the first and one past the last character of line j. */
+    pair<const char*, const char*> operator[]( size_t j ) const
+    {
+      return make_pair( text + lines[ j ].first, text + lines[ j ].second );
+    };
+
+  private:
+
+    bool IsBlank( size_t beg, size_t end ) const
+    {
+      for ( size_t i = beg; i < end; i ++ ) if ( !isspace( text[ i ] ) ) return false;
+      return true;
+    };
+
+    const char *text = NULL;
+
+    size_t bytes = 0;
+
+    vector<pair<size_t, size_t>> lines;
+
+}; /** end class TextLines */
+
 #ifdef HMLP_MIC_AVX512
 /** use hbw::allocator for Intel Xeon Phi */
 template<class T, class Allocator = hbw::allocator<T> >
@@ -159,9 +318,10 @@ class Data : public ReadWrite, public vector<T, Allocator>
 
     Data( size_t m, size_t n, T initT ) { resize( m, n, initT ); };
 
-    Data( size_t m, size_t n, string &filename ) : Data( m, n )
+    /** Read from a file (see read() for the page placement). */
+    Data( size_t m, size_t n, const string &filename ) : Data( m, n )
     {
-      this->read( m, n, filename );
+      HANDLE_ERROR( this->read( m, n, filename ) );
     };
 
     void resize( size_t m, size_t n ) { resize_( m, n ); };
@@ -176,23 +336,28 @@ class Data : public ReadWrite, public vector<T, Allocator>
      */ 
     void clear() { clear_(); }; 
 
-    void read( size_t m, size_t n, string &filename )
+    /**
+     *  @brief Read an m-by-n column-major binary file. Threads read disjoint
+     *         chunks with pread(). With std::allocator, Data( m, n ) and
+     *         resize() have already zero-filled (and placed) the pages on
+     *         the calling thread. Only storage resized without a value
+     *         through default_init_allocator (as SPDMatrix does) is first
+     *         touched by the reading threads.
+     */
+    hmlpError_t read( size_t m, size_t n, const string &filename )
     {
-      assert( this->m == m );
-      assert( this->n == n );
-      assert( this->size() == m * n );
-
-      cout << filename << endl;
-
-      ifstream file( filename.data(), ios::in|ios::binary|ios::ate );
-      if ( file.is_open() )
+      if ( this->m != m || this->n != n || this->size() != m * n ) 
+        return HMLP_ERROR_INVALID_VALUE;
+      int fd = open( filename.data(), O_RDONLY, 0 );
+      if ( fd == -1 ) return HMLP_ERROR_INVALID_VALUE;
+      struct stat file_stat;
+      auto rc = HMLP_ERROR_INVALID_VALUE;
+      if ( fstat( fd, &file_stat ) == 0 && (size_t)file_stat.st_size == m * n * sizeof(T) )
       {
-        auto size = file.tellg();
-        assert( size == m * n * sizeof(T) );
-        file.seekg( 0, ios::beg );
-        file.read( (char*)this->data(), size );
-        file.close();
+        rc = ParallelRead( fd, (char*)this->data(), m * n * sizeof(T) );
       }
+      close( fd );
+      return rc;
     };
 
 		void write( std::string &filename )
@@ -201,56 +366,73 @@ class Data : public ReadWrite, public vector<T, Allocator>
       myFile.write( (char*)(this->data()), this->size() * sizeof(T) );
 		};
 
+    /**
+     *  @brief Read a text (or CSV) file with n lines of m + SKIP_ATTRIBUTES 
+     *         values separated by white spaces, ',' or ';'. The file is
+     *         memory-mapped and lines are parsed in parallel.
+     */
     template<int SKIP_ATTRIBUTES = 0, bool TRANS = false>
-		void readmtx( size_t m, size_t n, string &filename )
+		hmlpError_t readmtx( size_t m, size_t n, const string &filename )
 		{
-      assert( this->m == m );
-      assert( this->n == n );
-      assert( this->size() == m * n );
+      if ( this->m != m || this->n != n || this->size() != m * n ) 
+        return HMLP_ERROR_INVALID_VALUE;
 
-      cout << filename << endl;
+      TextLines lines( filename );
+      if ( !lines.IsOpen() ) return HMLP_ERROR_INVALID_VALUE;
+      if ( lines.size() != n )
+      {
+        fprintf( stderr, "[WARNING] %s has %lu lines, but %lu are expected\n", 
+            filename.data(), lines.size(), n );
+        return HMLP_ERROR_INVALID_VALUE;
+      }
 
-      ifstream file( filename.data() );
-			string line;
-			if ( file.is_open() )
-			{
-				size_t j = 0;
-				while ( getline( file, line ) )
-				{
-					if ( j == 0 ) printf( "%s\n", line.data() );
-
-
-					if ( j % 1000 == 0 ) printf( "%4lu ", j ); fflush( stdout );
-					if ( j >= n )
-					{
-						printf( "more data then execpted n %lu\n", n );
-					}
-
-          /** Replace all ',' and ';' with white space ' ' */
-					replace( line.begin(), line.end(), ',', '\n' );
-					replace( line.begin(), line.end(), ';', '\n' );
-
-					istringstream iss( line );
-
-					for ( size_t i = 0; i < m + SKIP_ATTRIBUTES; i ++ )
-					{
-						T tmp;
-						if ( !( iss >> tmp ) )
-						{
-							printf( "line %lu does not have enough elements (only %lu)\n", j, i );
-					    printf( "%s\n", line.data() );
-							exit( 1 );
-						}
-						if ( i >= SKIP_ATTRIBUTES )
-						{
-							if ( TRANS ) (*this)[ j * m + i ] = tmp;
-							else         (*this)[ i * n + j ] = tmp;
-						}
-					}
-					j ++;
-				}
-				printf( "\nfinish readmatrix %s\n", filename.data() );
-			}
+      size_t bad_line = n;
+      #pragma omp parallel for schedule( dynamic, 64 ) reduction( min:bad_line )
+      for ( size_t j = 0; j < n; j ++ )
+      {
+        auto line = lines[ j ];
+        const char *ptr = line.first;
+        for ( size_t i = 0; i < m + SKIP_ATTRIBUTES; i ++ )
+        {
+          /** Skip separators; strtod() does not stop at the end of line. */
+          while ( ptr < line.second && ( isspace( *ptr ) || *ptr == ',' || *ptr == ';' ) ) ptr ++;
+          auto end = ptr;
+          while ( end < line.second && !isspace( *end ) && *end != ',' && *end != ';' ) end ++;
+          /** 
+           *  The mapping is not NUL-terminated, so the last token of a line
+           *  (which may end the file) is parsed from a bounded copy. Other
+           *  tokens end at a separator within the mapping.
+           */
+          char token[ 128 ];
+          const char *beg = ptr;
+          if ( end == line.second && ptr < end && end - ptr < (ptrdiff_t)sizeof(token) )
+          {
+            memcpy( token, ptr, end - ptr );
+            token[ end - ptr ] = '\0';
+            beg = token;
+          }
+          char *next = NULL;
+          T tmp = ( beg != ptr || end < line.second ) ? strtod( beg, &next ) : 0;
+          if ( ptr == end || next == beg || next != beg + ( end - ptr ) )
+          {
+            bad_line = std::min( bad_line, j );
+            break;
+          }
+          ptr = end;
+          if ( i >= SKIP_ATTRIBUTES )
+          {
+            if ( TRANS ) (*this)[ j * m + i - SKIP_ATTRIBUTES ] = tmp;
+            else         (*this)[ ( i - SKIP_ATTRIBUTES ) * n + j ] = tmp;
+          }
+        }
+      }
+      if ( bad_line < n )
+      {
+        fprintf( stderr, "[WARNING] line %lu of %s does not have %d elements\n", 
+            bad_line, filename.data(), (int)m + SKIP_ATTRIBUTES );
+        return HMLP_ERROR_INVALID_VALUE;
+      }
+      return HMLP_ERROR_SUCCESS;
 		};
 
 
@@ -480,6 +662,87 @@ class Data : public ReadWrite, public vector<T, Allocator>
     template<typename TINDEX>
     double flops( TINDEX na, TINDEX nb ) { return 0.0; };
 
+    /**
+     *  @brief Track the dependencies on mb-by-nb tiles of the current m-by-n
+     *         matrix instead of on the whole object. Call it again after
+     *         resize(); this also drops all recorded dependencies.
+     */
+    hmlpError_t CreateRegions( size_t mb, size_t nb )
+    {
+      return regions.Setup( m, n, mb, nb );
+    };
+
+    bool HasRegions() const noexcept { return regions.HasBeenSetup(); };
+
+    /** With regions, a whole-object access applies to all tiles. */
+    hmlpError_t DependencyAnalysis( ReadWriteType type, Task *task )
+    {
+      if ( HasRegions() ) return regions.DependencyAnalysis( 0, m, 0, n, type, task );
+      return ReadWrite::DependencyAnalysis( type, task );
+    };
+
+    /**
+     *  @brief Access of the rows [ i, i + rm ) and columns [ j, j + rn ). Only
+     *         tasks that touch a common tile are ordered. Without regions,
+     *         this is a whole-object access.
+     */
+    hmlpError_t DependencyAnalysis( size_t i, size_t rm, size_t j, size_t rn,
+        ReadWriteType type, Task *task )
+    {
+      if ( HasRegions() ) return regions.DependencyAnalysis( i, rm, j, rn, type, task );
+      return ReadWrite::DependencyAnalysis( type, task );
+    };
+
+    hmlpError_t DependencyCleanUp()
+    {
+      regions.DependencyCleanUp();
+      return ReadWrite::DependencyCleanUp();
+    };
+
+    /**
+     *  @brief A( i:i+rm-1, j:j+rn-1 ) += B for a column-major B with leading
+     *         dimension ldb. Each tile is updated while holding its lock, so
+     *         tasks that declared ACC on overlapping regions can call this
+     *         concurrently. Requires CreateRegions().
+     */
+    hmlpError_t Accumulate( size_t i, size_t rm, size_t j, size_t rn,
+        const T *B, size_t ldb )
+    {
+      if ( !HasRegions() || i + rm > m || j + rn > n || ldb < rm )
+        return HMLP_ERROR_INVALID_VALUE;
+      size_t mb = regions.GetRowBlockSize();
+      size_t nb = regions.GetColumnBlockSize();
+      for ( size_t jj = j; jj < j + rn; jj = ( jj / nb + 1 ) * nb )
+      {
+        size_t jend = std::min( ( jj / nb + 1 ) * nb, j + rn );
+        for ( size_t ii = i; ii < i + rm; ii = ( ii / mb + 1 ) * mb )
+        {
+          size_t iend = std::min( ( ii / mb + 1 ) * mb, i + rm );
+          RETURN_IF_ERROR( regions.AcquireTile( ii, jj ) );
+          for ( size_t q = jj; q < jend; q ++ )
+            for ( size_t p = ii; p < iend; p ++ )
+              (*this)[ q * m + p ] += B[ ( q - j ) * ldb + ( p - i ) ];
+          RETURN_IF_ERROR( regions.ReleaseTile( ii, jj ) );
+        }
+      }
+      return HMLP_ERROR_SUCCESS;
+    };
+
+    /**
+     *  @brief Lock all tiles of A( i:i+rm-1, j:j+rn-1 ), such that a task that
+     *         declared ACC can update the region in place (e.g. a GEMM with
+     *         beta = 1) while others accumulate. Requires CreateRegions().
+     */
+    hmlpError_t AcquireRegion( size_t i, size_t rm, size_t j, size_t rn )
+    {
+      return regions.Acquire( i, rm, j, rn );
+    };
+
+    hmlpError_t ReleaseRegion( size_t i, size_t rm, size_t j, size_t rn )
+    {
+      return regions.Release( i, rm, j, rn );
+    };
+
 #ifdef HMLP_USE_CUDA
 
     void CacheD( hmlp::Device *dev )
@@ -563,6 +826,9 @@ class Data : public ReadWrite, public vector<T, Allocator>
 
     size_t n = 0;
 
+    /** Tiled dependencies and locks; empty unless CreateRegions() was called. */
+    RegionReadWrite regions;
+
 }; /** end class Data */
 
 
@@ -570,6 +836,13 @@ class Data : public ReadWrite, public vector<T, Allocator>
 
 
 
+/**
+ *  @brief Compressed sparse column (CSC) storage. Row indices in each column 
+ *         are kept sorted, such that K( i, j ) is a binary search and K( I, J )
+ *         is a merge of the sorted I against each column. If issymmetric is
+ *         true, then K( i, j ) with i < j is read from K( j, i ); hence, it
+ *         is sufficient to store the lower triangular part.
+ */ 
 template<typename T, class Allocator = std::allocator<T> >
 class SparseData : public ReadWrite
 {
@@ -591,6 +864,8 @@ class SparseData : public ReadWrite
       this->row_ind.resize( nnz, 0 );
       this->col_ptr.resize( n + 1, 0 );
       this->issymmetric = issymmetric;
+      /** Cached blocks are no longer valid. */
+      if ( diag_cache ) EnableDiagonalCache( diag_cache->capacity );
     }; /** end Resize() */
 
     /** Construct from three arrays: val[ nnz ],row_ind[ nnz ], and col_ptr[ n + 1 ]. */
@@ -598,6 +873,7 @@ class SparseData : public ReadWrite
         const T *val, const size_t *row_ind, const size_t *col_ptr ) 
     {
       Resize( m, n, nnz, issymmetric );
+      #pragma omp parallel for
       for ( size_t i = 0; i < nnz; i ++ )
       {
         this->val[ i ] = val[ i ];
@@ -607,22 +883,19 @@ class SparseData : public ReadWrite
       {
         this->col_ptr[ j ] = col_ptr[ j ];
       }
+      SortColumns();
     }; /** end fromCSC()*/
 
     /** Retrive an element K( i, j ).  */
     T operator () ( size_t i, size_t j ) const
     {
       if ( issymmetric && i < j ) std::swap( i, j );
-      auto row_beg = col_ptr[ j ];
-      auto row_end = col_ptr[ j + 1 ];
-      /** Early return if there is no nonzero entry in this column. */
-      if ( row_beg == row_end ) return 0;
-      /** Search (BST) for row indices. */
-      auto lower = find( row_ind.begin() + row_beg, row_ind.begin() + row_end - 1, i );
-      //if ( lower != row_ind.end() ) printf( "lower %lu, i %lu, j %lu, row_beg %lu, row_end %lu\n", 
-      //    *lower, i, j, row_beg, row_end ); fflush( stdout );
+      auto row_beg = row_ind.begin() + col_ptr[ j ];
+      auto row_end = row_ind.begin() + col_ptr[ j + 1 ];
+      /** Binary search for the row index. */
+      auto lower = lower_bound( row_beg, row_end, i );
       /** If the lower bound matches, then return the value. */
-      if ( *lower == i ) return val[ distance( row_ind.begin(), lower ) ];
+      if ( lower != row_end && *lower == i ) return val[ distance( row_ind.begin(), lower ) ];
       /** Otherwise, return 0. */
       return 0;
     }; /** end operator () */
@@ -630,15 +903,65 @@ class SparseData : public ReadWrite
     /** Retrive a subblock K( I, J ).*/
     Data<T> operator()( const vector<size_t> &I, const vector<size_t> &J ) const
     {
-      Data<T> KIJ( I.size(), J.size() );
-      /** Evaluate Kij element by element. */
+      /** Diagonal blocks K( I, I ) may have been cached. */
+      bool is_diagonal = diag_cache && I == J;
+      if ( is_diagonal )
+      {
+        lock_guard<mutex> guard( diag_cache->lock );
+        auto it = diag_cache->blocks.find( I );
+        if ( it != diag_cache->blocks.end() ) return it->second;
+      }
+
+      Data<T> KIJ( I.size(), J.size(), 0 );
+      /** Sort I once; order[ s ] is the position of the s-th smallest index. */
+      vector<size_t> order( I.size() );
+      for ( size_t s = 0; s < order.size(); s ++ ) order[ s ] = s;
+      sort( order.begin(), order.end(), 
+          [&I] ( size_t a, size_t b ) { return I[ a ] < I[ b ]; } );
+
       for ( size_t j = 0; j < J.size(); j ++ )
-        for ( size_t i = 0; i < I.size(); i ++ )
-          KIJ( i, j ) = (*this)( I[ i ], J[ j ] );
+      {
+        size_t col = J[ j ];
+        size_t s = 0;
+        /** Entries above the diagonal are stored in the other triangle. */
+        if ( issymmetric )
+        {
+          for ( ; s < order.size() && I[ order[ s ] ] < col; s ++ )
+            KIJ( order[ s ], j ) = (*this)( I[ order[ s ] ], col );
+        }
+        /** Merge the rest of the sorted I with the sorted row indices. */
+        auto row_beg = row_ind.begin() + col_ptr[ col ];
+        auto row_end = row_ind.begin() + col_ptr[ col + 1 ];
+        for ( ; s < order.size() && row_beg != row_end; s ++ )
+        {
+          size_t i = I[ order[ s ] ];
+          row_beg = lower_bound( row_beg, row_end, i );
+          if ( row_beg != row_end && *row_beg == i ) 
+            KIJ( order[ s ], j ) = val[ distance( row_ind.begin(), row_beg ) ];
+        }
+      }
+
+      if ( is_diagonal )
+      {
+        lock_guard<mutex> guard( diag_cache->lock );
+        if ( diag_cache->blocks.size() < diag_cache->capacity ) 
+          diag_cache->blocks.insert( make_pair( I, KIJ ) );
+      }
       /** Return submatrix KIJ. */
       return KIJ;
     }; /** end operator () */ 
 
+    /** 
+     *  @brief Keep up to capacity dense diagonal blocks K( I, I ) (e.g. leaf
+     *         nodes) after their first extraction. A zero capacity disables
+     *         the cache. Previously cached blocks are dropped.
+     */
+    void EnableDiagonalCache( size_t capacity )
+    {
+      if ( capacity ) diag_cache = make_shared<DiagonalCache>( capacity );
+      else            diag_cache.reset();
+    }; /** end EnableDiagonalCache() */
+
     size_t ColPtr( size_t j ) { return col_ptr[ j ]; };
 
     size_t RowInd( size_t offset ) { return row_ind[ offset ]; };
@@ -647,6 +970,7 @@ class SparseData : public ReadWrite
 
     pair<T, size_t> ImportantSample( size_t j )
     {
+      if ( col_ptr[ j + 1 ] == col_ptr[ j ] ) return pair<T, size_t>( 0, rand() % m );
       size_t offset = col_ptr[ j ] + rand() % ( col_ptr[ j + 1 ] - col_ptr[ j ] );
       pair<T, size_t> sample( val[ offset ], row_ind[ offset ] );
       return sample; 
@@ -758,8 +1082,6 @@ class SparseData : public ReadWrite
       // Close the file.
       file.close();
 
-      //printf( "Here nnz %lu\n", nnz );
-
       // Recount nnz for the full storage.
       size_t full_nnz = 0;
       for ( size_t j = 0; j < n; j ++ )
@@ -772,21 +1094,6 @@ class SparseData : public ReadWrite
       row_ind.resize( full_nnz );
       val.resize( full_nnz );
 
-      //printf( "Here nnz %lu\n", nnz );
-
-      //full_nnz = 0;
-      //for ( size_t j = 0; j < n; j ++ )
-      //{
-      //  for ( size_t i = 0; i < full_row_ind[ j ].size(); i ++ )
-      //  {
-      //    row_ind[ full_nnz ] = full_row_ind[ j ][ i ];
-      //    val[ full_nnz ] = full_val[ j ][ i ];
-      //    full_nnz ++;
-      //  }
-      //}
-
-      //printf( "Close the file. Reformat.\n" );
-
       #pragma omp parallel for
       for ( size_t j = 0; j < n; j ++ )
       {
@@ -796,20 +1103,145 @@ class SparseData : public ReadWrite
           val[ col_ptr[ j ] + i ] = full_val[ j ][ i ];
         }
       }
+      SortColumns();
 
       printf( "finish readmatrix %s\n", filename.data() ); fflush( stdout );
     };
 
+    /**
+     *  @brief Memory-map a binary CSC file and load it. The layout is 
+     *         m, n, nnz, col_ptr[ n + 1 ], row_ind[ nnz ] (all size_t) 
+     *         followed by val[ nnz ] (T).
+     */
+    hmlpError_t readCSC( const string &filename, bool issymmetric = true )
+    {
+      return readBinary<false>( filename, issymmetric );
+    }; /** end readCSC() */
+
+    /**
+     *  @brief Memory-map a binary CSR file (row_ptr[ m + 1 ] and col_ind[ nnz ] 
+     *         in place of col_ptr and row_ind) and convert it to CSC.
+     */
+    hmlpError_t readCSR( const string &filename, bool issymmetric = true )
+    {
+      return readBinary<true>( filename, issymmetric );
+    }; /** end readCSR() */
+
+    /** Write the binary CSC layout read by readCSC(). */
+    hmlpError_t writeCSC( const string &filename ) const
+    {
+      ofstream file( filename.data(), ios::out | ios::binary );
+      if ( !file ) return HMLP_ERROR_INVALID_VALUE;
+      size_t header[ 3 ] = { m, n, nnz };
+      file.write( (char*)header, sizeof(header) );
+      file.write( (char*)col_ptr.data(), col_ptr.size() * sizeof(size_t) );
+      file.write( (char*)row_ind.data(), nnz * sizeof(size_t) );
+      file.write( (char*)val.data(), nnz * sizeof(T) );
+      return file.good() ? HMLP_ERROR_SUCCESS : HMLP_ERROR_EXECUTION_FAILED;
+    }; /** end writeCSC() */
 
     size_t row() { return m; };
 
     size_t col() { return n; };
+
+    size_t NNZ() const noexcept { return nnz; };
     
     template<typename TINDEX>
     double flops( TINDEX na, TINDEX nb ) { return 0.0; };
 
   private:
 
+    /** Sort row indices (and values) of each column in ascending order. */
+    void SortColumns()
+    {
+      #pragma omp parallel for schedule( dynamic, 64 )
+      for ( size_t j = 0; j < n; j ++ )
+      {
+        auto beg = col_ptr[ j ], end = col_ptr[ j + 1 ];
+        if ( is_sorted( row_ind.begin() + beg, row_ind.begin() + end ) ) continue;
+        vector<pair<size_t, T>> column( end - beg );
+        for ( size_t p = beg; p < end; p ++ ) column[ p - beg ] = make_pair( row_ind[ p ], val[ p ] );
+        sort( column.begin(), column.end(), 
+            [] ( const pair<size_t, T> &a, const pair<size_t, T> &b ) { return a.first < b.first; } );
+        for ( size_t p = beg; p < end; p ++ ) 
+        {
+          row_ind[ p ] = column[ p - beg ].first;
+          val[ p ] = column[ p - beg ].second;
+        }
+      }
+    }; /** end SortColumns() */
+
+    template<bool ISCSR>
+    hmlpError_t readBinary( const string &filename, bool issymmetric )
+    {
+      int fd = open( filename.data(), O_RDONLY, 0 );
+      if ( fd == -1 ) return HMLP_ERROR_INVALID_VALUE;
+      struct stat file_stat;
+      size_t header[ 3 ];
+      if ( fstat( fd, &file_stat ) || pread( fd, header, sizeof(header), 0 ) != sizeof(header) )
+      {
+        close( fd );
+        return HMLP_ERROR_INVALID_VALUE;
+      }
+      size_t m = header[ 0 ], n = header[ 1 ], nnz = header[ 2 ];
+      /** Bound the header before computing the size, such that it cannot overflow. */
+      size_t words = file_stat.st_size / sizeof(size_t);
+      if ( ( ISCSR ? m : n ) >= words || nnz >= words )
+      {
+        close( fd );
+        return HMLP_ERROR_INVALID_VALUE;
+      }
+      size_t nptr = ( ISCSR ? m : n ) + 1;
+      size_t bytes = sizeof(header) + ( nptr + nnz ) * sizeof(size_t) + nnz * sizeof(T);
+      if ( (size_t)file_stat.st_size != bytes )
+      {
+        close( fd );
+        return HMLP_ERROR_INVALID_VALUE;
+      }
+      void *buffer = mmap( NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0 );
+      close( fd );
+      if ( buffer == MAP_FAILED ) return HMLP_ERROR_ALLOC_FAILED;
+      madvise( buffer, bytes, MADV_SEQUENTIAL );
+
+      const size_t *ptr = (const size_t*)buffer + 3;
+      const size_t *ind = ptr + nptr;
+      const T *values = (const T*)( ind + nnz );
+      /** Offsets must be monotone from 0 to nnz, and indices within range. */
+      auto valid = [&] ()
+      {
+        if ( ptr[ 0 ] != 0 || ptr[ nptr - 1 ] != nnz ) return false;
+        for ( size_t i = 0; i + 1 < nptr; i ++ )
+          if ( ptr[ i ] > ptr[ i + 1 ] ) return false;
+        size_t bound = ISCSR ? n : m;
+        for ( size_t p = 0; p < nnz; p ++ )
+          if ( ind[ p ] >= bound ) return false;
+        return true;
+      };
+      auto rc = HMLP_ERROR_SUCCESS;
+      if ( !valid() ) rc = HMLP_ERROR_INVALID_VALUE;
+      else if ( !ISCSR ) fromCSC( m, n, nnz, issymmetric, values, ind, ptr );
+      else
+      {
+        /** Transpose with a counting sort over column indices. */
+        Resize( m, n, nnz, issymmetric );
+        for ( size_t p = 0; p < nnz; p ++ ) col_ptr[ ind[ p ] + 1 ] ++;
+        for ( size_t j = 0; j < n; j ++ ) col_ptr[ j + 1 ] += col_ptr[ j ];
+        vector<size_t> next( col_ptr.begin(), col_ptr.end() - 1 );
+        /** Rows are visited in order, so each column ends up sorted. */
+        for ( size_t i = 0; i < m; i ++ )
+        {
+          for ( size_t p = ptr[ i ]; p < ptr[ i + 1 ]; p ++ )
+          {
+            auto dst = next[ ind[ p ] ] ++;
+            row_ind[ dst ] = i;
+            val[ dst ] = values[ p ];
+          }
+        }
+      }
+      munmap( buffer, bytes );
+      return rc;
+    }; /** end readBinary() */
+
     size_t m = 0;
 
     size_t n = 0;
@@ -824,6 +1256,20 @@ class SparseData : public ReadWrite
    
     vector<size_t> col_ptr;
 
+    /** Dense diagonal blocks, shared by copies of this matrix. */
+    struct DiagonalCache
+    {
+      DiagonalCache( size_t capacity ) : capacity( capacity ) {};
+
+      size_t capacity = 0;
+
+      mutex lock;
+
+      map<vector<size_t>, Data<T>> blocks;
+    };
+
+    shared_ptr<DiagonalCache> diag_cache;
+
 }; /** end class CSC */
 
 
@@ -839,34 +1285,45 @@ class OOCData : public ReadWrite
 
     OOCData() {};
 
-    OOCData( size_t m, size_t n, string filename ) { Set( m, n, filename ); };
+    OOCData( size_t m, size_t n, string filename ) { HANDLE_ERROR( Set( m, n, filename ) ); };
 
-    ~OOCData()
-    {
-      /** Unmap */
-      int rc = munmap( mmappedData, m * n * sizeof(T) );
-      assert( rc == 0 );
-      close( fd );
-      printf( "finish readmatrix %s\n", filename.data() );
-    };
+    /** The mapping is owned by one object; it can be moved but not copied. */
+    OOCData( const OOCData& ) = delete;
 
-    void Set( size_t m, size_t n, string filename )
+    OOCData& operator=( const OOCData& ) = delete;
+
+    OOCData( OOCData&& other ) noexcept { swap( other ); };
+
+    OOCData& operator=( OOCData&& other ) noexcept { swap( other ); return *this; };
+
+    ~OOCData() { Unmap(); };
+
+    /**
+     *  @brief Map an m-by-n column-major binary file without copying it. 
+     *         Pages are faulted in on demand (no MAP_POPULATE), such that
+     *         files larger than the memory can be used.
+     */
+    hmlpError_t Set( size_t m, size_t n, string filename )
     {
+      Unmap();
+      /** Open the file */
+      int fd = open( filename.data(), O_RDONLY, 0 ); 
+      if ( fd == -1 ) return HMLP_ERROR_INVALID_VALUE;
+      struct stat file_stat;
+      if ( fstat( fd, &file_stat ) || (size_t)file_stat.st_size < m * n * sizeof(T) )
+      {
+        close( fd );
+        return HMLP_ERROR_INVALID_VALUE;
+      }
+      void *buffer = mmap( NULL, m * n * sizeof(T), PROT_READ, MAP_PRIVATE, fd, 0 );
+      /** The mapping stays valid after the file is closed. */
+      close( fd );
+      if ( buffer == MAP_FAILED ) return HMLP_ERROR_ALLOC_FAILED;
       this->m = m;
       this->n = n;
       this->filename = filename;
-      /** Open the file */
-      fd = open( filename.data(), O_RDONLY, 0 ); 
-      assert( fd != -1 );
-#ifdef __APPLE__
-      mmappedData = (T*)mmap( NULL, m * n * sizeof(T), 
-          PROT_READ, MAP_PRIVATE, fd, 0 );
-#else /** Assume Linux */
-      mmappedData = (T*)mmap( NULL, m * n * sizeof(T), 
-          PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0 );
-#endif
-      assert( mmappedData != MAP_FAILED );
-      cout << filename << endl;
+      mmappedData = (T*)buffer;
+      return HMLP_ERROR_SUCCESS;
     };
 
     //template<typename TINDEX>
@@ -880,9 +1337,12 @@ class OOCData : public ReadWrite
     Data<T> operator()( const vector<size_t>& I, const vector<size_t>& J ) const 
     {
       Data<T> KIJ( I.size(), J.size() );
-      for ( int j = 0; j < J.size(); j ++ )
-        for ( int i = 0; i < I.size(); i ++ )
-          KIJ[ j * I.size() + i ] = (*this)( I[ i ], J[ j ] );
+      for ( size_t j = 0; j < J.size(); j ++ )
+      {
+        const T *column = mmappedData + J[ j ] * m;
+        for ( size_t i = 0; i < I.size(); i ++ )
+          KIJ[ j * I.size() + i ] = column[ I[ i ] ];
+      }
       return KIJ;
     }; 
 
@@ -898,11 +1358,28 @@ class OOCData : public ReadWrite
 
     size_t col() const noexcept { return n; };
 
+    /** Return the (read-only) mapped column-major storage. */
+    const T* data() const noexcept { return mmappedData; };
+
     template<typename TINDEX>
     double flops( TINDEX na, TINDEX nb ) { return 0.0; };
 
   private:
 
+    void swap( OOCData &other ) noexcept
+    {
+      std::swap( m, other.m );
+      std::swap( n, other.n );
+      std::swap( filename, other.filename );
+      std::swap( mmappedData, other.mmappedData );
+    };
+
+    void Unmap()
+    {
+      if ( mmappedData ) munmap( mmappedData, m * n * sizeof(T) );
+      mmappedData = NULL;
+    };
+
     size_t m = 0;
 
     size_t n = 0;
@@ -912,8 +1389,6 @@ class OOCData : public ReadWrite
     /** Use mmap */
     T *mmappedData = NULL;
 
-    int fd = -1;
-
 }; /** end class OOCData */
 
 
@@ -1,6 +1,10 @@
 #ifndef DISTDATA_HPP
 #define DISTDATA_HPP
 
+#include <list>
+#include <memory>
+#include <mutex>
+
 #include <Data.hpp>
 #include <hmlp_mpi.hpp>
 
@@ -73,15 +77,19 @@ int AlltoallData( size_t m,
 
   vector<T> sendbuf;
   vector<T> recvbuf;
-  vector<int> sendcounts( size, 0 );
-  vector<int> recvcounts( size, 0 );
-  vector<int> sdispls( size + 1, 0 );
-  vector<int> rdispls( size + 1, 0 );
+  vector<size_t> sendcounts( size, 0 );
+  vector<size_t> recvcounts( size, 0 );
+  vector<size_t> sdispls( size + 1, 0 );
+  vector<size_t> rdispls( size + 1, 0 );
 
   for ( size_t p = 0; p < size; p ++ )
   {
     sendcounts[ p ] = sendvector[ p ].size();
     sdispls[ p + 1 ] = sdispls[ p ] + sendcounts[ p ];
+  }
+  sendbuf.reserve( sdispls[ size ] );
+  for ( size_t p = 0; p < size; p ++ )
+  {
     sendbuf.insert( sendbuf.end(), 
         sendvector[ p ].begin(), 
         sendvector[ p ].end() );
@@ -101,8 +109,8 @@ int AlltoallData( size_t m,
   /** Resize receving buffer. */
   recvbuf.resize( total_recvcount );
 
-  Alltoallv( sendbuf.data(), sendcounts.data(), sdispls.data(), 
-             recvbuf.data(), recvcounts.data(), rdispls.data(), comm );
+  Alltoallv64( sendbuf.data(), sendcounts, sdispls, 
+               recvbuf.data(), recvcounts, rdispls, comm );
 
   //printf( "after Alltoallv\n" ); fflush( stdout );
 
@@ -158,6 +166,357 @@ typedef enum
 } Distribution_t;
 
 
+/** The number of redistribution plans kept alive (LRU). */
+#ifndef HMLP_REDISTRIBUTION_PLAN_CACHE_SIZE
+#define HMLP_REDISTRIBUTION_PLAN_CACHE_SIZE 8
+#endif
+
+
+/**
+ *  @brief Persistent (grow-only) buffers used by RedistributionPlan. There
+ *         is one set of buffers per value type and allocator, so repeated
+ *         redistributions do not allocate. A pending RedistributionRequest
+ *         borrows send and recv, and gives them back in Wait().
+ */ 
+template<typename T, class Allocator>
+struct RedistributionBuffer
+{
+  vector<T, Allocator> send;
+  vector<T, Allocator> recv;
+  /** Only used (and released) by AlltoallvChunked() when counts overflow int. */
+  vector<T, Allocator> sendstage;
+  vector<T, Allocator> recvstage;
+
+  static RedistributionBuffer<T, Allocator> & Get()
+  {
+    static RedistributionBuffer<T, Allocator> buffer;
+    return buffer;
+  };
+
+  static void Reserve( vector<T, Allocator> &buf, size_t n )
+  {
+    if ( buf.size() < n ) buf.resize( n );
+  };
+
+  /** Keep the larger of the two buffers in the pool. */
+  static void GiveBack( vector<T, Allocator> &pool, vector<T, Allocator> &buf )
+  {
+    if ( buf.size() > pool.size() ) std::swap( pool, buf );
+  };
+}; /** end struct RedistributionBuffer */
+
+
+class RedistributionPlan;
+
+/**
+ *  @brief A redistribution started by RedistributionPlan::ExchangeBegin().
+ *         The exchange is nonblocking (MPI_Ialltoallv) unless the counts
+ *         overflow int. Wait() completes it and unpacks into the 
+ *         destination storage, which must stay alive until then.
+ */ 
+template<typename T, class Allocator>
+class RedistributionRequest
+{
+  public:
+
+    RedistributionRequest() {};
+
+    RedistributionRequest( const RedistributionRequest& ) = delete;
+
+    RedistributionRequest& operator = ( const RedistributionRequest& ) = delete;
+
+    ~RedistributionRequest() { Wait(); };
+
+    bool IsPending() { return pending; };
+
+    void Wait()
+    {
+      if ( !pending ) return;
+      if ( posted ) mpi::Wait( &request, MPI_STATUS_IGNORE );
+
+      /** Unpack directly into the destination storage. */
+      const T *recvbuf = recv.data();
+      #pragma omp parallel for
+      for ( size_t e = 0; e < rpos->size(); e ++ )
+      {
+        T *to = dst + (*rpos)[ e ] * dst_pos_stride;
+        for ( size_t k = 0; k < len; k ++ ) 
+          to[ k * dst_k_stride ] = recvbuf[ e * len + k ];
+      }
+
+      /** Return the buffers to the pool. */
+      auto &pool = RedistributionBuffer<T, Allocator>::Get();
+      RedistributionBuffer<T, Allocator>::GiveBack( pool.send, send );
+      RedistributionBuffer<T, Allocator>::GiveBack( pool.recv, recv );
+      pending = false;
+      posted = false;
+      plan.reset();
+    };
+
+  private:
+
+    friend class RedistributionPlan;
+
+    bool pending = false;
+
+    bool posted = false;
+
+    mpi::Request request;
+
+    /** MPI requires these to be valid until completion. */
+    vector<int> sendcounts, sdispls, recvcounts, rdispls;
+
+    vector<T, Allocator> send, recv;
+
+    /** Keep the plan (which owns rpos) alive until completion. */
+    shared_ptr<RedistributionPlan> plan;
+
+    /** Where to unpack. */
+    const vector<size_t> *rpos = NULL;
+    size_t len = 0;
+    T *dst = NULL;
+    size_t dst_pos_stride = 0;
+    size_t dst_k_stride = 0;
+
+}; /** end class RedistributionRequest */
+
+
+/**
+ *  @brief Communication plan between an IDS distribution (CIDS or RIDS)
+ *         and the cyclic BLK distribution (CBLK or RBLK), where gid is 
+ *         owned by rank ( gid % size ) at position ( gid / size ).
+ *
+ *         The plan only depends on ids and the communicator. It is built
+ *         once with one AlltoallVector() of ids and then serves both
+ *         directions (IDS to BLK and BLK to IDS) for all value types.
+ *         Entries are packed directly from the source storage into a 
+ *         persistent send buffer and unpacked directly into the target
+ *         storage without per-rank intermediates.
+ */ 
+class RedistributionPlan : public enable_shared_from_this<RedistributionPlan>
+{
+  public:
+
+    RedistributionPlan( const vector<size_t> &ids, mpi::Comm comm )
+    {
+      this->ids = ids;
+      this->comm = comm;
+      this->key = Hash( ids );
+      mpi::Comm_size( comm, &size );
+      mpi::Comm_rank( comm, &rank );
+
+      /** Group local positions of ids by their BLK owners. */
+      ids_offset.resize( size + 1, 0 );
+      for ( auto gid : ids ) ids_offset[ gid % size + 1 ] ++;
+      for ( int p = 0; p < size; p ++ ) ids_offset[ p + 1 ] += ids_offset[ p ];
+
+      vector<size_t> head( ids_offset.begin(), ids_offset.end() - 1 );
+      vector<vector<size_t>> sendids( size ), recvids( size );
+      ids_pos.resize( ids.size() );
+      for ( int p = 0; p < size; p ++ ) 
+        sendids[ p ].reserve( ids_offset[ p + 1 ] - ids_offset[ p ] );
+      for ( size_t i = 0; i < ids.size(); i ++ )
+      {
+        size_t owner = ids[ i ] % size;
+        ids_pos[ head[ owner ] ++ ] = i;
+        sendids[ owner ].push_back( ids[ i ] );
+      }
+
+      /** Tell each BLK owner which gids are required (one time only). */
+      mpi::AlltoallVector( sendids, recvids, comm );
+
+      /** Local positions of the requested gids in BLK distribution. */
+      blk_offset.resize( size + 1, 0 );
+      for ( int p = 0; p < size; p ++ ) 
+        blk_offset[ p + 1 ] = blk_offset[ p ] + recvids[ p ].size();
+      blk_pos.resize( blk_offset[ size ] );
+      for ( int p = 0; p < size; p ++ )
+      {
+        for ( size_t i = 0; i < recvids[ p ].size(); i ++ )
+        {
+          size_t gid = recvids[ p ][ i ];
+          assert( gid % size == rank );
+          blk_pos[ blk_offset[ p ] + i ] = gid / size;
+        }
+      }
+
+      /** Decide (globally) whether int counts can overflow. */
+      size_t my_entries = std::max( ids_offset[ size ], blk_offset[ size ] );
+      mpi::Allreduce( &my_entries, &max_entries, 1, MPI_MAX, comm );
+    };
+
+    /** Return true if the plan was built for the same ids and comm. */
+    bool Matches( const vector<size_t> &ids, size_t key, mpi::Comm comm ) const
+    {
+      int comm_size = 0; mpi::Comm_size( comm, &comm_size );
+      return ( this->comm == comm ) && ( size == comm_size ) && 
+             ( this->key == key ) && ( this->ids == ids );
+    };
+
+    static size_t Hash( const vector<size_t> &ids )
+    {
+      size_t seed = ids.size();
+      for ( auto gid : ids ) 
+        seed ^= gid + 0x9e3779b97f4a7c15 + ( seed << 6 ) + ( seed >> 2 );
+      return seed;
+    };
+
+    /**
+     *  @brief Move entries from IDS to BLK distribution (to_blk = true) or
+     *         from BLK to IDS distribution (to_blk = false). Each entry
+     *         (a column or a row) has length len, and its k-th element
+     *         at local position pos is buf[ pos * pos_stride + k * k_stride ].
+     *         This only packs and posts the exchange; request.Wait() 
+     *         completes it, so computation can be overlapped in between.
+     */ 
+    template<typename T, class Allocator>
+    void ExchangeBegin( bool to_blk, size_t len,
+        const T *src, size_t src_pos_stride, size_t src_k_stride,
+              T *dst, size_t dst_pos_stride, size_t dst_k_stride,
+        RedistributionRequest<T, Allocator> &request )
+    {
+      /** Complete the previous exchange (if any). */
+      request.Wait();
+
+      auto &pool = RedistributionBuffer<T, Allocator>::Get();
+
+      const vector<size_t> &spos = to_blk ? ids_pos : blk_pos;
+      const vector<size_t> &soff = to_blk ? ids_offset : blk_offset;
+      const vector<size_t> &rpos = to_blk ? blk_pos : ids_pos;
+      const vector<size_t> &roff = to_blk ? blk_offset : ids_offset;
+
+      /** Borrow the persistent buffers. */
+      std::swap( request.send, pool.send );
+      std::swap( request.recv, pool.recv );
+      RedistributionBuffer<T, Allocator>::Reserve( request.send, spos.size() * len );
+      RedistributionBuffer<T, Allocator>::Reserve( request.recv, rpos.size() * len );
+      T *sendbuf = request.send.data();
+      T *recvbuf = request.recv.data();
+
+      /** Pack directly from the source storage. */
+      #pragma omp parallel for
+      for ( size_t e = 0; e < spos.size(); e ++ )
+      {
+        const T *from = src + spos[ e ] * src_pos_stride;
+        for ( size_t k = 0; k < len; k ++ ) 
+          sendbuf[ e * len + k ] = from[ k * src_k_stride ];
+      }
+
+      request.pending = true;
+      request.plan = shared_from_this();
+      request.rpos = &rpos;
+      request.len = len;
+      request.dst = dst;
+      request.dst_pos_stride = dst_pos_stride;
+      request.dst_k_stride = dst_k_stride;
+
+      /** All ranks agree on the protocol, since max_entries is global. */
+      if ( max_entries * len > INT_MAX )
+      {
+        vector<size_t> sendcounts( size ), sdispls( size );
+        vector<size_t> recvcounts( size ), rdispls( size );
+        for ( int p = 0; p < size; p ++ )
+        {
+          sendcounts[ p ] = ( soff[ p + 1 ] - soff[ p ] ) * len;
+          recvcounts[ p ] = ( roff[ p + 1 ] - roff[ p ] ) * len;
+          sdispls[ p ] = soff[ p ] * len;
+          rdispls[ p ] = roff[ p ] * len;
+        }
+        mpi::AlltoallvChunked( sendbuf, sendcounts, sdispls, 
+            recvbuf, recvcounts, rdispls, comm, pool.sendstage, pool.recvstage );
+      }
+      else
+      {
+        request.sendcounts.resize( size ); request.sdispls.resize( size );
+        request.recvcounts.resize( size ); request.rdispls.resize( size );
+        for ( int p = 0; p < size; p ++ )
+        {
+          request.sendcounts[ p ] = ( soff[ p + 1 ] - soff[ p ] ) * len;
+          request.recvcounts[ p ] = ( roff[ p + 1 ] - roff[ p ] ) * len;
+          request.sdispls[ p ] = soff[ p ] * len;
+          request.rdispls[ p ] = roff[ p ] * len;
+        }
+        mpi::Ialltoallv( 
+            sendbuf, request.sendcounts.data(), request.sdispls.data(),
+            recvbuf, request.recvcounts.data(), request.rdispls.data(), 
+            comm, &(request.request) );
+        request.posted = true;
+      }
+    };
+
+    /** @brief Blocking version of ExchangeBegin(). */
+    template<typename T, class Allocator>
+    void Exchange( bool to_blk, size_t len,
+        const T *src, size_t src_pos_stride, size_t src_k_stride,
+              T *dst, size_t dst_pos_stride, size_t dst_k_stride )
+    {
+      RedistributionRequest<T, Allocator> request;
+      ExchangeBegin( to_blk, len, 
+          src, src_pos_stride, src_k_stride,
+          dst, dst_pos_stride, dst_k_stride, request );
+      request.Wait();
+    };
+
+  private:
+
+    /** IDS distribution (in the original order) and its hash key. */
+    vector<size_t> ids;
+    size_t key = 0;
+
+    mpi::Comm comm = MPI_COMM_WORLD;
+    int size = 1;
+    int rank = 0;
+
+    /** Local positions of ids grouped by BLK owners. */
+    vector<size_t> ids_pos;
+    vector<size_t> ids_offset;
+
+    /** Local BLK positions requested by each rank. */
+    vector<size_t> blk_pos;
+    vector<size_t> blk_offset;
+
+    /** The maximum number of entries sent or received by any rank. */
+    size_t max_entries = 0;
+
+}; /** end class RedistributionPlan */
+
+
+/**
+ *  @brief Return a cached RedistributionPlan of ( ids, comm ) or build one.
+ *         This routine is collective: all ranks must agree on a cache hit,
+ *         otherwise the plan is rebuilt everywhere.
+ */ 
+inline shared_ptr<RedistributionPlan> GetRedistributionPlan( 
+    const vector<size_t> &ids, mpi::Comm comm )
+{
+  static std::mutex cache_lock;
+  static list<shared_ptr<RedistributionPlan>> cache;
+
+  std::lock_guard<std::mutex> guard( cache_lock );
+
+  size_t key = RedistributionPlan::Hash( ids );
+  auto it = cache.begin();
+  while ( it != cache.end() && !(*it)->Matches( ids, key, comm ) ) it ++;
+
+  int is_hit = ( it != cache.end() ), all_hit = 0;
+  mpi::Allreduce( &is_hit, &all_hit, 1, MPI_MIN, comm );
+
+  if ( all_hit )
+  {
+    /** Move to the front (most recently used). */
+    cache.splice( cache.begin(), cache, it );
+  }
+  else
+  {
+    if ( is_hit ) cache.erase( it );
+    cache.push_front( make_shared<RedistributionPlan>( ids, comm ) );
+    if ( cache.size() > HMLP_REDISTRIBUTION_PLAN_CACHE_SIZE ) cache.pop_back();
+  }
+  return cache.front();
+}; /** end GetRedistributionPlan() */
+
+
+
 #ifdef HMLP_MIC_AVX512
 /** use hbw::allocator for Intel Xeon Phi */
 template<class T, class Allocator = hbw::allocator<T> >
@@ -535,62 +894,30 @@ class DistData<STAR, CBLK, T> : public DistDataBase<T>
     };
 
     
+    /** 
+     *  Start a nonblocking redistribution from CIDS to CBLK. Both A and 
+     *  this must stay alive until request.Wait() returns.
+     */
+    void RedistributeBegin( DistData<STAR, CIDS, T> &A, 
+        RedistributionRequest<T, ALLOCATOR> &request )
+    {
+      size_t m = this->row();
+      A.GetRedistributionPlan()->template ExchangeBegin<T, ALLOCATOR>( true, m, 
+          A.data(), m, 1, this->data(), m, 1, request );
+    };
+
     /** Redistribute from CIDS to CBLK */
     DistData<STAR, CBLK, T> & operator = ( DistData<STAR, CIDS, T> &A )
     {
-      /** MPI */
-      mpi::Comm comm = this->GetComm();
-      int size = this->GetSize();
-      int rank = this->GetRank();
-
-      /** allocate buffer for ids */
-      vector<vector<size_t>> sendids = A.CBLKOwnership();
-      vector<vector<size_t>> recvids( size );
-
-      /** exchange cids */
-      mpi::AlltoallVector( sendids, recvids, comm );
-      
-      /** allocate buffer for data */
-      vector<vector<T, ALLOCATOR>> senddata( size );
-      vector<vector<T, ALLOCATOR>> recvdata( size );
-
-      vector<size_t> amap( this->row() );
-      for ( size_t i = 0; i < amap.size(); i ++ ) amap[ i ] = i;
-
-      /** extract rows from A<STAR, CIDS> */
-      #pragma omp parallel for
-      for ( size_t p = 0; p < size; p ++ )
-      {
-        /** recvids should be gids (not local posiiton) */
-        senddata[ p ] = A( amap, sendids[ p ] );
-      }
-
-      /** exchange data */
-      mpi::AlltoallVector( senddata, recvdata, comm );
-
+      /** The plan (ids exchange) is cached and shared with A. */
+      auto plan = A.GetRedistributionPlan();
       /** 
        *  It is possible that the received cid has several copies on
        *  different MPI rank.
        */
-
-      #pragma omp parallel for 
-      for ( size_t p = 0; p < size; p ++ )
-      {
-        size_t ld = this->row();
-
-        for ( size_t j = 0; j < recvids[ p ].size(); j ++ )
-        {
-          size_t cid = recvids[ p ][ j ];
-
-          for ( size_t i = 0; i < this->row(); i ++ )
-          {
-            (*this)( i, cid ) = recvdata[ p ][ j * ld + i ];
-          }
-        };
-      };
-
-      mpi::Barrier( comm );
-      /** free all buffers and return */
+      size_t m = this->row();
+      plan->template Exchange<T, ALLOCATOR>( true, m, 
+          A.data(), m, 1, this->data(), m, 1 );
       return (*this);
     };
 
@@ -721,53 +1048,11 @@ class DistData<RBLK, STAR, T> : public DistDataBase<T>
     /** redistribute from RIDS to RBLK */
     DistData<RBLK, STAR, T> & operator = ( DistData<RIDS, STAR, T> &A )
     {
-      /** MPI */
-      mpi::Comm comm = this->GetComm();
-      int size = this->GetSize();
-      int rank = this->GetRank();
-
-      /** allocate buffer for ids */
-      vector<vector<size_t>> sendids = A.RBLKOwnership();
-      vector<vector<size_t>> recvids( size );
-
-      /** Exchange rids. */
-      mpi::AlltoallVector( sendids, recvids, comm );
-      
-      /** Allocate buffer for data. */
-      vector<vector<T, ALLOCATOR>> senddata( size );
-      vector<vector<T, ALLOCATOR>> recvdata( size );
-
-      vector<size_t> bmap( this->col() );
-      for ( size_t j = 0; j < bmap.size(); j ++ ) bmap[ j ] = j;
-
-      /** Extract rows from A<RBLK,STAR> */
-      #pragma omp parallel for 
-      for ( size_t p = 0; p < size; p ++ )
-      {
-        /** recvids should be gids (not local posiiton) */
-        senddata[ p ] = A( sendids[ p ], bmap );
-      }
-
-      /** exchange data */
-      mpi::AlltoallVector( senddata, recvdata, comm );
-
-      #pragma omp parallel for 
-      for ( size_t p = 0; p < size; p ++ )
-      {
-        size_t ld = recvdata[ p ].size() / this->col();
-        assert( ld == recvids[ p ].size() );
-        for ( size_t i = 0; i < recvids[ p ].size(); i ++ )
-        {
-          size_t rid = recvids[ p ][ i ];
-          for ( size_t j = 0; j < this->col(); j ++ )
-          {
-            (*this)( rid, j ) = recvdata[ p ][ j * ld + i ];
-          }
-        };
-      };
-
-      mpi::Barrier( comm );
-      /** free all buffers and return */
+      /** The plan (ids exchange) is cached and shared with A. */
+      auto plan = A.GetRedistributionPlan();
+      /** Rows are strided by the local leading dimension. */
+      plan->template Exchange<T, ALLOCATOR>( true, this->col(), 
+          A.data(), 1, A.row_owned(), this->data(), 1, this->row_owned() );
       return (*this);
     };
 
@@ -936,69 +1221,21 @@ class DistData<STAR, CIDS, T> : public DistDataBase<T>
 
 
 
+    /** Return the (cached) communication plan between CIDS and CBLK. */
+    shared_ptr<RedistributionPlan> GetRedistributionPlan()
+    {
+      if ( !plan ) plan = hmlp::GetRedistributionPlan( cids, this->GetComm() );
+      return plan;
+    };
+
     /** Redistribution from CBLK to CIDS */
     DistData<STAR, CIDS, T> & operator = ( DistData<STAR, CBLK, T> &A )
     {
       /** assertion: must provide rids */
       assert( cids.size() );
-
-      /** MPI */
-      mpi::Comm comm = this->GetComm();
-      int size = this->GetSize();
-      int rank = this->GetRank();
-
-      /** allocate buffer for ids */
-      vector<vector<size_t>> sendids = CBLKOwnership();
-      vector<vector<size_t>> recvids( size );
-
-      /** 
-       *  exchange cids: 
-       *
-       *  sendids contain all  required ids from each rank
-       *  recvids contain all requested ids from each rank
-       *
-       */
-      mpi::AlltoallVector( sendids, recvids, comm );
-
-
-      /** allocate buffer for data */
-      vector<vector<T, ALLOCATOR>> senddata( size );
-      vector<vector<T, ALLOCATOR>> recvdata( size );
-
-      vector<size_t> amap( this->row() );
-      for ( size_t i = 0; i < amap.size(); i ++ ) amap[ i ] = i;
-
-
-      /** extract columns from A<STAR,CBLK> */
-      #pragma omp parallel for 
-      for ( size_t p = 0; p < size; p ++ )
-      {
-        /** recvids should be gids (not local posiiton) */
-        senddata[ p ] = A( amap, recvids[ p ] );
-        assert( senddata[ p ].size() == amap.size() * recvids[ p ].size() );
-      }
-
-      /** exchange data */
-      mpi::AlltoallVector( senddata, recvdata, comm );
-
-      #pragma omp parallel for 
-      for ( size_t p = 0; p < size; p ++ )
-      {
-        assert( recvdata[ p ].size() == sendids[ p ].size() * this->row() );
-
-        size_t ld = this->row();
-
-        for ( size_t j = 0; j < sendids[ p ].size(); j ++ )
-        {
-          size_t cid = sendids[ p ][ j ];
-          for ( size_t i = 0; i < this->row(); i ++ )
-          {
-            (*this)( i, cid ) = recvdata[ p ][ j * ld + i ];
-          }
-        };
-      };
-
-      mpi::Barrier( comm );
+      size_t m = this->row();
+      GetRedistributionPlan()->template Exchange<T, ALLOCATOR>( false, m,
+          A.data(), m, 1, this->data(), m, 1 );
       return *this;
     };
 
@@ -1011,6 +1248,9 @@ class DistData<STAR, CIDS, T> : public DistDataBase<T>
     /** Use hash table: cid2col[ cid ] = local column index */
     unordered_map<size_t, size_t> cid2col;
 
+    /** Communication plan between CIDS and CBLK. */
+    shared_ptr<RedistributionPlan> plan;
+
 }; /** end class DistData<STAR, CIDS, T> */
 
 
@@ -1314,6 +1554,13 @@ class DistData<RIDS, STAR, T> : public DistDataBase<T>
 
 
 
+    /** Return the (cached) communication plan between RIDS and RBLK. */
+    shared_ptr<RedistributionPlan> GetRedistributionPlan()
+    {
+      if ( !plan ) plan = hmlp::GetRedistributionPlan( rids, this->GetComm() );
+      return plan;
+    };
+
     /**
      *  redistribution from RBLK to RIDS (MPI_Alltoallv) 
      */
@@ -1321,84 +1568,9 @@ class DistData<RIDS, STAR, T> : public DistDataBase<T>
     {
       /** assertion: must provide rids */
       assert( rids.size() );
-
-      /** MPI */
-      mpi::Comm comm = this->GetComm();
-      int size = this->GetSize();
-      int rank = this->GetRank();
-
-      //printf( "Enter redistrivution rids.size() %lu\n", rids.size() ); fflush( stdout );
-      //mpi::Barrier( comm );
-
-      /** allocate buffer for ids */
-      std::vector<std::vector<size_t>> sendids = RBLKOwnership();
-      std::vector<std::vector<size_t>> recvids( size );
-
-      //for ( size_t i = 0; i < rids.size(); i ++ )
-      //{
-      //  /** since A has RBLK distribution, rid is stored at rank (rid) % size */
-      //  size_t rid = rids[ i ];
-      //  /** ( rid / size ) is the local id of A */
-      //  sendids[ rid % size ].push_back( rid );
-      //}
-
-      //printf( "before All2allvector1\n" ); fflush( stdout );
-      //mpi::Barrier( comm );
-
-      /** 
-       *  exchange rids: 
-       *
-       *  sendids contain all  required ids from each rank
-       *  recvids contain all requested ids from each rank
-       *
-       */
-      mpi::AlltoallVector( sendids, recvids, comm );
-
-      //printf( "Finish All2allvector1\n" );fflush( stdout );
-      //mpi::Barrier( comm );
-
-
-      std::vector<std::vector<T, ALLOCATOR>> senddata( size );
-      std::vector<std::vector<T, ALLOCATOR>> recvdata( size );
-
-      std::vector<size_t> bmap( this->col() );
-      for ( size_t j = 0; j < bmap.size(); j ++ ) bmap[ j ] = j;
-
-      /** extract rows from A<RBLK,STAR> */
-      #pragma omp parallel for 
-      for ( size_t p = 0; p < size; p ++ )
-      {
-        /** recvids should be gids (not local posiiton) */
-        senddata[ p ] = A( recvids[ p ], bmap );
-        assert( senddata[ p ].size() == recvids[ p ].size() * bmap.size() );
-      }
-
-      //printf( "before All2allvector2\n" ); fflush( stdout );
-      /** exchange data */
-      mpi::AlltoallVector( senddata, recvdata, comm );
-
-
-      #pragma omp parallel for 
-      for ( size_t p = 0; p < size; p ++ )
-      {
-        assert( recvdata[ p ].size() == sendids[ p ].size() * this->col() );
-
-        size_t ld = recvdata[ p ].size() / this->col();
-
-        assert( ld == sendids[ p ].size() );
-
-
-        for ( size_t i = 0; i < sendids[ p ].size(); i ++ )
-        {
-          size_t rid = sendids[ p ][ i ];
-          for ( size_t j = 0; j < this->col(); j ++ )
-          {
-            (*this)( rid, j ) = recvdata[ p ][ j * ld + i ];
-          }
-        };
-      };
-      mpi::Barrier( comm );
-
+      /** Rows are strided by the local leading dimension. */
+      GetRedistributionPlan()->template Exchange<T, ALLOCATOR>( false, this->col(),
+          A.data(), 1, A.row_owned(), this->data(), 1, this->row_owned() );
       return (*this);
     };
 
@@ -1415,6 +1587,8 @@ class DistData<RIDS, STAR, T> : public DistDataBase<T>
 
     map<size_t, size_t> rid2row;
 
+    /** Communication plan between RIDS and RBLK. */
+    shared_ptr<RedistributionPlan> plan;
 
 }; /** end class DistData<RIDS, STAR, T> */
 
@@ -0,0 +1,129 @@
+/**
+ *  HMLP (High-Performance Machine Learning Primitives)
+ *
+ *  Copyright (C) 2014-2018, The University of Texas at Austin
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see the LICENSE file.
+ *
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <base/arch.hpp>
+
+namespace hmlp
+{
+namespace arch
+{
+
+/** The package selected by select(); HMLP_ARCH_UNSUPPORTED if not yet. */
+static hmlpArch_t selected_arch = HMLP_ARCH_UNSUPPORTED;
+
+const char* getName( hmlpArch_t arch )
+{
+  switch ( arch )
+  {
+    case HMLP_ARCH_SANDYBRIDGE:
+      return "sandybridge";
+    case HMLP_ARCH_HASWELL:
+      return "haswell";
+    case HMLP_ARCH_SKX:
+      return "skx";
+    default:
+      return "unsupported";
+  }
+}; /* end getName() */
+
+hmlpArch_t parse( const char* name )
+{
+  for ( auto arch : { HMLP_ARCH_SANDYBRIDGE, HMLP_ARCH_HASWELL, HMLP_ARCH_SKX } )
+  {
+    if ( name && !strcmp( name, getName( arch ) ) ) return arch;
+  }
+  return HMLP_ARCH_UNSUPPORTED;
+}; /* end parse() */
+
+hmlpArch_t detect()
+{
+#if defined(__x86_64__) && ( defined(__GNUC__) || defined(__clang__) )
+  /** __builtin_cpu_supports() also checks whether the OS saves the registers (XCR0). */
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx512f" )  && __builtin_cpu_supports( "avx512cd" ) &&
+       __builtin_cpu_supports( "avx512bw" ) && __builtin_cpu_supports( "avx512dq" ) &&
+       __builtin_cpu_supports( "avx512vl" ) )
+    return HMLP_ARCH_SKX;
+  if ( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" ) )
+    return HMLP_ARCH_HASWELL;
+  if ( __builtin_cpu_supports( "avx" ) )
+    return HMLP_ARCH_SANDYBRIDGE;
+#endif
+  return HMLP_ARCH_UNSUPPORTED;
+}; /* end detect() */
+
+hmlpError_t select( hmlpArch_t arch )
+{
+  hmlpArch_t cpu = detect();
+  if ( arch == HMLP_ARCH_UNSUPPORTED || arch > cpu )
+  {
+    fprintf( stderr, "Error: the %s package cannot run on this CPU (%s)\n",
+        getName( arch ), getName( cpu ) );
+    return HMLP_ERROR_NOT_SUPPORTED;
+  }
+  #pragma omp critical (arch)
+  selected_arch = arch;
+  return HMLP_ERROR_SUCCESS;
+}; /* end select() */
+
+hmlpError_t select()
+{
+  hmlpArch_t arch = detect();
+  /** Allow users to pin a less capable package, e.g. for benchmarking. */
+  const char* str = getenv( "HMLP_FORCE_ARCH" );
+  if ( str )
+  {
+    arch = parse( str );
+    if ( arch == HMLP_ARCH_UNSUPPORTED )
+    {
+      fprintf( stderr, "Error: HMLP_FORCE_ARCH=%s is not one of sandybridge, haswell, skx\n", str );
+      return HMLP_ERROR_INVALID_VALUE;
+    }
+  }
+  return select( arch );
+}; /* end select() */
+
+hmlpArch_t getSelected()
+{
+  if ( selected_arch == HMLP_ARCH_UNSUPPORTED )
+  {
+    /** Primitives may be called without hmlp_init(). */
+    auto error = select();
+    if ( error != HMLP_ERROR_SUCCESS ) select( detect() );
+  }
+  return selected_arch;
+}; /* end getSelected() */
+
+hmlpArch_t getPackage( const char* primitive, std::initializer_list<hmlpArch_t> available )
+{
+  hmlpArch_t arch = getSelected();
+  for ( auto candidate : available )
+  {
+    if ( candidate <= arch ) return candidate;
+  }
+  fprintf( stderr, "Error: %s() has no kernel package for %s\n", primitive, getName( arch ) );
+  exit( 1 );
+}; /* end getPackage() */
+
+}; /* end namespace arch */
+}; /* end namespace hmlp */
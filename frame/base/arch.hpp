@@ -0,0 +1,83 @@
+/**
+ *  HMLP (High-Performance Machine Learning Primitives)
+ *
+ *  Copyright (C) 2014-2018, The University of Texas at Austin
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see the LICENSE file.
+ *
+ **/
+
+
+#ifndef HMLP_ARCH_HPP
+#define HMLP_ARCH_HPP
+
+#include <initializer_list>
+/** Use hmlpError_t. */
+#include <hmlp.h>
+
+namespace hmlp
+{
+
+/**
+ *  @brief The x86_64 micro-architectures that have their own kernel package
+ *         (kernel/x86_64/* and package/x86_64/*). They are ordered by their
+ *         instruction sets, so a package can run on any larger value.
+ */
+typedef enum
+{
+  HMLP_ARCH_UNSUPPORTED,
+  HMLP_ARCH_SANDYBRIDGE, /* AVX */
+  HMLP_ARCH_HASWELL,     /* AVX2 and FMA3 */
+  HMLP_ARCH_SKX          /* AVX-512 F/CD/BW/DQ/VL */
+} hmlpArch_t;
+
+namespace arch
+{
+
+/** @brief Return the name of the package (e.g. "haswell"). */
+const char* getName( hmlpArch_t arch );
+
+/** @brief Parse a package name; return HMLP_ARCH_UNSUPPORTED otherwise. */
+hmlpArch_t parse( const char* name );
+
+/** @brief The best package supported by this CPU and OS (using CPUID). */
+hmlpArch_t detect();
+
+/**
+ *  @brief Select the package used by the runtime dispatch. The CPUID result
+ *         can be lowered with the environment variable HMLP_FORCE_ARCH.
+ *         This is called by hmlp_init(), and the selection is kept for
+ *         the rest of the program.
+ *  @return HMLP_ERROR_NOT_SUPPORTED if the CPU has no supported package or
+ *          HMLP_FORCE_ARCH asks for an instruction set the CPU does not have.
+ */
+hmlpError_t select();
+
+/** @brief Overwrite the selection; fail if the CPU cannot run the package. */
+hmlpError_t select( hmlpArch_t arch );
+
+/** @brief Return the selected package (select() on the first call). */
+hmlpArch_t getSelected();
+
+/**
+ *  @brief Return the first package in the list (from the most to the least
+ *         capable) that can run on the selected architecture. Primitives
+ *         that are not available in any of them exit with an error.
+ */
+hmlpArch_t getPackage( const char* primitive, std::initializer_list<hmlpArch_t> available );
+
+}; /* end namespace arch */
+}; /* end namespace hmlp */
+
+#endif /* define HMLP_ARCH_HPP */
@@ -39,6 +39,36 @@ extern "C"
 namespace hmlp
 {
 
+/** 
+ *  BLAS threading control
+ */
+
+int xblas_set_num_threads( int n )
+{
+#if defined(USE_INTEL) && defined(USE_BLAS)
+  int previous = MKL_Get_Max_Threads();
+  MKL_Set_Num_Threads( n );
+  return previous;
+#elif defined(HMLP_USE_OPENBLAS)
+  int previous = openblas_get_num_threads();
+  openblas_set_num_threads( n );
+  return previous;
+#else
+  return 1;
+#endif
+}; /** end xblas_set_num_threads() */
+
+int xblas_set_num_threads_local( int n )
+{
+#if defined(USE_INTEL) && defined(USE_BLAS)
+  return MKL_Set_Num_Threads_Local( n );
+#else
+  return -1;
+#endif
+}; /** end xblas_set_num_threads_local() */
+
+
+
 /** 
  *  BLAS level-1 wrappers: DOT, NRM2 
  */
@@ -167,6 +167,19 @@ float  xdot( int n, const  float *dx, int incx, const  float *dy, int incy );
 double xnrm2( int n, double *x, int incx );
 float  xnrm2( int n,  float *x, int incx );
 
+/** 
+ *  @brief Set the number of BLAS threads of the process and return the 
+ *         previous one. Single-threaded BLAS always returns 1.
+ */
+int xblas_set_num_threads( int n );
+
+/** 
+ *  @brief Set the number of BLAS threads for calls from the calling thread
+ *         only (MKL). Return the previous setting (0 means the process 
+ *         setting), or -1 if the library has no thread-local control.
+ */
+int xblas_set_num_threads_local( int n );
+
 
 
 #ifdef HMLP_USE_CUDA
@@ -0,0 +1,279 @@
+/**
+ *  HMLP (High-Performance Machine Learning Primitives)
+ *
+ *  Copyright (C) 2014-2018, The University of Texas at Austin
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see the LICENSE file.
+ *
+ **/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <base/costmodel.hpp>
+
+using namespace std;
+
+
+namespace hmlp
+{
+namespace costmodel
+{
+
+namespace
+{
+
+/** Sufficient statistics of the least squares fit (flops and mops in G). */
+struct stats_s
+{
+  double n = 0.0;
+  double f = 0.0, m = 0.0, s = 0.0;
+  double ff = 0.0, fm = 0.0, mm = 0.0;
+  double fs = 0.0, ms = 0.0;
+
+  void add( double gf, double gm, double sec )
+  {
+    n += 1.0; f += gf; m += gm; s += sec;
+    ff += gf * gf; fm += gf * gm; mm += gm * gm;
+    fs += gf * sec; ms += gm * sec;
+  };
+
+  void add( const stats_s &other )
+  {
+    n += other.n; f += other.f; m += other.m; s += other.s;
+    ff += other.ff; fm += other.fm; mm += other.mm;
+    fs += other.fs; ms += other.ms;
+  };
+};
+
+/** The samples of all runs (loaded and folded in by update()). */
+map<string, stats_s> stats;
+
+/** Executions recorded since the last update(); protected by record_lock. */
+map<string, stats_s> pending;
+
+mutex record_lock;
+
+/**
+ *  Models are only refitted by update(), load() and clear() and read without
+ *  locks. Entries are never erased, such that find() can hand out pointers;
+ *  inserting them is protected by record_lock.
+ */
+map<string, model_s> models;
+
+/** -1 means that HMLP_COST_MODEL_FILE has not been checked yet. */
+atomic<int> is_recording( -1 );
+
+/** Task names may contain spaces, but file entries are separated by spaces. */
+string getKey( const string &name )
+{
+  string key = name.empty() ? string( "unnamed" ) : name;
+  replace( key.begin(), key.end(), ' ', '_' );
+  return key;
+};
+
+/**
+ *  @brief Solve the normal equations of the terms in use ( 0: intercept,
+ *         1: flops, 2: mops ) with Gaussian elimination. Return false if
+ *         a term can not be determined by the samples.
+ */
+bool solve( const stats_s &st, const vector<int> &terms, vector<double> &x )
+{
+  /** Moments E[ t_i * t_j ] and E[ t_i * sec ] of the three terms. */
+  double moment[ 3 ][ 3 ] =
+  {
+    { st.n, st.f,  st.m  },
+    { st.f, st.ff, st.fm },
+    { st.m, st.fm, st.mm }
+  };
+  double rhs[ 3 ] = { st.s, st.fs, st.ms };
+  size_t k = terms.size();
+  vector<double> A( k * ( k + 1 ) );
+  for ( size_t i = 0; i < k; i ++ )
+  {
+    for ( size_t j = 0; j < k; j ++ ) A[ i * ( k + 1 ) + j ] = moment[ terms[ i ] ][ terms[ j ] ];
+    A[ i * ( k + 1 ) + k ] = rhs[ terms[ i ] ];
+  }
+  for ( size_t c = 0; c < k; c ++ )
+  {
+    size_t p = c;
+    for ( size_t i = c + 1; i < k; i ++ )
+      if ( fabs( A[ i * ( k + 1 ) + c ] ) > fabs( A[ p * ( k + 1 ) + c ] ) ) p = i;
+    /** Relative to the diagonal, a tiny pivot means collinear terms. */
+    double scale = moment[ terms[ c ] ][ terms[ c ] ];
+    if ( fabs( A[ p * ( k + 1 ) + c ] ) <= 1E-10 * scale || scale == 0.0 ) return false;
+    for ( size_t j = 0; j <= k; j ++ ) swap( A[ c * ( k + 1 ) + j ], A[ p * ( k + 1 ) + j ] );
+    for ( size_t i = 0; i < k; i ++ )
+    {
+      if ( i == c ) continue;
+      double ratio = A[ i * ( k + 1 ) + c ] / A[ c * ( k + 1 ) + c ];
+      for ( size_t j = c; j <= k; j ++ ) A[ i * ( k + 1 ) + j ] -= ratio * A[ c * ( k + 1 ) + j ];
+    }
+  }
+  x.resize( k );
+  for ( size_t i = 0; i < k; i ++ ) x[ i ] = A[ i * ( k + 1 ) + k ] / A[ i * ( k + 1 ) + i ];
+  return true;
+};
+
+/**
+ *  @brief Use the largest set of terms that is determined and has
+ *         nonnegative rates; the intercept alone always works.
+ */
+model_s fit( const stats_s &st )
+{
+  model_s model;
+  model.samples = st.n;
+  for ( auto terms : vector<vector<int>>{ { 0, 1, 2 }, { 0, 1 }, { 0, 2 }, { 0 } } )
+  {
+    vector<double> x;
+    if ( !solve( st, terms, x ) ) continue;
+    bool is_valid = true;
+    for ( size_t i = 1; i < terms.size(); i ++ ) if ( x[ i ] < 0.0 ) is_valid = false;
+    if ( !is_valid ) continue;
+    model = model_s();
+    model.samples = st.n;
+    for ( size_t i = 0; i < terms.size(); i ++ )
+    {
+      if ( terms[ i ] == 0 ) model.intercept = x[ i ];
+      if ( terms[ i ] == 1 ) model.per_gflop = x[ i ];
+      if ( terms[ i ] == 2 ) model.per_gmop  = x[ i ];
+    }
+    break;
+  }
+  return model;
+};
+
+}; /** end unnamed namespace */
+
+
+bool isEnabled()
+{
+  if ( is_recording.load() < 0 )
+  {
+    auto *filename = getenv( "HMLP_COST_MODEL_FILE" );
+    is_recording = ( filename && *filename ) ? 1 : 0;
+  }
+  return is_recording.load();
+};
+
+void enable( bool is_enabled ) { is_recording = is_enabled; };
+
+void record( const string &name, double flops, double mops, double sec )
+{
+  if ( !isEnabled() || !( sec >= 0.0 ) ) return;
+  lock_guard<mutex> guard( record_lock );
+  pending[ getKey( name ) ].add( flops / 1E+9, mops / 1E+9, sec );
+};
+
+void update()
+{
+  lock_guard<mutex> guard( record_lock );
+  for ( auto &it : pending )
+  {
+    auto &st = stats[ it.first ];
+    st.add( it.second );
+    models[ it.first ] = fit( st );
+  }
+  pending.clear();
+};
+
+bool get( const string &name, model_s &model )
+{
+  lock_guard<mutex> guard( record_lock );
+  auto it = models.find( getKey( name ) );
+  if ( it == models.end() || !it->second.samples ) return false;
+  model = it->second;
+  return true;
+};
+
+const model_s* find( const string &name )
+{
+  lock_guard<mutex> guard( record_lock );
+  return &models[ getKey( name ) ];
+};
+
+bool estimate( const string &name, double flops, double mops, float &sec )
+{
+  return estimate( find( name ), flops, mops, sec );
+};
+
+bool estimate( const model_s *model, double flops, double mops, float &sec )
+{
+  if ( !model || !model->samples ) return false;
+  double t = model->intercept + model->per_gflop * flops / 1E+9 + model->per_gmop * mops / 1E+9;
+  sec = max( t, 0.0 );
+  return true;
+};
+
+hmlpError_t load( const char* filename )
+{
+  if ( !filename ) return HMLP_ERROR_INVALID_VALUE;
+  ifstream file( filename );
+  if ( !file ) return HMLP_ERROR_INVALID_VALUE;
+  lock_guard<mutex> guard( record_lock );
+  string line;
+  while ( getline( file, line ) )
+  {
+    if ( line.empty() || line[ 0 ] == '#' ) continue;
+    istringstream entry( line );
+    string name;
+    stats_s st;
+    if ( !( entry >> name >> st.n >> st.f >> st.m >> st.s
+          >> st.ff >> st.fm >> st.mm >> st.fs >> st.ms ) )
+    {
+      fprintf( stderr, "[WARNING] skip the invalid line \"%s\" in %s\n", line.c_str(), filename );
+      continue;
+    }
+    stats[ name ].add( st );
+    models[ name ] = fit( stats[ name ] );
+  }
+  return HMLP_ERROR_SUCCESS;
+};
+
+hmlpError_t save( const char* filename )
+{
+  if ( !filename ) return HMLP_ERROR_INVALID_VALUE;
+  ofstream file( filename );
+  if ( !file ) return HMLP_ERROR_INVALID_VALUE;
+  lock_guard<mutex> guard( record_lock );
+  file << "# name samples sum_f sum_m sum_s sum_ff sum_fm sum_mm sum_fs sum_ms\n";
+  file.precision( 17 );
+  for ( auto &it : stats )
+  {
+    auto &st = it.second;
+    file << it.first << " " << st.n << " " << st.f << " " << st.m << " " << st.s << " "
+         << st.ff << " " << st.fm << " " << st.mm << " " << st.fs << " " << st.ms << "\n";
+  }
+  return file.good() ? HMLP_ERROR_SUCCESS : HMLP_ERROR_EXECUTION_FAILED;
+};
+
+void clear()
+{
+  lock_guard<mutex> guard( record_lock );
+  stats.clear();
+  pending.clear();
+  for ( auto &it : models ) it.second = model_s();
+};
+
+}; /* end namespace costmodel */
+}; /* end namespace hmlp */
@@ -0,0 +1,104 @@
+/**
+ *  HMLP (High-Performance Machine Learning Primitives)
+ *
+ *  Copyright (C) 2014-2018, The University of Texas at Austin
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see the LICENSE file.
+ *
+ **/
+
+
+#ifndef HMLP_COSTMODEL_HPP
+#define HMLP_COSTMODEL_HPP
+
+#include <string>
+/** Use hmlpError_t. */
+#include <hmlp.h>
+
+namespace hmlp
+{
+namespace costmodel
+{
+
+/**
+ *  @brief Per task type (Task::name), the duration in seconds is modeled as
+ *
+ *         sec = intercept + per_gflop * flops / 1E+9 + per_gmop * mops / 1E+9,
+ *
+ *         fitted by least squares over all measured executions. Terms that
+ *         the samples can not determine (e.g. constant mops) are dropped.
+ */
+struct model_s
+{
+  double intercept = 0.0;
+  double per_gflop = 0.0;
+  double per_gmop = 0.0;
+  size_t samples = 0;
+};
+
+/**
+ *  @brief Whether executions are recorded: HMLP_COST_MODEL_FILE is set, or
+ *         enable( true ) was called.
+ */
+bool isEnabled();
+
+/** @brief Turn recording on or off (overrides HMLP_COST_MODEL_FILE). */
+void enable( bool is_enabled );
+
+/** @brief Record a measured execution of a task type; thread-safe. */
+void record( const std::string &name, double flops, double mops, double sec );
+
+/**
+ *  @brief Fold the recorded executions into the models. The runtime calls
+ *         this between epochs, such that estimate() never races with it.
+ */
+void update();
+
+/** @brief Look up the model of a task type; return false if there is none. */
+bool get( const std::string &name, model_s &model );
+
+/**
+ *  @brief Return the model slot of a task type (created empty if the type
+ *         is new). The slot stays valid for the lifetime of the program and
+ *         is refitted in place, so tasks can resolve it once at submission.
+ *         A slot without samples has no model yet.
+ */
+const model_s* find( const std::string &name );
+
+/**
+ *  @brief Estimate the duration of a task type with the given flops and mops.
+ *         Return false (and leave sec unchanged) if there is no model.
+ */
+bool estimate( const std::string &name, double flops, double mops, float &sec );
+
+/** @brief Same as above, but with a slot returned by find(). */
+bool estimate( const model_s *model, double flops, double mops, float &sec );
+
+/**
+ *  @brief Add the samples of a cost model file. Each line has the format
+ *         "name samples sum_f sum_m sum_s sum_ff sum_fm sum_mm sum_fs sum_ms"
+ *         (flops and mops in G), and lines that start with # are comments.
+ */
+hmlpError_t load( const char* filename );
+
+/** @brief Write the samples of all task types to a cost model file. */
+hmlpError_t save( const char* filename );
+
+/** @brief Discard all models and recorded executions (slots stay valid). */
+void clear();
+
+}; /* end namespace costmodel */
+}; /* end namespace hmlp */
+
+#endif /* define HMLP_COSTMODEL_HPP */
@@ -379,6 +379,47 @@ int Iprobe( int source, int tag, Comm comm, int *flag, Status *status )
 #endif
 }; /** end Iprobe() */
 
+int Improbe( int source, int tag, Comm comm, int *flag, Message *message, Status *status )
+{
+#ifdef HMLP_USE_MPI
+  return MPI_Improbe( source, tag, comm, flag, message, status );
+#else
+  /** There is never any incoming message. */
+  *flag = 0;
+  return 0;
+#endif
+}; /** end Improbe() */
+
+int Mrecv( void *buf, int count, Datatype datatype, Message *message, Status *status )
+{
+#ifdef HMLP_USE_MPI
+  return MPI_Mrecv( buf, count, datatype, message, status );
+#else
+  return 0;
+#endif
+}; /** end Mrecv() */
+
+int Ialltoallv( void *sendbuf, int *sendcounts, int *sdispls, Datatype sendtype, 
+    void *recvbuf, int *recvcounts, int *rdispls, Datatype recvtype, Comm comm,
+    Request *request )
+{
+#ifdef HMLP_USE_MPI
+  return MPI_Ialltoallv( sendbuf, sendcounts, sdispls, sendtype,
+      recvbuf, recvcounts, rdispls, recvtype, comm, request ); 
+#else
+  return 0;
+#endif
+}; /** end Ialltoallv() */
+
+int Wait( Request *request, Status *status )
+{
+#ifdef HMLP_USE_MPI
+  return MPI_Wait( request, status );
+#else
+  return 0;
+#endif
+}; /** end Wait() */
+
 
 /** HMLP MPI extension */
 void PrintProgress( const char *s, mpi::Comm comm )
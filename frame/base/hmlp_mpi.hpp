@@ -11,6 +11,7 @@
 #include <cstdint>
 #include <cassert>
 #include <vector>
+#include <algorithm>
 
 #if SIZE_MAX == UCHAR_MAX
 #define HMLP_MPI_SIZE_T MPI_UNSIGNED_CHAR
@@ -43,6 +44,7 @@ namespace mpi
 {
 typedef MPI_Status Status;
 typedef MPI_Request Request;
+typedef MPI_Message Message;
 typedef MPI_Comm Comm;
 typedef MPI_Datatype Datatype;
 typedef MPI_Op Op;
@@ -82,6 +84,10 @@ int Alltoallv( void *sendbuf, int *sendcounts, int *sdispls, Datatype sendtype,
 int Init_thread( int *argc, char ***argv, int required, int *provided );
 int Probe( int source, int tag, Comm comm, Status *status );
 int Iprobe( int source, int tag, Comm comm, int *flag, Status *status );
+int Improbe( int source, int tag, Comm comm, int *flag, Message *message, Status *status );
+int Mrecv( void *buf, int count, Datatype datatype, Message *message, Status *status );
+int Ialltoallv( void *sendbuf, int *sendcounts, int *sdispls, Datatype sendtype, void *recvbuf, int *recvcounts, int *rdispls, Datatype recvtype, Comm comm, Request *request );
+int Wait( Request *request, Status *status );
 
 /** HMLP MPI extension */ 
 void PrintProgress( const char *s, mpi::Comm comm );
@@ -211,6 +217,13 @@ int Recv( TRECV *buf, int count,
   return Recv( buf, count, datatype, source, tag, comm, status );
 }; /** end Recv() */
 
+template<typename TRECV>
+int Mrecv( TRECV *buf, int count, Message *message, Status *status )
+{
+  Datatype datatype = GetMPIDatatype<TRECV>();
+  return Mrecv( buf, count, datatype, message, status );
+}; /** end Mrecv() */
+
 template<typename T>
 int Bcast( T *buffer, int count, int root, Comm comm )
 {
@@ -330,6 +343,19 @@ int Alltoallv(
 }; /** end Alltoallv() */
 
 
+template<typename TSEND, typename TRECV>
+int Ialltoallv( 
+    TSEND *sendbuf, int *sendcounts, int *sdispls,
+    TRECV *recvbuf, int *recvcounts, int *rdispls, Comm comm, Request *request )
+{
+  Datatype sendtype = GetMPIDatatype<TSEND>();
+  Datatype recvtype = GetMPIDatatype<TRECV>();
+  return Ialltoallv( 
+      sendbuf, sendcounts, sdispls, sendtype, 
+      recvbuf, recvcounts, rdispls, recvtype, comm, request );
+}; /** end Ialltoallv() */
+
+
 /**
  *  @brief This is a short hand for sending a vector, which
  *         involves two MPI_Send() calls.
@@ -450,6 +476,156 @@ int GatherVector( vector<T> &sendvector, vector<T> &recvvector, int root, Comm c
 
 
 
+/**
+ *  @brief The maximum number of elements exchanged with a single peer in 
+ *         one round of Alltoallv64(). MPI counts and displacements are int,
+ *         so this must satisfy comm_size * HMLP_MPI_MAX_CHUNK < INT_MAX.
+ */
+#ifndef HMLP_MPI_MAX_CHUNK
+#define HMLP_MPI_MAX_CHUNK ( 1 << 26 )
+#endif
+
+/**
+ *  @brief Alltoallv in rounds of at most HMLP_MPI_MAX_CHUNK elements per
+ *         peer, staged through sendstage and recvstage. Each round packs
+ *         only the peers that are still active, so the stages never hold
+ *         more than the local payload; they are released on return. All 
+ *         ranks must call this routine (i.e. agree on the protocol).
+ */ 
+template<typename T, class Allocator = std::allocator<T> >
+int AlltoallvChunked(
+    const T *sendbuf, const vector<size_t> &sendcounts, const vector<size_t> &sdispls,
+          T *recvbuf, const vector<size_t> &recvcounts, const vector<size_t> &rdispls,
+    Comm comm, vector<T, Allocator> &sendstage, vector<T, Allocator> &recvstage )
+{
+  int size = 0; Comm_size( comm, &size );
+
+  /** Chunk size per peer. */
+  size_t chunk = std::min( (size_t)HMLP_MPI_MAX_CHUNK, (size_t)( INT_MAX / size ) );
+
+  /** The first round is the largest; the stages are sized for it. */
+  size_t max_count = 0, send_stage_size = 0, recv_stage_size = 0;
+  for ( int p = 0; p < size; p ++ )
+  {
+    max_count = std::max( max_count, sendcounts[ p ] );
+    max_count = std::max( max_count, recvcounts[ p ] );
+    send_stage_size += std::min( chunk, sendcounts[ p ] );
+    recv_stage_size += std::min( chunk, recvcounts[ p ] );
+  }
+
+  /** The number of rounds is decided by the largest count across all ranks. */
+  size_t my_rounds = ( max_count + chunk - 1 ) / chunk;
+  size_t n_rounds = 0;
+  Allreduce( &my_rounds, &n_rounds, 1, MPI_MAX, comm );
+
+  sendstage.resize( send_stage_size );
+  recvstage.resize( recv_stage_size );
+
+  vector<int> isendcounts( size ), isdispls( size );
+  vector<int> irecvcounts( size ), irdispls( size );
+  int error = 0;
+
+  for ( size_t r = 0; r < n_rounds && !error; r ++ )
+  {
+    size_t offset = r * chunk;
+    /** Counts and packed displacements of this round. */
+    int sdisp = 0, rdisp = 0;
+    for ( int p = 0; p < size; p ++ )
+    {
+      isendcounts[ p ] = ( sendcounts[ p ] > offset ) ? 
+        std::min( chunk, sendcounts[ p ] - offset ) : 0;
+      irecvcounts[ p ] = ( recvcounts[ p ] > offset ) ? 
+        std::min( chunk, recvcounts[ p ] - offset ) : 0;
+      isdispls[ p ] = sdisp; sdisp += isendcounts[ p ];
+      irdispls[ p ] = rdisp; rdisp += irecvcounts[ p ];
+    }
+    /** Pack this round. */
+    #pragma omp parallel for
+    for ( int p = 0; p < size; p ++ )
+    {
+      std::copy( sendbuf + sdispls[ p ] + offset, 
+                 sendbuf + sdispls[ p ] + offset + isendcounts[ p ],
+                 sendstage.begin() + isdispls[ p ] );
+    }
+    error = Alltoallv( sendstage.data(), isendcounts.data(), isdispls.data(),
+        recvstage.data(), irecvcounts.data(), irdispls.data(), comm );
+    if ( error ) break;
+    /** Unpack this round. */
+    #pragma omp parallel for
+    for ( int p = 0; p < size; p ++ )
+    {
+      std::copy( recvstage.begin() + irdispls[ p ],
+                 recvstage.begin() + irdispls[ p ] + irecvcounts[ p ],
+                 recvbuf + rdispls[ p ] + offset );
+    }
+  }
+
+  /** Release the stages. */
+  vector<T, Allocator>().swap( sendstage );
+  vector<T, Allocator>().swap( recvstage );
+  return error;
+}; /** end AlltoallvChunked() */
+
+
+/**
+ *  @brief A 64-bit safe Alltoallv. Counts and displacements are size_t.
+ *         If everything fits in int, then this is a single MPI_Alltoallv
+ *         on the user buffers. Otherwise, the exchange is split into 
+ *         rounds of at most HMLP_MPI_MAX_CHUNK elements per peer, staged
+ *         through sendstage and recvstage (released on return).
+ */ 
+template<typename T, class Allocator = std::allocator<T> >
+int Alltoallv64(
+    const T *sendbuf, const vector<size_t> &sendcounts, const vector<size_t> &sdispls,
+          T *recvbuf, const vector<size_t> &recvcounts, const vector<size_t> &rdispls,
+    Comm comm, vector<T, Allocator> &sendstage, vector<T, Allocator> &recvstage )
+{
+  int size = 0; Comm_size( comm, &size );
+
+  assert( sendcounts.size() >= size && sdispls.size() >= size );
+  assert( recvcounts.size() >= size && rdispls.size() >= size );
+
+  /** Check if all counts and displacements are representable by int. */
+  int is_large = 0, any_large = 0;
+  for ( int p = 0; p < size; p ++ )
+  {
+    if ( sdispls[ p ] + sendcounts[ p ] > INT_MAX ) is_large = 1;
+    if ( rdispls[ p ] + recvcounts[ p ] > INT_MAX ) is_large = 1;
+  }
+  /** All ranks must agree on the protocol. */
+  Allreduce( &is_large, &any_large, 1, MPI_MAX, comm );
+
+  if ( !any_large )
+  {
+    vector<int> isendcounts( size ), isdispls( size );
+    vector<int> irecvcounts( size ), irdispls( size );
+    for ( int p = 0; p < size; p ++ )
+    {
+      isendcounts[ p ] = sendcounts[ p ]; isdispls[ p ] = sdispls[ p ];
+      irecvcounts[ p ] = recvcounts[ p ]; irdispls[ p ] = rdispls[ p ];
+    }
+    return Alltoallv( const_cast<T*>( sendbuf ), isendcounts.data(), isdispls.data(),
+        recvbuf, irecvcounts.data(), irdispls.data(), comm );
+  }
+
+  return AlltoallvChunked( sendbuf, sendcounts, sdispls, 
+      recvbuf, recvcounts, rdispls, comm, sendstage, recvstage );
+}; /** end Alltoallv64() */
+
+
+/** @brief Alltoallv64() with temporary staging buffers. */
+template<typename T>
+int Alltoallv64(
+    const T *sendbuf, const vector<size_t> &sendcounts, const vector<size_t> &sdispls,
+          T *recvbuf, const vector<size_t> &recvcounts, const vector<size_t> &rdispls,
+    Comm comm )
+{
+  vector<T> sendstage, recvstage;
+  return Alltoallv64( sendbuf, sendcounts, sdispls, 
+      recvbuf, recvcounts, rdispls, comm, sendstage, recvstage );
+}; /** end Alltoallv64() */
+
+
 #ifdef HMLP_MIC_AVX512
 /** use hbw::allocator for Intel Xeon Phi */
 template<class T, class Allocator = hbw::allocator<T> >
@@ -467,62 +643,40 @@ int AlltoallVector(
   assert( sendvector.size() == size );
   assert( recvvector.size() == size );
 
-  vector<T> sendbuf;
-  vector<T> recvbuf;
-  vector<int> sendcounts( size, 0 );
-  vector<int> recvcounts( size, 0 );
-  vector<int> sdispls( size + 1, 0 );
-  vector<int> rdispls( size + 1, 0 );
+  vector<T, Allocator> sendbuf;
+  vector<T, Allocator> recvbuf;
+  vector<size_t> sendcounts( size, 0 );
+  vector<size_t> recvcounts( size, 0 );
+  vector<size_t> sdispls( size + 1, 0 );
+  vector<size_t> rdispls( size + 1, 0 );
 
-  //printf( "rank %d ", rank );
   for ( size_t p = 0; p < size; p ++ )
   {
     sendcounts[ p ] = sendvector[ p ].size();
     sdispls[ p + 1 ] = sdispls[ p ] + sendcounts[ p ];
+  }
+  /** Concatenate all sendvector with only one allocation. */
+  sendbuf.reserve( sdispls[ size ] );
+  for ( size_t p = 0; p < size; p ++ )
+  {
     sendbuf.insert( sendbuf.end(), 
         sendvector[ p ].begin(), 
         sendvector[ p ].end() );
-    //printf( "%d ", sendcounts[ j ] );
   }
-  //printf( "\n" );
-
-  
-  //printf( "before Alltoall (mpi size = %d)\n", size ); fflush( stdout );
-  //Barrier( comm );
 
-  /** exchange sendcount */
+  /** Exchange sendcounts (size_t, so no overflow). */
   Alltoall( sendcounts.data(), 1, recvcounts.data(), 1, comm );
 
-
-  //printf( "after Alltoall\n" ); fflush( stdout );
-  //Barrier( comm );
-
-  //printf( "rank %d ", rank );
-  size_t total_recvcount = 0;
   for ( size_t p = 0; p < size; p ++ )
   {
     rdispls[ p + 1 ] = rdispls[ p ] + recvcounts[ p ];
-    total_recvcount += recvcounts[ p ];
-    //printf( "%d ", recvcounts[ j ] );
   }
-  //printf( "\n" );
-
-  /** resize receving buffer */
-  recvbuf.resize( total_recvcount );
-
-
-  //printf( "before Alltoall2 recvbuf.size() %lu\n", recvbuf.size() ); fflush( stdout );
-  //Barrier( comm );
-
-
-  Alltoallv(
-      sendbuf.data(), sendcounts.data(), sdispls.data(), 
-      recvbuf.data(), recvcounts.data(), rdispls.data(), comm );
-
 
-  //printf( "after Alltoall2\n" ); fflush( stdout );
-  //Barrier( comm );
+  /** Resize receving buffer. */
+  recvbuf.resize( rdispls[ size ] );
 
+  Alltoallv64( sendbuf.data(), sendcounts, sdispls, 
+               recvbuf.data(), recvcounts, rdispls, comm );
 
   recvvector.resize( size );
   for ( size_t p = 0; p < size; p ++ )
@@ -218,13 +218,15 @@ inline void pack2Dimg
 
 /**
  *  @brief This is the default packing routine for GKMX, GSKS, 
- *         GSKNN and STRASSEN.
+ *         GSKNN and STRASSEN. X0 and X1 are indexed by their own maps,
+ *         such that STRASSEN can pack X0( x0map, : ) + gamma * X1( x1map, : )
+ *         for two different row blocks of the same matrix.
  */ 
 template<bool TRANS, int FOLD, bool ZEROPAD=false, typename T>
 inline void pack2D
 (
   int m, int n,
-  T *X0, T *X1, int ldx, T gamma, int *xmap, T *packX
+  T *X0, int *x0map, T *X1, int *x1map, int ldx, T gamma, T *packX
 )
 {
   //printf( "X0[0]: %lf, X1[0]: %lf\n", X0[0], X1[0] );
@@ -235,13 +237,13 @@ inline void pack2D
   {
     for ( auto i = 0; i < m; i ++ )
     {
-      x0_pntr[ i ] = X0 + ldx * xmap[ i ];
-      x1_pntr[ i ] = X1 + ldx * xmap[ i ];
+      x0_pntr[ i ] = X0 + ldx * x0map[ i ];
+      x1_pntr[ i ] = X1 + ldx * x1map[ i ];
     }
     for ( auto i = m; i < FOLD; i ++ )
     {
-      x0_pntr[ i ] = X0 + ldx * xmap[ 0 ];
-      x1_pntr[ i ] = X1 + ldx * xmap[ 0 ];
+      x0_pntr[ i ] = X0 + ldx * x0map[ 0 ];
+      x1_pntr[ i ] = X1 + ldx * x1map[ 0 ];
     }
     for ( auto j = 0; j < n; j ++ ) 
     {
@@ -268,13 +270,13 @@ inline void pack2D
     //printf( "pack2D(): TRANS = false not yet implemented yet.\n" );
     for ( auto i = 0; i < m; i ++ )
     {
-      x0_pntr[ i ] = X0 + xmap[ i ];
-      x1_pntr[ i ] = X1 + xmap[ i ];
+      x0_pntr[ i ] = X0 + x0map[ i ];
+      x1_pntr[ i ] = X1 + x1map[ i ];
     }
     for ( auto i = m; i < FOLD; i ++ )
     {
-      x0_pntr[ i ] = X0 + xmap[ 0 ];
-      x1_pntr[ i ] = X1 + xmap[ 0 ];
+      x0_pntr[ i ] = X0 + x0map[ 0 ];
+      x1_pntr[ i ] = X1 + x1map[ 0 ];
     }
 
     for ( auto j = 0; j < n; j ++ )
@@ -311,6 +313,24 @@ inline void pack2D
 }; // end pack2D()
 
 
+/**
+ *  @brief X0 and X1 share the same map.
+ */ 
+template<bool TRANS, int FOLD, bool ZEROPAD=false, typename T>
+inline void pack2D
+(
+  int m, int n,
+  T *X0, T *X1, int ldx, T gamma, int *xmap, T *packX
+)
+{
+  pack2D<TRANS, FOLD, ZEROPAD, T>
+  (
+    m, n, 
+    X0, xmap, X1, xmap, ldx, gamma, packX
+  );
+}; // end pack2D()
+
+
 /**
  *  @brief
  */ 
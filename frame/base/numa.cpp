@@ -0,0 +1,179 @@
+/**
+ *  HMLP (High-Performance Machine Learning Primitives)
+ *
+ *  Copyright (C) 2014-2018, The University of Texas at Austin
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see the LICENSE file.
+ *
+ **/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <mutex>
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#include <base/numa.hpp>
+
+using namespace std;
+
+
+namespace hmlp
+{
+namespace numa
+{
+
+namespace
+{
+
+/** The socket of each online CPU, read once from sysfs. */
+struct topology_s
+{
+  vector<int> cpus;
+  vector<int> sockets;
+  int n_socket = 1;
+};
+
+const topology_s& getTopology()
+{
+  static topology_s topology;
+  static once_flag flag;
+  call_once( flag, [] ()
+  {
+#ifdef __linux__
+    long n_cpu = sysconf( _SC_NPROCESSORS_ONLN );
+    for ( int cpu = 0; cpu < n_cpu; cpu ++ )
+    {
+      int socket = 0;
+      ifstream file( "/sys/devices/system/cpu/cpu" + to_string( cpu ) 
+          + "/topology/physical_package_id" );
+      if ( file ) file >> socket;
+      topology.cpus.push_back( cpu );
+      topology.sockets.push_back( max( socket, 0 ) );
+    }
+#endif
+    if ( topology.cpus.empty() )
+    {
+      topology.cpus.push_back( 0 );
+      topology.sockets.push_back( 0 );
+    }
+    /** Renumber the package ids to 0, 1, ..., n_socket - 1. */
+    auto ids = topology.sockets;
+    sort( ids.begin(), ids.end() );
+    ids.erase( unique( ids.begin(), ids.end() ), ids.end() );
+    for ( auto &s : topology.sockets ) 
+      s = lower_bound( ids.begin(), ids.end(), s ) - ids.begin();
+    topology.n_socket = ids.size();
+  } );
+  return topology;
+};
+
+}; /** end unnamed namespace */
+
+
+int getNumSockets() { return getTopology().n_socket; };
+
+int getSocketOfCpu( int cpu )
+{
+  auto &topology = getTopology();
+  auto it = find( topology.cpus.begin(), topology.cpus.end(), cpu );
+  if ( it == topology.cpus.end() ) return 0;
+  return topology.sockets[ it - topology.cpus.begin() ];
+};
+
+vector<int> getPinning( int n_worker )
+{
+  vector<int> pinning;
+  auto *policy = getenv( "HMLP_PIN_WORKERS" );
+  if ( !policy || !*policy || !strcmp( policy, "none" ) || n_worker < 1 ) return pinning;
+
+  auto &topology = getTopology();
+  /** CPUs grouped by socket. */
+  vector<vector<int>> groups( topology.n_socket );
+  for ( size_t i = 0; i < topology.cpus.size(); i ++ )
+    groups[ topology.sockets[ i ] ].push_back( topology.cpus[ i ] );
+
+  vector<int> order;
+  if ( !strcmp( policy, "compact" ) )
+  {
+    for ( auto &group : groups ) order.insert( order.end(), group.begin(), group.end() );
+  }
+  else if ( !strcmp( policy, "scatter" ) )
+  {
+    for ( size_t i = 0; order.size() < topology.cpus.size(); i ++ )
+      for ( auto &group : groups ) if ( i < group.size() ) order.push_back( group[ i ] );
+  }
+  else
+  {
+    istringstream list( policy );
+    string cpu;
+    while ( getline( list, cpu, ',' ) )
+    {
+      if ( cpu.empty() ) continue;
+      order.push_back( atoi( cpu.data() ) );
+    }
+    if ( order.empty() )
+    {
+      fprintf( stderr, "[WARNING] ignore the invalid HMLP_PIN_WORKERS=%s\n", policy );
+      return pinning;
+    }
+  }
+  for ( int i = 0; i < n_worker; i ++ ) pinning.push_back( order[ i % order.size() ] );
+  return pinning;
+};
+
+hmlpError_t pinCurrentThread( int cpu )
+{
+#ifdef __linux__
+  if ( cpu < 0 || cpu >= CPU_SETSIZE ) return HMLP_ERROR_INVALID_VALUE;
+  cpu_set_t mask;
+  CPU_ZERO( &mask );
+  CPU_SET( cpu, &mask );
+  if ( sched_setaffinity( 0, sizeof(mask), &mask ) ) return HMLP_ERROR_INVALID_VALUE;
+  return HMLP_ERROR_SUCCESS;
+#else
+  return HMLP_ERROR_NOT_SUPPORTED;
+#endif
+};
+
+int getNumAffinityDomains()
+{
+  auto *policy = getenv( "HMLP_PIN_WORKERS" );
+  if ( !policy || !*policy || !strcmp( policy, "none" ) ) return 1;
+  return getNumSockets();
+};
+
+int getTreeNodeAffinity( size_t level_size, size_t ind, size_t arity )
+{
+  size_t n_domain = getNumAffinityDomains();
+  if ( n_domain < 2 || arity < 2 ) return -1;
+  /** The size of the first level with at least n_domain nodes. */
+  size_t domain_size = 1;
+  while ( domain_size < n_domain ) domain_size *= arity;
+  if ( level_size < domain_size ) return -1;
+  /** The subtree at that level which contains the node. */
+  size_t subtree = ind / ( level_size / domain_size );
+  return ( subtree * n_domain ) / domain_size;
+};
+
+}; /* end namespace numa */
+}; /* end namespace hmlp */
@@ -0,0 +1,71 @@
+/**
+ *  HMLP (High-Performance Machine Learning Primitives)
+ *
+ *  Copyright (C) 2014-2018, The University of Texas at Austin
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see the LICENSE file.
+ *
+ **/
+
+
+#ifndef HMLP_NUMA_HPP
+#define HMLP_NUMA_HPP
+
+#include <vector>
+/** Use hmlpError_t. */
+#include <hmlp.h>
+
+namespace hmlp
+{
+namespace numa
+{
+
+/** @brief Return the number of sockets (packages) of the online CPUs. */
+int getNumSockets();
+
+/** @brief Return the socket of a CPU (0 if unknown). */
+int getSocketOfCpu( int cpu );
+
+/**
+ *  @brief Return the CPU of each of the n_worker workers, or an empty
+ *         vector if workers should not be pinned. HMLP_PIN_WORKERS decides
+ *
+ *         1. "compact": fill the CPUs of socket 0 first, then socket 1, ...
+ *         2. "scatter": take CPUs from the sockets in a round-robin order,
+ *         3. a comma separated CPU list (e.g. "0,2,4,6"), reused cyclically,
+ *         4. unset or "none": no pinning.
+ */
+std::vector<int> getPinning( int n_worker );
+
+/** @brief Pin the calling thread to one CPU. */
+hmlpError_t pinCurrentThread( int cpu );
+
+/**
+ *  @brief The number of socket affinity domains that tasks and tree nodes
+ *         are distributed over: the number of sockets if workers are
+ *         pinned, otherwise 1 (no affinity).
+ */
+int getNumAffinityDomains();
+
+/**
+ *  @brief Return the affinity domain of node ind on a level of level_size
+ *         nodes of a complete tree with the given arity, or -1 for the
+ *         levels above the domains.
+ */
+int getTreeNodeAffinity( size_t level_size, size_t ind, size_t arity );
+
+}; /* end namespace numa */
+}; /* end namespace hmlp */
+
+#endif /* define HMLP_NUMA_HPP */
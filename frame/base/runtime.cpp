@@ -19,6 +19,14 @@
  **/  
 
 #include <base/runtime.hpp>
+#include <base/arch.hpp>
+#include <base/numa.hpp>
+#include <base/blas_lapack.hpp>
+#include <base/costmodel.hpp>
+#include <sched.h>
+#include <chrono>
+#include <string.h>
+#include <set>
 
 #ifdef HMLP_USE_CUDA
 #include <base/hmlp_gpu.hpp>
@@ -184,6 +192,192 @@ Task::Task()
 /** @brief (Default) Task destructor. */ 
 Task::~Task() {};
 
+
+/**
+ *  Task sizes are rounded up to 64-byte classes, and each thread keeps a
+ *  free list per class. Slabs are carved on demand and reused by later
+ *  epochs (and TaskGraph replays, whose tasks outlive their epoch). A list
+ *  that exceeds a bound, e.g. of the master thread that deletes all tasks in
+ *  Finalize(), hands half of it to a shared list. Once no task is alive,
+ *  ReleaseSlabs() frees all slabs, and each thread drops its stale lists on
+ *  its next allocation.
+ */
+namespace
+{
+
+const size_t task_class_bytes = 64;
+const size_t task_n_class = 32;
+const size_t task_slab_count = 64;
+const size_t task_cache_bound = 4096;
+
+struct FreeTask { FreeTask *next; };
+
+struct TaskFreeList
+{
+  FreeTask *head = NULL;
+  size_t count = 0;
+
+  FreeTask *pop()
+  {
+    auto *task = head;
+    head = task->next;
+    count --;
+    return task;
+  };
+
+  void push( FreeTask *task )
+  {
+    task->next = head;
+    head = task;
+    count ++;
+  };
+};
+
+struct TaskCache
+{
+  TaskCache();
+
+  ~TaskCache();
+
+  TaskFreeList lists[ task_n_class ];
+
+  /** Allocations minus deallocations of this thread; only it writes. */
+  atomic<long> n_alive;
+
+  /** The generation of the slabs that my lists point to. */
+  size_t generation;
+};
+
+/** Protects the shared lists, the slabs and the registry of caches. */
+mutex task_shared_lock;
+
+TaskFreeList task_shared[ task_n_class ];
+
+vector<void*> task_slabs;
+
+set<TaskCache*> task_caches;
+
+/** Tasks that are still alive from threads that have exited. */
+long task_n_orphan = 0;
+
+/** Increased whenever the slabs are freed. */
+atomic<size_t> task_generation( 0 );
+
+TaskCache::TaskCache() : n_alive( 0 ), generation( task_generation.load() )
+{
+  lock_guard<mutex> guard( task_shared_lock );
+  task_caches.insert( this );
+};
+
+/** An exiting thread hands its free lists and its count to the others. */
+TaskCache::~TaskCache()
+{
+  lock_guard<mutex> guard( task_shared_lock );
+  task_caches.erase( this );
+  task_n_orphan += n_alive.load();
+  if ( generation != task_generation.load() ) return;
+  for ( size_t c = 0; c < task_n_class; c ++ )
+    while ( lists[ c ].head ) task_shared[ c ].push( lists[ c ].pop() );
+};
+
+thread_local TaskCache task_cache;
+
+/** @return my cache, without the lists that point to freed slabs. */
+TaskCache& getTaskCache()
+{
+  auto &cache = task_cache;
+  size_t generation = task_generation.load( memory_order_relaxed );
+  if ( cache.generation != generation )
+  {
+    for ( auto &list : cache.lists ) list = TaskFreeList();
+    cache.generation = generation;
+  }
+  return cache;
+};
+
+}; /** end unnamed namespace */
+
+
+/** @brief Pop from my free list; refill from the shared list or a new slab. */
+void* Task::operator new( size_t size )
+{
+  size_t c = ( size + task_class_bytes - 1 ) / task_class_bytes - 1;
+  if ( c >= task_n_class ) return ::operator new( size );
+  auto &cache = getTaskCache();
+  auto &list = cache.lists[ c ];
+  if ( !list.head )
+  {
+    lock_guard<mutex> guard( task_shared_lock );
+    auto &shared = task_shared[ c ];
+    while ( shared.head && list.count < task_slab_count ) list.push( shared.pop() );
+    if ( !list.head )
+    {
+      size_t bytes = ( c + 1 ) * task_class_bytes;
+      void *slab = NULL;
+      if ( posix_memalign( &slab, task_class_bytes, task_slab_count * bytes ) ) throw bad_alloc();
+      task_slabs.push_back( slab );
+      for ( size_t i = 0; i < task_slab_count; i ++ ) 
+        list.push( reinterpret_cast<FreeTask*>( (char*)slab + i * bytes ) );
+    }
+  }
+  cache.n_alive.store( cache.n_alive.load( memory_order_relaxed ) + 1, memory_order_relaxed );
+  return list.pop();
+}; /** end Task::operator new() */
+
+
+/** @brief Push to my free list; spill half of it if it grows too long. */
+void Task::operator delete( void *ptr, size_t size )
+{
+  if ( !ptr ) return;
+  size_t c = ( size + task_class_bytes - 1 ) / task_class_bytes - 1;
+  if ( c >= task_n_class ) return ::operator delete( ptr );
+  auto &cache = getTaskCache();
+  auto &list = cache.lists[ c ];
+  list.push( reinterpret_cast<FreeTask*>( ptr ) );
+  cache.n_alive.store( cache.n_alive.load( memory_order_relaxed ) - 1, memory_order_relaxed );
+  if ( list.count > task_cache_bound )
+  {
+    lock_guard<mutex> guard( task_shared_lock );
+    auto &shared = task_shared[ c ];
+    while ( list.count > task_cache_bound / 2 ) shared.push( list.pop() );
+  }
+}; /** end Task::operator delete() */
+
+
+/**
+ *  @brief Free all slabs if no task is alive. This must not race with task
+ *         allocations, so it is only called outside epochs, by
+ *         TaskGraph::Clear() and hmlp_finalize().
+ */
+bool Task::ReleaseSlabs()
+{
+  lock_guard<mutex> guard( task_shared_lock );
+  long n_alive = task_n_orphan;
+  for ( auto *cache : task_caches ) n_alive += cache->n_alive.load();
+  if ( n_alive ) return false;
+  for ( auto slab : task_slabs ) free( slab );
+  task_slabs.clear();
+  for ( auto &list : task_shared ) list = TaskFreeList();
+  task_generation ++;
+  return true;
+}; /** end Task::ReleaseSlabs() */
+
+
+size_t Task::GetNumberOfSlabs()
+{
+  lock_guard<mutex> guard( task_shared_lock );
+  return task_slabs.size();
+}; /** end Task::GetNumberOfSlabs() */
+
+
+/** @brief Labels are only used by the timeline of DUMP_ANALYSIS_DATA. */
+void Task::SetLabel( size_t id )
+{
+#ifdef DUMP_ANALYSIS_DATA
+  label = to_string( id );
+#endif
+}; /** end Task::SetLabel() */
+
 /** @brief (Default) MessageTask constructor. */ 
 MessageTask::MessageTask( int src, int tar, int key )
 {
@@ -213,20 +407,46 @@ void Task::SetBatchStatus( TaskStatus next_status )
   }
 };
 
+/**
+ *  @brief Resolve the cost model slot of a task type. Tasks of the same type
+ *         are mostly submitted in a row, so each thread remembers the last
+ *         type and only looks up (and locks) the models on a change.
+ */
+static const costmodel::model_s* findCostModel( const string &name )
+{
+  thread_local string last_name;
+  thread_local const costmodel::model_s *last_model = NULL;
+  if ( !last_model || name != last_name )
+  {
+    last_model = costmodel::find( name );
+    last_name = name;
+  }
+  return last_model;
+}; /** end findCostModel() */
+
 /** 
  *  \brief Ask the runtime to create an normal task in file. 
  *  \return the error code
  */
 hmlpError_t Task::Submit() 
 { 
+  cost_model = findCostModel( name );
   return rt.scheduler->NewTask( this );
 };
 
 /** @brief Ask the runtime to create an message task in file. */
-void MessageTask::Submit() { rt.scheduler->NewMessageTask( this ); };
+void MessageTask::Submit() 
+{ 
+  cost_model = findCostModel( name );
+  rt.scheduler->NewMessageTask( this ); 
+};
 
 /** @brief Ask the runtime to create a listener task in file. */
-void ListenerTask::Submit() { rt.scheduler->NewListenerTask( this ); };
+void ListenerTask::Submit() 
+{ 
+  cost_model = findCostModel( name );
+  rt.scheduler->NewListenerTask( this ); 
+};
 
 /** @brief This is only for virtual function pointer. */
 void Task::Set( string user_name, void (*user_function)(Task*), void *user_arg )
@@ -268,10 +488,9 @@ hmlpError_t Task::addDependencyTo( Task* target )
 /** @brief Update the my outgoing and children's incoming edges. */
 hmlpError_t Task::dependenciesUpdate()
 {
-  /** Loop over each out-going edge. */
-  while ( out.size() )
+  /** Loop over each out-going edge; edges are kept for TaskGraph::Replay(). */
+  for ( auto *child : out )
   {
-    Task *child = out.front();
     /** There should be at least "one" remaining dependency to satisfy. */
     if ( child->n_dependencies_remaining_ <= 0 || child->GetStatus() != NOTREADY )
     {
@@ -290,8 +509,6 @@ hmlpError_t Task::dependenciesUpdate()
       }
     }
     RETURN_IF_ERROR( child->Release() );
-    /** Remove this out-going edge. */
-    out.pop_front();
   }
   /** Move forward to the last status "DONE". */
   SetStatus( DONE );
@@ -301,6 +518,14 @@ hmlpError_t Task::dependenciesUpdate()
 }; /* end Task::dependenciesUpdate() */
 
 
+/** @brief Move back to "NOTREADY" with n_dependencies incoming edges. */
+void Task::Rewind( int n_dependencies )
+{
+  n_dependencies_remaining_ = n_dependencies;
+  SetStatus( NOTREADY );
+}; /* end Task::Rewind() */
+
+
 hmlpError_t Task::Acquire() 
 { 
   if ( !task_lock )
@@ -356,6 +581,8 @@ void Task::ForceEnqueue( size_t tid )
     rt.scheduler->time_remaining[ assignment ] += cost; 
   }
   rt.scheduler->ready_queue_lock[ assignment ].Release();
+  /** Wake up a parked worker (if any), which may steal this task. */
+  rt.scheduler->Notify();
 }; /** end Task::ForceEnqueue() */
 
 
@@ -380,21 +607,36 @@ void Task::Enqueue( size_t tid )
         rt.scheduler->nested_queue[ created_by ].push_back( this );
     }
     rt.scheduler->nested_queue_lock[ created_by ].Release();
+    rt.scheduler->Notify();
     /** Finish and return without further going down. */
     return;
   };
 
-  /** Determine which worker the task should go to using HEFT policy. */
-  for ( int p = 0; p < rt.getNumberOfWorkers(); p ++ )
+  /** Replace the guessed cost by the calibrated model of this task type. */
+  costmodel::estimate( cost_model, event.GetFlops(), event.GetMops(), this->cost );
+
+  /** 
+   *  Determine which worker the task should go to using HEFT policy. With
+   *  a socket affinity, only the workers of that socket are considered,
+   *  unless none of them takes normal tasks (e.g. they are all listeners).
+   */
+  int n_socket = rt.scheduler->n_socket;
+  bool use_affinity = ( affinity >= 0 && n_socket > 1 );
+  for ( int pass = use_affinity ? 0 : 1; pass < 2; pass ++ )
   {
-    int i = ( tid + p ) % rt.getNumberOfWorkers();
-    float cost = rt.workers[ i ].EstimateCost( this );
-    float terminate_t = rt.scheduler->time_remaining[ i ];
-    if ( earliest_t == -1.0 || terminate_t + cost < earliest_t )
+    for ( int p = 0; p < rt.getNumberOfWorkers(); p ++ )
     {
-      earliest_t = terminate_t + cost;
-      assignment = i;
+      int i = ( tid + p ) % rt.getNumberOfWorkers();
+      if ( pass == 0 && rt.workers[ i ].socket != affinity % n_socket ) continue;
+      float cost = rt.workers[ i ].EstimateCost( this );
+      float terminate_t = rt.scheduler->time_remaining[ i ];
+      if ( earliest_t == -1.0 || terminate_t + cost < earliest_t )
+      {
+        earliest_t = terminate_t + cost;
+        assignment = i;
+      }
     }
+    if ( assignment >= 0 && earliest_t < numeric_limits<float>::max() ) break;
   }
 
   /** Dispatch to normal ready queue. */
@@ -422,17 +664,32 @@ bool Task::IsNested() { return is_created_in_epoch_session; };
 /** @breief (Default) ReadWrite constructor. */ 
 ReadWrite::ReadWrite() {};
 
-/** Clean both read and write sets. */
+/** Clean the read, write and accumulate sets. */
 hmlpError_t ReadWrite::DependencyCleanUp()
 {
   read.clear();
   write.clear();
+  accumulate.clear();
   return HMLP_ERROR_SUCCESS;
 }; /** end DependencyCleanUp() */
 
 /** @brief This is the key function that encode the dependency. **/ 
 hmlpError_t ReadWrite::DependencyAnalysis( ReadWriteType type, Task *task )
 {
+  if ( type == ACC )
+  {
+    /** Accumulations wait for the previous reads and writes, but not for each other. */
+    for ( auto it : read ) 
+    {
+      RETURN_IF_ERROR( Scheduler::DependencyAdd( it, task ) );
+    }
+    for ( auto it : write ) 
+    {
+      RETURN_IF_ERROR( Scheduler::DependencyAdd( it, task ) );
+    }
+    accumulate.push_back( task );
+    return HMLP_ERROR_SUCCESS;
+  }
   if ( type == R || type == RW )
   {
     /** Update the read set. */
@@ -442,6 +699,16 @@ hmlpError_t ReadWrite::DependencyAnalysis( ReadWriteType type, Task *task )
     {
       RETURN_IF_ERROR( Scheduler::DependencyAdd( it, task ) );
     }
+    /** Read-After-Accumulate: the accumulations become the last writers. */
+    for ( auto it : accumulate ) 
+    {
+      RETURN_IF_ERROR( Scheduler::DependencyAdd( it, task ) );
+    }
+    if ( accumulate.size() ) 
+    {
+      write.swap( accumulate );
+      accumulate.clear();
+    }
   }
   if ( type == W || type == RW )
   {
@@ -450,7 +717,12 @@ hmlpError_t ReadWrite::DependencyAnalysis( ReadWriteType type, Task *task )
     {
       RETURN_IF_ERROR( Scheduler::DependencyAdd( it, task ) );
     }
-    /** Clean up both read and write sets. */
+    /** Write-After-Accumulate. */
+    for ( auto it : accumulate ) 
+    {
+      RETURN_IF_ERROR( Scheduler::DependencyAdd( it, task ) );
+    }
+    /** Clean up all sets. */
     RETURN_IF_ERROR( DependencyCleanUp() );
     /** Update the write set. */
     write.push_back( task );
@@ -488,12 +760,12 @@ void MatrixReadWrite::Setup( size_t m, size_t n )
 bool MatrixReadWrite::HasBeenSetup() { return has_been_setup; };
 
 /** @brief */
-void MatrixReadWrite::DependencyAnalysis( 
+hmlpError_t MatrixReadWrite::DependencyAnalysis( 
     size_t i, size_t j, ReadWriteType type, Task *task )
 {
   //printf( "%lu %lu analysis\n", i, j  ); fflush( stdout );
-  assert( i < m && j < n );
-  Submatrices[ i ][ j ]. DependencyAnalysis( type, task );
+  if ( i >= m || j >= n ) return HMLP_ERROR_INVALID_VALUE;
+  return Submatrices[ i ][ j ]. DependencyAnalysis( type, task );
 }; /** end MatrixReadWrite::DependencyAnalysis() */
 
 /** @brief */
@@ -508,13 +780,113 @@ void MatrixReadWrite::DependencyCleanUp()
 
 
 
+/**
+ *  class RegionReadWrite
+ */ 
+
+/** @brief */
+hmlpError_t RegionReadWrite::Setup( size_t m, size_t n, size_t mb, size_t nb )
+{
+  if ( !mb || !nb ) return HMLP_ERROR_INVALID_VALUE;
+  this->m = m;
+  this->n = n;
+  this->mb = mb;
+  this->nb = nb;
+  /** At least one tile, such that an empty array still has a lock. */
+  size_t mt = std::max( ( m + mb - 1 ) / mb, (size_t)1 );
+  size_t nt = std::max( ( n + nb - 1 ) / nb, (size_t)1 );
+  tiles = MatrixReadWrite();
+  tiles.Setup( mt, nt );
+  locks.reset( new Lock[ mt * nt ] );
+  return HMLP_ERROR_SUCCESS;
+}; /** end RegionReadWrite::Setup() */
+
+
+/** @brief */
+bool RegionReadWrite::GetTileRange( size_t i, size_t m, size_t j, size_t n,
+    size_t &ibeg, size_t &iend, size_t &jbeg, size_t &jend ) const
+{
+  if ( !HasBeenSetup() || !m || !n ) return false;
+  if ( i + m > this->m || j + n > this->n ) return false;
+  ibeg = i / mb; iend = ( i + m - 1 ) / mb + 1;
+  jbeg = j / nb; jend = ( j + n - 1 ) / nb + 1;
+  return true;
+}; /** end RegionReadWrite::GetTileRange() */
+
+
+/** @brief */
+hmlpError_t RegionReadWrite::DependencyAnalysis( size_t i, size_t m, 
+    size_t j, size_t n, ReadWriteType type, Task *task )
+{
+  size_t ibeg, iend, jbeg, jend;
+  if ( !GetTileRange( i, m, j, n, ibeg, iend, jbeg, jend ) )
+  {
+    /** An empty region has no dependency. */
+    if ( HasBeenSetup() && ( !m || !n ) ) return HMLP_ERROR_SUCCESS;
+    return HMLP_ERROR_INVALID_VALUE;
+  }
+  for ( size_t jt = jbeg; jt < jend; jt ++ )
+    for ( size_t it = ibeg; it < iend; it ++ )
+      RETURN_IF_ERROR( tiles.DependencyAnalysis( it, jt, type, task ) );
+  return HMLP_ERROR_SUCCESS;
+}; /** end RegionReadWrite::DependencyAnalysis() */
+
+
+/** @brief */
+void RegionReadWrite::DependencyCleanUp() { tiles.DependencyCleanUp(); };
+
+
+/** @brief */
+hmlpError_t RegionReadWrite::Acquire( size_t i, size_t m, size_t j, size_t n )
+{
+  size_t ibeg, iend, jbeg, jend;
+  if ( !GetTileRange( i, m, j, n, ibeg, iend, jbeg, jend ) ) return HMLP_ERROR_INVALID_VALUE;
+  size_t mt = std::max( ( this->m + mb - 1 ) / mb, (size_t)1 );
+  /** A fixed order avoids deadlocks between overlapping regions. */
+  for ( size_t jt = jbeg; jt < jend; jt ++ )
+    for ( size_t it = ibeg; it < iend; it ++ )
+      RETURN_IF_ERROR( locks[ jt * mt + it ].Acquire() );
+  return HMLP_ERROR_SUCCESS;
+}; /** end RegionReadWrite::Acquire() */
+
+
+/** @brief */
+hmlpError_t RegionReadWrite::Release( size_t i, size_t m, size_t j, size_t n )
+{
+  size_t ibeg, iend, jbeg, jend;
+  if ( !GetTileRange( i, m, j, n, ibeg, iend, jbeg, jend ) ) return HMLP_ERROR_INVALID_VALUE;
+  size_t mt = std::max( ( this->m + mb - 1 ) / mb, (size_t)1 );
+  for ( size_t jt = jbeg; jt < jend; jt ++ )
+    for ( size_t it = ibeg; it < iend; it ++ )
+      RETURN_IF_ERROR( locks[ jt * mt + it ].Release() );
+  return HMLP_ERROR_SUCCESS;
+}; /** end RegionReadWrite::Release() */
+
+
+/** @brief */
+hmlpError_t RegionReadWrite::AcquireTile( size_t i, size_t j ) 
+{ 
+  return Acquire( i, 1, j, 1 ); 
+};
+
+
+/** @brief */
+hmlpError_t RegionReadWrite::ReleaseTile( size_t i, size_t j ) 
+{ 
+  return Release( i, 1, j, 1 ); 
+};
+
+
+
+
+
 /**
  *  class Scheduler
  */ 
 
 /**  @brief (Default) Scheduler constructor. */ 
 Scheduler::Scheduler( mpi::Comm user_comm ) 
-  : mpi::MPIObject( user_comm ), timeline_tag( 500 )
+  : mpi::MPIObject( user_comm ), timeline_tag( 500 ), n_parked( 0 )
 {
   try
   {
@@ -522,6 +894,7 @@ Scheduler::Scheduler( mpi::Comm user_comm )
     printf( "Scheduler()\n" );
 #endif
     listener_tasklist.resize( this->GetCommSize() );
+    mpi::Comm_dup( this->GetPrivateComm(), &payload_comm );
     /** Set now as the begining of the time table. */
     timeline_beg = omp_get_wtime();
   }
@@ -557,9 +930,35 @@ hmlpError_t Scheduler::Init( int user_n_worker )
 	do_terminate = false;
   has_ibarrier = false;
   ibarrier_consensus = 0;
+  /** Workers share the cores, so BLAS is single-threaded unless BlasThreads() says otherwise. */
+  blas_threads_outside = xblas_set_num_threads( 1 );
+  /** Pin workers (HMLP_PIN_WORKERS) and group them by socket. */
+  auto pinning = numa::getPinning( n_worker );
+  n_socket = 1;
+  for ( int i = 0; i < n_worker; i ++ )
+  {
+    rt.workers[ i ].cpu = pinning.size() ? pinning[ i ] : -1;
+    rt.workers[ i ].socket = pinning.size() ? numa::getSocketOfCpu( pinning[ i ] ) : 0;
+    n_socket = std::max( n_socket, rt.workers[ i ].socket + 1 );
+  }
+  /** Decide who drives MPI progress; only needed with more than one rank. */
+  auto *progress = getenv( "HMLP_MPI_PROGRESS" );
+  progress_mode = PROGRESS_IDLE;
+  if ( progress && !strcmp( progress, "dedicated" ) && n_worker > 1 ) 
+    progress_mode = PROGRESS_DEDICATED;
+  if ( progress && !strcmp( progress, "oversubscribed" ) && n_worker < MAX_WORKER ) 
+    progress_mode = PROGRESS_OVERSUBSCRIBED;
+  /** The oversubscribed progress thread is an extra (unpinned) worker. */
+  n_thread = n_worker;
+  if ( this->GetCommSize() > 1 && progress_mode == PROGRESS_OVERSUBSCRIBED )
+  {
+    rt.workers[ n_worker ].cpu = -1;
+    rt.workers[ n_worker ].socket = 0;
+    n_thread ++;
+  }
 
 #ifdef USE_PTHREAD_RUNTIME
-  for ( int i = 0; i < n_worker; i ++ )
+  for ( int i = 0; i < n_thread; i ++ )
   {
     rt.workers[ i ].tid = i;
     rt.workers[ i ].scheduler = this;
@@ -572,14 +971,18 @@ hmlpError_t Scheduler::Init( int user_n_worker )
   /** Now the master thread will enter the EntryPoint. */
   EntryPoint( (void*)&(rt.workers[ 0 ]) );
 #else
-  #pragma omp parallel for num_threads( n_worker )
-  for ( int i = 0; i < n_worker; i ++ )
+  /** Each worker needs its own thread; only this region turns dynamic teams off. */
+  int dynamic = omp_get_dynamic();
+  omp_set_dynamic( 0 );
+  #pragma omp parallel for num_threads( n_thread )
+  for ( int i = 0; i < n_thread; i ++ )
   {
     assert( omp_get_thread_num() == i );
     rt.workers[ i ].tid = i;
     rt.workers[ i ].scheduler = this;
     EntryPoint( (void*)&(rt.workers[ i ]) );
   } /** end pragma omp parallel for */
+  omp_set_dynamic( dynamic );
 #endif
   /* Return with no error. */
   return HMLP_ERROR_SUCCESS;
@@ -637,6 +1040,7 @@ void Scheduler::NewMessageTask( MessageTask *task )
   {
     /** We use a duplicated (private) communicator to handle message tasks. */
     task->comm = this->GetPrivateComm();
+    task->payload_comm = payload_comm;
     task->task_lock = &(task_lock[ tasklist.size() % ( 2 * MAX_WORKER ) ]);
     /** Counted toward termination criteria. */
     tasklist.push_back( task );
@@ -654,6 +1058,7 @@ void Scheduler::NewListenerTask( ListenerTask *task )
   {
     /** We use a duplicated (private) communicator to handle message tasks. */
     task->comm = this->GetPrivateComm();
+    task->payload_comm = payload_comm;
     task->task_lock = &(task_lock[ tasklist.size() % ( 2 * MAX_WORKER ) ]);
     listener_tasklist[ task->src ][ task->key ] = task;
     /** Counted toward termination criteria. */
@@ -673,20 +1078,27 @@ hmlpError_t Scheduler::Finalize()
   printf( "Scheduler::Finalize()\n" );
 #endif
 #ifdef USE_PTHREAD_RUNTIME
-  for ( int i = 0; i < rt.getNumberOfWorkers(); i ++ )
+  for ( int i = 0; i < n_thread; i ++ )
   {
     pthread_join( rt.workers[ i ].pthreadid, NULL );
   }
 #else
 #endif
 
+  /** Restore the BLAS threads of the phases between epochs. */
+  if ( blas_threads_outside ) xblas_set_num_threads( blas_threads_outside );
+  blas_threads_outside = 0;
   /** Print out statistics of this epoch */
   if ( REPORT_RUNTIME_STATUS ) Summary();
   /** Reset remaining time. */
   for ( int i = 0; i < n_worker; i ++ ) time_remaining[ i ] = 0.0;
-  /** Free all normal tasks and reset tasklist. */
-  for ( auto task : tasklist ) delete task; 
+  /** Free (or record) all normal tasks and reset tasklist. */
+  hmlpError_t error = HMLP_ERROR_SUCCESS;
+  if ( capture_graph ) error = capture_graph->Record( tasklist );
+  else for ( auto task : tasklist ) delete task; 
   tasklist.clear();
+  capture_graph = nullptr;
+  n_replay_task = 0;
   /** Free all nested tasks and reset nested_tasklist. */
   for ( auto task : nested_tasklist ) delete task; 
   nested_tasklist.clear();
@@ -694,11 +1106,33 @@ hmlpError_t Scheduler::Finalize()
   for ( auto & plist : listener_tasklist ) plist.clear();
   /* Clean up all message dependencies. */
   msg_dependencies.clear();
-  /* Return with no error. */
-  return HMLP_ERROR_SUCCESS;
+  /* Return the error of recording (if any). */
+  return error;
 }; /** end Scheduler::Finalize() */
 
 
+/** @brief Finalize() will hand the normal tasks to graph. */
+void Scheduler::CaptureNextEpoch( TaskGraph *graph )
+{
+  capture_graph = graph;
+}; /** end Scheduler::CaptureNextEpoch() */
+
+
+/** 
+ *  @brief Prepare a recorded epoch for the next run. The tasks are not
+ *         added to the tasklist, so Finalize() will not delete them.
+ */
+hmlpError_t Scheduler::RewindEpoch( vector<Task*> &tasks, const vector<int> &n_dependencies )
+{
+  if ( tasks.size() != n_dependencies.size() ) return HMLP_ERROR_INVALID_VALUE;
+  for ( size_t i = 0; i < tasks.size(); i ++ ) tasks[ i ]->Rewind( n_dependencies[ i ] );
+  n_replay_task = tasks.size();
+  /* Sources are ready right away; others are enqueued by dependenciesUpdate(). */
+  for ( auto *task : tasks ) task->TryEnqueue();
+  return HMLP_ERROR_SUCCESS;
+}; /** end Scheduler::RewindEpoch() */
+
+
 /** @brief  */
 void Scheduler::ReportRemainingTime()
 {
@@ -772,36 +1206,49 @@ Task *Scheduler::StealFromQueue( size_t target )
 }; /** end Scheduler::TryStealFromQueue() */
 
 
-/** @brief */
-vector<Task*> Scheduler::StealFromOther()
+/** @brief A per-thread xorshift generator for picking steal victims. */
+static uint32_t RandomVictim( int tid )
 {
-  int max_remaining_tasks = 0;
-  int max_remaining_nested_tasks = 0;
-  int target = 0;
-  /** Decide which target's normal queue to steal. */
-  for ( int p = 0; p < n_worker; p ++ )
+  static thread_local uint32_t state = 0;
+  if ( !state ) state = 2654435761u * ( tid + 1 );
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}; /** end RandomVictim() */
+
+
+/** 
+ *  @brief Steal from a randomly chosen nonempty queue, preferring the queues
+ *         on my socket. Random victims spread thieves over the queues, 
+ *         instead of all of them hammering the longest one.
+ */
+vector<Task*> Scheduler::StealFromOther( Worker *me )
+{
+  vector<Task*> batch;
+  int offset = RandomVictim( me->tid ) % n_worker;
+  /** Decide which target's normal queue to steal (socket-local first). */
+  for ( int pass = ( n_socket > 1 ) ? 0 : 1; pass < 2; pass ++ )
   {
-    if ( ready_queue[ p ].size() > max_remaining_tasks )
+    for ( int p = 0; p < n_worker; p ++ )
     {
-      max_remaining_tasks = ready_queue[ p ].size();
-      target = p;
+      int target = ( offset + p ) % n_worker;
+      if ( target == me->tid || !ready_queue[ target ].size() ) continue;
+      if ( pass == 0 && rt.workers[ target ].socket != me->socket ) continue;
+      /** Try to steal from target's ready queue.  */
+      batch = DispatchFromNormalQueue( target );
+      /** Return if batch is not empty. */
+      if ( batch.size() ) return batch;
     }
   }
-  /** Try to steal from target's ready queue.  */
-  auto batch = DispatchFromNormalQueue( target );
-  /** Return if batch is not empty. */
-  if ( batch.size() ) return batch;
-  /** Decide which target's nested queue to steal. */
+  /** Try to steal from a nonempty nested queue.  */
   for ( int p = 0; p < n_worker; p ++ )
   {
-    if ( nested_queue[ p ].size() > max_remaining_nested_tasks )
-    {
-      max_remaining_nested_tasks = nested_queue[ p ].size();
-      target = p;
-    }
+    int target = ( offset + p ) % n_worker;
+    if ( !nested_queue[ target ].size() ) continue;
+    batch = DispatchFromNestedQueue( target );
+    if ( batch.size() ) return batch;
   }
-  /** Try to steal from target's nested queue.  */
-  batch = DispatchFromNestedQueue( target );
   /** Return regardless if batch is empty or not. */
   return batch;
 }; /** end Scheduler::StealFromOther() */
@@ -840,7 +1287,7 @@ bool Scheduler::IsTimeToExit( int tid )
   /** In the case that do_terminate has been set, return "true". */
   if ( do_terminate ) return true;
   /** Both normal and nested tasks should all be executed. */
-  if ( n_task_completed >= tasklist.size() )
+  if ( n_task_completed >= tasklist.size() + n_replay_task )
   {
     if ( n_nested_task_completed >= nested_tasklist.size() )
     {
@@ -849,11 +1296,13 @@ bool Scheduler::IsTimeToExit( int tid )
       assert( !nested_queue[ tid ].size() );
 		  /** Set the termination flag to true. */
 	    do_terminate = true;
+      /** Parked workers should exit now as well. */
+      Notify( true );
       /** Now there should be no tasks left locally. Return "true". */
       return true;
     }
     else printf( "normal %d/%lu nested %d/%lu\n",
-        n_task_completed, tasklist.size(),
+        n_task_completed, tasklist.size() + n_replay_task,
         n_nested_task_completed, nested_tasklist.size() );
   }
   /** Otherwise, it is not yet to terminate. */
@@ -907,7 +1356,7 @@ bool Scheduler::ConsumeTasks( Worker *me, vector<Task*> &batch )
   /** For each task, move forward to the next status "RUNNING". */
   for ( auto task : batch ) task->SetStatus( RUNNING );
   /** Now the worker will execute all tasks in the batch. */
-  for ( auto task : batch ) me->Execute( task );
+  for ( auto task : batch ) Execute( me, task );
   /** For each task, update dependencies and my remining time. */
   for ( auto task : batch )
   {
@@ -964,7 +1413,7 @@ bool Scheduler::ConsumeTasks( Worker *me, Task *batch, bool is_nested )
   /** Update status */
   batch->SetBatchStatus( RUNNING );
 
-  if ( me->Execute( batch ) )
+  if ( Execute( me, batch ) )
   {
     Task *task = batch;
     while ( task )
@@ -1012,6 +1461,28 @@ bool Scheduler::ConsumeTasks( Worker *me, Task *batch, bool is_nested )
 
 
 
+/** 
+ *  @brief Tasks below 1 GFLOP run single-threaded BLAS. Larger tasks get
+ *         one more thread per GFLOP, but at most one per parked worker.
+ */
+int Scheduler::BlasThreads( Task *task )
+{
+  double flops = task->event.GetFlops();
+  if ( flops < 1E+9 ) return 1;
+  return std::min( 1 + (int)( flops / 1E+9 ), 1 + n_parked.load() );
+}; /** end Scheduler::BlasThreads() */
+
+
+/** @brief Only libraries with thread-local control (MKL) are adjusted. */
+bool Scheduler::Execute( Worker *me, Task *task )
+{
+  int previous = xblas_set_num_threads_local( BlasThreads( task ) );
+  bool executed = me->Execute( task );
+  if ( previous >= 0 ) xblas_set_num_threads_local( previous );
+  return executed;
+}; /** end Scheduler::Execute() */
+
+
 /** @brief This is the main body that each worker will go through. */
 void* Scheduler::EntryPoint( void* arg )
 {
@@ -1021,14 +1492,31 @@ void* Scheduler::EntryPoint( void* arg )
   Scheduler *scheduler = me->scheduler;
   /** This counter measures the idle iteration. */
   size_t idle = 0;
+  /** The OpenMP pool keeps its threads across epochs; only pin once per cpu. */
+  static thread_local int pinned_cpu = -1;
+  /** Pin myself, such that my tasks first-touch memory on my socket. */
+  if ( me->cpu >= 0 && me->cpu != pinned_cpu )
+  {
+    if ( numa::pinCurrentThread( me->cpu ) == HMLP_ERROR_SUCCESS ) pinned_cpu = me->cpu;
+    else fprintf( stderr, "[WARNING] fail to pin worker %d to cpu %d\n", me->tid, me->cpu );
+  }
 
 #ifdef DEBUG_SCHEDULER
   printf( "Scheduler::EntryPoint()\n" );
   printf( "pthreadid %d\n", me->tid );
 #endif
 
-  /** Prepare listeners (half of total workers). */
-  if ( ( me->tid % 2 ) && true )
+  /** MPI progress is only needed with more than one rank. */
+  bool has_progress = ( scheduler->GetCommSize() > 1 );
+  auto mode = scheduler->progress_mode;
+  /** The extra thread only drives progress. */
+  if ( has_progress && mode == PROGRESS_OVERSUBSCRIBED && me->tid == scheduler->n_worker )
+  {
+    scheduler->ProgressLoop( me, false );
+    return NULL;
+  }
+  /** The last worker drives progress and only steals in between. */
+  if ( has_progress && mode == PROGRESS_DEDICATED && me->tid == scheduler->n_worker - 1 )
   {
     /** Update my termination time to infinite. */
     scheduler->ready_queue_lock[ me->tid ].Acquire();
@@ -1036,8 +1524,8 @@ void* Scheduler::EntryPoint( void* arg )
       scheduler->time_remaining[ me->tid ] = numeric_limits<float>::max();
     }
     scheduler->ready_queue_lock[ me->tid ].Release();
-    /** Enter listening mode. */
-    scheduler->Listen( me );
+    scheduler->ProgressLoop( me, true );
+    return NULL;
   }
   /** Start to consume all tasks in this epoch session. */
   while ( 1 )
@@ -1062,120 +1550,174 @@ void* Scheduler::EntryPoint( void* arg )
     /** Try to steal from others. */
     if ( idle > 10 )
     {
+      /** Idle workers drive MPI progress opportunistically. */
+      if ( has_progress && mode == PROGRESS_IDLE && scheduler->Progress( me ) ) idle = 0;
       /** Try to steal a (normal or nested) task. */
-      auto stolen_batch = scheduler->StealFromOther();
+      auto stolen_batch = scheduler->StealFromOther( me );
       /** Reset the idle counter if there is executable stolen tasks. */
       if ( scheduler->ConsumeTasks( me, stolen_batch ) ) idle = 0;
     } /** end if ( idle > 10 ) */
 
+    /** Spin, then yield, then park; idle polling workers never park. */
+    if ( idle ) scheduler->Backoff( me, idle, !( has_progress && mode == PROGRESS_IDLE ) );
+
     /** Check if is time to terminate. */
     if ( scheduler->IsTimeToExit( me->tid ) ) break;
   }
+  /** Do not leave the epoch before the other ranks. */
+  if ( has_progress ) scheduler->WaitForGlobalConsensus( me );
   /** Return "NULL". */
   return NULL;
 }; /** end Scheduler::EntryPoint() */
 
 
-/** @brief Listen for asynchronous incoming MPI messages. */
-void Scheduler::Listen( Worker *me )
+/** 
+ *  @brief Match at most one incoming message with MPI_Improbe() and hand it
+ *         off to its listener, which receives it with MPI_Mrecv() and is
+ *         then enqueued like any ready task. Only one thread probes at a
+ *         time; the others return immediately instead of waiting. Only
+ *         headers are sent on the private communicator; their payloads go
+ *         to payload_comm, such that MPI_ANY_TAG can not match (and park)
+ *         a payload that the listener will receive by its tag.
+ *  @return whether a listener has been enqueued
+ */ 
+bool Scheduler::Progress( Worker *me )
 {
-  /** We use a duplicated (private) communicator to handle message tasks. */
-  auto comm = this->GetPrivateComm();
-  auto size = this->GetCommSize();
-  auto rank = this->GetCommRank();
+  if ( !progress_lock.TryAcquire() ) return false;
 
-  /** Iprobe flag and recv status */
-  int probe_flag = 0;
-  mpi::Status status;
-
-  /** Keep probing for incoming messages. */
-  while ( 1 ) 
+  ListenerTask *task = NULL;
+  /** The header message of a listener is tagged with its key. */
+  auto handoff = [&] ( mpi::Message &message, mpi::Status &status )
   {
-    ListenerTask *task = NULL;
-    /** Only one thread will probe and recv message at a time. */
-    #pragma omp critical
+    auto &listeners = listener_tasklist[ status.MPI_SOURCE ];
+    auto it = listeners.find( status.MPI_TAG );
+    if ( it == listeners.end() || it->second->GetStatus() != NOTREADY ) return false;
+    task = it->second;
+    task->SetStatus( QUEUED );
+    task->Listen( message, status );
+    return true;
+  };
+  /** Messages matched before their listeners were ready go first. */
+  for ( auto it = unmatched_messages.begin(); it != unmatched_messages.end(); it ++ )
+  {
+    if ( handoff( it->first, it->second ) ) 
     {
-      /** Asynchronously probe form incoming messages. */
-      mpi::Iprobe( MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &probe_flag, &status );
-      /** If receive any message, then handle it. */
-      if ( probe_flag )
-      {
-        /** Info from mpi::Status */
-        int recv_src = status.MPI_SOURCE;
-        int recv_tag = status.MPI_TAG;
-        int recv_key = 3 * ( recv_tag / 3 );
-   
-        if ( recv_key < 300 )
-        {
-          printf( "rank %d Iprobe src %d tag %d\n", rank, recv_src, recv_tag ); 
-          fflush( stdout );
-        }
-
-        /** Check if there is a corresponding task. */
-        auto it = listener_tasklist[ recv_src ].find( recv_key );
-        if ( it != listener_tasklist[ recv_src ].end() )
-        {
-          task = it->second;
-          if ( task->GetStatus() == NOTREADY )
-          {
-            //printf( "rank %d Find a task src %d tag %d\n", rank, recv_src, recv_tag ); 
-            //fflush( stdout );
-            task->SetStatus( QUEUED );
-            task->Listen();
-          }
-          else
-          {
-            printf( "rank %d Find a QUEUED task src %d tag %d\n", rank, recv_src, recv_tag ); 
-            fflush( stdout );
-            task = NULL;
-            probe_flag = false;
-          }
-        }
-        else 
-        {
-          //printf( "rank %d not match task src %d tag %d\n", rank, recv_src, recv_tag ); 
-          //fflush( stdout );
-          probe_flag = false;
-        }
-      }
+      unmatched_messages.erase( it );
+      break;
     }
-
-    if ( probe_flag )
+  }
+  if ( !task )
+  {
+    int flag = 0;
+    mpi::Message message;
+    mpi::Status status;
+    mpi::Improbe( MPI_ANY_SOURCE, MPI_ANY_TAG, this->GetPrivateComm(), &flag, &message, &status );
+    /** A matched message must be received; keep it until its listener is ready. */
+    if ( flag && !handoff( message, status ) ) 
     {
-      /** Execute tasks and update dependencies */
-      ConsumeTasks( me, task, false );
+      unmatched_messages.push_back( make_pair( message, status ) );
     }
-    else
+  }
+  progress_lock.Release();
+
+  if ( task ) task->Enqueue( me->tid );
+  return ( task != NULL );
+}; /** end Scheduler::Progress() */
+
+
+/** 
+ *  @brief Idle workers spin for a while (tasks often arrive right away),
+ *         then yield the core, and finally park on a condition variable
+ *         until Notify() is called by an enqueue or by termination. The
+ *         timed wait bounds the cost of a missed wakeup (e.g. a task that
+ *         can not be stolen from the queue of a parked worker).
+ */ 
+void Scheduler::Backoff( Worker *me, size_t idle, bool can_park )
+{
+  const size_t spin_iterations = 256;
+  const size_t yield_iterations = 1024;
+  if ( idle < spin_iterations ) return;
+  if ( idle < yield_iterations || !can_park ) 
+  {
+    sched_yield();
+    return;
+  }
+  unique_lock<mutex> guard( park_mutex );
+  n_parked ++;
+  /** Check again after announcing myself; enqueues from now on notify. */
+  if ( !do_terminate && !HasQueuedTasks() ) 
+  {
+    park_cond.wait_for( guard, chrono::milliseconds( 1 ) );
+  }
+  n_parked --;
+}; /** end Scheduler::Backoff() */
+
+
+/** @brief Only lock the mutex if there are parked workers. */
+void Scheduler::Notify( bool all )
+{
+  if ( !n_parked.load() ) return;
+  lock_guard<mutex> guard( park_mutex );
+  if ( all ) park_cond.notify_all();
+  else       park_cond.notify_one();
+}; /** end Scheduler::Notify() */
+
+
+/** @brief The sizes are read without locks; this is only a hint. */
+bool Scheduler::HasQueuedTasks()
+{
+  for ( int p = 0; p < n_worker; p ++ )
+  {
+    if ( ready_queue[ p ].size() || nested_queue[ p ].size() ) return true;
+  }
+  return false;
+}; /** end Scheduler::HasQueuedTasks() */
+
+
+/** @brief The loop of the dedicated or the oversubscribed progress worker. */
+void Scheduler::ProgressLoop( Worker *me, bool steal )
+{
+  while ( !IsTimeToExit( me->tid ) )
+  {
+    if ( Progress( me ) ) continue;
+    /** Steal a (normal or nested) task, or give up the core. */
+    if ( steal ) 
     {
-      /** Steal a (normal or nested) task from other. */
-      auto stolen_batch = StealFromOther();
+      auto stolen_batch = StealFromOther( me );
       ConsumeTasks( me, stolen_batch );
     }
+    else sched_yield();
+  }
+  WaitForGlobalConsensus( me );
+}; /** end Scheduler::ProgressLoop() */
 
-    /** Nonblocking consensus for termination. */
-    if ( do_terminate ) 
+
+/** @brief Nonblocking consensus for termination. */
+void Scheduler::WaitForGlobalConsensus( Worker *me )
+{
+  auto comm = this->GetPrivateComm();
+  int consensus = 0;
+  while ( !consensus )
+  {
+    /** We use an ibarrier to make sure global concensus. */
+    #pragma omp critical
     {
-      /** We use an ibarrier to make sure global concensus. */
-      #pragma omp critical
+      /** Only the first worker will issue an Ibarrier. */
+      if ( !has_ibarrier ) 
       {
-        /** Only the first worker will issue an Ibarrier. */
-        if ( !has_ibarrier ) 
-        {
-          mpi::Ibarrier( comm, &ibarrier_request );
-          has_ibarrier = true;
-        }
-        /** Test global consensus on "terminate_request". */
-        if ( !ibarrier_consensus )
-        {
-          mpi::Test( &ibarrier_request, &ibarrier_consensus, 
-              MPI_STATUS_IGNORE );
-        }
+        mpi::Ibarrier( comm, &ibarrier_request );
+        has_ibarrier = true;
       }
-      /** If terminate_request has been tested = true, then exit! */
-      if ( ibarrier_consensus ) break;
+      /** Test global consensus on "terminate_request". */
+      if ( !ibarrier_consensus )
+      {
+        mpi::Test( &ibarrier_request, &ibarrier_consensus, 
+            MPI_STATUS_IGNORE );
+      }
+      consensus = ibarrier_consensus;
     }
   }
-}; /** end Scheduler::Listen() */
+}; /** end Scheduler::WaitForGlobalConsensus() */
 
 
 /** @brief */
@@ -1269,6 +1811,101 @@ void Scheduler::Summary()
 
 
 
+/**
+ *  class TaskGraph
+ */ 
+
+/** @brief The graph owns all recorded tasks. */
+TaskGraph::~TaskGraph() { Clear(); };
+
+/** 
+ *  \brief Run all submitted tasks and record them as the next epoch.
+ *  \return the error code
+ */
+hmlpError_t TaskGraph::Capture()
+{
+  /* Check before the scheduler is told to record, see RunTime::run(). */
+  if ( !rt.isInit() ) return HMLP_ERROR_NOT_INITIALIZED;
+  if ( rt.isInEpochSession() ) return HMLP_ERROR_NOT_SUPPORTED;
+  rt.scheduler->CaptureNextEpoch( this );
+  return rt.run();
+}; /* end TaskGraph::Capture() */
+
+/** 
+ *  \brief Run all recorded epochs again in the order of capture.
+ *  \return the error code
+ */
+hmlpError_t TaskGraph::Replay()
+{
+  if ( !rt.isInit() ) return HMLP_ERROR_NOT_INITIALIZED;
+  if ( rt.isInEpochSession() ) return HMLP_ERROR_NOT_SUPPORTED;
+  for ( auto & epoch : epochs )
+  {
+    RETURN_IF_ERROR( rt.scheduler->RewindEpoch( epoch.tasks, epoch.n_dependencies ) );
+    RETURN_IF_ERROR( rt.run() );
+  }
+  /* Return with no error. */
+  return HMLP_ERROR_SUCCESS;
+}; /* end TaskGraph::Replay() */
+
+/** @brief Delete all recorded tasks and free the task slabs if possible. */
+void TaskGraph::Clear()
+{
+  if ( epochs.empty() ) return;
+  for ( auto & epoch : epochs )
+    for ( auto task : epoch.tasks ) delete task;
+  epochs.clear();
+  /* Return the memory if this was the last graph that held tasks. */
+  if ( !rt.isInEpochSession() ) Task::ReleaseSlabs();
+}; /* end TaskGraph::Clear() */
+
+/** @return the number of recorded tasks of all epochs. */
+size_t TaskGraph::NumberOfTasks() const noexcept
+{
+  size_t n_task = 0;
+  for ( auto & epoch : epochs ) n_task += epoch.tasks.size();
+  return n_task;
+}; /* end TaskGraph::NumberOfTasks() */
+
+/** 
+ *  \brief Take the ownership of tasks. The initial counter of each task is
+ *         the number of its incoming edges within the epoch, which are
+ *         exactly the edges that dependenciesUpdate() will decrease.
+ *  \return the error code
+ */
+hmlpError_t TaskGraph::Record( deque<Task*> &tasks )
+{
+  /* Message tasks depend on the remote ranks; they can not be replayed. */
+  for ( auto task : tasks )
+  {
+    if ( dynamic_cast<MessageTask*>( task ) )
+    {
+      for ( auto task : tasks ) delete task;
+      return HMLP_ERROR_NOT_SUPPORTED;
+    }
+  }
+  Epoch epoch;
+  epoch.tasks.assign( tasks.begin(), tasks.end() );
+  epoch.n_dependencies.resize( tasks.size(), 0 );
+  unordered_map<Task*, size_t> index;
+  for ( size_t i = 0; i < tasks.size(); i ++ ) index[ tasks[ i ] ] = i;
+  for ( auto task : tasks )
+  {
+    for ( auto child : task->out )
+    {
+      auto it = index.find( child );
+      if ( it != index.end() ) epoch.n_dependencies[ it->second ] ++;
+    }
+  }
+  epochs.push_back( epoch );
+  /* Return with no error. */
+  return HMLP_ERROR_SUCCESS;
+}; /* end TaskGraph::Record() */
+
+
+
+
+
 /**
  *  class RunTime
  */ 
@@ -1298,6 +1935,14 @@ hmlpError_t RunTime::init( mpi::Comm comm = MPI_COMM_WORLD )
       mpi::Initialized( &is_mpi_init );
 
       scheduler = new Scheduler( comm );
+      /** Calibrated task costs of earlier runs (the file may not exist yet). */
+      auto *cost_model_file = getenv( "HMLP_COST_MODEL_FILE" );
+      if ( cost_model_file && *cost_model_file ) 
+      {
+        /** The file already contains what an earlier session saved. */
+        costmodel::clear();
+        costmodel::load( cost_model_file );
+      }
 
 #ifdef HMLP_USE_CUDA
       /** TODO: detect devices */
@@ -1312,6 +1957,10 @@ hmlpError_t RunTime::init( mpi::Comm comm = MPI_COMM_WORLD )
     }
   } /* end pragma omp critical */
 
+#ifdef HMLP_USE_DISPATCH
+  /* Select the kernel package of this CPU (see package/x86_64/dispatch). */
+  RETURN_IF_ERROR( arch::select() );
+#endif
   /* Return error if the scheduler was failed in allocation. */
   if ( !scheduler ) return HMLP_ERROR_ALLOC_FAILED;
   /* Return without error. */
@@ -1357,6 +2006,14 @@ hmlpError_t RunTime::init( int* argc, char*** argv, mpi::Comm comm = MPI_COMM_WO
       }
       /** Initialize the scheduler. */
       scheduler = new Scheduler( comm );
+      /** Calibrated task costs of earlier runs (the file may not exist yet). */
+      auto *cost_model_file = getenv( "HMLP_COST_MODEL_FILE" );
+      if ( cost_model_file && *cost_model_file ) 
+      {
+        /** The file already contains what an earlier session saved. */
+        costmodel::clear();
+        costmodel::load( cost_model_file );
+      }
 #ifdef HMLP_USE_CUDA
       /** TODO: detect devices */
       device[ 0 ] = new hmlp::gpu::Nvidia( 0 );
@@ -1369,6 +2026,10 @@ hmlpError_t RunTime::init( int* argc, char*** argv, mpi::Comm comm = MPI_COMM_WO
       is_init_ = true;
     }
   } /* end pragma omp critical */
+#ifdef HMLP_USE_DISPATCH
+  /* Select the kernel package of this CPU (see package/x86_64/dispatch). */
+  RETURN_IF_ERROR( arch::select() );
+#endif
   /* Return error if the scheduler was failed in allocation. */
   if ( !scheduler ) return HMLP_ERROR_ALLOC_FAILED;
   /* Return without error. */
@@ -1399,11 +2060,13 @@ hmlpError_t RunTime::run()
   /* Schedule jobs to n workers. */
   RETURN_IF_ERROR( scheduler->Init( getNumberOfWorkers() ) );
   /* Clean up. */
-  RETURN_IF_ERROR( scheduler->Finalize() );
+  hmlpError_t error = scheduler->Finalize();
+  /* Fold the measured task durations into the cost models. */
+  if ( costmodel::isEnabled() ) costmodel::update();
   /* Finish this epoch session. */
   is_in_epoch_session_ = false;
-  /* Return without error. */
-  return HMLP_ERROR_SUCCESS;
+  /* Return the error of clean up (if any). */
+  return error;
 }; /* end RunTime::run() */
 
 /**
@@ -1420,7 +2083,17 @@ hmlpError_t RunTime::finalize()
     {
       /** Finalize the scheduler and delete it. */
       scheduler_error = scheduler->Finalize();
+      /** Persist the calibrated task costs for the next run. */
+      auto *cost_model_file = getenv( "HMLP_COST_MODEL_FILE" );
+      if ( cost_model_file && *cost_model_file && !scheduler->GetCommRank() )
+      {
+        costmodel::update();
+        if ( costmodel::save( cost_model_file ) != HMLP_ERROR_SUCCESS )
+          fprintf( stderr, "[WARNING] fail to write the cost model file %s\n", cost_model_file );
+      }
       delete scheduler;
+      /** All tasks are deleted unless a TaskGraph still holds some. */
+      Task::ReleaseSlabs();
       /** Set the initialized flag to false. */
       is_init_ = false;
       /** Finalize MPI if it was initialized by HMLP. */
@@ -1565,6 +2238,19 @@ hmlpError_t hmlp_set_num_workers( int num_of_workers )
   return hmlp::rt.setNumberOfWorkers( num_of_workers );
 };
 
+/**
+ *  \brief The team size of the parallel loops between epochs. It matches
+ *         the workers, such that OpenMP reuses their threads instead of
+ *         starting new ones. The OpenMP settings of the process are left
+ *         untouched; use it in num_threads() clauses.
+ *  \return the number of workers (omp_get_max_threads() if not initialized)
+ */
+int hmlp_get_num_workers()
+{
+  if ( !hmlp::rt.isInit() ) return omp_get_max_threads();
+  return hmlp::rt.getNumberOfWorkers();
+};
+
 /** 
  *  \brief Consume all tasks in the graph.
  *  \return error code
@@ -29,7 +29,11 @@
 #include <deque>
 #include <map>
 #include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <limits>
+#include <memory>
 #include <cstdint>
 #include <cassert>
 #include <stdio.h>
@@ -45,6 +49,7 @@
 
 #include <base/thread.hpp>
 #include <base/tci.hpp>
+#include <base/costmodel.hpp>
 #include <hmlp_mpi.hpp>
 
 #define MAX_WORKER 68
@@ -71,8 +76,16 @@ namespace hmlp
 /** @brief */
 typedef enum { ALLOCATED, NOTREADY, QUEUED, RUNNING, EXECUTED, DONE, CANCELLED } TaskStatus;
 
-/** @brief */
-typedef enum { R, W, RW } ReadWriteType;
+/**
+ *  @brief Access modes of DependencyAnalysis(). ACC is a commutative
+ *         accumulation (e.g. +=): ACC accesses are ordered against R and W
+ *         accesses but not against each other, such that they can run
+ *         concurrently as long as each update holds the lock of its region.
+ */
+typedef enum { R, W, RW, ACC } ReadWriteType;
+
+/** @brief Who drives MPI progress (HMLP_MPI_PROGRESS=idle|dedicated|oversubscribed). */
+typedef enum { PROGRESS_IDLE, PROGRESS_DEDICATED, PROGRESS_OVERSUBSCRIBED } ProgressMode;
 
 /**
  *  class Event
@@ -135,6 +148,74 @@ class Event
 
 
 
+/**
+ *  @brief A list of tasks whose first N entries are stored inline. Most
+ *         tasks have a few dependency edges, so they never touch the heap.
+ */
+template<typename T, size_t N>
+class InlineList
+{
+  public:
+
+    InlineList() {};
+
+    InlineList( const InlineList &other ) { *this = other; };
+
+    InlineList& operator=( const InlineList &other )
+    {
+      if ( this == &other ) return *this;
+      clear();
+      for ( size_t i = 0; i < other.size_; i ++ ) push_back( other.data_[ i ] );
+      return *this;
+    };
+
+    ~InlineList() { clear(); };
+
+    void push_back( T value )
+    {
+      /** Spill to (or grow) a heap array when the current storage is full. */
+      if ( size_ == capacity_ )
+      {
+        T *spill = new T[ 2 * capacity_ ];
+        std::copy( data_, data_ + size_, spill );
+        if ( data_ != inline_ ) delete [] data_;
+        data_ = spill;
+        capacity_ *= 2;
+      }
+      data_[ size_ ++ ] = value;
+    };
+
+    void clear()
+    {
+      if ( data_ != inline_ ) delete [] data_;
+      data_ = inline_;
+      size_ = 0;
+      capacity_ = N;
+    };
+
+    size_t size() const noexcept { return size_; };
+
+    bool empty() const noexcept { return !size_; };
+
+    T& operator[]( size_t i ) { return data_[ i ]; };
+
+    T* begin() { return data_; };
+
+    T* end() { return data_ + size_; };
+
+  private:
+
+    T inline_[ N ];
+
+    T *data_ = inline_;
+
+    size_t size_ = 0;
+
+    size_t capacity_ = N;
+
+}; /** end class InlineList */
+
+
 /**
  *  class Task
  */ 
@@ -146,7 +227,21 @@ class Task
 
     Task();
 
-    ~Task();
+    virtual ~Task();
+
+    /** Tasks are recycled through per-thread free lists of size classes. */
+    static void* operator new( size_t size );
+
+    static void operator delete( void *ptr, size_t size );
+
+    /** Keep placement new, which the class operator new would hide. */
+    static void* operator new( size_t, void *where ) { return where; };
+
+    /** Free all slabs if no task is alive; return whether they were freed. */
+    static bool ReleaseSlabs();
+
+    /** @return the number of slabs that task allocations are carved from. */
+    static size_t GetNumberOfSlabs();
 
     class Worker *worker = NULL;
 
@@ -154,10 +249,16 @@ class Task
 
     string label;
 
+    /** Labels are only read by the timeline, so they are only built for it. */
+    void SetLabel( size_t id );
+
     int taskid;
 
     float cost = 0;
 
+    /** The cost model of this task type, resolved once by Submit(). */
+    const costmodel::model_s *cost_model = NULL;
+
     bool priority = false;
 
     Event event;
@@ -202,9 +303,12 @@ class Task
     hmlpError_t addDependencyFrom( Task* source );
     hmlpError_t addDependencyTo( Task* target );
 
+    /** Reset the status and the dependency counter to replay this task. */
+    void Rewind( int n_dependencies );
+
     /** Read/write sets for dependency analysis */ 
-    deque<Task*> in;
-    deque<Task*> out;
+    InlineList<Task*, 4> in;
+    InlineList<Task*, 4> out;
 
     /** Task lock */
     hmlpError_t Acquire();
@@ -223,6 +327,9 @@ class Task
 
     volatile int created_by = 0;
 
+    /** The preferred socket (affinity domain) of this task; -1 means any. */
+    int affinity = -1;
+
     bool IsNested();
 
   protected:
@@ -275,6 +382,9 @@ class MessageTask : public Task
     /** MPI communicator will be provided during Submit(). */
     mpi::Comm comm;
 
+    /** Payloads follow their headers on this communicator, see Scheduler::Progress(). */
+    mpi::Comm payload_comm;
+
     /** Provided during the construction. */
     int tar = 0;
     int src = 0;
@@ -297,7 +407,8 @@ class ListenerTask : public MessageTask
 
     void Submit();
 
-    virtual void Listen() = 0;
+    /** Receive the matched message (and the rest) handed off by the progress engine. */
+    virtual void Listen( mpi::Message &message, mpi::Status &status ) = 0;
 }; /** end class ListenerTask */
 
 
@@ -322,7 +433,7 @@ class SendTask : public MessageTask
     void Set( ARG *user_arg, int src, int tar, int key )
     {
       name = string( "Send" );
-      label = to_string( tar );
+      SetLabel( tar );
       this->arg = user_arg;
       this->src = src;
       this->tar = tar;
@@ -346,7 +457,7 @@ class SendTask : public MessageTask
       //mpi::Isend( this->send_skels.data(), this->send_skels.size(),
       //    this->tar, this->key + 1, this->comm, &req2 ); 
       mpi::Isend( this->send_buffs.data(), this->send_buffs.size(),
-          this->tar, this->key + 2, this->comm, &req3 ); 
+          this->tar, this->key, this->payload_comm, &req3 ); 
     };
 }; /** end class SendTask */
 
@@ -369,7 +480,7 @@ class RecvTask : public ListenerTask
     void Set( ARG *user_arg, int src, int tar, int key )
     {
       name = string( "Listener" );
-      label = to_string( src );
+      SetLabel( src );
       this->arg = user_arg;
       this->src = src;
       this->tar = tar;
@@ -385,25 +496,21 @@ class RecvTask : public ListenerTask
       hmlp_msg_dependency_analysis( this->key, this->src, RW, this );
     };
 
-    void Listen()
+    void Listen( mpi::Message &message, mpi::Status &status )
     {
       int src = this->src;
-      int tar = this->tar;
       int key = this->key;
-      mpi::Comm comm = this->comm;
       int cnt = 0;
-      mpi::Status status;
-      /** Probe the message that contains recv_sizes */
-      mpi::Probe( src, key + 0, comm, &status );
+      /** The matched message contains recv_sizes */
       mpi::Get_count( &status, HMLP_MPI_SIZE_T, &cnt );
       recv_sizes.resize( cnt );
-      mpi::Recv( recv_sizes.data(), cnt, src, key + 0, comm, &status );
+      mpi::Mrecv( recv_sizes.data(), cnt, &message, &status );
       /** Calculate the total size of recv_buffs */
       cnt = 0;
       for ( auto c : recv_sizes ) cnt += c;
       recv_buffs.resize( cnt );
-      /** Receive recv_buffs as well */
-      mpi::Recv( recv_buffs.data(), cnt, src, key + 2, comm, &status );
+      /** The payload is never probed by Progress(), so it is still unmatched. */
+      mpi::Recv( recv_buffs.data(), cnt, src, key, this->payload_comm, &status );
     };
 
     virtual void Unpack() = 0;
@@ -416,6 +523,14 @@ class RecvTask : public ListenerTask
 
 
 
+/** @brief Use the affinity of the argument (e.g. a tree node) if it has one. */
+template<typename ARG>
+auto GetTaskAffinity( ARG *arg, int ) -> decltype( (int)arg->affinity ) { return arg->affinity; };
+
+template<typename ARG>
+int GetTaskAffinity( ARG *arg, long ) { return -1; };
+
+
 /** @brief Recursive task sibmission (base case). */ 
 template<typename ARG>
 void RecuTaskSubmit( ARG *arg ) { /** do nothing */ }; 
@@ -432,6 +547,7 @@ void RecuTaskSubmit( ARG *arg, TASK& dummy, Args&... dummyargs )
     auto task = new TASK();
     task->Submit();
     task->Set( arg );
+    task->affinity = GetTaskAffinity( arg, 0 );
     task->DependencyAnalysis();
   }
   /** now recurs to Args&... args, types are deduced automatically */
@@ -482,6 +598,9 @@ class ReadWrite
     /** Tracking the write set of the object. */
     deque<Task*> write;
 
+    /** Tracking the commutative accumulations since the last read or write. */
+    deque<Task*> accumulate;
+
     hmlpError_t DependencyAnalysis( ReadWriteType type, Task *task );
 
     hmlpError_t DependencyCleanUp();
@@ -509,7 +628,7 @@ class MatrixReadWrite
 
     bool HasBeenSetup();
 
-    void DependencyAnalysis( size_t i, size_t j, ReadWriteType type, Task *task );
+    hmlpError_t DependencyAnalysis( size_t i, size_t j, ReadWriteType type, Task *task );
 
     void DependencyCleanUp();
 
@@ -529,6 +648,148 @@ class MatrixReadWrite
 
 
 
+/**
+ *  class RegionReadWrite
+ */ 
+
+/**
+ *  @brief Tracks the dependencies of an m-by-n array on mb-by-nb tiles, such
+ *         that tasks accessing disjoint row ranges or column panels do not
+ *         depend on each other. Each tile also has a lock that serializes
+ *         the concurrent ACC updates of the same tile (see Acquire()).
+ */
+class RegionReadWrite
+{
+  public:
+
+    RegionReadWrite() {};
+
+    /** A copy is a different object; it does not inherit tiles or tasks. */
+    RegionReadWrite( const RegionReadWrite& ) {};
+
+    RegionReadWrite& operator=( const RegionReadWrite& )
+    {
+      m = n = mb = nb = 0;
+      tiles = MatrixReadWrite();
+      locks.reset();
+      return *this;
+    };
+
+    /** Partition the array into tiles; this also drops all dependencies. */
+    hmlpError_t Setup( size_t m, size_t n, size_t mb, size_t nb );
+
+    bool HasBeenSetup() const noexcept { return locks != nullptr; };
+
+    /** Apply the dependency to all tiles overlapping A( i:i+m-1, j:j+n-1 ). */
+    hmlpError_t DependencyAnalysis( size_t i, size_t m, size_t j, size_t n, 
+        ReadWriteType type, Task *task );
+
+    void DependencyCleanUp();
+
+    /** Lock all tiles overlapping the region (in the column-major tile order). */
+    hmlpError_t Acquire( size_t i, size_t m, size_t j, size_t n );
+
+    hmlpError_t Release( size_t i, size_t m, size_t j, size_t n );
+
+    /** Lock and unlock the tile that contains A( i, j ). */
+    hmlpError_t AcquireTile( size_t i, size_t j );
+
+    hmlpError_t ReleaseTile( size_t i, size_t j );
+
+    size_t GetRowBlockSize() const noexcept { return mb; };
+
+    size_t GetColumnBlockSize() const noexcept { return nb; };
+
+  private:
+
+    /** Return false if the region is empty or out of range. */
+    bool GetTileRange( size_t i, size_t m, size_t j, size_t n,
+        size_t &ibeg, size_t &iend, size_t &jbeg, size_t &jend ) const;
+
+    size_t m = 0;
+
+    size_t n = 0;
+
+    size_t mb = 0;
+
+    size_t nb = 0;
+
+    MatrixReadWrite tiles;
+
+    /** One lock per tile, stored in the column-major tile order. */
+    unique_ptr<Lock[]> locks;
+
+}; /** end class RegionReadWrite */
+
+
+
+
+
+/**
+ *  class TaskGraph
+ */ 
+
+/**
+ *  @brief A recorded task DAG that can be executed many times. Capture()
+ *         runs all tasks submitted so far (like hmlp_run()) but keeps the
+ *         tasks and their edges instead of deleting them; each call records
+ *         one epoch. Replay() runs all recorded epochs again in order, only
+ *         resetting the status and the dependency counters. There is no
+ *         allocation, Set() or DependencyAnalysis() during Replay(), so the
+ *         tasks must reach their data through objects that outlive the graph
+ *         (e.g. tree nodes and their setup), which can be rebound between
+ *         replays. Message tasks can not be captured.
+ */
+class TaskGraph
+{
+  public:
+
+    TaskGraph() {};
+
+    ~TaskGraph();
+
+    /** The graph owns its tasks; it can not be copied. */
+    TaskGraph( const TaskGraph& ) = delete;
+
+    TaskGraph& operator=( const TaskGraph& ) = delete;
+
+    /** Run all submitted tasks and record them as the next epoch. */
+    hmlpError_t Capture();
+
+    /** Run all recorded epochs again. */
+    hmlpError_t Replay();
+
+    /** Delete all recorded tasks; free the task slabs if none is alive. */
+    void Clear();
+
+    bool IsEmpty() const noexcept { return epochs.empty(); };
+
+    size_t NumberOfEpochs() const noexcept { return epochs.size(); };
+
+    size_t NumberOfTasks() const noexcept;
+
+  private:
+
+    friend class Scheduler;
+
+    /** Take the ownership of the tasks of one finished epoch. */
+    hmlpError_t Record( deque<Task*> &tasks );
+
+    struct Epoch
+    {
+      vector<Task*> tasks;
+      /** The initial dependency counter of each task. */
+      vector<int> n_dependencies;
+    };
+
+    vector<Epoch> epochs;
+
+}; /** end class TaskGraph */
+
+
+
+
+
 /**
  *  class Scheduler
  */ 
@@ -548,6 +809,9 @@ class Scheduler : public mpi::MPIObject
 
     int n_worker = 0;
 
+    /** Number of sockets (affinity domains) that the workers are pinned to. */
+    int n_socket = 1;
+
     size_t timeline_tag;
 
     double timeline_beg;
@@ -590,6 +854,21 @@ class Scheduler : public mpi::MPIObject
 
     void Summary();
 
+    /** Wake up a parked worker after a task has been enqueued. */
+    void Notify( bool all = false );
+
+    /** Match at most one incoming message and hand it off to its listener. */
+    bool Progress( Worker *me );
+
+    /** Message tasks send their payloads on this (unprobed) communicator. */
+    mpi::Comm GetPayloadComm() { return payload_comm; };
+
+    /** Record the normal tasks of the next epoch in graph. */
+    void CaptureNextEpoch( TaskGraph *graph );
+
+    /** Rewind the tasks of a recorded epoch and enqueue the sources. */
+    hmlpError_t RewindEpoch( vector<Task*> &tasks, const vector<int> &n_dependencies );
+
 
   private:
 
@@ -605,6 +884,15 @@ class Scheduler : public mpi::MPIObject
     /** This mutex grants exclusive right to modify tasklists. */
     Lock tasklist_lock;
 
+    /** Duplicated from the private communicator; only received with explicit tags. */
+    mpi::Comm payload_comm;
+
+    /** If set, Finalize() hands the normal tasks to this graph. */
+    TaskGraph *capture_graph = nullptr;
+
+    /** Number of rewound tasks of a recorded epoch (not in tasklist). */
+    size_t n_replay_task = 0;
+
     /** Number of tasks and nested tasks that have been completed. */
     int n_task_completed = 0;
     int n_nested_task_completed = 0;
@@ -616,7 +904,7 @@ class Scheduler : public mpi::MPIObject
 
     vector<Task*> DispatchFromNestedQueue( int tid );
 
-    vector<Task*> StealFromOther();
+    vector<Task*> StealFromOther( Worker *me );
 
     Task *StealFromQueue( size_t target );
 
@@ -626,7 +914,43 @@ class Scheduler : public mpi::MPIObject
 
     bool IsTimeToExit( int tid );
 
-    void Listen( Worker* );
+    /** The loop of the worker that only (or mainly) drives MPI progress. */
+    void ProgressLoop( Worker *me, bool steal );
+
+    /** Wait until all ranks have finished this epoch. */
+    void WaitForGlobalConsensus( Worker *me );
+
+    /** How MPI progress is driven in this epoch. */
+    ProgressMode progress_mode = PROGRESS_IDLE;
+
+    /** Spin, then yield, then park according to the idle counter. */
+    void Backoff( Worker *me, size_t idle, bool can_park );
+
+    /** Whether any ready or nested queue is nonempty (without locks). */
+    bool HasQueuedTasks();
+
+    /** Parked workers wait on park_cond; Notify() only locks if there are some. */
+    mutex park_mutex;
+    condition_variable park_cond;
+    atomic<int> n_parked;
+
+    /** Number of threads in this epoch (workers plus the oversubscribed one). */
+    int n_thread = 0;
+
+    /** BLAS threads outside epochs saved by Init() (0 if none), see Finalize(). */
+    int blas_threads_outside = 0;
+
+    /** The number of BLAS threads of a task according to its size class. */
+    int BlasThreads( Task *task );
+
+    /** Execute a task (or a batch) with the BLAS threads of its size class. */
+    bool Execute( Worker *me, Task *task );
+
+    /** Only one thread probes and receives at a time. */
+    Lock progress_lock;
+
+    /** Matched messages whose listeners are not ready yet. */
+    vector<pair<mpi::Message, mpi::Status>> unmatched_messages;
 
     Lock task_lock[ 2 * MAX_WORKER ];
 
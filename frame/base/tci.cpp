@@ -80,6 +80,15 @@ hmlpError_t Lock::Release()
   return HMLP_ERROR_SUCCESS;
 };
 
+bool Lock::TryAcquire()
+{
+#ifdef USE_PTHREAD_RUNTIME
+  return !pthread_mutex_trylock( &lock );
+#else
+  return omp_test_lock( &lock );
+#endif
+};
+
 
 
 
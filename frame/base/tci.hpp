@@ -59,6 +59,9 @@ class Lock
 
     hmlpError_t Release();
 
+    /** Acquire the lock only if it is free; return whether it is acquired. */
+    bool TryAcquire();
+
   private:
 #ifdef USE_PTHREAD_RUNTIME
     pthread_mutex_t lock;
@@ -21,6 +21,7 @@
 
 #include <base/runtime.hpp>
 #include <base/thread.hpp>
+#include <base/costmodel.hpp>
 
 
 using namespace std;
@@ -177,6 +178,14 @@ void thread_communicator::Create( int level, int num_threads, int *config )
   }
 };
 
+/**
+ *  @brief The root owns the whole tree (kids are created by Create()).
+ */
+thread_communicator::~thread_communicator()
+{
+  if ( kids ) delete [] kids;
+};
+
 thread_communicator::thread_communicator() :
   sent_object( NULL ), 
   comm_id( 0 ),
@@ -261,6 +270,109 @@ void thread_communicator::Recv( void** buffer )
   *buffer = sent_object;
 };
 
+/**
+ *  @brief Workspace implementation
+ */
+namespace
+{
+
+/** One level of the Workspace cache: buffers and communicators. */
+struct WorkspaceLevel
+{
+  vector<pair<void*, size_t>> buffers;
+
+  map<tuple<int, int, int, int>, thread_communicator*> comms;
+
+  size_t GetBytes()
+  {
+    size_t bytes = 0;
+    for ( auto &it : buffers ) bytes += it.second;
+    return bytes;
+  };
+
+  ~WorkspaceLevel()
+  {
+    for ( auto &it : buffers ) hmlp_free( it.first );
+    for ( auto &it : comms ) delete it.second;
+  };
+};
+
+/** Levels of the calling thread; levels[ 0, depth ) are in use. */
+struct WorkspaceCache
+{
+  vector<WorkspaceLevel*> levels;
+
+  size_t depth = 0;
+
+  ~WorkspaceCache() { for ( auto level : levels ) delete level; };
+};
+
+thread_local WorkspaceCache workspace_cache;
+
+}; /** end unnamed namespace */
+
+
+Workspace::Workspace()
+{
+  depth = workspace_cache.depth ++;
+  if ( workspace_cache.levels.size() <= depth )
+  {
+    workspace_cache.levels.push_back( new WorkspaceLevel() );
+  }
+};
+
+Workspace::~Workspace() { workspace_cache.depth --; };
+
+/**
+ *  @brief Reuse the next buffer of this level if it is large enough.
+ *         Buffers are page aligned, which covers all ALIGN_SIZE used by
+ *         the micro-kernels.
+ */
+void *Workspace::Buffer( size_t align, size_t bytes )
+{
+  const size_t page_size = 4096;
+  assert( align <= page_size && page_size % align == 0 );
+  auto &buffers = workspace_cache.levels[ depth ]->buffers;
+  if ( num_buffers == buffers.size() ) buffers.push_back( make_pair( (void*)NULL, 0 ) );
+  auto &buffer = buffers[ num_buffers ++ ];
+  if ( buffer.second < bytes || !buffer.first )
+  {
+    hmlp_free( buffer.first );
+    buffer.first = hmlp_malloc<page_size, char>( bytes, 1, 1 );
+    buffer.second = bytes;
+  }
+  return buffer.first;
+};
+
+thread_communicator &Workspace::Communicator( int jc_nt, int pc_nt, int ic_nt, int jr_nt )
+{
+  auto &comms = workspace_cache.levels[ depth ]->comms;
+  auto key = make_tuple( jc_nt, pc_nt, ic_nt, jr_nt );
+  auto it = comms.find( key );
+  if ( it == comms.end() )
+  {
+    it = comms.insert( make_pair( key, new thread_communicator( jc_nt, pc_nt, ic_nt, jr_nt ) ) ).first;
+  }
+  return *(it->second);
+};
+
+void Workspace::Release()
+{
+  auto &levels = workspace_cache.levels;
+  for ( size_t i = workspace_cache.depth; i < levels.size(); i ++ ) delete levels[ i ];
+  levels.resize( workspace_cache.depth );
+};
+
+size_t Workspace::GetCachedBytes()
+{
+  size_t bytes = 0;
+  for ( auto level : workspace_cache.levels ) bytes += level->GetBytes();
+  return bytes;
+};
+
+
+
+
 /**
  *  @brief Device implementation
  */
@@ -615,6 +727,9 @@ bool Worker::Execute( Task *batch )
   {
     task->event.Terminate();
     task->GetEventRecord();
+    /** Calibrate the cost model of this task type with the measurement. */
+    costmodel::record( task->name, task->event.GetFlops(), 
+        task->event.GetMops(), task->event.GetDuration() );
     /** Move to the next task in the batch */
     task = task->next;
   }
@@ -33,6 +33,8 @@
 #include <cassert>
 #include <map>
 #include <set>
+#include <tuple>
+#include <vector>
 #include <omp.h>
 
 
@@ -112,6 +114,13 @@ class thread_communicator
 
 	  thread_communicator( int jc_nt, int pc_nt, int ic_nt, int jr_nt );
 
+    /** The tree of kids is owned by the root; communicators are not copyable. */
+    thread_communicator( const thread_communicator& ) = delete;
+
+    thread_communicator& operator=( const thread_communicator& ) = delete;
+
+    ~thread_communicator();
+
     void Create( int level, int num_threads, int *config );
 
     //void Initialize( int )
@@ -131,7 +140,7 @@ class thread_communicator
 
     friend ostream& operator<<( ostream& os, const thread_communicator& obj );
 
-    thread_communicator *kids;
+    thread_communicator *kids = NULL;
 
     string name;
 
@@ -159,6 +168,70 @@ class thread_communicator
 
 
 
+/**
+ *  @brief Per-thread cache of the packing buffers and thread communicators
+ *         used by the BLIS-like primitives (gsks, gsknn, gkmx, strassen and
+ *         conv2d). GOFMM calls these primitives per leaf from every worker,
+ *         so allocating (and page-faulting) the buffers and building the
+ *         communicator tree on each call dominate small problems.
+ *
+ *         A primitive constructs a Workspace on the calling thread before
+ *         its parallel region. The i-th Buffer() returns the i-th cached
+ *         buffer of the thread, grown lazily to the largest request seen.
+ *         Nested Workspaces on the same thread use a deeper level of the
+ *         cache, so buffers and communicators are never shared by calls
+ *         that are alive at the same time. Cached memory is freed when the
+ *         thread exits or by Release(). Only blocking-sized buffers belong
+ *         here; problem-sized ones (e.g. m-by-n accumulators) are allocated
+ *         per call with hmlp_malloc, so the cache does not keep the largest
+ *         problem alive.
+ */
+class Workspace
+{
+  public:
+
+    Workspace();
+
+    ~Workspace();
+
+    /** Same layout as hmlp_malloc<ALIGN_SIZE, T>( m, n, size ). */
+    template<int ALIGN_SIZE, typename T>
+    T *Buffer( int m, int n, int size )
+    {
+      return (T*)Buffer( ALIGN_SIZE, (size_t)m * n * size );
+    };
+
+    /** Same layout as hmlp_malloc<ALIGN_SIZE, T>( n ). */
+    template<int ALIGN_SIZE, typename T>
+    T *Buffer( int n )
+    {
+      return Buffer<ALIGN_SIZE, T>( n, 1, sizeof(T) );
+    };
+
+    /** @brief Return a cached communicator with this partitioning. */
+    thread_communicator &Communicator( int jc_nt, int pc_nt, int ic_nt, int jr_nt );
+
+    /** @brief Free all levels of the calling thread that are not in use. */
+    static void Release();
+
+    /** @brief Return the bytes cached by the calling thread. */
+    static size_t GetCachedBytes();
+
+  private:
+
+    void *Buffer( size_t align, size_t bytes );
+
+    /** The level of the cache owned by this Workspace. */
+    size_t depth = 0;
+
+    /** The number of buffers returned so far. */
+    size_t num_buffers = 0;
+
+}; /** end class Workspace */
+
+
+
+
 /**
  *
  *
@@ -195,6 +268,12 @@ class Worker
 
     int gid = 0;
 
+    /** The CPU this worker is pinned to (-1 if not pinned). */
+    int cpu = -1;
+
+    /** The socket (affinity domain) of this worker. */
+    int socket = 0;
+
     int child_gid = 0;
 
     int jc_id;
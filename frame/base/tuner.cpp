@@ -0,0 +1,301 @@
+/**
+ *  HMLP (High-Performance Machine Learning Primitives)
+ *
+ *  Copyright (C) 2014-2018, The University of Texas at Austin
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see the LICENSE file.
+ *
+ **/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <omp.h>
+
+#include <base/util.hpp>
+#include <base/tuner.hpp>
+
+using namespace std;
+
+
+namespace hmlp
+{
+namespace tuner
+{
+
+namespace
+{
+
+/** An entry of the tuning file. */
+struct entry_s
+{
+  tuning_s setting;
+  double gflops = 0.0;
+};
+
+/** An online search: candidates are handed out in order, one per call. */
+struct search_s
+{
+  vector<tuning_s> candidates;
+  vector<double> gflops;
+  size_t next = 0;
+  size_t done = 0;
+};
+
+/** All entries and searches are protected by one lock. */
+mutex tuner_lock;
+
+map<string, entry_s> entries;
+
+map<string, search_s> searches;
+
+bool is_loaded = false;
+
+const char* shape_names[] = { "square", "skinny", "large_k" };
+
+string getKey( const string &primitive, hmlpShape_t shape, int cores )
+{
+  return primitive + " " + shape_names[ shape ] + " " + to_string( cores );
+};
+
+/** Add the entries of a tuning file; return false if it cannot be read. */
+bool loadUnlocked( const char* filename )
+{
+  ifstream file( filename );
+  if ( !file ) return false;
+  string line;
+  while ( getline( file, line ) )
+  {
+    if ( line.empty() || line[ 0 ] == '#' ) continue;
+    istringstream record( line );
+    string primitive, shape;
+    int cores;
+    entry_s entry;
+    auto &s = entry.setting;
+    if ( !( record >> primitive >> shape >> cores
+          >> s.jc_nt >> s.ic_nt >> s.jr_nt >> s.mc >> s.nc >> s.kc >> entry.gflops ) )
+    {
+      fprintf( stderr, "[WARNING] skip the invalid line \"%s\" in %s\n", line.c_str(), filename );
+      continue;
+    }
+    for ( int i = 0; i < 3; i ++ )
+    {
+      if ( shape == shape_names[ i ] ) entries[ getKey( primitive, (hmlpShape_t)i, cores ) ] = entry;
+    }
+  }
+  return true;
+};
+
+/** Read HMLP_TUNING_FILE on the first lookup (the file may not exist yet). */
+void loadOnce()
+{
+  if ( is_loaded ) return;
+  is_loaded = true;
+  auto *filename = getenv( "HMLP_TUNING_FILE" );
+  if ( filename && *filename ) loadUnlocked( filename );
+};
+
+hmlpError_t saveUnlocked( const char* filename )
+{
+  ofstream file( filename );
+  if ( !file ) return HMLP_ERROR_INVALID_VALUE;
+  file << "# primitive shape cores jc_nt ic_nt jr_nt mc nc kc gflops\n";
+  for ( auto &it : entries )
+  {
+    auto &s = it.second.setting;
+    file << it.first << " " << s.jc_nt << " " << s.ic_nt << " " << s.jr_nt << " "
+         << s.mc << " " << s.nc << " " << s.kc << " " << it.second.gflops << "\n";
+  }
+  return file.good() ? HMLP_ERROR_SUCCESS : HMLP_ERROR_EXECUTION_FAILED;
+};
+
+/**
+ *  @brief All ( jc_nt, ic_nt, jr_nt ) that use one or all cores, times the
+ *         default blocking and the blocking with MC, NC or KC halved.
+ */
+vector<tuning_s> getCandidates( int cores, int MC, int NC, int KC, int MR, int NR )
+{
+  vector<tuning_s> candidates;
+  vector<tuning_s> blockings( 1 );
+  if ( MC > 0 && NC > 0 && KC > 0 )
+  {
+    blockings.resize( 4 );
+    blockings[ 1 ].mc = max( MR, ( MC / 2 ) / MR * MR );
+    blockings[ 2 ].nc = max( NR, ( NC / 2 ) / NR * NR );
+    blockings[ 3 ].kc = max( 1, KC / 2 );
+  }
+  for ( int t : { 1, cores } )
+  {
+    for ( int jr_nt = 1; jr_nt <= min( t, 4 ); jr_nt ++ )
+    {
+      if ( t % jr_nt ) continue;
+      for ( int ic_nt = 1; ic_nt <= t / jr_nt; ic_nt ++ )
+      {
+        if ( ( t / jr_nt ) % ic_nt ) continue;
+        for ( auto candidate : blockings )
+        {
+          candidate.jc_nt = t / ( jr_nt * ic_nt );
+          candidate.ic_nt = ic_nt;
+          candidate.jr_nt = jr_nt;
+          candidates.push_back( candidate );
+        }
+      }
+    }
+    if ( cores == 1 ) break;
+  }
+  return candidates;
+};
+
+}; /** end unnamed namespace */
+
+
+hmlpShape_t classify( int m, int n, int k )
+{
+  if ( k >= min( m, n ) ) return HMLP_SHAPE_LARGE_K;
+  if ( max( m, n ) >= 4 * min( m, n ) ) return HMLP_SHAPE_SKINNY;
+  return HMLP_SHAPE_SQUARE;
+};
+
+int getNumCores()
+{
+  return omp_in_parallel() ? 1 : omp_get_max_threads();
+};
+
+bool get( string primitive, hmlpShape_t shape, int cores, tuning_s &setting )
+{
+  lock_guard<mutex> guard( tuner_lock );
+  loadOnce();
+  auto it = entries.find( getKey( primitive, shape, cores ) );
+  if ( it == entries.end() ) return false;
+  setting = it->second.setting;
+  return true;
+};
+
+void set( string primitive, hmlpShape_t shape, int cores, tuning_s setting, double gflops )
+{
+  lock_guard<mutex> guard( tuner_lock );
+  loadOnce();
+  auto &entry = entries[ getKey( primitive, shape, cores ) ];
+  entry.setting = setting;
+  entry.gflops = gflops;
+};
+
+bool isTuned( string primitive, int m, int n, int k )
+{
+  tuning_s setting;
+  return get( primitive, classify( m, n, k ), getNumCores(), setting );
+};
+
+hmlpError_t load( const char* filename )
+{
+  if ( !filename ) return HMLP_ERROR_INVALID_VALUE;
+  lock_guard<mutex> guard( tuner_lock );
+  /* Read the environment file first, such that this file overwrites it. */
+  loadOnce();
+  return loadUnlocked( filename ) ? HMLP_ERROR_SUCCESS : HMLP_ERROR_INVALID_VALUE;
+};
+
+hmlpError_t save( const char* filename )
+{
+  if ( !filename ) return HMLP_ERROR_INVALID_VALUE;
+  lock_guard<mutex> guard( tuner_lock );
+  return saveUnlocked( filename );
+};
+
+void clear()
+{
+  lock_guard<mutex> guard( tuner_lock );
+  entries.clear();
+  searches.clear();
+  /* Do not read HMLP_TUNING_FILE again. */
+  is_loaded = true;
+};
+
+
+Session::Session( string primitive, int m, int n, int k, int MC, int NC, int KC, int MR, int NR )
+{
+  /* Environment variables are an explicit choice; do not tune. */
+  if ( getenv( "KS_JC_NT" ) || getenv( "KS_IC_NT" ) || getenv( "KS_JR_NT" ) )
+  {
+    setting.jc_nt = hmlp_read_nway_from_env( "KS_JC_NT" );
+    setting.ic_nt = hmlp_read_nway_from_env( "KS_IC_NT" );
+    setting.jr_nt = hmlp_read_nway_from_env( "KS_JR_NT" );
+    return;
+  }
+
+  int cores = getNumCores();
+  key = getKey( primitive, classify( m, n, k ), cores );
+
+  lock_guard<mutex> guard( tuner_lock );
+  loadOnce();
+  auto it = entries.find( key );
+  if ( it != entries.end() )
+  {
+    setting = it->second.setting;
+    return;
+  }
+
+  auto *autotune = getenv( "HMLP_AUTOTUNE" );
+  if ( !autotune || strcmp( autotune, "1" ) ) return;
+
+  auto &search = searches[ key ];
+  if ( search.candidates.empty() )
+  {
+    search.candidates = getCandidates( cores, MC, NC, KC, MR, NR );
+    search.gflops.resize( search.candidates.size(), 0.0 );
+  }
+  /* Wait for the candidates in flight (other threads) with the default. */
+  if ( search.next == search.candidates.size() ) return;
+  candidate = search.next ++;
+  setting = search.candidates[ candidate ];
+  flops = 2.0 * m * n * k;
+  beg = omp_get_wtime();
+};
+
+Session::~Session()
+{
+  if ( candidate < 0 ) return;
+  double gflops = flops / ( omp_get_wtime() - beg + 1E-12 ) / 1E+9;
+
+  lock_guard<mutex> guard( tuner_lock );
+  auto it = searches.find( key );
+  if ( it == searches.end() ) return;
+  auto &search = it->second;
+  search.gflops[ candidate ] = gflops;
+  if ( ++ search.done < search.candidates.size() ) return;
+
+  /* All candidates are timed. Keep the fastest and persist it. */
+  auto best = max_element( search.gflops.begin(), search.gflops.end() ) - search.gflops.begin();
+  auto &entry = entries[ key ];
+  entry.setting = search.candidates[ best ];
+  entry.gflops = search.gflops[ best ];
+  searches.erase( it );
+  auto *filename = getenv( "HMLP_TUNING_FILE" );
+  if ( filename && *filename )
+  {
+    if ( saveUnlocked( filename ) != HMLP_ERROR_SUCCESS )
+    {
+      fprintf( stderr, "[WARNING] fail to write the tuning file %s\n", filename );
+    }
+  }
+};
+
+}; /* end namespace tuner */
+}; /* end namespace hmlp */
@@ -0,0 +1,127 @@
+/**
+ *  HMLP (High-Performance Machine Learning Primitives)
+ *
+ *  Copyright (C) 2014-2018, The University of Texas at Austin
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see the LICENSE file.
+ *
+ **/
+
+
+#ifndef HMLP_TUNER_HPP
+#define HMLP_TUNER_HPP
+
+#include <string>
+#include <vector>
+/** Use hmlpError_t. */
+#include <hmlp.h>
+
+namespace hmlp
+{
+
+/** @brief Shape classes of a ( m x k ) * ( k x n ) primitive call. */
+typedef enum
+{
+  HMLP_SHAPE_SQUARE,
+  HMLP_SHAPE_SKINNY,  /* max( m, n ) >= 4 * min( m, n ) */
+  HMLP_SHAPE_LARGE_K  /* k >= min( m, n ) */
+} hmlpShape_t;
+
+namespace tuner
+{
+
+/**
+ *  @brief Loop partitioning and cache blocking of the BLIS-like primitives.
+ *         Zero blocking means the compile-time default of the package.
+ */
+struct tuning_s
+{
+  int jc_nt = 1;
+  int ic_nt = 1;
+  int jr_nt = 1;
+  int mc = 0;
+  int nc = 0;
+  int kc = 0;
+};
+
+/** @brief Return the shape class of the problem. */
+hmlpShape_t classify( int m, int n, int k );
+
+/** @brief The number of threads a primitive can use from this context. */
+int getNumCores();
+
+/** @brief Look up the tuning file entry; return false if there is none. */
+bool get( std::string primitive, hmlpShape_t shape, int cores, tuning_s &setting );
+
+/** @brief Insert (or overwrite) an entry with its measured GFLOPS. */
+void set( std::string primitive, hmlpShape_t shape, int cores, tuning_s setting, double gflops );
+
+/** @brief Return true if the entry exists (tuned or read from the file). */
+bool isTuned( std::string primitive, int m, int n, int k );
+
+/**
+ *  @brief Read entries from a tuning file. Each line has the format
+ *         "primitive shape cores jc_nt ic_nt jr_nt mc nc kc gflops",
+ *         and lines that start with # are comments.
+ */
+hmlpError_t load( const char* filename );
+
+/** @brief Write all entries to a tuning file. */
+hmlpError_t save( const char* filename );
+
+/** @brief Discard all entries and the ongoing searches. */
+void clear();
+
+/**
+ *  @brief Decide the setting of one primitive call. The precedence is
+ *
+ *         1. KS_JC_NT, KS_IC_NT and KS_JR_NT if any of them is set,
+ *         2. the entry of ( primitive, shape, cores ) in the tuning file
+ *            ( HMLP_TUNING_FILE ),
+ *         3. with HMLP_AUTOTUNE=1, an online search: each call of an untuned
+ *            entry runs the next candidate and times it; the fastest one is
+ *            kept and written back to HMLP_TUNING_FILE,
+ *         4. a single thread with the package blocking.
+ *
+ *         Blocking candidates are only searched if the primitive passes
+ *         its compile-time MC, NC and KC (which bound the runtime blocking).
+ */
+class Session
+{
+  public:
+
+    Session( std::string primitive, int m, int n, int k,
+        int MC = 0, int NC = 0, int KC = 0, int MR = 1, int NR = 1 );
+
+    /** Record the elapsed time if this call is a search candidate. */
+    ~Session();
+
+    tuning_s setting;
+
+  private:
+
+    std::string key;
+
+    double flops = 0.0;
+
+    double beg = 0.0;
+
+    int candidate = -1;
+
+}; /** end class Session */
+
+}; /* end namespace tuner */
+}; /* end namespace hmlp */
+
+#endif /* define HMLP_TUNER_HPP */
@@ -3,8 +3,14 @@
 
 
 #include <unordered_map>
-
-#include <hmlp_runtime.hpp>
+#include <map>
+#include <set>
+#include <atomic>
+#include <limits>
+#include <omp.h>
+
+#include <base/runtime.hpp>
+#include <base/blas_lapack.hpp>
 #include <Data.hpp>
 
 using namespace std;
@@ -252,8 +258,409 @@ class Cache2D
 }; /** end class Cache2D */
 
 
+/** @brief Storage formats of a CachedBlock. */
+typedef enum
+{
+  CACHE_RECOMPUTE, /** Not stored. The block is recomputed on every use. */
+  CACHE_DENSE,     /** Stored as is. */
+  CACHE_DOWNCAST,  /** Stored in single precision. */
+  CACHE_LOWRANK    /** Stored as U * V from a truncated pivoted QR. */
+} CacheFormat_t;
+
+
+template<typename T> class CacheManager;
+
+
+/**
+ *  @brief A (possibly compressed) cached matrix block, e.g. NearKab and
+ *         FarKab in GOFMM. The inherited Data<T> is the dense storage, so
+ *         a dense block can still be used as Data<T>. Use Multiply() to
+ *         apply the block regardless of its format.
+ */ 
+template<typename T>
+class CachedBlock : public Data<T>
+{
+  public:
+
+    CachedBlock() {};
+
+    /** Detach from the CacheManager (if admitted). */
+    ~CachedBlock();
+
+    /** Store A as a dense block, which is no longer admitted. */
+    CachedBlock<T> & operator = ( const Data<T> &A )
+    {
+      if ( membership.manager ) membership.manager->Release( *this );
+      Clear();
+      Data<T>::operator = ( A );
+      m_ = A.row();
+      n_ = A.col();
+      if ( A.size() ) format = CACHE_DENSE;
+      return (*this);
+    };
+
+    CacheFormat_t Format() const { return format; };
+
+    bool IsCached() const { return format != CACHE_RECOMPUTE; };
+
+    /** Return true if a block of size m-by-n is cached. */
+    bool IsCached( size_t m, size_t n ) const
+    {
+      return IsCached() && m_ == m && n_ == n;
+    };
+
+    size_t Rank() const { return U.col(); };
+
+    /** Memory footprint in bytes. */
+    size_t Bytes() const
+    {
+      return sizeof(T) * ( Data<T>::size() + U.size() + V.size() ) + 
+        sizeof(float) * lowp.size();
+    };
+
+    /** Drop the block (it will be recomputed). */
+    void Clear()
+    {
+      ReleaseDense();
+      lowp.clear(); lowp.shrink_to_fit();
+      U.clear(); U.shrink_to_fit();
+      V.clear(); V.shrink_to_fit();
+      format = CACHE_RECOMPUTE;
+    };
+
+    /**
+     *  @brief Compress a dense block to the target format, if the new
+     *         footprint is smaller and at most max_bytes. Otherwise the 
+     *         block is not changed.
+     *  @param stol the relative tolerance of CACHE_LOWRANK
+     *  @return whether the block has been compressed
+     */ 
+    bool Compress( CacheFormat_t target, T stol, size_t max_bytes )
+    {
+      if ( format != CACHE_DENSE ) return false;
+
+      size_t m = m_, n = n_;
+
+      switch ( target )
+      {
+        case CACHE_DOWNCAST:
+        {
+          /** Downcast only pays off if T is wider than float. */
+          if ( sizeof(T) <= sizeof(float) ) return false;
+          if ( m * n * sizeof(float) > max_bytes ) return false;
+          lowp.resize( m, n );
+          for ( size_t i = 0; i < m * n; i ++ ) lowp[ i ] = (*this)[ i ];
+          break;
+        }
+        case CACHE_LOWRANK:
+        {
+          int mm = m, nn = n, mn = std::min( m, n );
+          if ( !mn ) return false;
+          Data<T> A = (*this);
+          vector<int> jpvt( n, 0 );
+          vector<T> tau( mn );
+          vector<T> work( 2 * nn + ( nn + 1 ) * 64 );
+          xgeqp3( mm, nn, A.data(), mm, jpvt.data(), tau.data(), work.data(), work.size() );
+          /** Numerical rank relative to the largest diagonal of R. */
+          size_t r = 0;
+          T rmax = std::abs( A[ 0 ] );
+          while ( r < mn && std::abs( A[ r * m + r ] ) > stol * rmax ) r ++;
+          /** Only keep U * V if it is at least twice smaller. */
+          if ( 2 * r * ( m + n ) >= m * n ) return false;
+          if ( r * ( m + n ) * sizeof(T) > max_bytes ) return false;
+          /** V( :, jpvt ) = R( 0:r-1, : ). */
+          V.resize( r, n, 0 );
+          for ( size_t j = 0; j < n; j ++ )
+            for ( size_t i = 0; i < std::min( r, j + 1 ); i ++ )
+              V( i, jpvt[ j ] - 1 ) = A( i, j );
+          /** U = Q( :, 0:r-1 ). */
+          if ( r ) xorgqr( mm, r, r, A.data(), mm, tau.data(), work.data(), work.size() );
+          U.resize( m, r );
+          for ( size_t j = 0; j < r; j ++ )
+            for ( size_t i = 0; i < m; i ++ ) U( i, j ) = A( i, j );
+          break;
+        }
+        case CACHE_RECOMPUTE:
+        {
+          Clear();
+          return true;
+        }
+        default: return false;
+      }
+      /** Release the dense storage. */
+      ReleaseDense();
+      format = target;
+      return true;
+    };
+
+    /** 
+     *  @brief C += A( :, offset:offset+k-1 ) * B, where A is this block, 
+     *         B is k-by-nrhs, and C is m-by-nrhs.
+     */
+    void Multiply( size_t offset, size_t k, size_t nrhs, 
+        const T *B, size_t ldb, T *C, size_t ldc )
+    {
+      size_t m = m_;
+      assert( IsCached() && offset + k <= n_ );
+      if ( !k || !nrhs || !m ) return;
+      switch ( format )
+      {
+        case CACHE_DENSE:
+        {
+          xgemm( "N", "N", m, nrhs, k, 
+              1.0, Data<T>::data() + offset * m, m, 
+              (T*)B, ldb, 1.0, C, ldc );
+          break;
+        }
+        case CACHE_DOWNCAST:
+        {
+          Data<T> A( m, k );
+          for ( size_t i = 0; i < m * k; i ++ ) A[ i ] = lowp[ offset * m + i ];
+          xgemm( "N", "N", m, nrhs, k, 
+              1.0, A.data(), m, (T*)B, ldb, 1.0, C, ldc );
+          break;
+        }
+        case CACHE_LOWRANK:
+        {
+          size_t r = Rank();
+          if ( !r ) return;
+          Data<T> VB( r, nrhs, 0 );
+          xgemm( "N", "N", r, nrhs, k, 
+              1.0, V.data() + offset * r, r, (T*)B, ldb, 0.0, VB.data(), r );
+          xgemm( "N", "N", m, nrhs, r, 
+              1.0, U.data(), m, VB.data(), r, 1.0, C, ldc );
+          break;
+        }
+        default: assert( 0 );
+      }
+    };
+
+  private:
+
+    friend class CacheManager<T>;
+
+    /** 
+     *  Where the block is accounted in its CacheManager. Copies of a block
+     *  are not admitted, so this is never copied.
+     */
+    struct Membership
+    {
+      Membership() {};
+      Membership( const Membership &other ) {};
+      Membership & operator = ( const Membership &other ) { return *this; };
+      void Reset() { manager = nullptr; bytes = 0; is_dense = false; };
+      CacheManager<T> *manager = nullptr;
+      /** Bytes counted in CacheManager::used. */
+      size_t bytes = 0;
+      bool is_dense = false;
+      typename multimap<double, CachedBlock<T>*>::iterator dense_it;
+    } membership;
+
+    void ReleaseDense()
+    {
+      Data<T>::resize( 0, 0 );
+      Data<T>::shrink_to_fit();
+    };
+
+    CacheFormat_t format = CACHE_RECOMPUTE;
+
+    /** Logical size of the block. */
+    size_t m_ = 0;
+    size_t n_ = 0;
+
+    /** CACHE_DOWNCAST storage. */
+    Data<float> lowp;
+
+    /** CACHE_LOWRANK storage. */
+    Data<T> U;
+    Data<T> V;
+
+}; /** end class CachedBlock */
 
 
+/**
+ *  @brief CacheManager decides whether a CachedBlock is stored, compressed,
+ *         or recomputed under a memory budget. Each block is admitted with
+ *         its measured evaluation time, and blocks with the highest saved
+ *         time per byte are kept dense. When the budget is exhausted, dense
+ *         blocks with lower value are compressed (or dropped) to make room.
+ *         Hits and misses at the use sites are also recorded here.
+ */ 
+template<typename T>
+class CacheManager
+{
+  public:
+
+    CacheManager( size_t budget = numeric_limits<size_t>::max(), 
+        bool use_downcast = true, bool use_lowrank = true, T stol = 1E-3 )
+    {
+      this->budget = budget;
+      this->use_downcast = use_downcast;
+      this->use_lowrank = use_lowrank;
+      this->stol = stol;
+    };
+
+    /** Blocks that are still admitted outlive the manager; detach them. */
+    ~CacheManager()
+    {
+      for ( auto *block : members ) block->membership.Reset();
+    };
+
+    /** 
+     *  @brief Admit a dense block that has just been evaluated. Admitting
+     *         a block again replaces its previous accounting.
+     *  @param cost the time (in seconds) it took to evaluate the block
+     */ 
+    void Admit( CachedBlock<T> &block, double cost )
+    {
+      lock.Acquire();
+      {
+        Forget( block );
+        if ( block.IsCached() )
+        {
+          size_t bytes = block.Bytes();
+          double value = cost / std::max( bytes, (size_t)1 );
+
+          /** Compress dense blocks with lower value to make room. */
+          while ( used + bytes > budget && dense.size() && dense.begin()->first < value )
+          {
+            auto *victim = dense.begin()->second;
+            Forget( *victim );
+            Downgrade( *victim );
+            n_evicted ++;
+          }
+
+          if ( used + bytes <= budget )
+          {
+            auto &membership = block.membership;
+            membership.manager = this;
+            membership.bytes = bytes;
+            membership.is_dense = true;
+            membership.dense_it = dense.insert( make_pair( value, &block ) );
+            members.insert( &block );
+            used += bytes;
+            n_dense ++;
+          }
+          else Downgrade( block );
+        }
+      }
+      lock.Release();
+    };
+
+    /** Forget a block (e.g. before it is cached again) and clear it. */
+    void Release( CachedBlock<T> &block )
+    {
+      lock.Acquire();
+      {
+        Forget( block );
+        block.Clear();
+      }
+      lock.Release();
+    };
+
+    /** Record that a cached block has been used. */
+    void Hit() { n_hit ++; };
+
+    /** Record that a block has been recomputed, which took cost seconds. */
+    void Miss( double cost )
+    {
+      n_miss ++;
+      lock.Acquire();
+      miss_time += cost;
+      lock.Release();
+    };
+
+    size_t Used() const { return used; };
+
+    void Report( const char *name ) const
+    {
+      printf( "%s cache: %.2lf/%.2lf GB [ %lu dense %lu downcast %lu lowrank %lu recompute ] %lu evicted\n",
+          name, (double)used / 1E+9, 
+          ( budget == numeric_limits<size_t>::max() ) ? -1.0 : (double)budget / 1E+9,
+          n_dense, n_downcast, n_lowrank, n_recompute, n_evicted );
+      printf( "%s cache: %lu hits %lu misses (%5.2lfs recomputing)\n",
+          name, (size_t)n_hit, (size_t)n_miss, miss_time );
+    };
+
+  private:
+
+    /** Remove the accounting of block (with the lock held). */
+    void Forget( CachedBlock<T> &block )
+    {
+      auto &membership = block.membership;
+      if ( membership.manager != this ) return;
+      if ( membership.is_dense )
+      {
+        dense.erase( membership.dense_it );
+        n_dense --;
+      }
+      used -= std::min( used, membership.bytes );
+      members.erase( &block );
+      membership.Reset();
+    };
+
+    /** Compress a dense block (or drop it) within the remaining budget. */
+    void Downgrade( CachedBlock<T> &block )
+    {
+      size_t left = ( used < budget ) ? budget - used : 0;
+      if ( use_lowrank && block.Compress( CACHE_LOWRANK, stol, left ) )
+      {
+        n_lowrank ++;
+      }
+      else if ( use_downcast && block.Compress( CACHE_DOWNCAST, stol, left ) )
+      {
+        n_downcast ++;
+      }
+      else
+      {
+        block.Clear();
+        n_recompute ++;
+      }
+      /** Compressed blocks stay admitted (not dense), so they can be detached. */
+      auto &membership = block.membership;
+      membership.manager = this;
+      membership.bytes = block.Bytes();
+      membership.is_dense = false;
+      members.insert( &block );
+      used += membership.bytes;
+    };
+
+    Lock lock;
+
+    size_t budget = numeric_limits<size_t>::max();
+
+    size_t used = 0;
+
+    bool use_downcast = true;
+
+    bool use_lowrank = true;
+
+    T stol = 1E-3;
+
+    /** Dense blocks ordered by saved seconds per byte. */
+    multimap<double, CachedBlock<T>*> dense;
+
+    /** All admitted blocks (dense or not). */
+    set<CachedBlock<T>*> members;
+
+    /** Statistics. */
+    size_t n_dense = 0;
+    size_t n_downcast = 0;
+    size_t n_lowrank = 0;
+    size_t n_recompute = 0;
+    size_t n_evicted = 0;
+    std::atomic<size_t> n_hit{ 0 };
+    std::atomic<size_t> n_miss{ 0 };
+    double miss_time = 0.0;
+
+}; /** end class CacheManager */
+
+
+template<typename T>
+CachedBlock<T>::~CachedBlock()
+{
+  if ( membership.manager ) membership.manager->Release( *this );
+};
 
 
 }; /** end namespace hmlp */
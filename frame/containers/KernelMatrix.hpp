@@ -270,6 +270,30 @@ class KernelMatrix : public VirtualMatrix<T, Allocator>,
     }; /** end GeometryDistances() */
 
 
+    /** Return K( X, J ) for out-of-sample points X (d-by-q), which are not in sources. */
+    Data<T> OutOfSample( const Data<T> &X, const vector<size_t>& J )
+    {
+      Data<T> KXJ( X.col(), J.size() );
+			/** Early return if possible. */
+			if ( !X.col() || !J.size() ) return KXJ;
+      Data<T> Y = sources( all_dimensions, J );
+      kernel( nullptr, X.data(), Y.data(), d, KXJ.data(), X.col(), J.size() );
+      return KXJ;
+    }; /** end OutOfSample() */
+
+
+    /** Return squared distances between out-of-sample points X (d-by-q) and sources J. */
+    Data<T> OutOfSampleDistances( const Data<T> &X, const vector<size_t>& J )
+    {
+      Data<T> DXJ( X.col(), J.size() );
+			/** Early return if possible. */
+			if ( !X.col() || !J.size() ) return DXJ;
+      Data<T> Y = sources( all_dimensions, J );
+      kernel_s<T, T>::squaredDistances( X.data(), Y.data(), d, DXJ.data(), X.col(), J.size() );
+      return DXJ;
+    }; /** end OutOfSampleDistances() */
+
+
     /** get the diagonal of KII, i.e. diag( K( I, I ) ) */
     Data<T> Diagonal( vector<size_t> &I )
     {
@@ -165,7 +165,7 @@ class OOCCovMatrix : public VirtualMatrix<T>
         int ib = min( nb, n - i );
         Samples.resize( Samples.size() + 1 );
         printf( "ib %d d %lu\n", ib, d );
-        Samples.back().Set( ib, d, filename + to_string( i ) );
+        HANDLE_ERROR( Samples.back().Set( ib, d, filename + to_string( i ) ) );
         //X.Set( ib, d, filename + to_string( i ) );
       }
 
@@ -25,27 +25,28 @@ class SPDMatrix : public VirtualMatrix<T>
     SPDMatrix() : VirtualMatrix<T>() {};
 
     SPDMatrix( size_t m, size_t n ) 
-      : VirtualMatrix<T>( m, n ) { K.resize( m, n ); };
+      : VirtualMatrix<T>( m, n ) { K.resize( m, n, 0 ); };
 
+    /** The storage is not zero-filled, since it is overwritten by read(). */
     SPDMatrix( size_t m, size_t n, string filename )
       : VirtualMatrix<T>( m, n )
     {
       K.resize( m, n );
-      K.read( m, n, filename );
+      HANDLE_ERROR( K.read( m, n, filename ) );
     };
 
     void resize( size_t m, size_t n )
     {
       VirtualMatrix<T>::resize( m, n );
-      K.resize( m, n );
+      K.resize( m, n, 0 );
     };
 
     template<bool USE_LOWRANK=true>
     void randspd( T a, T b ) { K.randspd( a, b ); };
 
-    void read( size_t m, size_t n, string &filename ) 
+    hmlpError_t read( size_t m, size_t n, const string &filename ) 
     { 
-      K.read( m, n, filename ); 
+      return K.read( m, n, filename ); 
     };
 
     T operator()( size_t i, size_t j ) { return K( i, j ); };
@@ -62,7 +63,7 @@ class SPDMatrix : public VirtualMatrix<T>
 
   private:
 
-    Data<T> K;
+    Data<T, default_init_allocator<T>> K;
 
 }; /** end class SPDMatrix */
 
@@ -77,7 +78,7 @@ class OOCSPDMatrix : public VirtualMatrix<T>
     OOCSPDMatrix( size_t m, size_t n, string filename )
       : VirtualMatrix<T>( m, n )
     {
-      K.Set( m, n, filename );
+      HANDLE_ERROR( K.Set( m, n, filename ) );
     };
 
     T operator()( size_t i, size_t j ) { return K( i, j ); };
@@ -94,6 +95,62 @@ class OOCSPDMatrix : public VirtualMatrix<T>
 
 }; /** end class OOCSPDMatrix */
 
+
+/**
+ *  @brief Sparse SPD matrices in CSC format. Submatrices K( I, J ) are
+ *         extracted by merging the sorted I against each column, and 
+ *         (leaf) diagonal blocks can be cached with EnableDiagonalCache().
+ */ 
+template<typename T>
+class SparseSPDMatrix : public VirtualMatrix<T>
+{
+  public:
+
+    SparseSPDMatrix( size_t m = 0, size_t n = 0, size_t nnz = 0, bool issymmetric = true )
+      : VirtualMatrix<T>( m, n ), K( m, n, nnz, issymmetric ) {};
+
+    void fromCSC( size_t m, size_t n, size_t nnz, bool issymmetric,
+        const T *val, const size_t *row_ind, const size_t *col_ptr )
+    {
+      VirtualMatrix<T>::resize( m, n );
+      K.fromCSC( m, n, nnz, issymmetric, val, row_ind, col_ptr );
+    };
+
+    /** Memory-map a binary CSC file (see SparseData::readCSC()). */
+    hmlpError_t readCSC( const string &filename, bool issymmetric = true )
+    {
+      RETURN_IF_ERROR( K.readCSC( filename, issymmetric ) );
+      VirtualMatrix<T>::resize( K.row(), K.col() );
+      return HMLP_ERROR_SUCCESS;
+    };
+
+    /** Memory-map a binary CSR file and convert it to CSC. */
+    hmlpError_t readCSR( const string &filename, bool issymmetric = true )
+    {
+      RETURN_IF_ERROR( K.readCSR( filename, issymmetric ) );
+      VirtualMatrix<T>::resize( K.row(), K.col() );
+      return HMLP_ERROR_SUCCESS;
+    };
+
+    void EnableDiagonalCache( size_t capacity ) { K.EnableDiagonalCache( capacity ); };
+
+    T operator()( size_t i, size_t j ) { return K( i, j ); };
+
+    Data<T> operator() ( const vector<size_t> &I, 
+                         const vector<size_t> &J )
+    {
+      return K( I, J );
+    };
+
+    /** Return the underlying CSC storage (e.g. for SparsePattern()). */
+    SparseData<T>& CSC() { return K; };
+
+  private:
+
+    SparseData<T> K;
+
+}; /** end class SparseSPDMatrix */
+
 }; /** end namespace hmlp */
 
 
@@ -239,6 +239,76 @@ class VirtualMatrix : public SPDMatrixMPISupport<DATATYPE>
       return HMLP_ERROR_SUCCESS;
     };
 
+    /**
+     *  @brief Fused kappa-nearest neighbor kernel. Distances between R and
+     *         a block of queries are computed, and then selected and merged
+     *         into the existing neighbor lists in the same pass, without
+     *         sorting all candidates of each query.
+     *  @param [inout] lists lists[ j ] points to the kappa neighbors of Q[ j ]
+     *  @param [out] n_updated the number of lists that have changed
+     */ 
+    hmlpError_t NeighborSearchMerge( 
+        DistanceMetric metric, size_t kappa, 
+        const vector<size_t> &Q,
+        const vector<size_t> &R,
+        vector<neigType*> &lists, 
+        size_t &n_updated )
+    {
+      n_updated = 0;
+      if ( R.size() < kappa )
+      {
+        printf( "\n[ERROR] the reference size %lu must be larger than kappa %lu.\n\n",
+            R.size(), kappa );
+        return HMLP_ERROR_INVALID_VALUE;
+      }
+      if ( lists.size() != Q.size() ) return HMLP_ERROR_INVALID_VALUE;
+
+      /** Queries are processed in blocks to keep distances in cache. */
+      const size_t block_size = 64;
+      vector<size_t> Qb;
+
+      for ( size_t jb = 0; jb < Q.size(); jb += block_size )
+      {
+        size_t jend = std::min( Q.size(), jb + block_size );
+        Qb.assign( Q.begin() + jb, Q.begin() + jend );
+        /** Compute pairwise distances of this block. */
+        auto DRQ = Distances( metric, R, Qb );
+
+        for ( size_t j = 0; j < Qb.size(); j ++ )
+        {
+          neigType *list = lists[ jb + j ];
+          /** The current list is kept as a max-heap during the scan. */
+          make_heap( list, list + kappa );
+          bool is_updated = false;
+          for ( size_t i = 0; i < R.size(); i ++ )
+          {
+            T dij = DRQ( i, j );
+            /** Sanity check: distance must be >= 0. */
+            if ( std::isnan( dij ) ) printf( "[ERROR] is nan\n" );
+            if ( std::isinf( dij ) ) printf( "[ERROR] is inf\n" );
+            dij = std::max( dij, T(0) );
+            /** Only candidates closer than the farthest neighbor matter. */
+            if ( !( dij < list[ 0 ].first ) ) continue;
+            /** Skip duplication. */
+            size_t gid = R[ i ];
+            bool is_duplicated = false;
+            for ( size_t p = 0; p < kappa; p ++ ) 
+              if ( list[ p ].second == gid ) is_duplicated = true;
+            if ( is_duplicated ) continue;
+            /** Replace the farthest neighbor. */
+            pop_heap( list, list + kappa );
+            list[ kappa - 1 ] = neigType( dij, gid );
+            push_heap( list, list + kappa );
+            is_updated = true;
+          }
+          /** Return the list in ascending order. */
+          sort_heap( list, list + kappa );
+          if ( is_updated ) n_updated ++;
+        }
+      }
+      return HMLP_ERROR_SUCCESS;
+    }; /** end NeighborSearchMerge() */
+
 		virtual Data<T> Diagonal( const vector<size_t> &I )
 		{
 			Data<T> DII( I.size(), 1, 0.0 );
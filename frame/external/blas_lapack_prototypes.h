@@ -281,4 +281,14 @@ void slarfb_(
 void dlarfg_( int *n, double *alpha, double *x, int *incx, double *tau );
 void slarfg_( int *n, float  *alpha, float  *x, int *incx, float  *tau );
 
+/** Threading control of the BLAS library. */
+#if defined(USE_INTEL) && defined(USE_BLAS)
+int  MKL_Set_Num_Threads_Local( int nt );
+void MKL_Set_Num_Threads( int nt );
+int  MKL_Get_Max_Threads( void );
+#elif defined(HMLP_USE_OPENBLAS)
+void openblas_set_num_threads( int nt );
+int  openblas_get_num_threads( void );
+#endif
+
 #endif /** define BLAS_LAPACK_PROTOTYPES_H */
@@ -91,6 +91,10 @@ typedef struct MPI_Status {
 /* MPI request opjects */
 typedef int MPI_Request;
 
+/* MPI matched message objects */
+typedef int MPI_Message;
+#define MPI_MESSAGE_NULL ((MPI_Message)0x2c000000)
+
 /* For supported thread levels */
 #define MPI_THREAD_SINGLE 0
 #define MPI_THREAD_FUNNELED 1
@@ -144,6 +144,7 @@ void sgeqp4( int * m, int * n, float * A, int * lda, int * jpvt, float * tau,
           m_A, n_A, mn_A, ldim_A, lquery, nb, num_factorized_fixed_cols, 
           minus_info, iws, lwkopt, j, k, num_fixed_cols, n_rest, itmp;
   int     * previous_jpvt;
+  /* ilaenv_ is Fortran: the lengths of NAME and OPTS are passed last. */
   int     ilaenv_();
 
   // Some initializations.
@@ -170,7 +171,7 @@ void sgeqp4( int * m, int * n, float * A, int * lda, int * jpvt, float * tau,
     } else {
       iws    = 3 * n_A + 1;
       nb     = ilaenv_( & INB, "SGEQRF", " ", & m_A, & n_A, & i_minus_one, 
-                        & i_minus_one );
+                        & i_minus_one, (size_t)6, (size_t)1 );
       lwkopt = 2 * n_A + ( n_A + 1 ) * nb;
     }
     work[ 0 ] = ( float ) lwkopt;
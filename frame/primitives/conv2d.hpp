@@ -28,6 +28,9 @@
 #include <hmlp_internal.hpp>
 #include <hmlp_base.hpp>
 
+/** for USE_STRASSEN */
+#include <primitives/strassen.hpp>
+
 // #define DEBUG_CONV2D 1
 
 namespace hmlp
@@ -244,6 +247,7 @@ void conv2d_internal
   int w1, int h1, int d1,
   TA *A,
   TC *C,
+  int k_stra,
   SEMIRINGKERNEL semiringkernel,
   MICROKERNEL microkernel,
   int nc, int pack_nc,
@@ -265,7 +269,7 @@ void conv2d_internal
 
   //auto loop6th = GetRange( HMLP_SCHEDULE_HEFT, 0, n, nc, thread.jc_id, thread.jc_nt );
   auto loop6th = GetRange( 0, n, nc, thread.jc_id, thread.jc_nt );
-  auto loop5th = GetRange( 0, k, KC );
+  auto loop5th = GetRange( k_stra, k, KC );
   auto loop4th = GetRange( 0, m, MC, thread.ic_id, thread.ic_nt );
 
   //printf( "tid %d beg %d end %d inc %d\n", thread.jc_id, loop6th.beg(), loop6th.end(), loop6th.inc() );
@@ -462,6 +466,7 @@ void conv2d
 {
   int jc_nt = 1, pc_nt = 1, ic_nt = 1, jr_nt = 1;
   int nc = NC, pack_nc = PACK_NC;
+  int k_stra = 0;
   char *str;
 
   int m = d1;
@@ -475,15 +480,17 @@ void conv2d
 
   TA *packA_buff = NULL;
   TB *packB_buff = NULL;
+  TB *Bcol_buff = NULL;
 
   // Early return if possible
 
-  // Check the environment variable.
+  // Loop partitioning (KS_*_NT, tuning file or autotuning)
+  tuner::Session session( sizeof(TC) == 4 ? "sconv2d" : "dconv2d", m, n, k );
   if ( omp_get_num_threads() == 1 && omp_get_max_threads() > 1 )
   {
-    jc_nt = hmlp_read_nway_from_env( "KS_JC_NT" );
-    ic_nt = hmlp_read_nway_from_env( "KS_IC_NT" );
-    jr_nt = hmlp_read_nway_from_env( "KS_JR_NT" );
+    jc_nt = session.setting.jc_nt;
+    ic_nt = session.setting.ic_nt;
+    jr_nt = session.setting.jr_nt;
   }
 
 
@@ -494,26 +501,60 @@ void conv2d
     pack_nc = ( nc / NR ) * PACK_NR;
   }
 
+  // packing buffers and communicator are cached by the calling thread
+  Workspace workspace;
+
   // allocate packing memory
-  packA_buff  = hmlp_malloc<ALIGN_SIZE, TA>( KC, ( PACK_MC + 1 ) * jc_nt * ic_nt,         sizeof(TA) );
-  packB_buff  = hmlp_malloc<ALIGN_SIZE, TB>( KC, ( pack_nc + 1 ) * jc_nt,                 sizeof(TB) ); 
+  packA_buff  = workspace.Buffer<ALIGN_SIZE, TA>( KC, ( PACK_MC + 1 ) * jc_nt * ic_nt,         sizeof(TA) );
+  packB_buff  = workspace.Buffer<ALIGN_SIZE, TB>( KC, ( pack_nc + 1 ) * jc_nt,                 sizeof(TB) ); 
 
   //#pragma omp parallel for
   //for ( int i = 0; i < KC * ( PACK_MC + 1 ) * jc_nt * ic_nt; i ++ ) packA_buff[ i ] = 1.0;
 
 
-  // allocate tree communicator
-  thread_communicator my_comm( jc_nt, pc_nt, ic_nt, jr_nt );
+  // C = A' * im2col( B ) of the leading k_stra by the one-level Strassen
+  if ( USE_STRASSEN )
+  {
+    k_stra = strassen::GetStrassenK<MC, KC>( m, n, k );
+    if ( k_stra )
+    {
+      // Strassen packs the sums of two blocks, so the implicit im2col
+      // view is materialized (k-by-n, the same layout as conv2d_ref). It is
+      // problem sized, so it is not kept in the workspace.
+      Bcol_buff = hmlp_malloc<ALIGN_SIZE, TB>( k, n, sizeof(TB) );
+      im2col( n, k, Bcol_buff, B, w0, h0, d0, s, p, w1, h1 );
+      std::fill( C, C + (size_t)m * n, (TC)0 );
+    }
+  }
+
+  // reuse the tree communicator
+  thread_communicator &my_comm = workspace.Communicator( jc_nt, pc_nt, ic_nt, jr_nt );
 
 
   #pragma omp parallel num_threads( my_comm.GetNumThreads() ) 
   {
     Worker thread( &my_comm );
 
-    if ( USE_STRASSEN )
+    if ( k_stra )
     {
-      printf( "cnn: strassen algorithms haven't been implemented." );
-      exit( 1 );
+      strassen::strassen_internal
+      <MC, NC, KC, MR, NR,
+      PACK_MC, PACK_NC, PACK_MR, PACK_NR, ALIGN_SIZE,
+      USE_STRASSEN,
+      SEMIRINGKERNEL, SEMIRINGKERNEL,
+      TA, TB, TC, TC>
+      (
+        thread,
+        HMLP_OP_T, HMLP_OP_N,
+        m, n, k_stra,
+        A, k,
+        Bcol_buff, k,
+        C, m,
+        semiringkernel, semiringkernel,
+        nc, pack_nc,
+        packA_buff,
+        packB_buff
+      );
     }
 
     conv2d_internal
@@ -529,6 +570,7 @@ void conv2d
       w1, h1, d1,
       A,
       C,
+      k_stra,
       semiringkernel, microkernel,
       nc, pack_nc,
       packA_buff,
@@ -536,6 +578,8 @@ void conv2d
     );
   }                                                        // end omp 
 
+  hmlp_free( Bcol_buff );
+
 #ifdef DEBUG_CONV2D
   for ( int j = 0; j < ny; j ++ )
   {
@@ -465,12 +465,13 @@ void gkmx
     exit( 1 );
   }
 
+  // Loop partitioning (KS_*_NT, tuning file or autotuning)
+  tuner::Session session( sizeof(TC) == 4 ? "sgkmx" : "dgkmx", m, n, k );
   if ( omp_get_num_threads() == 1 && omp_get_max_threads() > 1 )
   {
-    // Check the environment variable.
-    jc_nt = hmlp_read_nway_from_env( "KS_JC_NT" );
-    ic_nt = hmlp_read_nway_from_env( "KS_IC_NT" );
-    jr_nt = hmlp_read_nway_from_env( "KS_JR_NT" );
+    jc_nt = session.setting.jc_nt;
+    ic_nt = session.setting.ic_nt;
+    jr_nt = session.setting.jr_nt;
   }
 
   if ( jc_nt > 1 )
@@ -479,9 +480,12 @@ void gkmx
     pack_nc = ( nc / NR ) * PACK_NR;
   }
 
+  // packing buffers and communicator are cached by the calling thread
+  Workspace workspace;
+
   // allocate packing memory
-  packA_buff  = hmlp_malloc<ALIGN_SIZE, TA>( KC * ( PACK_MC + 1 ) * jc_nt * ic_nt );
-  packB_buff  = hmlp_malloc<ALIGN_SIZE, TB>( KC * ( pack_nc + 1 ) * jc_nt         ); 
+  packA_buff  = workspace.Buffer<ALIGN_SIZE, TA>( KC * ( PACK_MC + 1 ) * jc_nt * ic_nt );
+  packB_buff  = workspace.Buffer<ALIGN_SIZE, TB>( KC * ( pack_nc + 1 ) * jc_nt         ); 
 
 
   // allocate V if k > KC
@@ -496,17 +500,15 @@ void gkmx
     ldv = ldc;
   }
 
-  // allocate tree communicator
-  thread_communicator my_comm( jc_nt, pc_nt, ic_nt, jr_nt );
+  // reuse the tree communicator
+  thread_communicator &my_comm = workspace.Communicator( jc_nt, pc_nt, ic_nt, jr_nt );
 
 
   if ( USE_STRASSEN )
   {
     assert( typeid(TA) == typeid(TB) );
     assert( typeid(TC) == typeid(TV) );
-    k_stra = k - k % KC;
-
-    if ( k_stra == k ) k_stra -= KC;
+    k_stra = strassen::GetStrassenK<MC, KC>( m, n, k );
 
     if ( k_stra )
     {
@@ -520,7 +522,7 @@ void gkmx
   {
     Worker thread( &my_comm );
 
-    if ( USE_STRASSEN )
+    if ( k_stra )
     {
       strassen::strassen_internal
       <MC, NC, KC, MR, NR,
@@ -564,8 +566,6 @@ void gkmx
     );
   }                                                        // end omp parallel
 
-  hmlp_free( packA_buff );
-  hmlp_free( packB_buff );
   //hmlp_free( V );
 };                                                         // end gkmx
 
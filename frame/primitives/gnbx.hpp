@@ -506,8 +506,9 @@ void gnbx
     jr_nt = hmlp_read_nway_from_env( "KS_JR_NT" );
   }
 
-  /** allocate tree communicator */
-  thread_communicator my_comm( jc_nt, pc_nt, ic_nt, jr_nt );
+  /** Reuse the tree communicator cached by the calling thread. */
+  Workspace workspace;
+  thread_communicator &my_comm = workspace.Communicator( jc_nt, pc_nt, ic_nt, jr_nt );
 
   #pragma omp parallel num_threads( my_comm.GetNumThreads() ) 
   {
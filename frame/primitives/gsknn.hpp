@@ -387,17 +387,21 @@ void gsknn(
   ldpackc = m;
   ldr = r;
 
+  // packing buffers and communicator are cached by the calling thread
+  Workspace workspace;
+
   // allocate packing memory
-  packA_buff  = hmlp_malloc<ALIGN_SIZE, TA>( KC, ( PACK_MC + 1 ) * ic_nt,         sizeof(TA) );
-  packB_buff  = hmlp_malloc<ALIGN_SIZE, TB>( KC, ( PACK_NC + 1 ),                 sizeof(TB) );
-  packA2_buff = hmlp_malloc<ALIGN_SIZE, TA>(  1, ( PACK_MC + 1 ) * ic_nt,         sizeof(TA) );
-  packB2_buff = hmlp_malloc<ALIGN_SIZE, TB>(  1, ( PACK_NC + 1 ),                 sizeof(TB) );
+  packA_buff  = workspace.Buffer<ALIGN_SIZE, TA>( KC, ( PACK_MC + 1 ) * ic_nt,         sizeof(TA) );
+  packB_buff  = workspace.Buffer<ALIGN_SIZE, TB>( KC, ( PACK_NC + 1 ),                 sizeof(TB) );
+  packA2_buff = workspace.Buffer<ALIGN_SIZE, TA>(  1, ( PACK_MC + 1 ) * ic_nt,         sizeof(TA) );
+  packB2_buff = workspace.Buffer<ALIGN_SIZE, TB>(  1, ( PACK_NC + 1 ),                 sizeof(TB) );
+  // m-by-n is problem sized, so it is not kept in the workspace.
   if ( k > KC ) {
     packC_buff = hmlp_malloc<ALIGN_SIZE, TC>(  m, n, sizeof(TC) );
   }
 
-  // allocate tree communicator
-  thread_communicator my_comm( 1, 1, ic_nt, 1 );
+  // reuse the tree communicator
+  thread_communicator &my_comm = workspace.Communicator( 1, 1, ic_nt, 1 );
 
   if ( USE_STRASSEN )
   {
@@ -459,10 +463,6 @@ void gsknn(
 
   }                                                        // end omp region
 
-  hmlp_free( packA_buff );
-  hmlp_free( packB_buff );
-  hmlp_free( packA2_buff );
-  hmlp_free( packB2_buff );
   hmlp_free( packC_buff );
 }                                                          // end gsknn
 
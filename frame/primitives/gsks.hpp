@@ -26,6 +26,7 @@
 
 #include <math.h>
 #include <vector>
+#include <limits>
 
 #include <hmlp.h>
 #include <hmlp_internal.hpp>
@@ -33,15 +34,136 @@
 
 #include <KernelMatrix.hpp>
 
+/** for USE_STRASSEN */
+#include <primitives/strassen.hpp>
+
 
 namespace hmlp
 {
+
+/** Register-tile kernel of gsks_fused(), see gsks_ref_mrxnr.hpp. */
+template<typename SEMIRINGKERNEL, typename T> struct gsks_mrxnr;
+
 namespace gsks
 {
 
 #define min( i, j ) ( (i)<(j) ? (i): (j) )
 #define KS_RHS 1
 
+/**
+ *  @brief Overwrite the m-by-n inner products C( i, j ) = a_i' * b_j with
+ *         the kernel values K( a_i, b_j ). a2 and b2 are the squared
+ *         2-norms, and hi and hj are the bandwidths (only used by
+ *         GAUSSIAN_VAR_BANDWIDTH). With r2 = a2 + b2 - 2 * a_i' * b_j,
+ *
+ *         GAUSSIAN:               exp( scal * r2 )
+ *         GAUSSIAN_VAR_BANDWIDTH: exp( -0.5 * hi * hj * r2 )
+ *         POLYNOMIAL:             ( scal * a_i' * b_j + cons )^powe
+ *         LAPLACE:                1 / sqrt( r2 ) ( 0 if a_i = b_j )
+ *         SIGMOID and TANH:       tanh( scal * a_i' * b_j + cons )
+ *         QUARTIC:                15 / 16 * ( 1 - min( r2, 1 ) )^2
+ *         MULTIQUADRATIC:         sqrt( r2 + cons )
+ *         EPANECHNIKOV:           3 / 4 * ( 1 - min( r2, 1 ) )
+ *
+ *         The microkernels and gsks_ref() share this definition. Returns
+ *         HMLP_ERROR_INVALID_VALUE (and leaves C untouched) for any other
+ *         kernel type; with m = n = 0 it only checks the kernel type.
+ */
+template<typename T>
+inline hmlpError_t evaluate_kernel
+(
+  kernel_s<T, T> *kernel,
+  int m, int n,
+  T *C, int ldc,
+  T *a2, T *b2,
+  T *hi, T *hj
+)
+{
+  /** Squared distances, rounding errors may make them negative. */
+  auto r2 = [&] ( int i, int j )
+  {
+    T r = a2[ i ] + b2[ j ] - 2.0 * C[ j * ldc + i ];
+    return r > 0 ? r : (T)0;
+  };
+
+  switch ( kernel->type )
+  {
+    case GAUSSIAN:
+    {
+      for ( int j = 0; j < n; j ++ )
+        for ( int i = 0; i < m; i ++ )
+          C[ j * ldc + i ] = std::exp( kernel->scal * r2( i, j ) );
+      break;
+    }
+    case GAUSSIAN_VAR_BANDWIDTH:
+    {
+      for ( int j = 0; j < n; j ++ )
+        for ( int i = 0; i < m; i ++ )
+          C[ j * ldc + i ] = std::exp( -0.5 * hi[ i ] * hj[ j ] * r2( i, j ) );
+      break;
+    }
+    case POLYNOMIAL:
+    {
+      for ( int j = 0; j < n; j ++ )
+        for ( int i = 0; i < m; i ++ )
+          C[ j * ldc + i ] = std::pow( kernel->scal * C[ j * ldc + i ] + kernel->cons, kernel->powe );
+      break;
+    }
+    case LAPLACE:
+    {
+      /** Coincident points (up to rounding errors) do not interact. */
+      const T eps = std::numeric_limits<T>::epsilon();
+      for ( int j = 0; j < n; j ++ )
+        for ( int i = 0; i < m; i ++ )
+        {
+          T r = r2( i, j );
+          C[ j * ldc + i ] = ( r > 8 * eps * ( a2[ i ] + b2[ j ] ) ) ? 1.0 / std::sqrt( r ) : 0.0;
+        }
+      break;
+    }
+    case SIGMOID:
+    case TANH:
+    {
+      for ( int j = 0; j < n; j ++ )
+        for ( int i = 0; i < m; i ++ )
+          C[ j * ldc + i ] = std::tanh( kernel->scal * C[ j * ldc + i ] + kernel->cons );
+      break;
+    }
+    case QUARTIC:
+    {
+      for ( int j = 0; j < n; j ++ )
+        for ( int i = 0; i < m; i ++ )
+        {
+          T c = r2( i, j ) < 1 ? 1.0 - r2( i, j ) : 0.0;
+          C[ j * ldc + i ] = ( 15.0 / 16.0 ) * c * c;
+        }
+      break;
+    }
+    case MULTIQUADRATIC:
+    {
+      for ( int j = 0; j < n; j ++ )
+        for ( int i = 0; i < m; i ++ )
+          C[ j * ldc + i ] = std::sqrt( r2( i, j ) + kernel->cons );
+      break;
+    }
+    case EPANECHNIKOV:
+    {
+      for ( int j = 0; j < n; j ++ )
+        for ( int i = 0; i < m; i ++ )
+        {
+          T c = r2( i, j ) < 1 ? 1.0 - r2( i, j ) : 0.0;
+          C[ j * ldc + i ] = ( 3.0 / 4.0 ) * c;
+        }
+      break;
+    }
+    default:
+    {
+      return HMLP_ERROR_INVALID_VALUE;
+    }
+  }
+  return HMLP_ERROR_SUCCESS;
+}; /** end evaluate_kernel() */
+
 /**
  *
  */ 
@@ -182,14 +304,15 @@ void gsks_internal
   Worker &thread,
   //ks_t *kernel,
   kernel_s<TV, TC> *kernel,
-  int m, int n, int k,
+  int m, int n, int k, int k_stra,
   TC *u,         int *umap, 
   TA *A, TA *A2, int *amap,
   TB *B, TB *B2, int *bmap,
   TC *w,         int *wmap, 
+  TV *Cstra,     int ldcstra,
   SEMIRINGKERNEL semiringkernel,
   MICROKERNEL microkernel,
-  int nc, int pack_nc,
+  int mc, int nc, int kc, int pack_nc,
   TC *packu,
   TA *packA, TA *packA2, TA *packAh,
   TB *packB, TB *packB2, TB *packBh,
@@ -210,8 +333,8 @@ void gsks_internal
   packC  += ( thread.jc_id                               ) * ldpackc * padn;
 
   auto loop6th = GetRange( 0, n, nc, thread.jc_id, thread.jc_nt );
-  auto loop5th = GetRange( 0, k, KC );
-  auto loop4th = GetRange( 0, m, MC, thread.ic_id, thread.ic_nt );
+  auto loop5th = GetRange( k_stra, k, kc );
+  auto loop4th = GetRange( 0, m, mc, thread.ic_id, thread.ic_nt );
 
   for ( int jc  = loop6th.beg(); 
             jc  < loop6th.end(); 
@@ -220,13 +343,38 @@ void gsks_internal
     auto &jc_comm = *thread.jc_comm;
     auto jb = min( n - jc, nc );
 
+    if ( k_stra )                                          // packC = Cstra
+    {
+      /** The rank-k updates from k_stra accumulate on the Strassen part. */
+      auto looppkC = GetRange( 0, jb, NR, thread.ic_jr, thread.pc_comm->GetNumThreads() );
+
+      for ( int j   = looppkC.beg();
+                j   < looppkC.end();
+                j  += looppkC.inc() )
+      {
+        for ( int ic = 0; ic < m; ic += mc )
+        {
+          auto ib = min( m - ic, mc );
+          auto ldc = ( ( ib - 1 ) / MR + 1 ) * MR;
+          for ( int jj = 0; jj < min( jb - j, NR ); jj ++ )
+          {
+            for ( int i = 0; i < ib; i ++ )
+            {
+              packC[ ic * padn + j * ldc + ( i / MR ) * MR * NR + jj * MR + i % MR ]
+                = Cstra[ ( jc + j + jj ) * ldcstra + ic + i ];
+            }
+          }
+        }
+      }
+    }
+
     for ( int pc  = loop5th.beg();
               pc  < loop5th.end();
               pc += loop5th.inc() )
     {
       auto &pc_comm = *thread.pc_comm;
-      auto pb = min( k - pc, KC );
-      auto is_the_last_pc_iteration = ( pc + KC >= k );
+      auto pb = min( k - pc, kc );
+      auto is_the_last_pc_iteration = ( pc + kc >= k );
 
       auto looppkB = GetRange( 0, jb,      NR, thread.ic_jr, pc_comm.GetNumThreads() ); 
       auto packpkB = GetRange( 0, jb, PACK_NR, thread.ic_jr, pc_comm.GetNumThreads() ); 
@@ -276,7 +424,7 @@ void gsks_internal
                 ic += loop4th.inc() )                      // beg 4th loop
       {
         auto &ic_comm = *thread.ic_comm;
-        auto ib = min( m - ic, MC );
+        auto ib = min( m - ic, mc );
 
         auto looppkA = GetRange( 0, ib,      MR, thread.jr_id, thread.jr_nt ); 
         auto packpkA = GetRange( 0, ib, PACK_MR, thread.jr_id, thread.jr_nt ); 
@@ -407,6 +555,8 @@ void gsks
 {
   int jc_nt = 1, pc_nt = 1, ic_nt = 1, jr_nt = 1;
   int ldpackc = 0, padn = 0, nc = NC, pack_nc = PACK_NC;
+  int mc = MC, kc = KC;
+  int k_stra = 0;
   char *str;
 
   TC *packu_buff = NULL;
@@ -414,14 +564,25 @@ void gsks
   TB *packB_buff = NULL, *packB2_buff = NULL, *packBh_buff = NULL;
   TC *packw_buff = NULL;
   TV *packC_buff = NULL;
+  TV *Cstra_buff = NULL;
 
   // Early return if possible
   if ( m == 0 || n == 0 || k == 0 ) return;
 
-  // Check the environment variable.
-  jc_nt = hmlp_read_nway_from_env( "KS_JC_NT" );
-  ic_nt = hmlp_read_nway_from_env( "KS_IC_NT" );
-  jr_nt = hmlp_read_nway_from_env( "KS_JR_NT" );
+  // Loop partitioning and blocking (KS_*_NT, tuning file or autotuning)
+  tuner::Session session( sizeof(TC) == 4 ? "sgsks" : "dgsks", m, n, k, MC, NC, KC, MR, NR );
+  jc_nt = session.setting.jc_nt;
+  ic_nt = session.setting.ic_nt;
+  jr_nt = session.setting.jr_nt;
+
+  // The runtime blocking is bounded by the packing buffers of MC, NC and KC.
+  if ( session.setting.mc > 0 ) mc = std::max( MR, ( min( session.setting.mc, MC ) / MR ) * MR );
+  if ( session.setting.kc > 0 ) kc = min( session.setting.kc, KC );
+  if ( session.setting.nc > 0 )
+  {
+    nc = std::max( NR, ( min( session.setting.nc, NC ) / NR ) * NR );
+    pack_nc = ( nc / NR ) * PACK_NR;
+  }
 
   if ( jc_nt > 1 )
   {
@@ -429,29 +590,33 @@ void gsks
     pack_nc = ( nc / NR ) * PACK_NR;
   }
 
+  // packing buffers and communicator are cached by the calling thread
+  Workspace workspace;
+
   // allocate packing memory
   {
-    packA_buff  = hmlp_malloc<ALIGN_SIZE, TA>( KC, ( PACK_MC + 1 ) * jc_nt * ic_nt,         sizeof(TA) );
-    packB_buff  = hmlp_malloc<ALIGN_SIZE, TB>( KC, ( pack_nc + 1 ) * jc_nt,                 sizeof(TB) ); 
-    packu_buff  = hmlp_malloc<ALIGN_SIZE, TC>(  1, ( PACK_MC + 1 ) * jc_nt * ic_nt * jr_nt, sizeof(TC) );
-    packw_buff  = hmlp_malloc<ALIGN_SIZE, TC>(  1, ( pack_nc + 1 ) * jc_nt,                 sizeof(TC) ); 
+    packA_buff  = workspace.Buffer<ALIGN_SIZE, TA>( KC, ( PACK_MC + 1 ) * jc_nt * ic_nt,         sizeof(TA) );
+    packB_buff  = workspace.Buffer<ALIGN_SIZE, TB>( KC, ( pack_nc + 1 ) * jc_nt,                 sizeof(TB) ); 
+    packu_buff  = workspace.Buffer<ALIGN_SIZE, TC>(  1, ( PACK_MC + 1 ) * jc_nt * ic_nt * jr_nt, sizeof(TC) );
+    packw_buff  = workspace.Buffer<ALIGN_SIZE, TC>(  1, ( pack_nc + 1 ) * jc_nt,                 sizeof(TC) ); 
   }
 
   // allocate extra packing buffer
   if ( USE_L2NORM )
   {
-    packA2_buff = hmlp_malloc<ALIGN_SIZE, TA>(  1, ( PACK_MC + 1 ) * jc_nt * ic_nt,         sizeof(TA) );
-    packB2_buff = hmlp_malloc<ALIGN_SIZE, TB>(  1, ( pack_nc + 1 ) * jc_nt,                 sizeof(TB) ); 
+    packA2_buff = workspace.Buffer<ALIGN_SIZE, TA>(  1, ( PACK_MC + 1 ) * jc_nt * ic_nt,         sizeof(TA) );
+    packB2_buff = workspace.Buffer<ALIGN_SIZE, TB>(  1, ( pack_nc + 1 ) * jc_nt,                 sizeof(TB) ); 
   }
 
   if ( USE_VAR_BANDWIDTH )
   {
-    packAh_buff = hmlp_malloc<ALIGN_SIZE, TA>(  1, ( PACK_MC + 1 ) * jc_nt * ic_nt,         sizeof(TA) );
-    packBh_buff = hmlp_malloc<ALIGN_SIZE, TB>(  1, ( pack_nc + 1 ) * jc_nt,                 sizeof(TB) ); 
+    packAh_buff = workspace.Buffer<ALIGN_SIZE, TA>(  1, ( PACK_MC + 1 ) * jc_nt * ic_nt,         sizeof(TA) );
+    packBh_buff = workspace.Buffer<ALIGN_SIZE, TB>(  1, ( pack_nc + 1 ) * jc_nt,                 sizeof(TB) ); 
   }
 
-  // Temporary bufferm <TV> to store the semi-ring rank-k update
-  if ( k > KC )
+  // Temporary bufferm <TV> to store the semi-ring rank-k update. It and
+  // Cstra_buff are problem sized, so they are not kept in the workspace.
+  if ( k > kc )
   {
     ldpackc  = ( ( m - 1 ) / PACK_MR + 1 ) * PACK_MR;
     padn = pack_nc;
@@ -459,18 +624,45 @@ void gsks
     packC_buff = hmlp_malloc<ALIGN_SIZE, TV>( ldpackc, padn * jc_nt, sizeof(TV) );
   }
 
-  // allocate tree communicator
-  thread_communicator my_comm( jc_nt, pc_nt, ic_nt, jr_nt );
+  // A( :, amap )' * B( :, bmap ) of the leading k_stra by the one-level Strassen
+  if ( USE_STRASSEN )
+  {
+    k_stra = strassen::GetStrassenK<MC, KC>( m, n, k );
+    if ( k_stra )
+    {
+      Cstra_buff = hmlp_malloc<ALIGN_SIZE, TV>( m, n, sizeof(TV) );
+      std::fill( Cstra_buff, Cstra_buff + (size_t)m * n, (TV)0 );
+    }
+  }
+
+  // reuse the tree communicator
+  thread_communicator &my_comm = workspace.Communicator( jc_nt, pc_nt, ic_nt, jr_nt );
 
 
   #pragma omp parallel num_threads( my_comm.GetNumThreads() ) 
   {
     Worker thread( &my_comm );
 
-    if ( USE_STRASSEN )
+    if ( k_stra )
     {
-      printf( "gsks: strassen algorithms haven't been implemented." );
-      exit( 1 );
+      strassen::strassen_internal
+      <MC, NC, KC, MR, NR,
+      PACK_MC, PACK_NC, PACK_MR, PACK_NR, ALIGN_SIZE,
+      USE_STRASSEN,
+      SEMIRINGKERNEL, SEMIRINGKERNEL,
+      TA, TB, TC, TV>
+      (
+        thread,
+        HMLP_OP_T, HMLP_OP_N,
+        m, n, k_stra,
+        A, k, amap,
+        B, k, bmap,
+        Cstra_buff, m,
+        semiringkernel, semiringkernel,
+        nc, pack_nc,
+        packA_buff,
+        packB_buff
+      );
     }
 
     gsks_internal
@@ -481,13 +673,14 @@ void gsks
     (
       thread,
       kernel,
-      m, n, k,
+      m, n, k, k_stra,
       u,     umap,
       A, A2, amap,
       B, B2, bmap,
       w,     wmap,
+      Cstra_buff, m,
       semiringkernel, microkernel,
-      nc, pack_nc,
+      mc, nc, kc, pack_nc,
       packu_buff,
       packA_buff, packA2_buff, packAh_buff,
       packB_buff, packB2_buff, packBh_buff,
@@ -497,23 +690,65 @@ void gsks
 
   } /** end omp region */
 
-  hmlp_free( packA_buff );
-  hmlp_free( packB_buff );
-  hmlp_free( packu_buff );
-  hmlp_free( packw_buff );
-  if ( USE_L2NORM )
-  {
-    hmlp_free( packA2_buff );
-    hmlp_free( packB2_buff );
-  }
+  hmlp_free( packC_buff );
+  hmlp_free( Cstra_buff );
 } /** end gsks() */
 
 
+/**
+ *  @brief Fused GSKS with the BLIS rank-k kernel of SEMIRINGKERNEL. The
+ *         kernel function is applied on the register tile by gsks_mrxnr,
+ *         so all kernel types share the same instance; each architecture
+ *         only picks the blocking parameters and the rank-k kernel.
+ */
+template<size_t MC, size_t NC, size_t KC, bool USE_VAR_BANDWIDTH,
+  typename SEMIRINGKERNEL, typename T>
+hmlpError_t gsks_fused
+(
+  kernel_s<T, T> *kernel,
+  int m, int n, int k,
+  T *u,        int *umap,
+  T *A, T *A2, int *amap,
+  T *B, T *B2, int *bmap,
+  T *w,        int *wmap
+)
+{
+  /** Reject unsupported kernel types before any packing. */
+  RETURN_IF_ERROR( evaluate_kernel<T>( kernel, 0, 0, NULL, 1, NULL, NULL, NULL, NULL ) );
+
+  const size_t MR = SEMIRINGKERNEL::mr;
+  const size_t NR = SEMIRINGKERNEL::nr;
+  const size_t PACK_MR = SEMIRINGKERNEL::pack_mr;
+  const size_t PACK_NR = SEMIRINGKERNEL::pack_nr;
+  const size_t ALIGN_SIZE = SEMIRINGKERNEL::align_size;
+
+  SEMIRINGKERNEL semiringkernel;
+  gsks_mrxnr<SEMIRINGKERNEL, T> fusedkernel;
+
+  gsks<MC, NC, KC, MR, NR, MC, NC, PACK_MR, PACK_NR, ALIGN_SIZE,
+    true,              /** USE_L2NORM */
+    USE_VAR_BANDWIDTH, /** USE_VAR_BANDWIDTH */
+    true,              /** USE_STRASSEN (large k only) */
+    SEMIRINGKERNEL, gsks_mrxnr<SEMIRINGKERNEL, T>,
+    T, T, T, T>
+  (
+    kernel,
+    m, n, k,
+    u,     umap,
+    A, A2, amap,
+    B, B2, bmap,
+    w,     wmap,
+    semiringkernel, fusedkernel
+  );
+  return HMLP_ERROR_SUCCESS;
+}; /** end gsks_fused() */
+
+
 /**
  *
  */ 
 template<typename T>
-void gsks_ref
+hmlpError_t gsks_ref
 (
   //ks_t *kernel,
   kernel_s<T, T> *kernel,
@@ -525,32 +760,31 @@ void gsks_ref
 )
 {
   int nrhs = KS_RHS;
-  T rank_k_scale, fone = 1.0, fzero = 0.0;
+  T fone = 1.0, fzero = 0.0;
   std::vector<T> packA, packB, C, packu, packw;
+  std::vector<T> packA2, packB2, packAh, packBh;
+
+  /** Reject unsupported kernel types before any packing. */
+  RETURN_IF_ERROR( evaluate_kernel<T>( kernel, 0, 0, NULL, 1, NULL, NULL, NULL, NULL ) );
 
   // Early return if possible
-  if ( m == 0 || n == 0 || k == 0 ) return;
+  if ( m == 0 || n == 0 || k == 0 ) return HMLP_ERROR_SUCCESS;
 
   packA.resize( k * m );
   packB.resize( k * n );
   C.resize( m * n );
   packu.resize( m );
   packw.resize( n );
-
-  switch ( kernel->type )
+  packA2.resize( m );
+  packB2.resize( n );
+  if ( kernel->type == GAUSSIAN_VAR_BANDWIDTH )
   {
-    case GAUSSIAN:
-      rank_k_scale = -2.0;
-      break;
-    case GAUSSIAN_VAR_BANDWIDTH:
-      rank_k_scale = -2.0;
-      break;
-    default:
-      exit( 1 );
+    packAh.resize( m );
+    packBh.resize( n );
   }
 
   /*
-   *  Collect packA and packu
+   *  Collect packA, packA2, packAh and packu
    */ 
   #pragma omp parallel for
   for ( int i = 0; i < m; i ++ ) 
@@ -563,10 +797,12 @@ void gsks_ref
     {
       packu[ p * m + i ] = u[ umap[ i ] * KS_RHS + p ];
     }
+    packA2[ i ] = A2[ amap[ i ] ];
+    if ( packAh.size() ) packAh[ i ] = kernel->hi[ amap[ i ] ];
   }
 
   /*
-   *  Collect packB and packw
+   *  Collect packB, packB2, packBh and packw
    */ 
   #pragma omp parallel for
   for ( int j = 0; j < n; j ++ ) 
@@ -579,19 +815,21 @@ void gsks_ref
     {
       packw[ p * n + j ] = w[ wmap[ j ] * KS_RHS + p ];
     }
+    packB2[ j ] = B2[ bmap[ j ] ];
+    if ( packBh.size() ) packBh[ j ] = kernel->hj[ bmap[ j ] ];
   }
 
   /*
-   *  C = -2.0 * A^T * B (GEMM)
+   *  C = A^T * B (GEMM)
    */ 
 #ifdef USE_BLAS
   xgemm
   ( 
     "T", "N", 
     m, n, k, 
-    rank_k_scale, packA.data(), k,
-                  packB.data(), k, 
-    fzero,        C.data(),     m 
+    fone,  packA.data(), k,
+           packB.data(), k, 
+    fzero, C.data(),     m 
   );
 #else
   #pragma omp parallel for
@@ -606,58 +844,17 @@ void gsks_ref
       }
     }
   }
-  #pragma omp parallel for
-  for ( int j = 0; j < n; j ++ ) 
-  {
-    for ( int i = 0; i < m; i ++ ) 
-    {
-      C[ j * m + i ] *= rank_k_scale;
-    }
-  }
 #endif
 
-  switch ( kernel->type ) 
+  /*
+   *  C = K( A, B ), one column at a time
+   */ 
+  #pragma omp parallel for
+  for ( int j = 0; j < n; j ++ ) 
   {
-    case GAUSSIAN:
-      {
-        #pragma omp parallel for
-        for ( int j = 0; j < n; j ++ ) 
-        {
-          for ( int i = 0; i < m; i ++ ) 
-          {
-            C[ j * m + i ] += A2[ amap[ i ] ];
-            C[ j * m + i ] += B2[ bmap[ j ] ];
-            C[ j * m + i ] *= kernel->scal;
-          }
-          for ( int i = 0; i < m; i ++ ) 
-          {
-            C[ j * m + i ] = exp( C[ j * m + i ] );
-          }
-        }
-        break;
-      }
-    case GAUSSIAN_VAR_BANDWIDTH:
-      {
-        #pragma omp parallel for
-        for ( int j = 0; j < n; j ++ ) 
-        {
-          for ( int i = 0; i < m; i ++ ) 
-          {
-            C[ j * m + i ] += A2[ amap[ i ] ];
-            C[ j * m + i ] += B2[ bmap[ j ] ];
-            C[ j * m + i ] *= -0.5;
-            C[ j * m + i ] *= kernel->hi[ i ];
-            C[ j * m + i ] *= kernel->hj[ j ];
-          }
-          for ( int i = 0; i < m; i ++ ) 
-          {
-            C[ j * m + i ] = exp( C[ j * m + i ] );
-          }
-        }
-        break;
-      }
-    default:
-      exit( 1 );
+    evaluate_kernel( kernel, m, 1, C.data() + j * m, m, 
+        packA2.data(), packB2.data() + j, 
+        packAh.data(), packBh.size() ? packBh.data() + j : NULL );
   }
 
   /*
@@ -698,6 +895,7 @@ void gsks_ref
     }
   }
 
+  return HMLP_ERROR_SUCCESS;
 } // end void gsks_ref
 
 
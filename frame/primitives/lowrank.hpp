@@ -39,6 +39,16 @@ using namespace hmlp;
 
 namespace hmlp
 {
+
+/** @brief Interpolative decompositions used by the skeletonization. */
+typedef enum
+{
+  /** Column pivoting QR (GEQP4) on the sampled block. */
+  LOWRANK_ID_GEQP4,
+  /** Column pivoting QR on a blocked Gaussian sketch. */
+  LOWRANK_ID_RANDOMIZED
+} lowrankMethod_t;
+
 namespace lowrank
 {
 
@@ -174,8 +184,9 @@ namespace lowrank
 
 
 /**
- *
- *
+ *  @brief Interpolative decomposition with GEQP4. If residual is given, it
+ *         returns the magnitude of the first discarded pivot, an estimate
+ *         of the error of the ID (0 if no column is discarded).
  */ 
 template<typename T>
 void id
@@ -183,7 +194,8 @@ void id
   bool use_adaptive_ranks, bool secure_accuracy,
   int m, int n, int maxs, T stol,
   Data<T> A,
-  vector<size_t> &skels, Data<T> &proj, vector<int> &jpvt
+  vector<size_t> &skels, Data<T> &proj, vector<int> &jpvt,
+  T *residual = nullptr
 )
 {
   int s;
@@ -228,6 +240,7 @@ void id
     s = maxs;
     if ( secure_accuracy )
     {
+      if ( residual ) *residual = std::abs( A_tmp[ maxs * m + maxs ] );
       skels.clear();
       proj.clear();
       jpvt.clear();
@@ -245,6 +258,8 @@ void id
     s = std::min( s, n );
   }
 
+  if ( residual ) *residual = ( s < n ) ? std::abs( A_tmp[ s * m + s ] ) : 0;
+
   /** If the required rank exceeds maxs. */
   //if ( s > maxs )
   //{
@@ -355,7 +370,127 @@ void id
   }
 
 }; // end id()
-  
+
+
+
+/**
+ *  @brief Randomized blocked interpolative decomposition with the same
+ *         outputs as id(). Instead of a pivoting QR on the whole m-by-n
+ *         matrix A, we sketch Y = Omega * A with a Gaussian Omega and 
+ *         pivot on Y. Omega grows by nb rows at a time until the 
+ *         numerical rank of Y is revealed (with oversampling p), or 
+ *         until the rank is known to exceed maxs. Omega is drawn from 
+ *         seed, so the same seed gives the same skeletons.
+ */ 
+template<typename T>
+void rid
+(
+  bool use_adaptive_ranks, bool secure_accuracy,
+  int m, int n, int maxs, T stol,
+  Data<T> &A,
+  vector<size_t> &skels, Data<T> &proj, vector<int> &jpvt, int nb = 64,
+  T *residual = nullptr, unsigned seed = 0
+)
+{
+  /** Oversampling of the sketch. */
+  const int p = 10;
+  /** The sketch never needs more rows than min( m, n ). */
+  int lmax = std::min( m, n );
+  /** The (fixed) rank we need to capture. */
+  int smax = std::min( maxs, n );
+  int s = 0, l = 0;
+
+  assert( m > 0 && n > 0 );
+
+  int lwork = 2 * n  + ( n + 1 ) * 64;
+  vector<T> work( lwork );
+  vector<T> tau( lmax );
+  Data<T> Y( lmax, n ), Omega, R;
+
+  std::mt19937 generator( seed );
+  std::normal_distribution<T> gaussian( 0.0, 1.0 );
+
+  jpvt.clear();
+  jpvt.resize( n, 0 );
+
+  while ( l < lmax )
+  {
+    /** Append b rows to the sketch: Y( l:l+b-1, : ) = Omega * A. */
+    int b = std::min( nb, lmax - l );
+    Omega.resize( b, m );
+    for ( auto &omega : Omega ) omega = gaussian( generator );
+    xgemm( "N", "N", b, n, m, 1.0, Omega.data(), b, A.data(), m, 
+        0.0, Y.data() + l, lmax );
+    l += b;
+
+    /** R = Y( 0:l-1, : ) / sqrt( l ) such that E[ |Rx| ] = |Ax|. */
+    R.resize( l, n );
+    T scal = 1.0 / std::sqrt( (T)l );
+    for ( int j = 0; j < n; j ++ )
+      for ( int i = 0; i < l; i ++ ) 
+        R[ j * l + i ] = scal * Y[ j * lmax + i ];
+
+    /** Pivoting QR on the (small) sketch. */
+    std::fill( jpvt.begin(), jpvt.end(), 0 );
+    xgeqp3( l, n, R.data(), l, jpvt.data(), tau.data(), work.data(), lwork );
+
+    /** Search for rank 1 <= s <= l that satisfies the error tolerance. */
+    for ( s = 1; s < l; s ++ )
+    {
+      if ( std::abs( R[ s * l + s ] ) < stol ) break;
+    }
+
+    if ( use_adaptive_ranks )
+    {
+      /** The rank has been revealed. */
+      if ( s + p <= l ) break;
+      /** The rank exceeds maxs; no need to sketch further. */
+      if ( s > maxs && l >= maxs + p ) break;
+    }
+    else
+    {
+      /** The fixed rank has been captured with oversampling. */
+      if ( l >= smax + p ) break;
+    }
+  }
+
+  /** Shift jpvt from 1-base to 0-base index. */
+  for ( auto &j : jpvt ) j = j - 1;
+
+  if ( s > maxs )
+  {
+    s = maxs;
+    if ( secure_accuracy )
+    {
+      if ( residual ) *residual = std::abs( R[ maxs * l + maxs ] );
+      skels.clear();
+      proj.clear();
+      jpvt.clear();
+      return;
+    }
+  }
+
+  /** If using fixed rank, then take the minimum between maxs and n. */
+  s = use_adaptive_ranks ? std::min( s, n ) : std::min( smax, l );
+
+  if ( residual ) *residual = ( s < l ) ? std::abs( R[ s * l + s ] ) : 0;
+
+  skels.resize( s );
+  for ( int j = 0; j < s; j ++ ) skels[ j ] = jpvt[ j ];
+
+  /** proj = R( 0:s-1, : ), the same layout as id(). */
+  proj.clear();
+  proj.resize( s, n, 0.0 );
+  for ( int j = 0; j < n; j ++ )
+  {
+    for ( int i = 0; i < s && i <= j; i ++ ) 
+    {
+      proj[ j * s + i ] = R[ j * l + i ];
+    }
+  }
+
+}; /** end rid() */
+
 
 
 /**
@@ -42,7 +42,7 @@
       packB_buff \
     ); \
 
-#define STRAPRIM_MAP( A0,A1,gamma,B0,B1,delta,C0,C1,alpha0,alpha1 ) \
+#define STRAPRIM_MAP( A0,amap0,A1,amap1,gamma,B0,bmap0,B1,bmap1,delta,C0,C1,alpha0,alpha1 ) \
     straprim \
     <MC, NC, KC, MR, NR,  \
     PACK_MC, PACK_NC, PACK_MR, PACK_NR, ALIGN_SIZE, \
@@ -53,8 +53,8 @@
       thread, \
       transA, transB, \
       md, nd, kd, \
-      A0, A1, lda, gamma, amap, \
-      B0, B1, ldb, delta, bmap, \
+      A0, A1, lda, gamma, amap0, amap1, \
+      B0, B1, ldb, delta, bmap0, bmap1, \
       C0, C1, ldc, alpha0, alpha1, \
       stra_semiringkernel, stra_microkernel, \
       nc, pack_nc, \
@@ -73,6 +73,22 @@ namespace strassen
 
 //#define min( i, j ) ( (i)<(j) ? (i): (j) )
 
+/**
+ *  @brief Return the leading k of a large-k rank-k update that is worth
+ *         the one-level Strassen (0 if m, n or k is too small). k_stra is a
+ *         multiple of KC, and at least one rank-KC update is left to the
+ *         caller, such that gkmx, gsks and conv2d can still fuse their
+ *         microkernels in the last iteration.
+ */ 
+template<int MC, int KC>
+int GetStrassenK( int m, int n, int k )
+{
+  if ( m < 2 * MC || n < 2 * MC || k < 4 * KC ) return 0;
+  int k_stra = k - k % KC;
+  if ( k_stra == k ) k_stra -= KC;
+  return k_stra;
+}; /** end GetStrassenK() */
+
 /**
  *
  */ 
@@ -674,8 +690,8 @@ void straprim
   Worker &thread,
   hmlpOperation_t transA, hmlpOperation_t transB,
   int m, int n, int k,
-  TA *A0, TA *A1, int lda, TA gamma, int *amap,
-  TB *B0, TB *B1, int ldb, TB delta, int *bmap,
+  TA *A0, TA *A1, int lda, TA gamma, int *amap0, int *amap1,
+  TB *B0, TB *B1, int ldb, TB delta, int *bmap0, int *bmap1,
   TV *C0, TV *C1, int ldc, TV alpha0, TV alpha1,
   STRA_SEMIRINGKERNEL stra_semiringkernel,
   STRA_MICROKERNEL stra_microkernel,
@@ -717,43 +733,38 @@ void straprim
       {
 
         //printf( "before packB\n" );
-        if ( transB == HMLP_OP_N )
+        /** B( :, bmap ) is k-by-n, or n-by-k if transB. */
+        auto *b0 = transB == HMLP_OP_N ? &B0[ pc ] : &B0[ pc * ldb ];
+        if ( delta == 0 || B1 == NULL )
         {
-
-          if ( delta == 0 || B1 == NULL ) {
-            // ldb == k
-            pack2D<true, PACK_NR>                              // packB
+          if ( transB == HMLP_OP_N )
+            pack2D<true, PACK_NR>                          // packB
             (
               std::min( jb - j, NR ), pb,
-              &B0[ pc ], ldb, &bmap[ jc + j ], &packB[ jp * pb ]
+              b0, ldb, &bmap0[ jc + j ], &packB[ jp * pb ]
             );
-          } else {
-            pack2D<true, PACK_NR>                              // packB
+          else
+            pack2D<false, PACK_NR>                         // packB (transB)
             (
               std::min( jb - j, NR ), pb,
-              &B0[ pc ],  &B1[ pc ], ldb, delta, &bmap[ jc + j ], &packB[ jp * pb ]
+              b0, ldb, &bmap0[ jc + j ], &packB[ jp * pb ]
             );
-          }
-
         }
         else
         {
-          if ( delta == 0 || B1 == NULL ) {
-            pack2D<false, PACK_NR>                              // packB (transB)
+          auto *b1 = transB == HMLP_OP_N ? &B1[ pc ] : &B1[ pc * ldb ];
+          if ( transB == HMLP_OP_N )
+            pack2D<true, PACK_NR>                          // packB
             (
               std::min( jb - j, NR ), pb,
-              &B0[ pc ], ldb, &bmap[ jc + j ], &packB[ jp * pb ]
+              b0, &bmap0[ jc + j ], b1, &bmap1[ jc + j ], ldb, delta, &packB[ jp * pb ]
             );
-          } else {
-            pack2D<false, PACK_NR>                              // packB (transB)
+          else
+            pack2D<false, PACK_NR>                         // packB (transB)
             (
               std::min( jb - j, NR ), pb,
-              &B0[ pc ],  &B1[ pc ], ldb, delta, &bmap[ jc + j ], &packB[ jp * pb ]
+              b0, &bmap0[ jc + j ], b1, &bmap1[ jc + j ], ldb, delta, &packB[ jp * pb ]
             );
-
-
-          }
-
         }
 
       }
@@ -776,42 +787,38 @@ void straprim
           //assert( lda == k );
           //For transpose cases, lda should be equal to k.
 
-          if ( transA == HMLP_OP_N )
+          /** A( amap, : ) is m-by-k, or k-by-m if transA. */
+          auto *a0 = transA == HMLP_OP_N ? &A0[ pc * lda ] : &A0[ pc ];
+          if ( gamma == 0 || A1 == NULL )
           {
-
-            if ( gamma == 0 || A1 == NULL ) {
-              pack2D<false, PACK_MR>                            // packA
+            if ( transA == HMLP_OP_N )
+              pack2D<false, PACK_MR>                       // packA
               (
                 std::min( ib - i, MR ), pb,
-                &A0[ pc ], lda, &amap[ ic + i ], &packA[ ip * pb ]
+                a0, lda, &amap0[ ic + i ], &packA[ ip * pb ]
               );
-            } else {
-              pack2D<false, PACK_MR>                            // packA
+            else
+              pack2D<true, PACK_MR>                        // packA (transA)
               (
                 std::min( ib - i, MR ), pb,
-                &A0[ pc ], &A1[ pc ], lda, gamma, &amap[ ic + i ], &packA[ ip * pb ]
+                a0, lda, &amap0[ ic + i ], &packA[ ip * pb ]
               );
-            }
-
           }
           else
           {
-
-            if ( gamma == 0 || A1 == NULL ) {
-              pack2D<true, PACK_MR>                            // packA (transA)
+            auto *a1 = transA == HMLP_OP_N ? &A1[ pc * lda ] : &A1[ pc ];
+            if ( transA == HMLP_OP_N )
+              pack2D<false, PACK_MR>                       // packA
               (
                 std::min( ib - i, MR ), pb,
-                &A0[ pc ], lda, &amap[ ic + i ], &packA[ ip * pb ]
+                a0, &amap0[ ic + i ], a1, &amap1[ ic + i ], lda, gamma, &packA[ ip * pb ]
               );
-            } else {
-              pack2D<true, PACK_MR>                            // packA (transA)
+            else
+              pack2D<true, PACK_MR>                        // packA (transA)
               (
                 std::min( ib - i, MR ), pb,
-                &A0[ pc ], &A1[ pc ], lda, gamma, &amap[ ic + i ], &packA[ ip * pb ]
+                a0, &amap0[ ic + i ], a1, &amap1[ ic + i ], lda, gamma, &packA[ ip * pb ]
               );
-
-            }
-
           }
 
         }
@@ -1063,6 +1070,54 @@ void hmlp_dynamic_peeling
   //printf( "Leave dynamic peeling\n" );
 }
 
+/**
+ *  @brief Dynamic peeling of C += A( amap, : ) * B( :, bmap ). The one-level
+ *         Strassen only covers the leading even m, n and k, so C( 0:ms, 0:ns )
+ *         misses the last column of A, and the last row and column of C miss
+ *         the whole product. The columns of C are distributed to all threads
+ *         of the communicator.
+ */ 
+template<typename TA, typename TB, typename TV>
+void hmlp_dynamic_peeling
+(
+  Worker &thread,
+  hmlpOperation_t transA, hmlpOperation_t transB,
+  int m, int n, int k,
+  TA *A, int lda, int *amap,
+  TB *B, int ldb, int *bmap,
+  TV *C, int ldc,
+  int dim1, int dim2, int dim3
+)
+{
+  int ms = m - m % dim1;
+  int ks = k - k % dim2;
+  int ns = n - n % dim3;
+
+  if ( ms == m && ns == n && ks == k ) return;
+
+  auto a = [&] ( int i, int p )
+  {
+    return transA == HMLP_OP_N ? A[ p * lda + amap[ i ] ] : A[ amap[ i ] * lda + p ];
+  };
+  auto b = [&] ( int p, int j )
+  {
+    return transB == HMLP_OP_N ? B[ bmap[ j ] * ldb + p ] : B[ p * ldb + bmap[ j ] ];
+  };
+
+  auto n_threads = thread.my_comm->GetNumThreads();
+
+  for ( int j = thread.tid; j < n; j += n_threads )
+  {
+    for ( int i = 0; i < m; i ++ )
+    {
+      int beg = ( i < ms && j < ns ) ? ks : 0;
+      TV cij = 0;
+      for ( int p = beg; p < k; p ++ ) cij += a( i, p ) * b( p, j );
+      C[ j * ldc + i ] += cij;
+    }
+  }
+}; /** end hmlp_dynamic_peeling() */
+
 template<
   int MC, int NC, int KC, int MR, int NR, 
   int PACK_MC, int PACK_NC, int PACK_MR, int PACK_NR, int ALIGN_SIZE,
@@ -1084,55 +1139,48 @@ void strassen_internal
   TB *packB_buff
 )
 {
-
-  int ms, ks, ns;
-  int md, kd, nd;
-  int mr, kr, nr;
-
-  mr = m % ( 2 ), kr = k % ( 2 ), nr = n % ( 2 );
-  md = m - mr, kd = k - kr, nd = n - nr;
-
-  // Partition code.
-  ms=md, ks=kd, ns=nd;
-  TA *A00, *A01, *A10, *A11;
-  hmlp_acquire_mpart( transA, ms, ks, A, lda, 2, 2, 0, 0, &A00 );
-  hmlp_acquire_mpart( transA, ms, ks, A, lda, 2, 2, 0, 1, &A01 );
-  hmlp_acquire_mpart( transA, ms, ks, A, lda, 2, 2, 1, 0, &A10 );
-  hmlp_acquire_mpart( transA, ms, ks, A, lda, 2, 2, 1, 1, &A11 );
-
-  TB *B00, *B01, *B10, *B11;
-  hmlp_acquire_mpart( transB, ks, ns, B, ldb, 2, 2, 0, 0, &B00 );
-  hmlp_acquire_mpart( transB, ks, ns, B, ldb, 2, 2, 0, 1, &B01 );
-  hmlp_acquire_mpart( transB, ks, ns, B, ldb, 2, 2, 1, 0, &B10 );
-  hmlp_acquire_mpart( transB, ks, ns, B, ldb, 2, 2, 1, 1, &B11 );
+  int md = m / 2, kd = k / 2, nd = n / 2;
+
+  /**
+   *  A( amap, : ) and B( :, bmap ) are not contiguous, so the row (column)
+   *  blocks of A (B) are selected by offsetting the maps, and only the
+   *  blocks of k are selected by offsetting the pointers.
+   */
+  TA *A_0 = A, *A_1 = ( transA == HMLP_OP_N ) ? A + kd * lda : A + kd;
+  TB *B_0 = B, *B_1 = ( transB == HMLP_OP_N ) ? B + kd : B + kd * ldb;
+  int *amap_0 = amap, *amap_1 = amap + md;
+  int *bmap_0 = bmap, *bmap_1 = bmap + nd;
 
   TV *C00, *C01, *C10, *C11;
-  hmlp_acquire_mpart( HMLP_OP_N, ms, ns, C, ldc, 2, 2, 0, 0, &C00 );
-  hmlp_acquire_mpart( HMLP_OP_N, ms, ns, C, ldc, 2, 2, 0, 1, &C01 );
-  hmlp_acquire_mpart( HMLP_OP_N, ms, ns, C, ldc, 2, 2, 1, 0, &C10 );
-  hmlp_acquire_mpart( HMLP_OP_N, ms, ns, C, ldc, 2, 2, 1, 1, &C11 );
-
-  md = md / 2, kd = kd / 2, nd = nd / 2;
+  hmlp_acquire_mpart( HMLP_OP_N, 2 * md, 2 * nd, C, ldc, 2, 2, 0, 0, &C00 );
+  hmlp_acquire_mpart( HMLP_OP_N, 2 * md, 2 * nd, C, ldc, 2, 2, 0, 1, &C01 );
+  hmlp_acquire_mpart( HMLP_OP_N, 2 * md, 2 * nd, C, ldc, 2, 2, 1, 0, &C10 );
+  hmlp_acquire_mpart( HMLP_OP_N, 2 * md, 2 * nd, C, ldc, 2, 2, 1, 1, &C11 );
 
+  /** A00 = ( A_0, amap_0 ), A01 = ( A_1, amap_0 ), A10 = ( A_0, amap_1 ), ... */
   // M1: C00 = 1*C00+1*(A00+A11)(B00+B11); C11 = 1*C11+1*(A00+A11)(B00+B11)
-  STRAPRIM_MAP( A00, A11, 1, B00, B11, 1, C00, C11, 1, 1 );
+  STRAPRIM_MAP( A_0, amap_0, A_1, amap_1, 1, B_0, bmap_0, B_1, bmap_1, 1, C00, C11, 1, 1 )
   // M2: C10 = 1*C10+1*(A10+A11)B00; C11 = 1*C11-1*(A10+A11)B00
-  STRAPRIM_MAP( A10, A11, 1, B00, NULL, 0, C10, C11, 1, -1 )
+  STRAPRIM_MAP( A_0, amap_1, A_1, amap_1, 1, B_0, bmap_0, NULL, NULL, 0, C10, C11, 1, -1 )
   // M3: C01 = 1*C01+1*A00(B01-B11); C11 = 1*C11+1*A00(B01-B11)
-  STRAPRIM_MAP( A00, NULL, 0, B01, B11, -1, C01, C11, 1, 1 )
+  STRAPRIM_MAP( A_0, amap_0, NULL, NULL, 0, B_0, bmap_1, B_1, bmap_1, -1, C01, C11, 1, 1 )
   // M4: C00 = 1*C00+1*A11(B10-B00); C10 = 1*C10+1*A11(B10-B00)
-  STRAPRIM_MAP( A11, NULL, 0, B10, B00, -1, C00, C10, 1, 1 )
+  STRAPRIM_MAP( A_1, amap_1, NULL, NULL, 0, B_1, bmap_0, B_0, bmap_0, -1, C00, C10, 1, 1 )
   // M5: C00 = 1*C00-1*(A00+A01)B11; C01 = 1*C01+1*(A00+A01)B11
-  STRAPRIM_MAP( A00, A01, 1, B11, NULL, 0, C00, C01, -1, 1 )
+  STRAPRIM_MAP( A_0, amap_0, A_1, amap_0, 1, B_1, bmap_1, NULL, NULL, 0, C00, C01, -1, 1 )
   // M6: C11 = 1*C11+(A10-A00)(B00+B01)
-  STRAPRIM_MAP( A10, A00, -1, B00, B01, 1, C11, NULL, 1, 0 )
+  STRAPRIM_MAP( A_0, amap_1, A_0, amap_0, -1, B_0, bmap_0, B_0, bmap_1, 1, C11, NULL, 1, 0 )
   // M7: C00 = 1*C00+(A01-A11)(B10+B11)
-  STRAPRIM_MAP( A01, A11, -1, B10, B11, 1, C00, NULL, 1, 0 )
-
-  if ( omp_get_thread_num() == 0 ) { //Chief thread
-    hmlp_dynamic_peeling( transA, transB, m, n, k, A, lda, B, ldb, C, ldc, 2, 2, 2 );
-  }
-
+  STRAPRIM_MAP( A_1, amap_0, A_1, amap_1, -1, B_1, bmap_0, B_1, bmap_1, 1, C00, NULL, 1, 0 )
+
+  /** Wait for all blocks of C before peeling the edges. */
+  thread.my_comm->Barrier();
+  hmlp_dynamic_peeling
+  (
+    thread, transA, transB, m, n, k,
+    A, lda, amap, B, ldb, bmap, C, ldc, 2, 2, 2
+  );
+  thread.my_comm->Barrier();
 }
 
 template<
@@ -1221,9 +1269,12 @@ void strassen_internal
 
   //printf( "before dynamic peeling\n" );
 
-  if ( omp_get_thread_num() == 0 ) { //Chief thread
+  /** Wait for all blocks of C before peeling the edges. */
+  thread.my_comm->Barrier();
+  if ( thread.tid == 0 ) { //Chief thread
     hmlp_dynamic_peeling( transA, transB, m, n, k, A, lda, B, ldb, C, ldc, 2, 2, 2 );
   }
+  thread.my_comm->Barrier();
 
 }
 
@@ -1259,10 +1310,11 @@ void strassen
   // Early return if possible
   if ( m == 0 || n == 0 || k == 0 ) return;
 
-  // Check the environment variable.
-  jc_nt = hmlp_read_nway_from_env( "KS_JC_NT" );
-  ic_nt = hmlp_read_nway_from_env( "KS_IC_NT" );
-  jr_nt = hmlp_read_nway_from_env( "KS_JR_NT" );
+  // Loop partitioning (KS_*_NT, tuning file or autotuning)
+  tuner::Session session( sizeof(TC) == 4 ? "sstrassen" : "dstrassen", m, n, k );
+  jc_nt = session.setting.jc_nt;
+  ic_nt = session.setting.ic_nt;
+  jr_nt = session.setting.jr_nt;
 
 
   if ( jc_nt > 1 )
@@ -1271,12 +1323,15 @@ void strassen
     pack_nc = ( nc / NR ) * PACK_NR;
   }
 
+  // packing buffers and communicator are cached by the calling thread
+  Workspace workspace;
+
   // allocate packing memory
-  packA_buff  = hmlp_malloc<ALIGN_SIZE, TA>( KC, ( PACK_MC + 1 ) * jc_nt * ic_nt,         sizeof(TA) );
-  packB_buff  = hmlp_malloc<ALIGN_SIZE, TB>( KC, ( pack_nc + 1 ) * jc_nt,                 sizeof(TB) ); 
+  packA_buff  = workspace.Buffer<ALIGN_SIZE, TA>( KC, ( PACK_MC + 1 ) * jc_nt * ic_nt,         sizeof(TA) );
+  packB_buff  = workspace.Buffer<ALIGN_SIZE, TB>( KC, ( pack_nc + 1 ) * jc_nt,                 sizeof(TB) ); 
 
-  // allocate tree communicator
-  thread_communicator my_comm( jc_nt, pc_nt, ic_nt, jr_nt );
+  // reuse the tree communicator
+  thread_communicator &my_comm = workspace.Communicator( jc_nt, pc_nt, ic_nt, jr_nt );
 
   #pragma omp parallel num_threads( my_comm.GetNumThreads() ) 
   {
@@ -54,6 +54,7 @@
 /** Use HMLP containers. */
 #include <containers/VirtualMatrix.hpp>
 #include <containers/SPDMatrix.hpp>
+#include <containers/Cache.hpp>
 /** GOFMM templates. */
 #include <tree.hpp>
 #include <igofmm.hpp>
@@ -72,6 +73,8 @@ using namespace hmlp;
 #define MAX_NRHS 1024
 /** the block size we use for partitioning GEMM tasks */
 #define GEMM_NB 256
+/** the row tile of the near-field accumulation u_leaf[ 1 ] */
+#define L2L_MB 64
 
 
 //#define DEBUG_SPDASKIT 1
@@ -269,6 +272,20 @@ class Configuration
 
     size_t getMaximumDepth() const noexcept { return maximum_depth_; };
 
+    hmlpError_t setMaximumDepth( size_t maximum_depth ) noexcept 
+    {
+      /* Check if arguments are valid. */
+      if ( maximum_depth > MortonHelper::MaxDepth() ) 
+      {
+        fprintf( stderr, "[ERROR] maximum depth must be <= %lu\n", MortonHelper::MaxDepth() );
+        return HMLP_ERROR_INVALID_VALUE;
+      }
+      /* Set the value. */
+      maximum_depth_ = maximum_depth;
+      /* Return with no error. */
+      return HMLP_ERROR_SUCCESS;
+    };
+
     hmlpError_t setLeafNodeSize( sizeType leaf_node_size ) noexcept 
     {
       /* Check if arguments are valid. */
@@ -290,6 +307,106 @@ class Configuration
 
 		size_t NeighborSize() const noexcept { return neighbor_size; };
 
+    /** 
+     *  The neighbor search stops when the fraction of neighbor lists that 
+     *  have changed in an iteration is no larger than this value.
+     */
+    hmlpError_t setNeighborConvergence( T neighbor_convergence ) noexcept
+    {
+      /* Check if arguments are valid. */
+      if ( neighbor_convergence < 0 || neighbor_convergence > 1 ) 
+      {
+        fprintf( stderr, "[ERROR] neighbor convergence must be in [0,1]\n" );
+        return HMLP_ERROR_INVALID_VALUE;
+      }
+      /* Set the value. */
+      neighbor_convergence_ = neighbor_convergence;
+      /* Return with no error. */
+      return HMLP_ERROR_SUCCESS;
+    };
+
+    T getNeighborConvergence() const noexcept { return neighbor_convergence_; };
+
+    /** The interpolative decomposition used to skeletonize each node. */
+    hmlpError_t setSkeletonizationMethod( lowrankMethod_t method ) noexcept
+    {
+      /* Check if arguments are valid. */
+      if ( method != LOWRANK_ID_GEQP4 && method != LOWRANK_ID_RANDOMIZED )
+      {
+        fprintf( stderr, "[ERROR] unknown skeletonization method\n" );
+        return HMLP_ERROR_INVALID_VALUE;
+      }
+      /* Set the value. */
+      skeletonization_method_ = method;
+      /* Return with no error. */
+      return HMLP_ERROR_SUCCESS;
+    };
+
+    lowrankMethod_t getSkeletonizationMethod() const noexcept 
+    { 
+      return skeletonization_method_; 
+    };
+
+    /** 
+     *  The maximum number of bytes used to cache NearKab and FarKab. Blocks 
+     *  that do not fit are compressed (if allowed) or recomputed on use.
+     */
+    hmlpError_t setCacheBudget( size_t cache_budget ) noexcept
+    {
+      cache_budget_ = cache_budget;
+      return HMLP_ERROR_SUCCESS;
+    };
+
+    size_t getCacheBudget() const noexcept { return cache_budget_; };
+
+    /** Whether cached blocks may be stored in single precision. */
+    hmlpError_t setCacheDowncast( bool use_cache_downcast ) noexcept
+    {
+      use_cache_downcast_ = use_cache_downcast;
+      return HMLP_ERROR_SUCCESS;
+    };
+
+    bool getCacheDowncast() const noexcept { return use_cache_downcast_; };
+
+    /** Whether cached blocks may be stored in low-rank form. */
+    hmlpError_t setCacheLowRank( bool use_cache_lowrank ) noexcept
+    {
+      use_cache_lowrank_ = use_cache_lowrank;
+      return HMLP_ERROR_SUCCESS;
+    };
+
+    bool getCacheLowRank() const noexcept { return use_cache_lowrank_; };
+
+    /** 
+     *  The relative matvec error Compress() aims for (0 to disable). If set,
+     *  Refine() tightens the nodes that contribute the most error until a
+     *  sampled estimate meets it. Tolerance() is then only the first guess.
+     */
+    hmlpError_t setTargetError( T target_error ) noexcept
+    {
+      /* Check if arguments are valid. */
+      if ( target_error < 0 ) 
+      {
+        fprintf( stderr, "[ERROR] target error must be >= 0\n" );
+        return HMLP_ERROR_INVALID_VALUE;
+      }
+      /* Set the value. */
+      target_error_ = target_error;
+      /* Return with no error. */
+      return HMLP_ERROR_SUCCESS;
+    };
+
+    T getTargetError() const noexcept { return target_error_; };
+
+    /** The maximum number of Refine() iterations. */
+    hmlpError_t setMaximumRefinements( size_t maximum_refinements ) noexcept
+    {
+      maximum_refinements_ = maximum_refinements;
+      return HMLP_ERROR_SUCCESS;
+    };
+
+    size_t getMaximumRefinements() const noexcept { return maximum_refinements_; };
+
 		size_t MaximumRank() const noexcept { return maximum_rank; };
 
 		T Tolerance() const noexcept { return tolerance; };
@@ -310,7 +427,7 @@ class Configuration
 		/** (Default) problem size. */
 		size_t problem_size = 0;
 
-    /** (Default) maximum tree depth. By defaultm we use 4 bits = 0-15 levels. */
+    /** (Default) maximum tree depth. MortonIDs encode up to MortonHelper::MaxDepth(). */
     size_t maximum_depth_ = 15;
 
 		/** (Default) maximum leaf node size. */
@@ -319,6 +436,23 @@ class Configuration
 		/** (Default) number of neighbors. */
 		size_t neighbor_size = 32;
 
+    /** (Default) stop the neighbor search only if no list has changed. */
+    T neighbor_convergence_ = 0;
+
+    /** (Default) skeletonize with GEQP4 on the whole sampled block. */
+    lowrankMethod_t skeletonization_method_ = LOWRANK_ID_GEQP4;
+
+    /** (Default) cache all NearKab and FarKab. */
+    size_t cache_budget_ = numeric_limits<size_t>::max();
+
+    /** (Default, Advanced) whether cached Kab can be compressed. */
+    bool use_cache_downcast_ = true;
+    bool use_cache_lowrank_ = true;
+
+    /** (Default) no accuracy target; use the tolerance and ranks as given. */
+    T target_error_ = 0;
+    size_t maximum_refinements_ = 4;
+
 		/** (Default) maximum off-diagonal ranks. */
 		size_t maximum_rank = 64;
 
@@ -359,6 +493,9 @@ class Setup : public tree::Setup<SPLITTER, T>,
       this->K = &K;
       this->splitter = splitter;
       this->NN = NN;
+      /* Compressed blocks (if any) keep the user tolerance. */
+      this->kab_cache = make_shared<CacheManager<T>>( config.getCacheBudget(),
+          config.getCacheDowncast(), config.getCacheLowRank(), config.Tolerance() );
       /* Return with no error. */
       return HMLP_ERROR_SUCCESS;
     };
@@ -380,6 +517,9 @@ class Setup : public tree::Setup<SPLITTER, T>,
     /** Use ULV or Sherman-Morrison-Woodbury */
     bool do_ulv_factorization = true;
 
+    /** Budget and statistics of the cached NearKab and FarKab. */
+    shared_ptr<CacheManager<T>> kab_cache;
+
   private:
 
 
@@ -413,6 +553,17 @@ class NodeData : public Factor<T>
     /** s-by-2s, interpolative coefficients. */
     Data<T> proj;
 
+    /** 
+     *  Estimated error of the ID in the units of Tolerance() (the first 
+     *  discarded pivot, scaled back like the tolerance of the node).
+     */
+    T error_estimate = 0;
+
+    /** Per node Tolerance(), MaximumRank() and row samples set by Refine(); 0 means the default. */
+    T tolerance = 0;
+    size_t maximum_rank = 0;
+    size_t row_samples = 0;
+
     /** Sampling neighbors gids. */
     map<size_t, T> snids; 
 
@@ -429,7 +580,8 @@ class NodeData : public Factor<T>
 
     /** (Buffer) permuted weights and potentials. */
     Data<T> w_leaf;
-    Data<T> u_leaf[ 20 ];
+    /** u_leaf[ 0 ] gets the far field; L2L tasks accumulate to u_leaf[ 1 ]. */
+    Data<T> u_leaf[ 2 ];
 
     /** Hierarchical tree view of w<RIDS, STAR> and u<RIDS, STAR>. */
     View<T> w_view;
@@ -437,8 +589,16 @@ class NodeData : public Factor<T>
 
     /** Cached Kab */
     Data<size_t> Nearbmap;
-    Data<T> NearKab;
-    Data<T> FarKab;
+    CachedBlock<T> NearKab;
+    CachedBlock<T> FarKab;
+
+    /**
+     *  Dependency handles of the near and far interaction lists. Compress()
+     *  orders the tasks that build and cache the lists on these instead of
+     *  the node, so they do not wait for the skeletonization of the node.
+     */
+    ReadWrite near_lists;
+    ReadWrite far_lists;
 
 
     /** recorded events (for HMLP Runtime) */
@@ -488,7 +648,7 @@ class TreeViewTask : public Task
     {
       arg = user_arg;
       name = string( "TreeView" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       cost = 1.0;
     };
 
@@ -702,7 +862,7 @@ struct centersplit
     vector<size_t> Q( 1, gids[ idf2f ] );
 
     /** Compute all pairwise distances. */
-    auto DIQ = K.Distances( this->metric, gids, P );
+    auto DIQ = K.Distances( this->metric, gids, Q );
 
     for ( size_t i = 0; i < temp.size(); i ++ )
       temp[ i ] = DIP[ i ] - DIQ[ i ];
@@ -785,23 +945,12 @@ hmlpError_t FindNeighbors( NODE *node, DistanceMetric metric )
   auto & I = node->gids;
   /** Number of neighbors to search for. */
   size_t kappa = NN.row();
-  /** Initial value for the neighbor select. */
-  pair<T, size_t> init( numeric_limits<T>::max(), NN.col() );
-  Data<pair<T, size_t>> candidates;
-  /** k-nearest neighbor search kernel. */
-  RETURN_IF_ERROR( K.NeighborSearch( metric, kappa, I, I, candidates, init ) );
-  /** Merge and update neighbors. */
-	#pragma omp parallel
-  {
-    vector<pair<T, size_t> > aux( 2 * kappa );
-    #pragma omp for
-    for ( size_t j = 0; j < I.size(); j ++ )
-    {
-      MergeNeighbors( kappa, NN.columndata( I[ j ] ), 
-          candidates.columndata( j ), aux );
-    }
-  }
-  return HMLP_ERROR_SUCCESS;
+  /** Neighbor lists of all queries in this node. */
+  vector<pair<T, size_t>*> lists( I.size() );
+  for ( size_t j = 0; j < I.size(); j ++ ) lists[ j ] = NN.columndata( I[ j ] );
+  /** Fused k-nearest neighbor search and merge kernel. */
+  size_t n_updated = 0;
+  return K.NeighborSearchMerge( metric, kappa, I, I, lists, n_updated );
 }; /* end FindNeighbors() */
 
 
@@ -822,7 +971,7 @@ class NeighborsTask : public Task
     {
       arg = user_arg;
       name = string( "Neighbors" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       /** Use the same distance as the tree. */
       metric = arg->setup->MetricType();
 
@@ -839,8 +988,8 @@ class NeighborsTask : public Task
       mops += flops;
       event.Set( name + label, flops, mops );
       //--------------------------------------
-			
-      // TODO: Need an accurate cost model.
+
+      /** Default cost; a calibrated model overrides it at submission. */
       cost = mops / 1E+9;
     };
 
@@ -865,14 +1014,15 @@ Data<pair<T, size_t>> SparsePattern( size_t n, size_t k, CSCMATRIX &K )
   printf( "SparsePattern k %lu n %lu, NN.row %lu NN.col %lu ...", 
       k, n, NN.row(), NN.col() ); fflush( stdout );
 
-  #pragma omp parallel for schedule( dynamic )
+  #pragma omp parallel for schedule( dynamic, 64 )
   for ( size_t j = 0; j < n; j ++ )
   {
-    std::set<size_t> NNset;
     size_t nnz = K.ColPtr( j + 1 ) - K.ColPtr( j );
     if ( DOAPPROXIMATE && nnz > 2 * k ) nnz = 2 * k;
 
-    //printf( "j %lu nnz %lu\n", j, nnz );
+    /** Rows already picked (sorted later) for membership tests. */
+    vector<size_t> picked;
+    if ( nnz < k ) picked.reserve( k );
 
     for ( size_t i = 0; i < nnz; i ++ )
     {
@@ -883,10 +1033,10 @@ Data<pair<T, size_t>> SparsePattern( size_t n, size_t k, CSCMATRIX &K )
       if ( val ) val = 1.0 / std::abs( val );
       else       val = std::numeric_limits<T>::max() - 1.0;
 
-      NNset.insert( row_ind );
       std::pair<T, std::size_t> query( val, row_ind );
       if ( nnz < k ) // not enough candidates
       {
+        picked.push_back( row_ind );
         NN[ j * k + i  ] = query;
       }
       else
@@ -895,16 +1045,24 @@ Data<pair<T, size_t>> SparsePattern( size_t n, size_t k, CSCMATRIX &K )
       }
     }
 
-    while ( nnz < k )
+    /** Fill up with random rows; each column has its own (reproducible) generator. */
+    if ( nnz < k )
     {
-      std::size_t row_ind = rand() % n;
-      if ( !NNset.count( row_ind ) )
+      sort( picked.begin(), picked.end() );
+      mt19937 generator( j );
+      uniform_int_distribution<size_t> distribution( 0, n - 1 );
+      while ( nnz < std::min( k, n ) )
       {
-        T val = std::numeric_limits<T>::max() - 1.0;
-        std::pair<T, std::size_t> query( val, row_ind );
-        NNset.insert( row_ind );
-        NN[ j * k + nnz ] = query;
-        nnz ++;
+        size_t row_ind = distribution( generator );
+        auto it = lower_bound( picked.begin(), picked.end(), row_ind );
+        if ( it == picked.end() || *it != row_ind )
+        {
+          T val = std::numeric_limits<T>::max() - 1.0;
+          std::pair<T, std::size_t> query( val, row_ind );
+          picked.insert( it, row_ind );
+          NN[ j * k + nnz ] = query;
+          nnz ++;
+        }
       }
     }
   }
@@ -1029,7 +1187,7 @@ class InterpolateTask : public Task
     {
       arg = user_arg;
       name = string( "it" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       // Need an accurate cost model.
       cost = 1.0;
     };
@@ -1224,6 +1382,9 @@ void SkeletonKIJ( NODE *node )
     nsamples = 2 * node->setup->getLeafNodeSize();
   }
 
+  /** Refine() may ask for more. */
+  nsamples = std::max( nsamples, node->data.row_samples );
+
   /** Sample off-diagonal rows. */
   RowSamples<NNPRUNE>( node, nsamples );
   
@@ -1254,7 +1415,7 @@ class SkeletonKIJTask : public Task
     {
       arg = user_arg;
       name = string( "par-gskm" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       /** we don't know the exact cost here */
       cost = 5.0;
       /** high priority */
@@ -1276,12 +1437,12 @@ void Skeletonize( NODE *node )
   using T = typename NODE::T;
   /** Gather shared data and create reference. */
   auto &K   = *(node->setup->K);
-  auto maxs = node->setup->MaximumRank();
-  auto stol = node->setup->Tolerance();
+  auto &data  = node->data;
+  auto maxs = ( data.maximum_rank ) ? data.maximum_rank : node->setup->MaximumRank();
+  auto stol = ( data.tolerance > 0 ) ? data.tolerance : node->setup->Tolerance();
   bool secure_accuracy = node->setup->SecureAccuracy();
   bool use_adaptive_ranks = node->setup->UseAdaptiveRanks();
   /** Gather per node data and create reference. */
-  auto &data  = node->data;
   auto &skels = data.skels;
   auto &proj  = data.proj;
   auto &jpvt  = data.jpvt;
@@ -1297,8 +1458,22 @@ void Skeletonize( NODE *node )
   /** TODO: check if this is needed? Account for uniform sampling. */
   if ( true ) scaled_stol *= std::sqrt( (T)q / N );
   /** Call adaptive interpolative decomposition primitive. */
-  lowrank::id( use_adaptive_ranks, secure_accuracy,
-    KIJ.row(), KIJ.col(), maxs, scaled_stol, KIJ, skels, proj, jpvt );
+  T residual = 0;
+  switch ( node->setup->getSkeletonizationMethod() )
+  {
+    case LOWRANK_ID_RANDOMIZED:
+    {
+      lowrank::rid( use_adaptive_ranks, secure_accuracy,
+        KIJ.row(), KIJ.col(), maxs, scaled_stol, KIJ, skels, proj, jpvt, 64, &residual, node->morton );
+      break;
+    }
+    default:
+    {
+      lowrank::id( use_adaptive_ranks, secure_accuracy,
+        KIJ.row(), KIJ.col(), maxs, scaled_stol, KIJ, skels, proj, jpvt, &residual );
+    }
+  }
+  data.error_estimate = ( scaled_stol > 0 ) ? residual * stol / scaled_stol : 0;
   /** Free KIJ for spaces. */
   KIJ.clear();
   /** Relabel skeletions with the real gids. */
@@ -1325,7 +1500,7 @@ class SkeletonizeTask : public Task
     {
       arg = user_arg;
       name = string( "sk" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       /** we don't know the exact cost here */
       cost = 5.0;
       /** high priority */
@@ -1341,9 +1516,19 @@ class SkeletonizeTask : public Task
       size_t m = 2 * n;
       size_t k = arg->data.proj.row();
 
-      /** GEQP3 */
-      flops += ( 2.0 / 3.0 ) * n * n * ( 3 * m - n );
-      mops += ( 2.0 / 3.0 ) * n * n * ( 3 * m - n );
+      if ( arg->setup->getSkeletonizationMethod() == LOWRANK_ID_RANDOMIZED )
+      {
+        /** Sketch (about k + 10 rows) and GEQP3 on the sketch. */
+        size_t l = std::min( k + 10, n );
+        flops += 2.0 * l * m * n + ( 2.0 / 3.0 ) * l * l * ( 3 * n - l );
+        mops  += 2.0 * ( m * n + l * n );
+      }
+      else
+      {
+        /** GEQP3 */
+        flops += ( 2.0 / 3.0 ) * n * n * ( 3 * m - n );
+        mops += ( 2.0 / 3.0 ) * n * n * ( 3 * m - n );
+      }
 
       /* TRSM */
       flops += k * ( k - 1 ) * ( n + 1 );
@@ -1373,6 +1558,7 @@ class SkeletonizeTask : public Task
       /* Clear skels and proj. */
       data.skels.clear();
       data.proj.clear();
+      data.error_estimate = 0;
       /* If one of my children is not compreesed, so am I. */
       if ( secure_accuracy && !arg->isleaf ) 
       {
@@ -1567,7 +1753,7 @@ class UpdateWeightsTask : public Task
     {
       arg = user_arg;
       name = string( "n2s" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
 
       /** Compute flops and mops */
       double flops, mops;
@@ -1698,8 +1884,7 @@ void SkeletonsToSkeletons( NODE *node )
   size_t offset = 0;
 
 
-  /** create a base view for FarKab */
-  View<T> FarKab_v( FarKab );
+  auto &cache = *node->setup->kab_cache;
 
   /** reduce all u_skel */
   for ( auto it = FarNodes->begin(); it != FarNodes->end(); it ++ )
@@ -1710,52 +1895,24 @@ void SkeletonsToSkeletons( NODE *node )
     assert( w_skel.row() == bmap.size() );
     assert( w_skel.size() == nrhs * bmap.size() );
 
-    if ( FarKab.size() ) /** Kab is cached */
+    if ( FarKab.IsCached() ) /** Kab is cached (possibly compressed) */
     {
-      //if ( node->treelist_id > 6 )
-      if ( 1 )
-      {
-        assert( FarKab.row() == amap.size() );
-        assert( u_skel.row() * offset <= FarKab.size() );
-
-        //printf( "%8lu s2s %8lu w_skel[%lu %lu]\n", 
-        //    node->morton, (*it)->morton, w_skel.row(), w_skel.col() );
-        //fflush( stdout );
-        xgemm
-        (
-          "N", "N",
-          u_skel.row(), u_skel.col(), w_skel.row(),
-          1.0, FarKab.data() + u_skel.row() * offset, FarKab.row(),
-               w_skel.data(),          w_skel.row(),
-          1.0, u_skel.data(),          u_skel.row()
-        );
-
-      }
-      else
-      {
-        /** create views */
-        View<T> U( false, u_skel );
-        View<T> W( false, w_skel );
-        View<T> Kab;
-        assert( FarKab.col() >= W.row() + offset );
-        Kab.Set( FarKab.row(), W.row(), 0, offset, &FarKab_v );
-        gemm::xgemm<GEMM_NB>( (T)1.0, Kab, W, (T)1.0, U );
-      }
-
+      FarKab.Multiply( offset, w_skel.row(), nrhs, 
+          w_skel.data(), w_skel.row(), u_skel.data(), u_skel.row() );
+      cache.Hit();
       /** move to the next submatrix Kab */
       offset += w_skel.row();
     }
     else
     {
-      printf( "Far Kab not cached treelist_id %lu, l %lu\n\n",
-					node->treelist_id, node->l ); fflush( stdout );
-
       /** get submatrix Kad from K */
+      beg = omp_get_wtime();
       auto Kab = K( amap, bmap );
       xgemm( "N", "N", u_skel.row(), u_skel.col(), w_skel.row(),
         1.0, Kab.data(),       Kab.row(),
              w_skel.data(), w_skel.row(),
         1.0, u_skel.data(), u_skel.row() );
+      cache.Miss( omp_get_wtime() - beg );
     }
   }
 
@@ -1784,12 +1941,7 @@ class SkeletonsToSkeletonsTask : public Task
     {
       arg = user_arg;
       name = string( "s2s" );
-      {
-        //label = std::to_string( arg->treelist_id );
-        ostringstream ss;
-        ss << arg->treelist_id;
-        label = ss.str();
-      }
+      SetLabel( arg->treelist_id );
 
       /** compute flops and mops */
       double flops = 0.0, mops = 0.0;
@@ -1964,7 +2116,7 @@ class SkeletonsToNodesTask : public Task
     {
       arg = user_arg;
       name = string( "s2n" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
 
       //--------------------------------------
       double flops = 0.0, mops = 0.0;
@@ -2070,12 +2222,17 @@ class SkeletonsToNodesTask : public Task
 
 
 
-template<int SUBTASKID, bool NNPRUNE, typename NODE, typename T>
-void LeavesToLeaves( NODE *node, size_t itbeg, size_t itend )
+/**
+ *  @brief u_leaf[ 1 ] += K( amap, bmap ) * w( bmap ) for all near nodes. The
+ *         GEMMs accumulate in place while holding the tiles of u_leaf[ 1 ],
+ *         and Kab is evaluated (if not cached) before taking them.
+ */
+template<bool NNPRUNE, typename NODE, typename T>
+void LeavesToLeaves( NODE *node )
 {
   assert( node->isleaf );
 
-  double beg, u_leaf_time, before_writeback_time, after_writeback_time;
+  double beg;
 
   /** gather shared data and create reference */
   auto &K = *node->setup->K;
@@ -2085,6 +2242,7 @@ void LeavesToLeaves( NODE *node, size_t itbeg, size_t itend )
   auto &data = node->data;
   auto &amap = node->gids;
   auto &NearKab = data.NearKab;
+  auto &u_leaf = data.u_leaf[ 1 ];
 
   size_t nrhs = w.col();
 
@@ -2092,128 +2250,62 @@ void LeavesToLeaves( NODE *node, size_t itbeg, size_t itend )
   if ( NNPRUNE ) NearNodes = &node->NNNearNodes;
   else           NearNodes = &node->NearNodes;
 
-  /** TODO: I think there may be a performance bug here. 
-   *        Overall there will be 4 task
-   **/
-  auto &u_leaf = data.u_leaf[ SUBTASKID ];
-  u_leaf.resize( 0, 0 );
+  auto &cache = *node->setup->kab_cache;
 
-  /** early return if nothing to do */
-  if ( itbeg == itend ) 
-  {
-    return;
-  }
-  else
-  {
-    u_leaf.resize( gids.size(), nrhs, 0.0 );
-  }
+  size_t offset = 0;
 
-  if ( NearKab.size() ) /** Kab is cached */
+  for ( auto it = NearNodes->begin(); it != NearNodes->end(); it ++ )
   {
-    size_t itptr = 0;
-    size_t offset = 0;
-
-    for ( auto it = NearNodes->begin(); it != NearNodes->end(); it ++ )
+    auto &bmap = (*it)->gids;
+    auto &wb = (*it)->data.w_leaf;
+    /** Either use the permuted w_leaf or the view of w. */
+    View<T> W = (*it)->data.w_view;
+    const T *wb_data = wb.size() ? wb.data() : W.data();
+    size_t   wb_ld   = wb.size() ? wb.row()  : W.ld();
+
+    if ( NearKab.IsCached() ) /** Kab is cached (possibly compressed) */
     {
-      if ( itbeg <= itptr && itptr < itend )
-      {
-        //auto wb = w( bmap );
-        auto wb = (*it)->data.w_leaf;
-
-        if ( wb.size() )
-        {
-          /** Kab * wb */
-          xgemm
-          (
-            "N", "N",
-            u_leaf.row(), u_leaf.col(), wb.row(),
-            1.0, NearKab.data() + offset * NearKab.row(), NearKab.row(),
-                      wb.data(),                               wb.row(),
-            1.0,  u_leaf.data(),                           u_leaf.row()
-          );
-        }
-        else
-        {
-          View<T> W = (*it)->data.w_view;
-          xgemm
-          (
-            "N", "N",
-            u_leaf.row(), u_leaf.col(), W.row(),
-            1.0, NearKab.data() + offset * NearKab.row(), NearKab.row(),
-                       W.data(),                                 W.ld(),
-            1.0,  u_leaf.data(),                           u_leaf.row()
-          );
-        }
-      }
-      offset += (*it)->gids.size();
-      itptr ++;
+      HANDLE_ERROR( u_leaf.AcquireRegion( 0, u_leaf.row(), 0, u_leaf.col() ) );
+      NearKab.Multiply( offset, bmap.size(), nrhs, 
+          wb_data, wb_ld, u_leaf.data(), u_leaf.row() );
+      HANDLE_ERROR( u_leaf.ReleaseRegion( 0, u_leaf.row(), 0, u_leaf.col() ) );
+      cache.Hit();
     }
-  }
-  else /** TODO: make xgemm into NN instead of NT. Kab is not cached */
-  {
-    size_t itptr = 0;
-    for ( auto it = NearNodes->begin(); it != NearNodes->end(); it ++ )
+    else /** TODO: make xgemm into NN instead of NT. Kab is not cached */
     {
-      if ( itbeg <= itptr && itptr < itend )
-      {
-        auto &bmap = (*it)->gids;
-        auto wb = (*it)->data.w_leaf;
-
-        /** evaluate the submatrix */
-        auto Kab = K( amap, bmap );
-
-        if ( wb.size() )
-        {
-          /** ( Kab * wb )' = wb' * Kab' */
-          xgemm( "N", "N", u_leaf.row(), u_leaf.col(), wb.row(),
-            1.0,    Kab.data(),    Kab.row(),
-                     wb.data(),     wb.row(),
-            1.0, u_leaf.data(), u_leaf.row());
-        }
-        else
-        {
-          View<T> W = (*it)->data.w_view;
-          xgemm( "N", "N", u_leaf.row(), u_leaf.col(), W.row(),
-            1.0,    Kab.data(),    Kab.row(),
-                      W.data(),       W.ld(),
-            1.0, u_leaf.data(), u_leaf.row() );
-        }
-      }
-      itptr ++;
+      /** evaluate the submatrix */
+      beg = omp_get_wtime();
+      auto Kab = K( amap, bmap );
+      HANDLE_ERROR( u_leaf.AcquireRegion( 0, u_leaf.row(), 0, u_leaf.col() ) );
+      xgemm( "N", "N", u_leaf.row(), u_leaf.col(), bmap.size(),
+        1.0,    Kab.data(),    Kab.row(),
+         (T*)wb_data,            wb_ld,
+        1.0, u_leaf.data(), u_leaf.row() );
+      HANDLE_ERROR( u_leaf.ReleaseRegion( 0, u_leaf.row(), 0, u_leaf.col() ) );
+      cache.Miss( omp_get_wtime() - beg );
     }
+    offset += bmap.size();
   }
-  before_writeback_time = omp_get_wtime() - beg;
 
 }; /** end LeavesToLeaves() */
 
 
-template<int SUBTASKID, bool NNPRUNE, typename NODE, typename T>
+template<bool NNPRUNE, typename NODE, typename T>
 class LeavesToLeavesTask : public Task
 {
   public:
 
     NODE *arg = NULL;
 
-    size_t itbeg;
-
-	  size_t itend;
-
     void Set( NODE *user_arg )
     {
       arg = user_arg;
       name = string( "l2l" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
 
-      /** TODO: fill in flops and mops */
-      //--------------------------------------
       double flops = 0.0, mops = 0.0;
       auto &gids = arg->gids;
-      auto &data = arg->data;
-      auto &proj = data.proj;
-      auto &skels = data.skels;
       auto &w = *arg->setup->w;
-      auto &K = *arg->setup->K;
-      auto &NearKab = data.NearKab;
 
       assert( arg->isleaf );
 
@@ -2224,26 +2316,12 @@ class LeavesToLeavesTask : public Task
       if ( NNPRUNE ) NearNodes = &arg->NNNearNodes;
       else           NearNodes = &arg->NearNodes;
 
-      /** TODO: need to better decide the range [itbeg itend] */ 
-      size_t itptr = 0;
-      size_t itrange = ( NearNodes->size() + 3 ) / 4;
-      if ( itrange < 1 ) itrange = 1;
-      itbeg = ( SUBTASKID - 1 ) * itrange;
-      itend = ( SUBTASKID + 0 ) * itrange;
-      if ( itbeg > NearNodes->size() ) itbeg = NearNodes->size();
-      if ( itend > NearNodes->size() ) itend = NearNodes->size();
-      if ( SUBTASKID == 4 ) itend = NearNodes->size();
-
       for ( auto it = NearNodes->begin(); it != NearNodes->end(); it ++ )
       {
-        if ( itbeg <= itptr && itptr < itend )
-        {
-          size_t k = (*it)->gids.size();
-          flops += 2.0 * m * n * k;
-          mops += m * k;
-          mops += 2.0 * ( m * n + n * k + m * k );
-        }
-        itptr ++;
+        size_t k = (*it)->gids.size();
+        flops += 2.0 * m * n * k;
+        mops += m * k;
+        mops += 2.0 * ( m * n + n * k + m * k );
       }
 
       /** setup the event */
@@ -2255,7 +2333,7 @@ class LeavesToLeavesTask : public Task
 
     void Prefetch( Worker* user_worker )
     {
-      auto &u_leaf = arg->data.u_leaf[ SUBTASKID ];
+      auto &u_leaf = arg->data.u_leaf[ 1 ];
       __builtin_prefetch( u_leaf.data() );
     };
 
@@ -2268,17 +2346,15 @@ class LeavesToLeavesTask : public Task
     void DependencyAnalysis()
     {
       assert( arg->isleaf );
-      /** depends on nothing */
+      /** L2L only accumulates to u_leaf[ 1 ], so it commutes with other ACC. */
+      auto &u_leaf = arg->data.u_leaf[ 1 ];
+      HANDLE_ERROR( u_leaf.DependencyAnalysis( 0, u_leaf.row(), 0, u_leaf.col(), ACC, this ) );
       this->TryEnqueue();
-
-      /** impose rw dependencies on multiple copies */
-      //auto &u_leaf = arg->data.u_leaf[ SUBTASKID ];
-      //u_leaf.DependencyAnalysis( hmlp::ReadWriteType::W, this );
     };
 
     void Execute( Worker* user_worker )
     {
-      LeavesToLeaves<SUBTASKID, NNPRUNE, NODE, T>( arg, itbeg, itend );
+      LeavesToLeaves<NNPRUNE, NODE, T>( arg );
     };
 
 }; /** end class LeavesToLeaves */
@@ -2369,8 +2445,12 @@ multimap<size_t, size_t> NearNodeBallots( NODE *node )
 
 
 
+/**
+ *  @brief Build the near list of a leaf from the neighbor ballots, up to
+ *         Budget() of the n_leaves leaves of the tree.
+ */
 template<typename NODE, typename T>
-void NearSamples( NODE *node )
+void NearSamples( NODE *node, size_t n_leaves )
 {
   auto &setup = *(node->setup);
   auto &NN = *(setup.NN);
@@ -2380,7 +2460,6 @@ void NearSamples( NODE *node )
     auto &gids = node->gids;
     //double budget = setup.budget;
     double budget = setup.Budget();
-    size_t n_nodes = ( 1 << node->l );
 
     /** Add myself to the near interaction list.  */
     node->NearNodes.insert( node );
@@ -2394,7 +2473,7 @@ void NearSamples( NODE *node )
     for ( auto it = sorted_ballot.rbegin(); it != sorted_ballot.rend(); it ++ )
     {
       /** Exit if we have enough. */ 
-      if ( node->NNNearNodes.size() >= n_nodes * budget ) break;
+      if ( node->NNNearNodes.size() >= n_leaves * budget ) break;
       /** Insert */
       auto *target = (*node->morton2node)[ (*it).second ];
       node->NNNearNodeMortonIDs.insert( (*it).second );
@@ -2405,9 +2484,38 @@ void NearSamples( NODE *node )
 }; /** void NearSamples() */
 
 
+/** @brief Add a leaf to Near( target ) for each target in its own near list. */
+template<typename NODE>
+void SymmetrizeNearInteractions( NODE *node )
+{
+  if ( !node->isleaf ) return;
+  for ( auto & it : node->NNNearNodeMortonIDs )
+  {
+    auto *target = (*node->morton2node)[ it ];
+    target->NNNearNodes.insert( node );
+  }
+}; /** end SymmetrizeNearInteractions() */
 
-template<typename NODE, typename T>
-class NearSamplesTask : public Task
+
+template<typename TREE>
+void SymmetrizeNearInteractions( TREE & tree )
+{
+  int n_nodes = tree.getLevelSize( tree.getDepth() );
+  auto level_beg = tree.treelist.begin() + tree.getLevelBegin( tree.getDepth() );
+
+  for ( int node_ind = 0; node_ind < n_nodes; node_ind ++ )
+  {
+    SymmetrizeNearInteractions( *(level_beg + node_ind) );
+  }
+}; /** end SymmetrizeNearInteractions() */
+
+
+/** 
+ *  @brief Task wrapper for SymmetrizeNearInteractions( node ). The sampled
+ *         near list of the leaf must be complete when the task is submitted.
+ */
+template<typename NODE>
+class SymmetrizeNearInteractionsTask : public Task
 {
   public:
 
@@ -2416,47 +2524,29 @@ class NearSamplesTask : public Task
     void Set( NODE *user_arg )
     {
       arg = user_arg;
-      name = string( "near" );
-
-      //--------------------------------------
-      double flops = 0.0, mops = 0.0;
-
-      /** setup the event */
-      event.Set( label + name, flops, mops );
-      /** asuume computation bound */
-      cost = 1.0;
+      name = string( "sym-n" );
+      SetLabel( arg->treelist_id );
       /** low priority */
-      priority = true;
-    }
-
-    void DependencyAnalysis() { this->TryEnqueue(); };
+      cost = 1.0;
+    };
 
-    void Execute( Worker* user_worker )
+    /** 
+     *  Only update the near lists of the leaves sampled by this leaf. Use
+     *  RW, since W does not order two insertions into the same list.
+     */
+    void DependencyAnalysis()
     {
-      NearSamples<NODE, T>( arg );
+      for ( auto & it : arg->NNNearNodeMortonIDs )
+      {
+        auto *target = (*arg->morton2node)[ it ];
+        target->data.near_lists.DependencyAnalysis( RW, this );
+      }
+      this->TryEnqueue();
     };
 
-}; /** end class NearSamplesTask */
-
-
-template<typename TREE>
-void SymmetrizeNearInteractions( TREE & tree )
-{
-  int n_nodes = 1 << tree.getDepth();
-  auto level_beg = tree.treelist.begin() + n_nodes - 1;
+    void Execute( Worker* user_worker ) { SymmetrizeNearInteractions( arg ); };
 
-  for ( int node_ind = 0; node_ind < n_nodes; node_ind ++ )
-  {
-    auto *node = *(level_beg + node_ind);
-    auto & NearMortonIDs = node->NNNearNodeMortonIDs;
-    for ( auto & it : NearMortonIDs )
-    {
-      auto *target = tree.morton2node[ it ];
-      target->NNNearNodes.insert( node );
-      target->NNNearNodeMortonIDs.insert( it );
-    }
-  }
-}; /** end SymmetrizeNearInteractions() */
+}; /** end class SymmetrizeNearInteractionsTask */
 
 
 /** @brief Task wrapper for CacheNearNodes(). */
@@ -2471,7 +2561,7 @@ class CacheNearNodesTask : public Task
     {
       arg = user_arg;
       name = string( "c-n" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       /** asuume computation bound */
       cost = 1.0;
     };
@@ -2495,7 +2585,12 @@ class CacheNearNodesTask : public Task
       event.Set( label + name, flops, mops );
     };
 
-    void DependencyAnalysis() { arg->DependOnNoOne( this ); };
+    /** Only wait for the near lists, not for the skeletonization. */
+    void DependencyAnalysis()
+    {
+      arg->data.near_lists.DependencyAnalysis( R, this );
+      this->TryEnqueue();
+    };
 
     void Execute( Worker* user_worker )
     {
@@ -2512,7 +2607,10 @@ class CacheNearNodesTask : public Task
       {
         bmap.insert( bmap.end(), (*it)->gids.begin(), (*it)->gids.end() );
       }
+      /** Admit NearKab with the time it takes to recompute. */
+      double beg = omp_get_wtime();
       data.NearKab = K( amap, bmap );
+      node->setup->kab_cache->Admit( data.NearKab, omp_get_wtime() - beg );
 
       /** */
       data.Nearbmap.resize( bmap.size(), 1 );
@@ -2634,110 +2732,201 @@ hmlpError_t FindFarNodes( NODE *node, NODE *target )
 
 
 /**
- *  @brief (FMM specific) perform an bottom-up traversal to build 
- *         Far( node ) for each node. Leaf nodes call
- *         FindFarNodes(), and inner nodes will merge two Far lists
- *         from lchild and rchild.
- *
- *  @TODO  change to task.
- *
+ *  @brief (FMM specific) build Far( node ). Leaf nodes call FindFarNodes(),
+ *         and inner nodes merge the Far lists of lchild and rchild, which
+ *         must have been built.
  */
-template<typename TREE>
-void MergeFarNodes( TREE &tree )
+template<typename NODE>
+void MergeFarNodes( NODE *node )
 {
-  for ( int l = tree.getDepth(); l >= 0; l -- )
-  {
-    size_t n_nodes = ( 1 << l );
-    auto level_beg = tree.treelist.begin() + n_nodes - 1;
+  /** if I don't have any skeleton, then I'm nobody's far field */
+  if ( !node->data.is_compressed ) return;
 
-    for ( int node_ind = 0; node_ind < n_nodes; node_ind ++ )
+  if ( node->isleaf )
+  {
+    /** Walk up to the root. */
+    auto *root = node;
+    while ( root->parent ) root = root->parent;
+    FindFarNodes( root, node );
+  }
+  else
+  {
+    /** merge Far( lchild ) and Far( rchild ) from children */
+    auto *lchild = node->lchild;
+    auto *rchild = node->rchild;
+
+    /** case: !NNPRUNE (HSS specific) */ 
+    auto &pFarNodes =   node->FarNodes;
+    auto &lFarNodes = lchild->FarNodes;
+    auto &rFarNodes = rchild->FarNodes;
+    /** Far( parent ) = Far( lchild ) intersects Far( rchild ) */
+    for ( auto it = lFarNodes.begin(); it != lFarNodes.end(); ++ it )
     {
-      auto *node = *(level_beg + node_ind);
-
-      /** if I don't have any skeleton, then I'm nobody's far field */
-      if ( !node->data.is_compressed ) continue;
+      if ( rFarNodes.count( *it ) ) pFarNodes.insert( *it );
+    }
+    /** Far( lchild ) \= Far( parent ); Far( rchild ) \= Far( parent ) */
+    for ( auto it = pFarNodes.begin(); it != pFarNodes.end(); it ++ )
+    {
+      lFarNodes.erase( *it ); rFarNodes.erase( *it );
+    }
 
-      if ( node->isleaf )
-      {
-        FindFarNodes( tree.treelist[ 0 ] /** root */, node );
-      }
-      else
-      {
-        /** merge Far( lchild ) and Far( rchild ) from children */
-        auto *lchild = node->lchild;
-        auto *rchild = node->rchild;
 
-        /** case: !NNPRUNE (HSS specific) */ 
-        auto &pFarNodes =   node->FarNodes;
-        auto &lFarNodes = lchild->FarNodes;
-        auto &rFarNodes = rchild->FarNodes;
-        /** Far( parent ) = Far( lchild ) intersects Far( rchild ) */
-        for ( auto it = lFarNodes.begin(); it != lFarNodes.end(); ++ it )
-        {
-          if ( rFarNodes.count( *it ) ) pFarNodes.insert( *it );
-        }
-        /** Far( lchild ) \= Far( parent ); Far( rchild ) \= Far( parent ) */
-        for ( auto it = pFarNodes.begin(); it != pFarNodes.end(); it ++ )
-        {
-          lFarNodes.erase( *it ); rFarNodes.erase( *it );
-        }
+    /** case: NNPRUNE (FMM specific) */ 
+    auto &pNNFarNodes =   node->NNFarNodes;
+    auto &lNNFarNodes = lchild->NNFarNodes;
+    auto &rNNFarNodes = rchild->NNFarNodes;
 
+    //printf( "node %lu\n", node->treelist_id );
+    //PrintSet( pNNFarNodes );
+    //PrintSet( lNNFarNodes );
+    //PrintSet( rNNFarNodes );
 
-        /** case: NNPRUNE (FMM specific) */ 
-        auto &pNNFarNodes =   node->NNFarNodes;
-        auto &lNNFarNodes = lchild->NNFarNodes;
-        auto &rNNFarNodes = rchild->NNFarNodes;
 
-        //printf( "node %lu\n", node->treelist_id );
-        //PrintSet( pNNFarNodes );
-        //PrintSet( lNNFarNodes );
-        //PrintSet( rNNFarNodes );
+    /** Far( parent ) = Far( lchild ) intersects Far( rchild ) */
+    for ( auto it = lNNFarNodes.begin(); it != lNNFarNodes.end(); ++ it )
+    {
+      if ( rNNFarNodes.count( *it ) ) pNNFarNodes.insert( *it );
+    }
+    /** Far( lchild ) \= Far( parent ); Far( rchild ) \= Far( parent ) */
+    for ( auto it = pNNFarNodes.begin(); it != pNNFarNodes.end(); it ++ )
+    {
+      lNNFarNodes.erase( *it ); 
+      rNNFarNodes.erase( *it );
+    }
 
+    //PrintSet( pNNFarNodes );
+    //PrintSet( lNNFarNodes );
+    //PrintSet( rNNFarNodes );
+  }
+}; /** end MergeFarNodes() */
 
-        /** Far( parent ) = Far( lchild ) intersects Far( rchild ) */
-        for ( auto it = lNNFarNodes.begin(); it != lNNFarNodes.end(); ++ it )
-        {
-          if ( rNNFarNodes.count( *it ) ) pNNFarNodes.insert( *it );
-        }
-        /** Far( lchild ) \= Far( parent ); Far( rchild ) \= Far( parent ) */
-        for ( auto it = pNNFarNodes.begin(); it != pNNFarNodes.end(); it ++ )
-        {
-          lNNFarNodes.erase( *it ); 
-          rNNFarNodes.erase( *it );
-        }
 
-        //PrintSet( pNNFarNodes );
-        //PrintSet( lNNFarNodes );
-        //PrintSet( rNNFarNodes );
-      }
-    }
-  }
+/** @brief Task wrapper for MergeFarNodes( node ). */
+template<typename NODE>
+class MergeFarNodesTask : public Task
+{
+  public:
 
-  if ( tree.setup.IsSymmetric() )
-  {
-    /** symmetrinize FarNodes to FarNodes interaction */
-    for ( int l = tree.getDepth(); l >= 0; l -- )
+    NODE *arg = NULL;
+
+    void Set( NODE *user_arg )
     {
-      std::size_t n_nodes = 1 << l;
-      auto level_beg = tree.treelist.begin() + n_nodes - 1;
+      arg = user_arg;
+      name = string( "merge" );
+      SetLabel( arg->treelist_id );
+      /** we don't know the exact cost here */
+      cost = 1.0;
+      /** high priority */
+      priority = true;
+    };
 
-      for ( int node_ind = 0; node_ind < n_nodes; node_ind ++ )
+    /**
+     *  Leaves read the root (is_compressed of all nodes is final once the
+     *  root is skeletonized) and their near lists. Inner nodes write to the
+     *  far lists of their children.
+     */
+    void DependencyAnalysis()
+    {
+      if ( arg->isleaf )
       {
-        auto *node = *(level_beg + node_ind);
-        auto &pFarNodes = node->NNFarNodes;
-        for ( auto it = pFarNodes.begin(); it != pFarNodes.end(); it ++ )
-        {
-          (*it)->NNFarNodes.insert( node );
-        }
+        auto *root = arg;
+        while ( root->parent ) root = root->parent;
+        root->DependencyAnalysis( R, this );
+        arg->data.near_lists.DependencyAnalysis( R, this );
+      }
+      else
+      {
+        arg->lchild->data.far_lists.DependencyAnalysis( RW, this );
+        arg->rchild->data.far_lists.DependencyAnalysis( RW, this );
+      }
+      arg->data.far_lists.DependencyAnalysis( RW, this );
+      this->TryEnqueue();
+    };
+
+    void Execute( Worker* user_worker ) { MergeFarNodes( arg ); };
+
+}; /** end class MergeFarNodesTask */
+
+
+/** @brief Add the missing far interactions to make NNFarNodes symmetric. */
+template<typename TREE>
+void SymmetrizeFarInteractions( TREE &tree )
+{
+  if ( !tree.setup.IsSymmetric() ) return;
+  /** symmetrinize FarNodes to FarNodes interaction */
+  for ( int l = tree.getDepth(); l >= 0; l -- )
+  {
+    std::size_t n_nodes = tree.getLevelSize( l );
+    auto level_beg = tree.treelist.begin() + tree.getLevelBegin( l );
+
+    for ( int node_ind = 0; node_ind < n_nodes; node_ind ++ )
+    {
+      auto *node = *(level_beg + node_ind);
+      auto &pFarNodes = node->NNFarNodes;
+      for ( auto it = pFarNodes.begin(); it != pFarNodes.end(); it ++ )
+      {
+        (*it)->NNFarNodes.insert( node );
       }
     }
   }
+}; /** end SymmetrizeFarInteractions() */
+
+
+/** @brief Task wrapper for SymmetrizeFarInteractions(). */
+template<typename TREE>
+class SymmetrizeFarInteractionsTask : public Task
+{
+  public:
+
+    TREE *arg = NULL;
+
+    void Set( TREE *user_arg )
+    {
+      arg = user_arg;
+      name = string( "sym-f" );
+      cost = 1.0;
+    };
+
+    /** Read and write the far lists of all nodes. */
+    void DependencyAnalysis()
+    {
+      for ( auto *node : arg->treelist ) 
+        node->data.far_lists.DependencyAnalysis( RW, this );
+      this->TryEnqueue();
+    };
+
+    void Execute( Worker* user_worker ) { SymmetrizeFarInteractions( *arg ); };
+
+}; /** end class SymmetrizeFarInteractionsTask */
+
+
+/**
+ *  @brief (FMM specific) perform an bottom-up traversal to build 
+ *         Far( node ) for each node. Leaf nodes call
+ *         FindFarNodes(), and inner nodes will merge two Far lists
+ *         from lchild and rchild.
+ */
+template<typename TREE>
+void MergeFarNodes( TREE &tree )
+{
+  for ( int l = tree.getDepth(); l >= 0; l -- )
+  {
+    size_t n_nodes = tree.getLevelSize( l );
+    auto level_beg = tree.treelist.begin() + tree.getLevelBegin( l );
+
+    for ( int node_ind = 0; node_ind < n_nodes; node_ind ++ )
+    {
+      MergeFarNodes( *(level_beg + node_ind) );
+    }
+  }
+
+  SymmetrizeFarInteractions( tree );
   
 #ifdef DEBUG_SPDASKIT
   for ( int l = tree.getDepth(); l >= 0; l -- )
   {
-    std::size_t n_nodes = 1 << l;
-    auto level_beg = tree.treelist.begin() + n_nodes - 1;
+    std::size_t n_nodes = tree.getLevelSize( l );
+    auto level_beg = tree.treelist.begin() + tree.getLevelBegin( l );
 
     for ( int node_ind = 0; node_ind < n_nodes; node_ind ++ )
     {
@@ -2769,6 +2958,57 @@ void MergeFarNodes( TREE &tree )
 };
 
 
+/** @brief Evaluate and cache the Far( node ) submatrix Kab of one node. */
+template<bool NNPRUNE, typename NODE>
+void CacheFarKab( NODE *node )
+{
+  auto *FarNodes = &node->FarNodes;
+  if ( NNPRUNE ) FarNodes = &node->NNFarNodes;
+  auto &K = *node->setup->K;
+  auto &data = node->data;
+  auto &amap = data.skels;
+  std::vector<size_t> bmap;
+  for ( auto it = FarNodes->begin(); it != FarNodes->end(); it ++ )
+  {
+    bmap.insert( bmap.end(), (*it)->data.skels.begin(), 
+                             (*it)->data.skels.end() );
+  }
+  /** Admit FarKab with the time it takes to recompute. */
+  double beg = omp_get_wtime();
+  data.FarKab = K( amap, bmap );
+  node->setup->kab_cache->Admit( data.FarKab, omp_get_wtime() - beg );
+}; /** end CacheFarKab() */
+
+
+/** @brief Task wrapper for CacheFarKab(). */
+template<bool NNPRUNE, typename NODE>
+class CacheFarNodesTask : public Task
+{
+  public:
+
+    NODE *arg = NULL;
+
+    void Set( NODE *user_arg )
+    {
+      arg = user_arg;
+      name = string( "c-f" );
+      SetLabel( arg->treelist_id );
+      /** asuume computation bound */
+      cost = 1.0;
+    };
+
+    /** The far lists are final, and so are the skeletons they refer to. */
+    void DependencyAnalysis()
+    {
+      arg->data.far_lists.DependencyAnalysis( R, this );
+      this->TryEnqueue();
+    };
+
+    void Execute( Worker* user_worker ) { CacheFarKab<NNPRUNE>( arg ); };
+
+}; /** end class CacheFarNodesTask */
+
+
 /**
  *  @brief Evaluate and store all submatrices Kba used in the Far 
  *         interaction.
@@ -2780,7 +3020,7 @@ template<bool NNPRUNE, bool CACHE = true, typename TREE>
 void CacheFarNodes( TREE &tree )
 {
   /** reserve space for w_leaf and u_leaf */
-  #pragma omp parallel for schedule( dynamic )
+  #pragma omp parallel for num_threads( hmlp_get_num_workers() ) schedule( dynamic )
   for ( size_t i = 0; i < tree.treelist.size(); i ++ )
   {
     auto *node = tree.treelist[ i ];
@@ -2795,49 +3035,42 @@ void CacheFarNodes( TREE &tree )
   if ( CACHE )
   {
     /** cache FarKab */
-    #pragma omp parallel for schedule( dynamic )
+    #pragma omp parallel for num_threads( hmlp_get_num_workers() ) schedule( dynamic )
     for ( size_t i = 0; i < tree.treelist.size(); i ++ )
     {
-      auto *node = tree.treelist[ i ];
-      auto *FarNodes = &node->FarNodes;
-      if ( NNPRUNE ) FarNodes = &node->NNFarNodes;
-      auto &K = *node->setup->K;
-      auto &data = node->data;
-      auto &amap = data.skels;
-      std::vector<size_t> bmap;
-      for ( auto it = FarNodes->begin(); it != FarNodes->end(); it ++ )
-      {
-        bmap.insert( bmap.end(), (*it)->data.skels.begin(), 
-                                 (*it)->data.skels.end() );
-      }
-      data.FarKab = K( amap, bmap );
+      CacheFarKab<NNPRUNE>( tree.treelist[ i ] );
     }
   }
 }; /** end CacheFarNodes() */
 
 
 /**
- *  @brief 
+ *  @brief Return the fraction of K evaluated exactly (near interactions).
+ *         If draw is true, also plot the interaction matrix to
+ *         interaction.m.
  */ 
 template<bool NNPRUNE, typename TREE>
-double DrawInteraction( TREE &tree )
+double DrawInteraction( TREE &tree, bool draw = true )
 {
   double exact_ratio = 0.0;
-  FILE * pFile;
+  FILE * pFile = NULL;
   //int n;
   char name[ 100 ];
 
-  pFile = fopen ( "interaction.m", "w" );
+  if ( draw ) pFile = fopen ( "interaction.m", "w" );
 
-  fprintf( pFile, "figure('Position',[100,100,800,800]);" );
-  fprintf( pFile, "hold on;" );
-  fprintf( pFile, "axis square;" );
-  fprintf( pFile, "axis ij;" );
+  if ( pFile )
+  {
+    fprintf( pFile, "figure('Position',[100,100,800,800]);" );
+    fprintf( pFile, "hold on;" );
+    fprintf( pFile, "axis square;" );
+    fprintf( pFile, "axis ij;" );
+  }
 
   for ( int l = tree.getDepth(); l >= 0; l -- )
   {
-    std::size_t n_nodes = 1 << l;
-    auto level_beg = tree.treelist.begin() + n_nodes - 1;
+    std::size_t n_nodes = tree.getLevelSize( l );
+    auto level_beg = tree.treelist.begin() + tree.getLevelBegin( l );
 
     for ( int node_ind = 0; node_ind < n_nodes; node_ind ++ )
     {
@@ -2849,6 +3082,7 @@ double DrawInteraction( TREE &tree )
         auto &pFarNodes = node->NNFarNodes;
         for ( auto it = pFarNodes.begin(); it != pFarNodes.end(); it ++ )
         {
+          if ( !pFile ) break;
           double gb = (double)std::min( node->l, (*it)->l ) / tree.getDepth();
           //printf( "node->l %lu (*it)->l %lu depth %lu\n", node->l, (*it)->l, tree.depth );
           fprintf( pFile, "rectangle('position',[%lu %lu %lu %lu],'facecolor',[1.0,%lf,%lf]);\n",
@@ -2858,9 +3092,12 @@ double DrawInteraction( TREE &tree )
         }
         for ( auto it = pNearNodes.begin(); it != pNearNodes.end(); it ++ )
         {
-          fprintf( pFile, "rectangle('position',[%lu %lu %lu %lu],'facecolor',[0.2,0.4,1.0]);\n",
-              node->offset,      (*it)->offset,
-              node->gids.size(), (*it)->gids.size() );
+          if ( pFile )
+          {
+            fprintf( pFile, "rectangle('position',[%lu %lu %lu %lu],'facecolor',[0.2,0.4,1.0]);\n",
+                node->offset,      (*it)->offset,
+                node->gids.size(), (*it)->gids.size() );
+          }
 
           /** accumulate exact evaluation */
           exact_ratio += node->gids.size() * (*it)->gids.size();
@@ -2871,8 +3108,11 @@ double DrawInteraction( TREE &tree )
       }
     }
   }
-  fprintf( pFile, "hold off;" );
-  fclose( pFile );
+  if ( pFile )
+  {
+    fprintf( pFile, "hold off;" );
+    fclose( pFile );
+  }
 
   return exact_ratio / ( tree.n * tree.n );
 }; /** end DrawInteration() */
@@ -2995,7 +3235,182 @@ hmlpError_t Evaluate( TREE &tree, const size_t gid, Data<T> & potentials, const
 
 
 /**
- *  @brief ComputeAll
+ *  @brief Return at most n_samples gids that represent the geometry of
+ *         the node: its skeletons if any, otherwise evenly spaced gids.
+ */
+template<typename NODE>
+vector<size_t> QueryRepresentatives( NODE *node, size_t n_samples )
+{
+  auto &candidates = node->data.skels.size() ? node->data.skels : node->gids;
+  if ( candidates.size() <= n_samples ) return candidates;
+  vector<size_t> representatives( n_samples );
+  for ( size_t i = 0; i < n_samples; i ++ )
+  {
+    representatives[ i ] = candidates[ i * candidates.size() / n_samples ];
+  }
+  return representatives;
+}; /* end QueryRepresentatives() */
+
+
+/**
+ *  @brief Route queries qids top-down. Each query follows the child that
+ *         owns the closest representative, where distances( qids, reps )
+ *         returns the qids.size()-by-reps.size() distances. The queries
+ *         that reach the same leaf are grouped together.
+ */
+template<typename NODE, typename DISTANCES>
+void RouteQueries( NODE *node, const vector<size_t> &qids, DISTANCES &distances,
+    map<NODE*, vector<size_t>> &groups )
+{
+  using T = typename NODE::T;
+  if ( qids.empty() ) return;
+  if ( node->isleaf )
+  {
+    auto &group = groups[ node ];
+    group.insert( group.end(), qids.begin(), qids.end() );
+    return;
+  }
+  /* One GEMM per child gives the distances to its representatives. */
+  auto Dl = distances( qids, QueryRepresentatives( node->lchild, 32 ) );
+  auto Dr = distances( qids, QueryRepresentatives( node->rchild, 32 ) );
+  vector<size_t> lqids, rqids;
+  for ( size_t i = 0; i < qids.size(); i ++ )
+  {
+    T dl = numeric_limits<T>::max(), dr = numeric_limits<T>::max();
+    for ( size_t j = 0; j < Dl.col(); j ++ ) dl = std::min( dl, Dl( i, j ) );
+    for ( size_t j = 0; j < Dr.col(); j ++ ) dr = std::min( dr, Dr( i, j ) );
+    if ( dl <= dr ) lqids.push_back( qids[ i ] );
+    else            rqids.push_back( qids[ i ] );
+  }
+  RouteQueries( node->lchild, lqids, distances, groups );
+  RouteQueries( node->rchild, rqids, distances, groups );
+}; /* end RouteQueries() */
+
+
+/**
+ *  @brief Split the tree into the interaction lists of a leaf group. Nodes
+ *         that contain a near leaf are opened; near or uncompressed leaves
+ *         are evaluated directly and all other nodes through their skeletons.
+ */
+template<typename NODE>
+void QueryInteractions( NODE *node, const set<NODE*> &opened,
+    vector<NODE*> &direct, vector<NODE*> &far )
+{
+  if ( opened.count( node ) || !node->data.is_compressed )
+  {
+    if ( node->isleaf ) direct.push_back( node );
+    else
+    {
+      QueryInteractions( node->lchild, opened, direct, far );
+      QueryInteractions( node->rchild, opened, direct, far );
+    }
+  }
+  else far.push_back( node );
+}; /* end QueryInteractions() */
+
+
+/**
+ *  @brief Evaluate potentials( i, : ) = sum_j K( queries( :, i ), x_j ) weights( j, : )
+ *         for a batch of out-of-sample points (d-by-q) with the compressed tree.
+ *         The queries are routed to leaves and grouped; each group evaluates
+ *         its near leaves directly and the rest of the tree through w_skel,
+ *         one fused kernel block and one GEMM per interaction. w_skel must
+ *         come from Evaluate( tree, weights ); otherwise (e.g. a different
+ *         nrhs) HMLP_ERROR_INVALID_VALUE is returned. The kernel matrix
+ *         must provide OutOfSample() and OutOfSampleDistances() (e.g.
+ *         KernelMatrix).
+ */
+template<typename TREE, typename T>
+hmlpError_t EvaluateQueries( TREE &tree, const Data<T> &weights,
+    const Data<T> &queries, Data<T> &potentials )
+{
+  using NODE = typename TREE::NODE;
+  auto &K = *tree.setup.K;
+  auto *root = tree.treelist[ 0 ];
+  size_t nrhs = weights.col();
+
+  if ( weights.row() != root->gids.size() ) return HMLP_ERROR_INVALID_VALUE;
+  if ( queries.row() != K.dim() ) return HMLP_ERROR_INVALID_VALUE;
+  /* Clean up and properly initialize the output. */
+  potentials.clear();
+  potentials.resize( queries.col(), nrhs, 0.0 );
+  if ( !queries.col() ) return HMLP_ERROR_SUCCESS;
+
+  /* Route all queries to leaves and group them by leaf. */
+  vector<size_t> qids( queries.col() );
+  for ( size_t i = 0; i < qids.size(); i ++ ) qids[ i ] = i;
+  vector<size_t> all_dimensions( queries.row() ), bmap( nrhs );
+  for ( size_t i = 0; i < all_dimensions.size(); i ++ ) all_dimensions[ i ] = i;
+  for ( size_t j = 0; j < bmap.size(); j ++ ) bmap[ j ] = j;
+  auto distances = [&] ( const vector<size_t> &I, const vector<size_t> &J )
+  {
+    return K.OutOfSampleDistances( queries( all_dimensions, I ), J );
+  };
+  map<NODE*, vector<size_t>> groups;
+  RouteQueries( root, qids, distances, groups );
+  vector<pair<NODE*, vector<size_t>>> batches( groups.begin(), groups.end() );
+  /* Set if a far node has no w_skel of the given weights. */
+  bool invalid = false;
+
+  #pragma omp parallel for schedule(dynamic) reduction(||:invalid)
+  for ( size_t b = 0; b < batches.size(); b ++ )
+  {
+    auto *leaf = batches[ b ].first;
+    auto &group = batches[ b ].second;
+    /* The near leaves and all their ancestors are opened. */
+    set<NODE*> opened;
+    opened.insert( leaf );
+    for ( auto *near : leaf->NNNearNodes ) opened.insert( near );
+    for ( auto *near : set<NODE*>( opened ) )
+    {
+      for ( auto *node = near->parent; node; node = node->parent ) opened.insert( node );
+    }
+    vector<NODE*> direct, far;
+    QueryInteractions( root, opened, direct, far );
+
+    auto X = queries( all_dimensions, group );
+    Data<T> U( group.size(), nrhs, 0.0 );
+    for ( auto *node : direct )
+    {
+      auto Kab = K.OutOfSample( X, node->gids );
+      auto wb = weights( node->gids, bmap );
+      xgemm( "No transpose", "No transpose",
+        Kab.row(), wb.col(), wb.row(),
+        1.0, Kab.data(), Kab.row(),
+              wb.data(),  wb.row(),
+        1.0,   U.data(),   U.row() );
+    }
+    for ( auto *node : far )
+    {
+      auto &w_skel = node->data.w_skel;
+      if ( w_skel.row() != node->data.skels.size() || w_skel.col() != nrhs )
+      {
+        invalid = true;
+        break;
+      }
+      auto Kab = K.OutOfSample( X, node->data.skels );
+      xgemm( "No transpose", "No transpose",
+        Kab.row(), w_skel.col(), w_skel.row(),
+        1.0,    Kab.data(),    Kab.row(),
+             w_skel.data(), w_skel.row(),
+        1.0,      U.data(),      U.row() );
+    }
+    /* Every query belongs to exactly one group. */
+    for ( size_t j = 0; j < nrhs; j ++ )
+      for ( size_t i = 0; i < group.size(); i ++ )
+        potentials( group[ i ], j ) = U( i, j );
+  }
+  return invalid ? HMLP_ERROR_INVALID_VALUE : HMLP_ERROR_SUCCESS;
+}; /* end EvaluateQueries() */
+
+
+/**
+ *  @brief ComputeAll. If graph is given, the first call records the
+ *         N2S, S2S, S2N and L2L tasks in it, and the following calls replay
+ *         them with setup.w and setup.u rebound to the new weights and
+ *         potentials. The graph must be cleared after the tree changes
+ *         (e.g. Compress() or Update()). Task costs are those of the first
+ *         call, so keep nrhs fixed for the best schedule.
  */ 
 template<
   bool     USE_RUNTIME = true, 
@@ -3004,7 +3419,7 @@ template<
   bool     CACHE = true, 
   typename TREE, 
   typename T>
-Data<T> Evaluate( TREE &tree, Data<T> &weights )
+Data<T> Evaluate( TREE &tree, Data<T> &weights, TaskGraph *graph = nullptr )
 {
   const bool AUTO_DEPENDENCY = true;
 
@@ -3035,9 +3450,9 @@ Data<T> Evaluate( TREE &tree, Data<T> &weights )
     printf( "Forward permute ...\n" ); fflush( stdout );
   }
   beg = omp_get_wtime();
-  int n_nodes = ( 1 << tree.getDepth() );
-  auto level_beg = tree.treelist.begin() + n_nodes - 1;
-  #pragma omp parallel for
+  int n_nodes = tree.getLevelSize( tree.getDepth() );
+  auto level_beg = tree.treelist.begin() + tree.getLevelBegin( tree.getDepth() );
+  #pragma omp parallel for num_threads( hmlp_get_num_workers() )
   for ( int node_ind = 0; node_ind < n_nodes; node_ind ++ )
   {
     auto *node = *(level_beg + node_ind);
@@ -3058,6 +3473,12 @@ Data<T> Evaluate( TREE &tree, Data<T> &weights )
         w_leaf( i, j ) = weights( gids[ i ], j ); 
       }
     };
+
+    /** Zero the near-field accumulation; this also drops its old dependencies. */
+    auto &u_near = node->data.u_leaf[ 1 ];
+    u_near.resize( 0, 0 );
+    u_near.resize( gids.size(), nrhs, 0.0 );
+    HANDLE_ERROR( u_near.CreateRegions( L2L_MB, std::max( nrhs, (size_t)1 ) ) );
   }
   forward_permute_time = omp_get_wtime() - beg;
 
@@ -3076,19 +3497,13 @@ Data<T> Evaluate( TREE &tree, Data<T> &weights )
     using LEAFTOLEAFVER2TASK = gpu::LeavesToLeavesVer2Task<CACHE, NNPRUNE, NODE, T>;
     LEAFTOLEAFVER2TASK leaftoleafver2task;
 #endif
-    using LEAFTOLEAFTASK1 = LeavesToLeavesTask<1, NNPRUNE, NODE, T>;
-    using LEAFTOLEAFTASK2 = LeavesToLeavesTask<2, NNPRUNE, NODE, T>;
-    using LEAFTOLEAFTASK3 = LeavesToLeavesTask<3, NNPRUNE, NODE, T>;
-    using LEAFTOLEAFTASK4 = LeavesToLeavesTask<4, NNPRUNE, NODE, T>;
+    using LEAFTOLEAFTASK  = LeavesToLeavesTask<NNPRUNE, NODE, T>;
 
     using NODETOSKELTASK  = UpdateWeightsTask<NODE, T>;
     using SKELTOSKELTASK  = SkeletonsToSkeletonsTask<NNPRUNE, NODE, T>;
     using SKELTONODETASK  = SkeletonsToNodesTask<NNPRUNE, NODE, T>;
 
-    LEAFTOLEAFTASK1 leaftoleaftask1;
-    LEAFTOLEAFTASK2 leaftoleaftask2;
-    LEAFTOLEAFTASK3 leaftoleaftask3;
-    LEAFTOLEAFTASK4 leaftoleaftask4;
+    LEAFTOLEAFTASK  leaftoleaftask;
 
     NODETOSKELTASK  nodetoskeltask;
     SKELTOSKELTASK  skeltoskeltask;
@@ -3141,19 +3556,26 @@ Data<T> Evaluate( TREE &tree, Data<T> &weights )
 
 
 
-    /** CPU-GPU hybrid uses a different kind of L2L task */
+    if ( graph && !graph->IsEmpty() )
+    {
+      /** Replay the recorded DAG; no task allocation or dependency analysis. */
+      HANDLE_ERROR( graph->Replay() );
+    }
+    else
+    {
+      /** CPU-GPU hybrid uses a different kind of L2L task */
 #ifdef HMLP_USE_CUDA
-    tree.TraverseLeafs( leaftoleafver2task );
+      tree.TraverseLeafs( leaftoleafver2task );
 #else
-    tree.TraverseLeafs( leaftoleaftask1 );
-    tree.TraverseLeafs( leaftoleaftask2 );
-    tree.TraverseLeafs( leaftoleaftask3 );
-    tree.TraverseLeafs( leaftoleaftask4 );
+      tree.TraverseLeafs( leaftoleaftask );
 #endif
-    tree.TraverseUp( nodetoskeltask );
-    tree.TraverseUnOrdered( skeltoskeltask );
-    tree.TraverseDown( skeltonodetask );
-    tree.ExecuteAllTasks();
+      tree.TraverseUp( nodetoskeltask );
+      tree.TraverseUnOrdered( skeltoskeltask );
+      tree.TraverseDown( skeltonodetask );
+      if ( graph ) HANDLE_ERROR( graph->Capture() );
+      else hmlp_run();
+      tree.DependencyCleanUp();
+    }
     //if ( USE_RUNTIME ) hmlp_run();
 
 
@@ -3170,14 +3592,14 @@ Data<T> Evaluate( TREE &tree, Data<T> &weights )
 
 
     double aggregate_beg_t = omp_get_wtime();
-    /** reduce direct iteractions from 4 copies */
-    #pragma omp parallel for
+    /** reduce direct iteractions */
+    #pragma omp parallel for num_threads( hmlp_get_num_workers() )
     for ( int node_ind = 0; node_ind < n_nodes; node_ind ++ )
     {
       auto *node = *(level_beg + node_ind);
       auto &u_leaf = node->data.u_leaf[ 0 ];
-      /** reduce all u_leaf[0:4] */
-      for ( size_t p = 1; p < 20; p ++ )
+      /** add the near field u_leaf[ 1 ] */
+      for ( size_t p = 1; p < 2; p ++ )
       {
         for ( size_t i = 0; i < node->data.u_leaf[ p ].size(); i ++ )
           u_leaf[ i ] += node->data.u_leaf[ p ][ i ];
@@ -3206,7 +3628,7 @@ Data<T> Evaluate( TREE &tree, Data<T> &weights )
     printf( "Backward permute ...\n" ); fflush( stdout );
   }
   beg = omp_get_wtime();
-  #pragma omp parallel for
+  #pragma omp parallel for num_threads( hmlp_get_num_workers() )
   for ( int node_ind = 0; node_ind < n_nodes; node_ind ++ )
   {
     auto *node = *(level_beg + node_ind);
@@ -3251,6 +3673,8 @@ Data<T> Evaluate( TREE &tree, Data<T> &weights )
     printf( "========================================================\n");
     printf( "Evaluate ------------------------------ %5.2lfs (%5.1lf%%)\n", 
         evaluation_time, evaluation_time * time_ratio );
+    printf( "========================================================\n");
+    tree.setup.kab_cache->Report( "Kab" );
     printf( "========================================================\n\n");
   }
 
@@ -3298,6 +3722,11 @@ Data<pair<T, size_t>> FindNeighbors( SPDMATRIX &K, SPLITTER splitter,
 }; /** end FindNeighbors() */
 
 
+/** Refine a compressed tree until it meets the target error (see below). */
+template<typename TREE>
+hmlpError_t Refine( TREE &tree, size_t ntest = 100, size_t nrhs = 4 );
+
+
 /**
  *  @brielf template of the compress routine
  */ 
@@ -3332,7 +3761,7 @@ tree::Tree< gofmm::Setup<SPDMATRIX, SPLITTER, T>, gofmm::NodeData<T>>
     /** all timers */
     double beg, omptask45_time, omptask_time, ref_time;
     double time_ratio, compress_time = 0.0, other_time = 0.0;
-    double ann_time, tree_time, skel_time, mergefarnodes_time, cachefarnodes_time;
+    double ann_time, tree_time, skel_time, refine_time;
     double nneval_time, nonneval_time, fmm_evaluation_time, symbolic_evaluation_time;
 
     /** Iterative all nearnest-neighbor (ANN). */
@@ -3379,69 +3808,69 @@ tree::Tree< gofmm::Setup<SPDMATRIX, SPLITTER, T>, gofmm::NodeData<T>>
 
 
 
-    /** Build near interaction lists. */ 
-    NearSamplesTask<NODE, T> NEARSAMPLEStask;
-    tree.DependencyCleanUp();
-    printf( "Dependency clean up\n" ); fflush( stdout );
-    tree.TraverseLeafs( NEARSAMPLEStask );
-    tree.ExecuteAllTasks();
-    //hmlp_run();
-    printf( "Finish NearSamplesTask\n" ); fflush( stdout );
-    SymmetrizeNearInteractions( tree );
-    printf( "Finish SymmetrizeNearInteractions\n" ); fflush( stdout );
-
-
-
-    /** Skeletonization */
+    /**
+     *  Near lists, skeletonization, far lists and their Kab caches in one
+     *  epoch. Each step only waits for what it reads: the near lists are
+     *  sampled up front, so each leaf only waits for the leaves it
+     *  samples to add themselves to its near list, and neither step
+     *  waits for the skeletonization. The far lists need the root to be
+     *  skeletonized and every merge to finish before they are symmetric.
+     */
     if ( REPORT_COMPRESS_STATUS )
     {
       printf( "Skeletonization (HMLP Runtime) ...\n" ); fflush( stdout );
     }
     beg = omp_get_wtime();
+    auto level_beg = tree.treelist.begin() + tree.getLevelBegin( tree.getDepth() );
+    #pragma omp parallel for num_threads( hmlp_get_num_workers() ) schedule( dynamic )
+    for ( size_t i = 0; i < tree.getLevelSize( tree.getDepth() ); i ++ )
+    {
+      gofmm::NearSamples<NODE, T>( *(level_beg + i), tree.getLevelSize( tree.getDepth() ) );
+    }
+    gofmm::SymmetrizeNearInteractionsTask<NODE> SYMNEARtask;
     gofmm::SkeletonKIJTask<NNPRUNE, NODE, T> GETMTXtask;
     gofmm::SkeletonizeTask<NODE, T> SKELtask;
     gofmm::InterpolateTask<NODE> PROJtask;
+    gofmm::CacheNearNodesTask<NNPRUNE, NODE> KIJtask;
+    gofmm::MergeFarNodesTask<NODE> MERGEtask;
+    gofmm::SymmetrizeFarInteractionsTask<TREE> SYMFARtask;
+    gofmm::CacheFarNodesTask<NNPRUNE, NODE> FARKIJtask;
     tree.DependencyCleanUp();
+    tree.TraverseLeafs( SYMNEARtask );
     tree.TraverseUp( GETMTXtask, SKELtask );
     tree.TraverseUnOrdered( PROJtask );
-    if ( CACHE )
-    {
-      gofmm::CacheNearNodesTask<NNPRUNE, NODE> KIJtask;
-      tree.template TraverseLeafs( KIJtask );
-    }
+    if ( CACHE ) tree.TraverseLeafs( KIJtask );
+    tree.TraverseUp( MERGEtask );
+    if ( tree.DoOutOfOrder() ) RecuTaskSubmit( &tree, SYMFARtask );
+    else RecuTaskExecute( &tree, SYMFARtask );
+    if ( CACHE ) tree.TraverseUnOrdered( FARKIJtask );
     other_time += omp_get_wtime() - beg;
     hmlp_run();
-    skel_time = omp_get_wtime() - beg;
-
-
-
-
-    /** MergeFarNodes */
-    beg = omp_get_wtime();
-    if ( REPORT_COMPRESS_STATUS )
+    for ( auto *node : tree.treelist )
     {
-      printf( "MergeFarNodes ...\n" ); fflush( stdout );
+      node->data.near_lists.DependencyCleanUp();
+      node->data.far_lists.DependencyCleanUp();
     }
-    gofmm::MergeFarNodes( tree );
-    mergefarnodes_time = omp_get_wtime() - beg;
+    /** Only reserve the leaf buffers; FarKab is cached above. */
+    gofmm::CacheFarNodes<NNPRUNE, false>( tree );
+    skel_time = omp_get_wtime() - beg;
 
-    /** CacheFarNodes */
+    /** (Optional) refine until the sampled error meets the target. */
     beg = omp_get_wtime();
-    if ( REPORT_COMPRESS_STATUS )
+    if ( config.getTargetError() > 0 && gofmm::Refine( tree ) != HMLP_ERROR_SUCCESS )
     {
-      printf( "CacheFarNodes ...\n" ); fflush( stdout );
+      fprintf( stderr, "[WARNING] target error %3.1E is not met after refinement\n", 
+          (double)config.getTargetError() );
     }
-    gofmm::CacheFarNodes<NNPRUNE, CACHE>( tree );
-    cachefarnodes_time = omp_get_wtime() - beg;
+    refine_time = omp_get_wtime() - beg;
 
-    /** plot iteraction matrix */  
-    auto exact_ratio = hmlp::gofmm::DrawInteraction<true>( tree );
+    /** plot iteraction matrix (only with the report) */
+    auto exact_ratio = hmlp::gofmm::DrawInteraction<true>( tree, REPORT_COMPRESS_STATUS );
 
     compress_time += ann_time;
     compress_time += tree_time;
     compress_time += skel_time;
-    compress_time += mergefarnodes_time;
-    compress_time += cachefarnodes_time;
+    compress_time += refine_time;
     time_ratio = 100.0 / compress_time;
     if ( REPORT_COMPRESS_STATUS )
     {
@@ -3450,12 +3879,13 @@ tree::Tree< gofmm::Setup<SPDMATRIX, SPLITTER, T>, gofmm::NodeData<T>>
       printf( "========================================================\n");
       printf( "NeighborSearch ------------------------ %5.2lfs (%5.1lf%%)\n", ann_time, ann_time * time_ratio );
       printf( "TreePartitioning ---------------------- %5.2lfs (%5.1lf%%)\n", tree_time, tree_time * time_ratio );
-      printf( "Skeletonization ----------------------- %5.2lfs (%5.1lf%%)\n", skel_time, skel_time * time_ratio );
-      printf( "MergeFarNodes ------------------------- %5.2lfs (%5.1lf%%)\n", mergefarnodes_time, mergefarnodes_time * time_ratio );
-      printf( "CacheFarNodes ------------------------- %5.2lfs (%5.1lf%%)\n", cachefarnodes_time, cachefarnodes_time * time_ratio );
+      printf( "Skeletonization (near, far, cache) ---- %5.2lfs (%5.1lf%%)\n", skel_time, skel_time * time_ratio );
+      printf( "Refinement ---------------------------- %5.2lfs (%5.1lf%%)\n", refine_time, refine_time * time_ratio );
       printf( "========================================================\n");
       printf( "Compress (%4.2lf not compressed) -------- %5.2lfs (%5.1lf%%)\n", 
           exact_ratio, compress_time, compress_time * time_ratio );
+      printf( "========================================================\n");
+      tree_ptr->setup.kab_cache->Report( "Kab" );
       printf( "========================================================\n\n");
     }
 
@@ -3621,6 +4051,531 @@ tree::Tree<
 
 
 
+/** @brief Number of leaves below the node (the tree is complete). */
+template<typename TREE, typename NODE>
+size_t NumberOfLeaves( TREE &tree, NODE *node )
+{
+  return (size_t)1 << ( tree.getDepth() - node->l );
+}; /** end NumberOfLeaves() */
+
+
+/** @brief Concatenate the gids of children, as IndexPermuteTask does. */
+template<typename NODE>
+void GatherGids( NODE *node )
+{
+  if ( !node->isleaf )
+  {
+    node->gids = node->lchild->gids;
+    node->gids.insert( node->gids.end(), node->rchild->gids.begin(), node->rchild->gids.end() );
+  }
+  node->n = node->gids.size();
+}; /** end GatherGids() */
+
+
+/**
+ *  @brief Split the gids of the subtree again with the splitter (top-down),
+ *         which redistributes points of overflowing or underflowing leaves
+ *         over all leaves of the subtree. All nodes of the subtree are dirty.
+ */
+template<typename NODE>
+void Repartition( NODE *node, set<NODE*> &dirty )
+{
+  dirty.insert( node );
+  if ( node->isleaf )
+  {
+    node->n = node->gids.size();
+    for ( auto gid : node->gids ) node->setup->morton[ gid ] = node->morton;
+    return;
+  }
+  node->Split();
+  Repartition( node->lchild, dirty );
+  Repartition( node->rchild, dirty );
+  GatherGids( node );
+}; /** end Repartition() */
+
+
+/**
+ *  @brief Skeletonize dirty nodes again (bottom-up, as runtime tasks), cache
+ *         NearKab of leaves in near_changed, rebuild the far lists and cache
+ *         FarKab of nodes whose far interactions have changed. The ancestors
+ *         of dirty nodes must be dirty, and the near lists symmetric.
+ */
+template<typename TREE>
+hmlpError_t Recompress( TREE &tree, const set<typename TREE::NODE*> &dirty,
+    const set<typename TREE::NODE*> &near_changed )
+{
+  using NODE = typename TREE::NODE;
+  using T = typename TREE::T;
+  const bool NNPRUNE = true;
+  const bool CACHE = true;
+
+  auto &setup = tree.setup;
+  auto &K = *setup.K;
+
+  /* Skeletonize dirty nodes again (bottom-up) and cache their NearKab. */
+  SkeletonKIJTask<NNPRUNE, NODE, T> GETMTXtask;
+  SkeletonizeTask<NODE, T> SKELtask;
+  InterpolateTask<NODE> PROJtask;
+  CacheNearNodesTask<NNPRUNE, NODE> KIJtask;
+  tree.DependencyCleanUp();
+  vector<NODE*> order( dirty.begin(), dirty.end() );
+  stable_sort( order.begin(), order.end(), [] ( NODE *a, NODE *b ) { return a->l > b->l; } );
+  for ( auto *node : order ) RecuTaskSubmit( node, GETMTXtask, SKELtask );
+  for ( auto *node : order ) RecuTaskSubmit( node, PROJtask );
+  if ( CACHE )
+  {
+    for ( auto *leaf : near_changed )
+    {
+      setup.kab_cache->Release( leaf->data.NearKab );
+      RecuTaskSubmit( leaf, KIJtask );
+    }
+  }
+  hmlp_run();
+  tree.DependencyCleanUp();
+
+  /* Rebuild far lists (no kernel evaluation) and cache FarKab that changed. */
+  vector<set<NODE*>> old_far( tree.treelist.size() );
+  for ( size_t i = 0; i < tree.treelist.size(); i ++ )
+  {
+    auto *node = tree.treelist[ i ];
+    old_far[ i ].swap( node->NNFarNodes );
+    node->FarNodes.clear();
+  }
+  MergeFarNodes( tree );
+  #pragma omp parallel for num_threads( hmlp_get_num_workers() ) schedule( dynamic )
+  for ( size_t i = 0; i < tree.treelist.size(); i ++ )
+  {
+    auto *node = tree.treelist[ i ];
+    auto &FarNodes = node->NNFarNodes;
+    if ( node->isleaf && dirty.count( node ) )
+    {
+      node->data.w_leaf.reserve( node->gids.size(), MAX_NRHS );
+      node->data.u_leaf[ 0 ].reserve( MAX_NRHS, node->gids.size() );
+    }
+    if ( !CACHE ) continue;
+    bool is_changed = dirty.count( node ) || FarNodes != old_far[ i ];
+    for ( auto *it : FarNodes ) is_changed = is_changed || dirty.count( it );
+    if ( !is_changed ) continue;
+    vector<size_t> bmap;
+    for ( auto *it : FarNodes )
+    {
+      bmap.insert( bmap.end(), it->data.skels.begin(), it->data.skels.end() );
+    }
+    setup.kab_cache->Release( node->data.FarKab );
+    /** Admit FarKab with the time it takes to recompute. */
+    double beg = omp_get_wtime();
+    node->data.FarKab = K( node->data.skels, bmap );
+    setup.kab_cache->Admit( node->data.FarKab, omp_get_wtime() - beg );
+  }
+
+
+  /* Return with no error. */
+  return HMLP_ERROR_SUCCESS;
+}; /** end Recompress() */
+
+
+/**
+ *  @brief Insert gids into (and remove gids from) a compressed tree without
+ *         recompressing it.
+ *
+ *         Inserted gids must already be in K (e.g. append coordinates and
+ *         call K.resize()); removed gids stay in K but leave the tree (and
+ *         the neighbor lists of other gids), so their potentials are zero
+ *         and their weights are ignored. Inserted gids are routed to leaves
+ *         like EvaluateQueries() and get neighbors from the near leaves
+ *         (setup.NN grows to K.col() columns). A leaf that overflows
+ *         2 * leaf_node_size or underflows leaf_node_size / 4 is split
+ *         again together with its smallest ancestor whose leaves can hold
+ *         all its points. Only changed leaves, repartitioned subtrees and
+ *         their ancestors are skeletonized again (as runtime tasks); near
+ *         lists are patched around changed leaves, far lists are rebuilt,
+ *         and only blocks that changed are cached again. Factorize() must
+ *         be called again if needed.
+ */
+template<typename TREE>
+hmlpError_t Update( TREE &tree, const vector<size_t> &inserted, const vector<size_t> &removed )
+{
+  using NODE = typename TREE::NODE;
+  using T = typename TREE::T;
+
+  auto &setup = tree.setup;
+  auto &K = *setup.K;
+  auto &morton = setup.morton;
+  auto *root = tree.treelist[ 0 ];
+  size_t N = K.col();
+  size_t m = setup.getLeafNodeSize();
+  auto metric = setup.MetricType();
+
+  if ( !setup.NN || !setup.NN->row() ) return HMLP_ERROR_INVALID_VALUE;
+  auto &NN = *setup.NN;
+  size_t kappa = NN.row();
+
+  /* Return the leaf that contains gid (or nullptr). */
+  auto LeafOf = [&] ( size_t gid ) -> NODE*
+  {
+    if ( gid >= morton.size() ) return nullptr;
+    auto it = tree.morton2node.find( morton[ gid ] );
+    if ( it == tree.morton2node.end() || !it->second->isleaf ) return nullptr;
+    auto &gids = it->second->gids;
+    return ( find( gids.begin(), gids.end(), gid ) != gids.end() ) ? it->second : nullptr;
+  };
+
+  /* Check if arguments are valid. */
+  map<NODE*, set<size_t>> removals;
+  for ( auto gid : removed )
+  {
+    auto *leaf = LeafOf( gid );
+    if ( !leaf ) return HMLP_ERROR_INVALID_VALUE;
+    removals[ leaf ].insert( gid );
+  }
+  if ( std::set<size_t>( inserted.begin(), inserted.end() ).size() != inserted.size() )
+  {
+    return HMLP_ERROR_INVALID_VALUE;
+  }
+  for ( auto gid : inserted )
+  {
+    if ( gid >= N || LeafOf( gid ) ) return HMLP_ERROR_INVALID_VALUE;
+  }
+
+  /** Nodes that need to be skeletonized again. */
+  set<NODE*> dirty;
+
+  /* Remove gids from their leaves. */
+  for ( auto &it : removals )
+  {
+    auto *leaf = it.first;
+    auto &gone = it.second;
+    auto &gids = leaf->gids;
+    gids.erase( remove_if( gids.begin(), gids.end(),
+          [&] ( size_t gid ) { return gone.count( gid ); } ), gids.end() );
+    leaf->n = gids.size();
+    dirty.insert( leaf );
+  }
+
+  /* Removed gids leave the neighbor lists; refill them from the near leaves. */
+  set<size_t> gone( removed.begin(), removed.end() );
+  for ( auto gid : gone ) morton[ gid ] = root->morton;
+  if ( gone.size() )
+  {
+    int n_leaves = tree.getLevelSize( tree.getDepth() );
+    auto leaf_beg = tree.treelist.begin() + tree.getLevelBegin( tree.getDepth() );
+    #pragma omp parallel for schedule(dynamic)
+    for ( int leaf_ind = 0; leaf_ind < n_leaves; leaf_ind ++ )
+    {
+      auto *leaf = *(leaf_beg + leaf_ind);
+      vector<size_t> affected;
+      for ( auto gid : leaf->gids )
+      {
+        for ( size_t p = 0; p < kappa; p ++ )
+        {
+          if ( gone.count( NN( p, gid ).second ) ) { affected.push_back( gid ); break; }
+        }
+      }
+      if ( affected.empty() ) continue;
+      set<size_t> pool( leaf->gids.begin(), leaf->gids.end() );
+      for ( auto *near : leaf->NNNearNodes ) pool.insert( near->gids.begin(), near->gids.end() );
+      vector<size_t> candidates( pool.begin(), pool.end() );
+      auto D = K.Distances( metric, affected, candidates );
+      for ( size_t i = 0; i < affected.size(); i ++ )
+      {
+        auto gid = affected[ i ];
+        vector<pair<T, size_t>> neighbors;
+        for ( size_t j = 0; j < candidates.size(); j ++ )
+        {
+          neighbors.push_back( make_pair( D( i, j ), candidates[ j ] ) );
+        }
+        /* Keep the remaining neighbors (they may come from far leaves). */
+        for ( size_t p = 0; p < kappa; p ++ )
+        {
+          auto &it = NN( p, gid );
+          if ( !gone.count( it.second ) && !pool.count( it.second ) ) neighbors.push_back( it );
+        }
+        size_t k = std::min( kappa, neighbors.size() );
+        partial_sort( neighbors.begin(), neighbors.begin() + k, neighbors.end() );
+        for ( size_t p = 0; p < kappa; p ++ )
+        {
+          NN( p, gid ) = ( p < k ) ? neighbors[ p ] : make_pair( numeric_limits<T>::max(), gid );
+        }
+      }
+    }
+  }
+
+  /* Route inserted gids to leaves, and give them neighbors from the near leaves. */
+  morton.resize( N, root->morton );
+  NN.resize( kappa, N, make_pair( numeric_limits<T>::max(), (size_t)0 ) );
+  auto distances = [&] ( const vector<size_t> &I, const vector<size_t> &J )
+  {
+    return K.Distances( metric, I, J );
+  };
+  map<NODE*, vector<size_t>> groups;
+  RouteQueries( root, inserted, distances, groups );
+  vector<pair<NODE*, vector<size_t>>> batches( groups.begin(), groups.end() );
+
+  #pragma omp parallel for schedule(dynamic)
+  for ( size_t b = 0; b < batches.size(); b ++ )
+  {
+    auto *leaf = batches[ b ].first;
+    auto &group = batches[ b ].second;
+    vector<size_t> candidates = group;
+    for ( auto *near : leaf->NNNearNodes )
+    {
+      candidates.insert( candidates.end(), near->gids.begin(), near->gids.end() );
+    }
+    if ( !leaf->NNNearNodes.count( leaf ) )
+    {
+      candidates.insert( candidates.end(), leaf->gids.begin(), leaf->gids.end() );
+    }
+    auto D = K.Distances( metric, group, candidates );
+    vector<pair<T, size_t>> neighbors( candidates.size() );
+    for ( size_t i = 0; i < group.size(); i ++ )
+    {
+      for ( size_t j = 0; j < candidates.size(); j ++ )
+      {
+        neighbors[ j ] = make_pair( D( i, j ), candidates[ j ] );
+      }
+      size_t k = std::min( kappa, neighbors.size() );
+      partial_sort( neighbors.begin(), neighbors.begin() + k, neighbors.end() );
+      for ( size_t p = 0; p < kappa; p ++ )
+      {
+        NN( p, group[ i ] ) = ( p < k ) ? neighbors[ p ] : make_pair( numeric_limits<T>::max(), group[ i ] );
+      }
+    }
+  }
+  for ( auto &batch : batches )
+  {
+    auto *leaf = batch.first;
+    leaf->gids.insert( leaf->gids.end(), batch.second.begin(), batch.second.end() );
+    leaf->n = leaf->gids.size();
+    for ( auto gid : batch.second ) morton[ gid ] = leaf->morton;
+    dirty.insert( leaf );
+  }
+
+  /* Gather the gids of all ancestors (bottom-up). */
+  auto BottomUp = [] ( const set<NODE*> &nodes )
+  {
+    vector<NODE*> order( nodes.begin(), nodes.end() );
+    stable_sort( order.begin(), order.end(), [] ( NODE *a, NODE *b ) { return a->l > b->l; } );
+    return order;
+  };
+  auto GatherAncestors = [&] ()
+  {
+    set<NODE*> ancestors;
+    for ( auto *node : dirty )
+      for ( auto *it = node->parent; it; it = it->parent ) ancestors.insert( it );
+    for ( auto *node : BottomUp( ancestors ) ) GatherGids( node );
+    dirty.insert( ancestors.begin(), ancestors.end() );
+  };
+  GatherAncestors();
+
+  /* Split again the smallest subtree that holds an overflowing (underflowing) leaf. */
+  auto IsBalanced = [&] ( size_t size, size_t n_leaves )
+  {
+    return size <= 2 * m * n_leaves && 4 * size >= m * n_leaves;
+  };
+  set<NODE*> changed_leaves;
+  for ( auto *node : dirty ) if ( node->isleaf ) changed_leaves.insert( node );
+  for ( auto *leaf : changed_leaves )
+  {
+    if ( IsBalanced( leaf->gids.size(), 1 ) ) continue;
+    auto *node = leaf;
+    while ( node->parent && !IsBalanced( node->gids.size(), NumberOfLeaves( tree, node ) ) )
+    {
+      node = node->parent;
+    }
+    Repartition( node, dirty );
+  }
+  GatherAncestors();
+
+  /* Patch near lists of changed leaves and keep them symmetric. */
+  set<NODE*> dirty_leaves;
+  for ( auto *node : dirty ) if ( node->isleaf ) dirty_leaves.insert( node );
+  for ( auto *leaf : dirty_leaves )
+  {
+    leaf->NearNodes.clear();
+    leaf->NNNearNodes.clear();
+    leaf->NNNearNodeMortonIDs.clear();
+  }
+  int n_nodes = tree.getLevelSize( tree.getDepth() );
+  for ( auto *leaf : dirty_leaves ) NearSamples<NODE, T>( leaf, n_nodes );
+  auto level_beg = tree.treelist.begin() + tree.getLevelBegin( tree.getDepth() );
+  for ( int node_ind = 0; node_ind < n_nodes; node_ind ++ )
+  {
+    auto *node = *(level_beg + node_ind);
+    for ( auto *near : node->NNNearNodes )
+    {
+      if ( dirty_leaves.count( node ) || dirty_leaves.count( near ) ) near->NNNearNodes.insert( node );
+    }
+  }
+  /** Leaves whose NearKab contains a changed leaf. */
+  set<NODE*> near_changed = dirty_leaves;
+  for ( auto *leaf : dirty_leaves )
+  {
+    near_changed.insert( leaf->NNNearNodes.begin(), leaf->NNNearNodes.end() );
+  }
+
+  RETURN_IF_ERROR( Recompress( tree, dirty, near_changed ) );
+
+  tree.Offset( root, 0 );
+  tree.n = root->gids.size();
+  /* Return with no error. */
+  return HMLP_ERROR_SUCCESS;
+}; /** end Update() */
+
+
+/**
+ *  @brief Estimate the relative error of u = K * w (nrhs random columns) on
+ *         ntest rows sampled evenly from the tree, against the exact rows.
+ *         w is drawn from a fixed seed, so the estimate is reproducible.
+ */
+template<typename TREE>
+typename TREE::T SampledError( TREE &tree, size_t ntest, size_t nrhs,
+    unsigned seed = 2019 )
+{
+  using T = typename TREE::T;
+  auto &K = *tree.setup.K;
+  auto &gids = tree.treelist[ 0 ]->gids;
+  if ( ntest > gids.size() ) ntest = gids.size();
+
+  vector<size_t> amap( ntest ), all_rhs( nrhs );
+  for ( size_t i = 0; i < ntest; i ++ ) amap[ i ] = gids[ i * gids.size() / ntest ];
+  for ( size_t p = 0; p < nrhs; p ++ ) all_rhs[ p ] = p;
+
+  /** Only gids in the tree take part in the product (see Update()). */
+  Data<T> w( K.col(), nrhs, 0 );
+  Data<T> wb( gids.size(), nrhs );
+  std::default_random_engine generator( seed );
+  std::normal_distribution<T> normal( 0.0, 1.0 );
+  for ( auto &wi : wb ) wi = normal( generator );
+  for ( size_t j = 0; j < gids.size(); j ++ )
+    for ( size_t p = 0; p < nrhs; p ++ ) w( gids[ j ], p ) = wb( j, p );
+  auto u = Evaluate( tree, w );
+
+  auto Kab = K( amap, gids );
+  Data<T> exact( ntest, nrhs, 0 );
+  xgemm( "No transpose", "No transpose", ntest, nrhs, gids.size(),
+    1.0,   Kab.data(),   Kab.row(),
+            wb.data(),    wb.row(),
+    0.0, exact.data(), exact.row() );
+
+  T err = 0, nrm = 0;
+  for ( size_t i = 0; i < ntest; i ++ )
+  {
+    for ( size_t p = 0; p < nrhs; p ++ )
+    {
+      T diff = exact( i, p ) - u( amap[ i ], p );
+      err += diff * diff;
+      nrm += exact( i, p ) * exact( i, p );
+    }
+  }
+  return ( nrm > 0 ) ? std::sqrt( err / nrm ) : std::sqrt( err );
+}; /** end SampledError() */
+
+
+/**
+ *  @brief Refine a compressed tree until SampledError() meets
+ *         setup.getTargetError(), or getMaximumRefinements() iterations.
+ *
+ *         Each iteration only refines the nodes with the largest
+ *         error_estimate, such that the nodes left alone account for at
+ *         most ( target / error )^2 of the squared estimates. Refined
+ *         nodes get a tolerance of the largest estimate lowered by that
+ *         ratio, twice the row samples, and twice the rank capped by
+ *         MaximumRank(). A leaf that would need more than half its
+ *         columns keeps them all and gets its strongest far interactions
+ *         (by NearNodeBallots) as near blocks instead. Refined nodes and
+ *         their ancestors are then skeletonized again with Recompress().
+ *
+ *         Return HMLP_ERROR_EXECUTION_FAILED if the target is not met.
+ */
+template<typename TREE>
+hmlpError_t Refine( TREE &tree, size_t ntest, size_t nrhs )
+{
+  using NODE = typename TREE::NODE;
+  using T = typename TREE::T;
+
+  auto &setup = tree.setup;
+  T target = setup.getTargetError();
+  if ( target <= 0 ) return HMLP_ERROR_INVALID_VALUE;
+
+  for ( size_t iter = 0; ; iter ++ )
+  {
+    T error = SampledError( tree, ntest, nrhs );
+    if ( REPORT_COMPRESS_STATUS )
+    {
+      printf( "Refine #%lu sampled error %3.1E (target %3.1E)\n", iter, error, target ); 
+      fflush( stdout );
+    }
+    if ( error <= target ) break;
+    if ( iter >= setup.getMaximumRefinements() ) return HMLP_ERROR_EXECUTION_FAILED;
+
+    /** Leave the smallest estimates alone (with a safety factor of 2). */
+    vector<T> squared_estimates;
+    for ( auto *node : tree.treelist ) 
+    {
+      T estimate = node->data.error_estimate;
+      if ( node->parent ) squared_estimates.push_back( estimate * estimate );
+    }
+    sort( squared_estimates.begin(), squared_estimates.end() );
+    T budget = 0, threshold = 0, max_estimate = 0;
+    for ( auto e2 : squared_estimates ) budget += e2;
+    budget *= ( target / error ) * ( target / error ) / 2;
+    for ( auto e2 : squared_estimates )
+    {
+      if ( e2 > budget ) break;
+      budget -= e2;
+      threshold = std::sqrt( e2 );
+    }
+    if ( squared_estimates.size() ) max_estimate = std::sqrt( squared_estimates.back() );
+    T tolerance = max_estimate * ( target / error ) / 2;
+
+    set<NODE*> dirty, near_changed;
+    for ( auto *node : tree.treelist )
+    {
+      auto &data = node->data;
+      if ( !node->parent || data.error_estimate <= threshold ) continue;
+      T stol = ( data.tolerance > 0 ) ? data.tolerance : setup.Tolerance();
+      size_t maxs = ( data.maximum_rank ) ? data.maximum_rank : setup.MaximumRank();
+      size_t ncols = data.candidate_cols.size();
+      data.tolerance = std::min( stol, tolerance );
+      data.row_samples = 2 * std::max( data.candidate_rows.size(), ncols );
+      /** The rank was capped (or secure accuracy gave up) at maxs. */
+      if ( !data.is_compressed || data.skels.size() >= maxs )
+      {
+        if ( 2 * maxs < ncols ) data.maximum_rank = 2 * maxs;
+        else
+        {
+          data.maximum_rank = ncols;
+          if ( node->isleaf )
+          {
+            /** Double the near list with the next candidates of NearSamples(). */
+            size_t n_near = 2 * node->NNNearNodes.size();
+            auto sorted_ballot = NearNodeBallots( node );
+            for ( auto it = sorted_ballot.rbegin(); it != sorted_ballot.rend(); it ++ )
+            {
+              if ( node->NNNearNodes.size() >= n_near ) break;
+              auto *near = tree.morton2node[ (*it).second ];
+              node->NNNearNodes.insert( near );
+              node->NNNearNodeMortonIDs.insert( near->morton );
+              near->NNNearNodes.insert( node );
+              near->NNNearNodeMortonIDs.insert( node->morton );
+              near_changed.insert( near );
+            }
+            near_changed.insert( node );
+          }
+        }
+      }
+      for ( auto *it = node; it; it = it->parent ) dirty.insert( it );
+    }
+    if ( dirty.empty() ) return HMLP_ERROR_EXECUTION_FAILED;
+    RETURN_IF_ERROR( Recompress( tree, dirty, near_changed ) );
+  }
+
+  /* Return with no error. */
+  return HMLP_ERROR_SUCCESS;
+}; /** end Refine() */
+
+
+
 
 
 
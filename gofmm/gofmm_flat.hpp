@@ -0,0 +1,477 @@
+/**
+ *  HMLP (High-Performance Machine Learning Primitives)
+ *
+ *  Copyright (C) 2014-2018, The University of Texas at Austin
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see the LICENSE file.
+ *
+ **/
+
+
+#ifndef GOFMM_FLAT_HPP
+#define GOFMM_FLAT_HPP
+
+/** Inherit most of the classes from shared-memory GOFMM. */
+#include <gofmm.hpp>
+
+/** Use STL and HMLP namespaces. */
+using namespace std;
+using namespace hmlp;
+
+
+namespace hmlp
+{
+namespace gofmm
+{
+
+
+/**
+ *  @brief A level-synchronous ("compressed") layout of a compressed tree.
+ *
+ *         After Compress(), each node owns its own proj, w_skel, u_skel
+ *         and w_leaf. FlatTree packs them level by level into contiguous
+ *         arrays with offsets, such that evaluation becomes a sequence of
+ *         batched sweeps (one parallel loop per level and per phase).
+ *
+ *         On each level, the skeleton weights (and potentials) of all
+ *         nodes are stored in one S-by-nrhs matrix, where S is the sum
+ *         of the skeleton sizes. Since siblings are adjacent in treelist,
+ *         the skeletons of the kids of a node are adjacent rows, and N2S
+ *         and S2N of a node are single GEMMs with ld = S of the child
+ *         level. Leaves store w and u in the permuted order (the order
+ *         of concatenated gids), with ld = n.
+ *
+ *         The FlatTree refers to the nodes for the interaction lists,
+ *         NearKab and FarKab, so it must be rebuilt (Flatten) whenever
+ *         the tree is recompressed. Buffers are reused across Evaluate().
+ */
+template<bool NNPRUNE, typename TREE>
+class FlatTree
+{
+  public:
+
+    /** Derive NODE and T from TREE. */
+    typedef typename TREE::NODE NODE;
+    typedef typename TREE::T T;
+
+    /** All nodes of the same depth. */
+    class Level
+    {
+      public:
+
+        /** Nodes of this level in treelist order. */
+        vector<NODE*> nodes;
+
+        /** Row offsets of skeletons in W and U (length nodes.size() + 1). */
+        vector<size_t> skel_offset;
+
+        /** Offsets of the packed s-by-k proj (length nodes.size() + 1). */
+        vector<size_t> proj_offset;
+
+        /** Packed interpolative coefficients (column major per node). */
+        vector<T> proj;
+
+        /** Kids of node i on the next level: [ kid_ptr[ i ], kid_ptr[ i + 1 ] ). */
+        vector<size_t> kid_ptr;
+
+        /** Far( node ) in CSR format: (level, index) of each far node. */
+        vector<size_t> far_ptr;
+        vector<size_t> far_level;
+        vector<size_t> far_index;
+
+        /** S-by-nrhs skeleton weights and potentials. */
+        Data<T> W;
+        Data<T> U;
+
+        /** Total number of skeletons of this level. */
+        size_t S() const noexcept { return skel_offset.back(); };
+
+        /** Number of skeletons of the i-th node on this level. */
+        size_t s( size_t i ) const noexcept
+        {
+          return skel_offset[ i + 1 ] - skel_offset[ i ];
+        };
+    };
+
+    FlatTree( TREE &tree ) : tree_( tree ) {};
+
+    /** @brief Pack the compressed tree into the level-synchronous layout. */
+    hmlpError_t Flatten()
+    {
+      size_t depth = tree_.getDepth();
+      levels_.clear();
+      levels_.resize( depth + 1 );
+
+      /** Skeleton sizes and packed proj, level by level. */
+      for ( size_t l = 0; l <= depth; l ++ )
+      {
+        auto &level = levels_[ l ];
+        size_t n_nodes = tree_.getLevelSize( l );
+        auto level_beg = tree_.treelist.begin() + tree_.getLevelBegin( l );
+        level.nodes.assign( level_beg, level_beg + n_nodes );
+        level.skel_offset.assign( n_nodes + 1, 0 );
+        level.proj_offset.assign( n_nodes + 1, 0 );
+        level.kid_ptr.assign( n_nodes + 1, 0 );
+        for ( size_t i = 0; i < n_nodes; i ++ )
+        {
+          auto *node = level.nodes[ i ];
+          if ( node->treelist_id != tree_.getLevelBegin( l ) + i ) return HMLP_ERROR_INVALID_VALUE;
+          level.kid_ptr[ i + 1 ] = level.kid_ptr[ i ];
+          for ( int c = 0; c < NODE::N_CHILDREN && node->kids[ c ]; c ++ )
+          {
+            size_t kid = tree_.getLevelBegin( l + 1 ) + level.kid_ptr[ i + 1 ] ++;
+            if ( node->kids[ c ]->treelist_id != kid ) return HMLP_ERROR_INVALID_VALUE;
+          }
+          size_t s = IsActive( node ) ? node->data.skels.size() : 0;
+          if ( s && node->data.proj.row() != s ) return HMLP_ERROR_INVALID_VALUE;
+          level.skel_offset[ i + 1 ] = level.skel_offset[ i ] + s;
+          level.proj_offset[ i + 1 ] = level.proj_offset[ i ] + ( s ? node->data.proj.size() : 0 );
+        }
+        level.proj.resize( level.proj_offset.back() );
+        #pragma omp parallel for
+        for ( size_t i = 0; i < n_nodes; i ++ )
+        {
+          auto &proj = level.nodes[ i ]->data.proj;
+          if ( level.s( i ) ) std::copy( proj.begin(), proj.end(),
+              level.proj.begin() + level.proj_offset[ i ] );
+        }
+      }
+
+      /** An active inner node must interpolate from the skeletons of its kids. */
+      for ( size_t l = 0; l < depth; l ++ )
+      {
+        auto &level = levels_[ l ];
+        for ( size_t i = 0; i < level.nodes.size(); i ++ )
+        {
+          if ( !level.s( i ) ) continue;
+          size_t k = 0;
+          for ( size_t j = level.kid_ptr[ i ]; j < level.kid_ptr[ i + 1 ]; j ++ )
+            k += levels_[ l + 1 ].s( j );
+          if ( level.nodes[ i ]->data.proj.col() != k ) return HMLP_ERROR_INVALID_VALUE;
+        }
+      }
+
+      /** Far( node ) lists in the same order as FarKab. */
+      for ( auto &level : levels_ )
+      {
+        level.far_ptr.assign( 1, 0 );
+        level.far_level.clear();
+        level.far_index.clear();
+        for ( size_t i = 0; i < level.nodes.size(); i ++ )
+        {
+          if ( level.s( i ) )
+          {
+            for ( auto *far : FarNodes( level.nodes[ i ] ) )
+            {
+              size_t l = LevelOf( far );
+              size_t j = far->treelist_id - tree_.getLevelBegin( l );
+              if ( !levels_[ l ].s( j ) ) return HMLP_ERROR_INVALID_VALUE;
+              level.far_level.push_back( l );
+              level.far_index.push_back( j );
+            }
+          }
+          level.far_ptr.push_back( level.far_level.size() );
+        }
+      }
+
+      /** Leaves in the permuted order, and Near( leaf ) in CSR format. */
+      auto &leaves = levels_[ depth ].nodes;
+      leaf_offset_.assign( leaves.size() + 1, 0 );
+      for ( size_t i = 0; i < leaves.size(); i ++ )
+        leaf_offset_[ i + 1 ] = leaf_offset_[ i ] + leaves[ i ]->gids.size();
+      perm_.resize( leaf_offset_.back() );
+      near_ptr_.assign( 1, 0 );
+      near_index_.clear();
+      for ( size_t i = 0; i < leaves.size(); i ++ )
+      {
+        auto &gids = leaves[ i ]->gids;
+        std::copy( gids.begin(), gids.end(), perm_.begin() + leaf_offset_[ i ] );
+        for ( auto *near : NearNodes( leaves[ i ] ) )
+        {
+          if ( !near->isleaf ) return HMLP_ERROR_INVALID_VALUE;
+          near_index_.push_back( near->treelist_id - tree_.getLevelBegin( depth ) );
+        }
+        near_ptr_.push_back( near_index_.size() );
+      }
+
+      /* Return with no error. */
+      return HMLP_ERROR_SUCCESS;
+    }; /** end Flatten() */
+
+
+    /** @brief Compute potentials = K * weights level by level. */
+    Data<T> Evaluate( Data<T> &weights )
+    {
+      size_t n = perm_.size();
+      size_t nrhs = weights.col();
+      size_t depth = levels_.size() - 1;
+      auto &K = *tree_.setup.K;
+      auto &cache = *tree_.setup.kab_cache;
+      if ( weights.row() != n ) throw std::invalid_argument( "FlatTree: weights.row() != n" );
+
+      /** All timers. */
+      double beg, permute_time, n2s_time, s2s_time, s2n_time, l2l_time;
+
+      /** Reuse buffers if the shapes have not changed. */
+      Data<T> potentials( n, nrhs, 0.0 );
+      w_leaf_.resize( n, nrhs );
+      u_leaf_.resize( 0, 0 );
+      u_leaf_.resize( n, nrhs, 0.0 );
+      for ( auto &level : levels_ )
+      {
+        level.W.resize( level.S(), nrhs );
+        level.U.resize( 0, 0 );
+        level.U.resize( level.S(), nrhs, 0.0 );
+      }
+
+      /** Forward permute. */
+      beg = omp_get_wtime();
+      #pragma omp parallel for
+      for ( size_t j = 0; j < nrhs; j ++ )
+        for ( size_t i = 0; i < n; i ++ ) w_leaf_( i, j ) = weights( perm_[ i ], j );
+      permute_time = omp_get_wtime() - beg;
+
+      /** N2S: leaves interpolate w_leaf, inner nodes interpolate W of children. */
+      beg = omp_get_wtime();
+      for ( int l = depth; l >= 0; l -- )
+      {
+        auto &level = levels_[ l ];
+        #pragma omp parallel for schedule( dynamic )
+        for ( size_t i = 0; i < level.nodes.size(); i ++ )
+        {
+          size_t s = level.s( i );
+          if ( !s ) continue;
+          const T *B; size_t k, ldb;
+          if ( l == depth )
+          {
+            B = w_leaf_.data() + leaf_offset_[ i ];
+            k = leaf_offset_[ i + 1 ] - leaf_offset_[ i ];
+            ldb = n;
+          }
+          else
+          {
+            auto &child = levels_[ l + 1 ];
+            B = child.W.data() + child.skel_offset[ level.kid_ptr[ i ] ];
+            k = child.skel_offset[ level.kid_ptr[ i + 1 ] ] - child.skel_offset[ level.kid_ptr[ i ] ];
+            ldb = child.S();
+          }
+          xgemm( "N", "N", s, nrhs, k,
+            1.0, level.proj.data() + level.proj_offset[ i ], s,
+                 (T*)B, ldb,
+            0.0, level.W.data() + level.skel_offset[ i ], level.S() );
+        }
+      }
+      n2s_time = omp_get_wtime() - beg;
+
+      /** S2S: all levels are independent. */
+      beg = omp_get_wtime();
+      for ( size_t l = 0; l <= depth; l ++ )
+      {
+        auto &level = levels_[ l ];
+        #pragma omp parallel for schedule( dynamic )
+        for ( size_t i = 0; i < level.nodes.size(); i ++ )
+        {
+          size_t s = level.s( i );
+          if ( level.far_ptr[ i ] == level.far_ptr[ i + 1 ] ) continue;
+          auto *node = level.nodes[ i ];
+          auto &FarKab = node->data.FarKab;
+          T *C = level.U.data() + level.skel_offset[ i ];
+          size_t offset = 0;
+          for ( size_t it = level.far_ptr[ i ]; it < level.far_ptr[ i + 1 ]; it ++ )
+          {
+            auto &far = levels_[ level.far_level[ it ] ];
+            size_t j = level.far_index[ it ];
+            const T *B = far.W.data() + far.skel_offset[ j ];
+            if ( FarKab.IsCached() )
+            {
+              FarKab.Multiply( offset, far.s( j ), nrhs, B, far.S(), C, level.S() );
+              cache.Hit();
+              offset += far.s( j );
+            }
+            else
+            {
+              double miss_beg = omp_get_wtime();
+              auto Kab = K( node->data.skels, far.nodes[ j ]->data.skels );
+              xgemm( "N", "N", s, nrhs, far.s( j ),
+                1.0, Kab.data(), Kab.row(),
+                     (T*)B, far.S(),
+                1.0, C, level.S() );
+              cache.Miss( omp_get_wtime() - miss_beg );
+            }
+          }
+        }
+      }
+      s2s_time = omp_get_wtime() - beg;
+
+      /** S2N: inner nodes accumulate to children, leaves to u_leaf. */
+      beg = omp_get_wtime();
+      for ( size_t l = 0; l <= depth; l ++ )
+      {
+        auto &level = levels_[ l ];
+        #pragma omp parallel for schedule( dynamic )
+        for ( size_t i = 0; i < level.nodes.size(); i ++ )
+        {
+          size_t s = level.s( i );
+          if ( !s ) continue;
+          T *C; size_t k, ldc;
+          if ( l == depth )
+          {
+            C = u_leaf_.data() + leaf_offset_[ i ];
+            k = leaf_offset_[ i + 1 ] - leaf_offset_[ i ];
+            ldc = n;
+          }
+          else
+          {
+            auto &child = levels_[ l + 1 ];
+            C = child.U.data() + child.skel_offset[ level.kid_ptr[ i ] ];
+            k = child.skel_offset[ level.kid_ptr[ i + 1 ] ] - child.skel_offset[ level.kid_ptr[ i ] ];
+            ldc = child.S();
+          }
+          xgemm( "T", "N", k, nrhs, s,
+            1.0, level.proj.data() + level.proj_offset[ i ], s,
+                 level.U.data() + level.skel_offset[ i ], level.S(),
+            1.0, C, ldc );
+        }
+      }
+      s2n_time = omp_get_wtime() - beg;
+
+      /** L2L: each leaf accumulates its Near( leaf ) to u_leaf. */
+      beg = omp_get_wtime();
+      auto &leaves = levels_[ depth ].nodes;
+      #pragma omp parallel for schedule( dynamic )
+      for ( size_t i = 0; i < leaves.size(); i ++ )
+      {
+        auto *node = leaves[ i ];
+        auto &NearKab = node->data.NearKab;
+        size_t m = leaf_offset_[ i + 1 ] - leaf_offset_[ i ];
+        T *C = u_leaf_.data() + leaf_offset_[ i ];
+        size_t offset = 0;
+        for ( size_t it = near_ptr_[ i ]; it < near_ptr_[ i + 1 ]; it ++ )
+        {
+          size_t j = near_index_[ it ];
+          size_t k = leaf_offset_[ j + 1 ] - leaf_offset_[ j ];
+          const T *B = w_leaf_.data() + leaf_offset_[ j ];
+          if ( NearKab.IsCached() )
+          {
+            NearKab.Multiply( offset, k, nrhs, B, n, C, n );
+            cache.Hit();
+          }
+          else
+          {
+            double miss_beg = omp_get_wtime();
+            auto Kab = K( node->gids, leaves[ j ]->gids );
+            xgemm( "N", "N", m, nrhs, k,
+              1.0, Kab.data(), Kab.row(),
+                   (T*)B, n,
+              1.0, C, n );
+            cache.Miss( omp_get_wtime() - miss_beg );
+          }
+          offset += k;
+        }
+      }
+      l2l_time = omp_get_wtime() - beg;
+
+      /** Backward permute. */
+      beg = omp_get_wtime();
+      #pragma omp parallel for
+      for ( size_t j = 0; j < nrhs; j ++ )
+        for ( size_t i = 0; i < n; i ++ ) potentials( perm_[ i ], j ) = u_leaf_( i, j );
+      permute_time += omp_get_wtime() - beg;
+
+      if ( REPORT_EVALUATE_STATUS )
+      {
+        double evaluation_time = permute_time + n2s_time + s2s_time + s2n_time + l2l_time;
+        double time_ratio = 100 / evaluation_time;
+        printf( "========================================================\n");
+        printf( "GOFMM evaluation phase (level-synchronous)\n" );
+        printf( "========================================================\n");
+        printf( "Permute ------------------------------- %5.2lfs (%5.1lf%%)\n",
+            permute_time, permute_time * time_ratio );
+        printf( "N2S ----------------------------------- %5.2lfs (%5.1lf%%)\n",
+            n2s_time, n2s_time * time_ratio );
+        printf( "S2S ----------------------------------- %5.2lfs (%5.1lf%%)\n",
+            s2s_time, s2s_time * time_ratio );
+        printf( "S2N ----------------------------------- %5.2lfs (%5.1lf%%)\n",
+            s2n_time, s2n_time * time_ratio );
+        printf( "L2L ----------------------------------- %5.2lfs (%5.1lf%%)\n",
+            l2l_time, l2l_time * time_ratio );
+        printf( "========================================================\n");
+        printf( "Evaluate ------------------------------ %5.2lfs (%5.1lf%%)\n",
+            evaluation_time, evaluation_time * time_ratio );
+        printf( "========================================================\n");
+        cache.Report( "Kab" );
+        printf( "========================================================\n\n");
+      }
+
+      return potentials;
+    }; /** end Evaluate() */
+
+  private:
+
+    /** Same early-return condition as UpdateWeights(). */
+    static bool IsActive( NODE *node )
+    {
+      return node->parent && node->data.is_compressed;
+    };
+
+    size_t LevelOf( NODE *node )
+    {
+      size_t l = 0;
+      while ( tree_.getLevelBegin( l + 1 ) <= node->treelist_id ) l ++;
+      return l;
+    };
+
+    static set<NODE*> & FarNodes( NODE *node )
+    {
+      return NNPRUNE ? node->NNFarNodes : node->FarNodes;
+    };
+
+    static set<NODE*> & NearNodes( NODE *node )
+    {
+      return NNPRUNE ? node->NNNearNodes : node->NearNodes;
+    };
+
+    TREE &tree_;
+
+    vector<Level> levels_;
+
+    /** Concatenated gids of all leaves and their offsets. */
+    vector<size_t> perm_;
+    vector<size_t> leaf_offset_;
+
+    /** Near( leaf ) in CSR format (leaf indices). */
+    vector<size_t> near_ptr_;
+    vector<size_t> near_index_;
+
+    /** n-by-nrhs permuted weights and potentials. */
+    Data<T> w_leaf_;
+    Data<T> u_leaf_;
+
+}; /** end class FlatTree */
+
+
+/** @brief Flatten a compressed tree for level-synchronous evaluation. */
+template<bool NNPRUNE = true, typename TREE>
+FlatTree<NNPRUNE, TREE> * Flatten( TREE &tree )
+{
+  auto *flat = new FlatTree<NNPRUNE, TREE>( tree );
+  HANDLE_ERROR( flat->Flatten() );
+  return flat;
+}; /** end Flatten() */
+
+
+}; /** end namespace gofmm */
+}; /** end namespace hmlp */
+
+#endif /** define GOFMM_FLAT_HPP */
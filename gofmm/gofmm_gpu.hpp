@@ -454,25 +454,17 @@ void LeavesToLeaves( DEVICE *dev, NODE *node )
     for ( auto it  = NearNodes->begin(); 
                it != NearNodes->end(); it ++ )
     {
-      assert( omp_get_thread_num() > 0 && omp_get_thread_num() < 20 );
-      auto &u_leaf = (*it)->data.u_leaf[ omp_get_thread_num() ];
       size_t m = (*it)->lids.size();
+      /** Accumulate in place while holding the tiles of u_leaf[ 1 ]. */
+      auto &u_leaf = (*it)->data.u_leaf[ 1 ];
 
       assert( offset < NearKab.col() );
       assert( w_leaf.size() == k * n );
 
-
-      if ( u_leaf.size() != m * n )
-      {
-        //printf( "u_leaf.size() %lu m %lu n %lu w.row() %lu\n", 
-        //    u_leaf.size(), m, n, w.row() );
-        u_leaf.resize( 0, 0 );
-        u_leaf.resize( m, n, 0.0 );
-      }
-
       //printf( "NearKab.col() %lu m %lu offset %lu\n",
       //    NearKab.col(), m, offset ); fflush( stdout );
 
+      HANDLE_ERROR( u_leaf.AcquireRegion( 0, m, 0, n ) );
       hmlp::xgemm
       (
         "T", "N",
@@ -481,6 +473,7 @@ void LeavesToLeaves( DEVICE *dev, NODE *node )
               w_leaf.data(),              w_leaf.row(),
         1.0,  u_leaf.data(),              u_leaf.row()
       );
+      HANDLE_ERROR( u_leaf.ReleaseRegion( 0, m, 0, n ) );
       offset += m;
     }
     printf( "cpu gemm finishd\n" ); fflush( stdout );
@@ -507,12 +500,7 @@ class LeavesToLeavesVer2Task : public hmlp::Task
       arg = user_arg;
       stream_id = ( arg->treelist_id % 8 ) + 1;
       name = std::string( "l2l" );
-      {
-        //label = std::to_string( arg->treelist_id );
-        std::ostringstream ss;
-        ss << arg->treelist_id;
-        label = ss.str();
-      }
+      SetLabel( arg->treelist_id );
 
       assert( arg->isleaf );
 
@@ -599,6 +587,14 @@ class LeavesToLeavesVer2Task : public hmlp::Task
     void DependencyAnalysis()
     {
       assert( arg->isleaf );
+      /** The CPU fallback accumulates to u_leaf[ 1 ] of all near nodes. */
+      auto *NearNodes = &arg->NearNodes;
+      if ( NNPRUNE ) NearNodes = &arg->NNNearNodes;
+      for ( auto *near : *NearNodes )
+      {
+        auto &u_leaf = near->data.u_leaf[ 1 ];
+        HANDLE_ERROR( u_leaf.DependencyAnalysis( 0, u_leaf.row(), 0, u_leaf.col(), ACC, this ) );
+      }
       //if ( arg->data.NearKab.is_up_to_date( hmlp_get_device( 0 ) ) )
         this->ForceEnqueue( 0 );
       //else
@@ -220,6 +220,8 @@ class Setup : public mpitree::Setup<SPLITTER, T>,
       this->K = &K;
       this->splitter = splitter;
       this->NN_cblk = NN_cblk;
+      this->kab_cache = make_shared<CacheManager<T>>( config.getCacheBudget(),
+          config.getCacheDowncast(), config.getCacheLowRank(), config.Tolerance() );
     };
 
     /** The SPDMATRIX (accessed with gids: dense, CSC or OOC) */
@@ -244,6 +246,9 @@ class Setup : public mpitree::Setup<SPLITTER, T>,
 
     unordered_set<size_t> compression_failure_frontier_;
 
+    /** Budget and statistics of the cached Kab (local and remote). */
+    shared_ptr<CacheManager<T>> kab_cache;
+
   private:
 
 
@@ -268,7 +273,7 @@ class DistTreeViewTask : public Task
     {
       arg = user_arg;
       name = string( "TreeView" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       cost = 1.0;
     };
 
@@ -519,7 +524,7 @@ struct centersplit : public gofmm::centersplit<SPDMATRIX, N_SPLIT, T>
     K.BcastIndices( Q, max_pair.key, comm );
 
     /** Compute all pairwise distances. */
-    auto DIQ = K.Distances( this->metric, gids, P );
+    auto DIQ = K.Distances( this->metric, gids, Q );
 
     /** We use relative distances (dip - diq) for clustering. */
     for ( size_t i = 0; i < temp.size(); i ++ )
@@ -795,7 +800,7 @@ class DistUpdateWeightsTask : public Task
     {
       arg = user_arg;
       name = string( "DistN2S" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
 
       /** Compute FLOPS and MOPS */
       double flops = 0.0, mops = 0.0;
@@ -877,7 +882,7 @@ class DistUpdateWeightsTask : public Task
 //    {
 //      arg = user_arg;
 //      name = string( "DistS2S" );
-//      label = to_string( arg->treelist_id );
+//      SetLabel( arg->treelist_id );
 //      /** compute flops and mops */
 //      double flops = 0.0, mops = 0.0;
 //      auto &w = *arg->setup->w;
@@ -976,7 +981,7 @@ class S2STask2 : public Task
       lock = user_lock;
       num_arrived_subtasks = user_num_arrived_subtasks;
       name = string( "S2S" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
 
       /** Compute FLOPS and MOPS */
       double flops = 0.0, mops = 0.0;
@@ -1028,32 +1033,23 @@ class S2STask2 : public Task
       {
         auto &J = src->data.skels;
         auto &w = src->data.w_skel;
-        bool is_cached = true;
-
         auto &KIJ = node->DistFar[ p ][ src->morton ];
-        if ( KIJ.row() != I.size() || KIJ.col() != J.size() ) 
-        {
-          //printf( "KIJ %lu %lu I %lu J %lu\n", KIJ.row(), KIJ.col(), I.size(), J.size() );
-          KIJ = K( I, J );
-          is_cached = false;
-        }
 
         assert( w.col() == nrhs );
         assert( w.row() == J.size() );
-        //xgemm
-        //(
-        //  "N", "N", u.row(), u.col(), w.row(),
-        //  1.0, KIJ.data(), KIJ.row(),
-        //         w.data(),   w.row(),
-        //  1.0,   u.data(),   u.row()
-        //);
-        gemm::xgemm( (T)1.0, KIJ, w, (T)1.0, u );
-
-        /** Free KIJ, if !is_cached. */
-        if ( !is_cached ) 
+
+        if ( KIJ.IsCached( I.size(), J.size() ) )
         {
-          KIJ.resize( 0, 0 );
-          KIJ.shrink_to_fit();
+          KIJ.Multiply( 0, J.size(), nrhs, w.data(), w.row(), u.data(), u.row() );
+          node->setup->kab_cache->Hit();
+        }
+        else
+        {
+          /** Recompute KIJ without caching it. */
+          double beg = omp_get_wtime();
+          Data<T> Kab = K( I, J );
+          gemm::xgemm( (T)1.0, Kab, w, (T)1.0, u );
+          node->setup->kab_cache->Miss( omp_get_wtime() - beg );
         }
       }
 
@@ -1088,7 +1084,7 @@ class S2SReduceTask2 : public Task
     {
       arg = user_arg;
       name = string( "S2SR" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
 
       /** Reset u_skel */
       if ( arg ) 
@@ -1248,7 +1244,7 @@ class DistSkeletonsToNodesTask : public Task
     {
       arg = user_arg;
       name = string( "PS2N" );
-      label = to_string( arg->l );
+      SetLabel( arg->l );
 
       double flops = 0.0, mops = 0.0;
       auto &gids = arg->gids;
@@ -1340,7 +1336,7 @@ class L2LTask2 : public Task
       lock = user_lock;
       num_arrived_subtasks = user_num_arrived_subtasks;
       name = string( "L2L" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
 
       /** Compute FLOPS and MOPS. */
       double flops = 0.0, mops = 0.0;
@@ -1380,7 +1376,7 @@ class L2LTask2 : public Task
       double beg = omp_get_wtime();
       /** Temporary buffer */
       Data<T> u( I.size(), nrhs, 0.0 );
-      size_t k;
+      size_t k = 0;
 
       for ( auto src : Sources )
       {
@@ -1388,43 +1384,33 @@ class L2LTask2 : public Task
         View<T> &W = src->data.w_view;
         Data<T> &w = src->data.w_leaf;
         
-        bool is_cached = true;
         auto &J = src->gids;
         auto &KIJ = node->DistNear[ p ][ src->morton ];
-        if ( KIJ.row() != I.size() || KIJ.col() != J.size() ) 
-        {
-          KIJ = K( I, J );
-          is_cached = false;
-        }
 
-        if ( W.col() == nrhs && W.row() == J.size() )
+        /** Use the view if it is available, otherwise w_leaf. */
+        bool use_view = ( W.col() == nrhs && W.row() == J.size() );
+        const T *w_data = use_view ? W.data() : w.data();
+        size_t   w_ld   = use_view ? W.ld()   : w.row();
+        k += J.size();
+
+        if ( KIJ.IsCached( I.size(), J.size() ) )
         {
-          k += W.row();
-          xgemm
-          (
-            "N", "N", u.row(), u.col(), W.row(),
-            1.0, KIJ.data(), KIJ.row(),
-                   W.data(),   W.ld(),
-            1.0,   u.data(),   u.row()
-          );
+          KIJ.Multiply( 0, J.size(), nrhs, w_data, w_ld, u.data(), u.row() );
+          node->setup->kab_cache->Hit();
         }
         else
         {
-          k += w.row();
+          /** Recompute KIJ without caching it. */
+          double beg = omp_get_wtime();
+          Data<T> Kab = K( I, J );
           xgemm
           (
-            "N", "N", u.row(), u.col(), w.row(),
-            1.0, KIJ.data(), KIJ.row(),
-                   w.data(),   w.row(),
+            "N", "N", u.row(), u.col(), J.size(),
+            1.0, Kab.data(), Kab.row(),
+             (T*)w_data,       w_ld,
             1.0,   u.data(),   u.row()
           );
-        }
-
-        /** Free KIJ, if !is_cached. */
-        if ( !is_cached ) 
-        {
-          KIJ.resize( 0, 0 );
-          KIJ.shrink_to_fit();
+          node->setup->kab_cache->Miss( omp_get_wtime() - beg );
         }
       }
 
@@ -1471,7 +1457,7 @@ class L2LReduceTask2 : public Task
     {
       arg = user_arg;
       name = string( "L2LR" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       /** Create subtasks */
       for ( int p = 0; p < hmlp_get_mpi_size(); p ++ )
       {
@@ -1563,7 +1549,7 @@ void FindNearInteractions( TREE &tree )
   auto &setup = tree.setup;
   auto &NN = *setup.NN;
   double budget = setup.Budget();
-  size_t n_leafs = ( 1 << tree.getDepth() );
+  size_t n_leafs = tree.getLevelSize( tree.getDepth() );
   /** 
    *  The type here is tree::Node but not mpitree::Node.
    *  NearNodes and NNNearNodes also take tree::Node.
@@ -1572,7 +1558,7 @@ void FindNearInteractions( TREE &tree )
    *  However, FarNodes and NNFarNodes may contain distributed
    *  tree nodes. In this case, we have to do type casting.
    */
-  auto level_beg = tree.treelist.begin() + n_leafs - 1;
+  auto level_beg = tree.treelist.begin() + tree.getLevelBegin( tree.getDepth() );
 
   /** Traverse all leaf nodes. **/
   #pragma omp parallel for
@@ -1677,8 +1663,8 @@ void SymmetrizeNearInteractions( TREE & tree )
    *  Loop over all near node MortonIDs, create
    *
    */ 
-  int n_nodes = 1 << tree.getDepth();
-  auto level_beg = tree.treelist.begin() + n_nodes - 1;
+  int n_nodes = tree.getLevelSize( tree.getDepth() );
+  auto level_beg = tree.treelist.begin() + tree.getLevelBegin( tree.getDepth() );
 
   #pragma omp parallel
   {
@@ -1897,8 +1883,8 @@ void BuildInteractionListPerRank( TREE &tree, bool is_near )
   if ( is_near )
   {
     /** Traverse leaf nodes (near interation lists) */ 
-    int n_nodes = 1 << tree.getDepth();
-    auto level_beg = tree.treelist.begin() + n_nodes - 1;
+    int n_nodes = tree.getLevelSize( tree.getDepth() );
+    auto level_beg = tree.treelist.begin() + tree.getLevelBegin( tree.getDepth() );
 
     #pragma omp parallel
     {
@@ -2816,7 +2802,7 @@ class MergeFarNodesTask : public Task
     {
       arg = user_arg;
       name = string( "merge" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       /** we don't know the exact cost here */
       cost = 5.0;
       /** high priority */
@@ -2942,7 +2928,7 @@ class DistMergeFarNodesTask : public Task
     {
       arg = user_arg;
       name = string( "dist-merge" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       /** we don't know the exact cost here */
       cost = 5.0;
       /** high priority */
@@ -2994,7 +2980,7 @@ class CacheFarNodesTask : public Task
     {
       arg = user_arg;
       name = string( "FKIJ" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       /** Compute FLOPS and MOPS. */
       double flops = 0, mops = 0;
       /** We don't know the exact cost here. */
@@ -3019,7 +3005,9 @@ class CacheFarNodesTask : public Task
           auto *src = (*node->morton2node)[ it.first ];
           auto &I = node->data.skels;
           auto &J = src->data.skels;
+          double beg = omp_get_wtime();
           it.second = K( I, J );
+          node->setup->kab_cache->Admit( it.second, omp_get_wtime() - beg );
           //printf( "Cache I %lu J %lu\n", I.size(), J.size() ); fflush( stdout );
         }
       }
@@ -3046,7 +3034,7 @@ class CacheNearNodesTask : public Task
     {
       arg = user_arg;
       name = string( "NKIJ" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       /** We don't know the exact cost here */
       cost = 5.0;
     };
@@ -3069,7 +3057,9 @@ class CacheNearNodesTask : public Task
           auto *src = (*node->morton2node)[ it.first ];
           auto &I = node->gids;
           auto &J = src->gids;
+          double beg = omp_get_wtime();
           it.second = K( I, J );
+          node->setup->kab_cache->Admit( it.second, omp_get_wtime() - beg );
           //printf( "Cache I %lu J %lu\n", I.size(), J.size() ); fflush( stdout );
         }
       }
@@ -3343,7 +3333,7 @@ class DistSkeletonKIJTask : public Task
     {
       arg = user_arg;
       name = string( "par-gskm" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       /** We don't know the exact cost here */
       cost = 5.0;
       /** "High" priority */
@@ -3485,7 +3475,7 @@ class DistSkeletonKIJTask : public Task
 //    {
 //      arg = user_arg;
 //      name = string( "SK" );
-//      label = to_string( arg->treelist_id );
+//      SetLabel( arg->treelist_id );
 //      /** We don't know the exact cost here */
 //      cost = 5.0;
 //      /** "High" priority */
@@ -3547,7 +3537,7 @@ class DistSkeletonizeTask : public hmlp::Task
     {
       arg = user_arg;
       name = string( "PSK" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
 
       /** We don't know the exact cost here */
       cost = 5.0;
@@ -3672,7 +3662,7 @@ class InterpolateTask : public Task
     {
       arg = user_arg;
       name = string( "PROJ" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       // Need an accurate cost model.
       cost = 1.0;
     };
@@ -3942,6 +3932,8 @@ DistData<RIDS, STAR, T> Evaluate( TREE &tree, DistData<RIDS, STAR, T> &weights )
           evaluation_time, evaluation_time * time_ratio );
       printf( "Evaluate (Async) ---------------------- %5.2lfs (%5.2lfs)\n", 
           async_time, overhead_time );
+      printf( "========================================================\n");
+      tree.setup.kab_cache->Report( "KIJ (rank 0)" );
       printf( "========================================================\n\n");
     }
 
@@ -4002,7 +3994,8 @@ DistData<STAR, CBLK, pair<T, size_t>> FindNeighbors
   gofmm::NeighborsTask<NODE, T> NEIGHBORStask;
   TREE rkdt( CommGOFMM );
   rkdt.setup.FromConfiguration( config, K, splitter, NULL );
-  return rkdt.AllNearestNeighbor( n_iter, n, k, init, NEIGHBORStask );
+  return rkdt.AllNearestNeighbor( n_iter, n, k, init, NEIGHBORStask,
+      config.getNeighborConvergence() );
 }; /** end FindNeighbors() */
 
 
@@ -4248,6 +4241,8 @@ mpitree::Tree<mpigofmm::Setup<SPDMATRIX, SPLITTER, T>, gofmm::NodeData<T>>
       printf( "========================================================\n");
       printf( "%5.3lf%% and %5.3lf%% uncompressed--------- %5.2lfs (%5.1lf%%)\n", 
           100 * ratio.first, 100 * ratio.second, compress_time, compress_time * time_ratio );
+      printf( "========================================================\n");
+      tree.setup.kab_cache->Report( "KIJ (rank 0)" );
       printf( "========================================================\n\n");
     }
 
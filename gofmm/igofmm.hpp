@@ -1148,7 +1148,7 @@ class SetupFactorTask : public Task
     {
       arg = user_arg;
       name = string( "sf" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       cost = 1.0;
     };
 
@@ -1221,7 +1221,7 @@ class SolverTreeViewTask : public Task
     {
       arg = user_arg;
       name = string( "TreeView" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       cost = 1.0;
     };
 
@@ -1359,7 +1359,7 @@ class ULVForwardSolveTask : public Task
     {
       arg = user_arg;
       name = string( "ulvforward" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       cost = 1.0;
     };
 
@@ -1397,7 +1397,7 @@ class ULVBackwardSolveTask : public Task
     {
       arg = user_arg;
       name = string( "ulvbackward" );
-      label = std::to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       cost = 1.0;
 
       //printf( "Set treelist_id %lu\n", arg->treelist_id ); fflush( stdout );
@@ -1485,7 +1485,7 @@ class SolveTask : public Task
     {
       arg = user_arg;
       name = string( "sl" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       cost = 1.0;
 
       //printf( "Set treelist_id %lu\n", arg->treelist_id ); fflush( stdout );
@@ -1516,10 +1516,13 @@ class SolveTask : public Task
 
 
 /**
- *
+ *  @brief Solve ( K + lambda * I ) x = input in place. If graph is given,
+ *         the first call records the tasks of both epochs in it, and the
+ *         following calls replay them with setup.input and setup.output
+ *         rebound. The graph must be cleared after the tree changes.
  */ 
 template<typename T, typename TREE>
-hmlpError_t Solve( TREE &tree, Data<T> &input )
+hmlpError_t Solve( TREE &tree, Data<T> &input, TaskGraph *graph = nullptr )
 {
   using NODE = typename TREE::NODE;
 
@@ -1542,7 +1545,15 @@ hmlpError_t Solve( TREE &tree, Data<T> &input )
   tree.setup.input  = &input;
   tree.setup.output = output;
 
-  if ( tree.setup.do_ulv_factorization )
+  /** Run all submitted tasks (and record them if a graph is given). */
+  auto run = [&] () { return graph ? graph->Capture() : hmlp_run(); };
+
+  if ( graph && !graph->IsEmpty() )
+  {
+    /** Tree views read setup.input and setup.output while replaying. */
+    RETURN_IF_ERROR( graph->Replay() );
+  }
+  else if ( tree.setup.do_ulv_factorization )
   {
     /** clean up all dependencies on tree nodes */
     tree.DependencyCleanUp();
@@ -1550,12 +1561,12 @@ hmlpError_t Solve( TREE &tree, Data<T> &input )
     tree.TraverseLeafs( forwardpermutetask );
     tree.TraverseUp( ulvforwardsolvetask );
     tree.TraverseDown( ulvbackwardsolvetask );
-    if ( USE_RUNTIME ) hmlp_run();
+    if ( USE_RUNTIME ) RETURN_IF_ERROR( run() );
 
     /** clean up all dependencies on tree nodes */
     tree.DependencyCleanUp();
     tree.TraverseLeafs( inversepermutetask );
-    if ( USE_RUNTIME ) hmlp_run();
+    if ( USE_RUNTIME ) RETURN_IF_ERROR( run() );
   }
   else
   {
@@ -1564,11 +1575,11 @@ hmlpError_t Solve( TREE &tree, Data<T> &input )
     tree.TraverseDown( treeviewtask );
     tree.TraverseLeafs( forwardpermutetask );
     tree.TraverseUp( solvetask1 );
-    if ( USE_RUNTIME ) hmlp_run();
+    if ( USE_RUNTIME ) RETURN_IF_ERROR( run() );
     /** clean up all dependencies on tree nodes */
     tree.DependencyCleanUp();
     tree.TraverseLeafs( inversepermutetask );
-    if ( USE_RUNTIME ) hmlp_run();
+    if ( USE_RUNTIME ) RETURN_IF_ERROR( run() );
   }
 
   /** delete buffer space */
@@ -1819,7 +1830,7 @@ class FactorizeTask : public Task
     {
       arg = user_arg;
       name = string( "fa" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       // Need an accurate cost model.
       cost = 1.0;
     };
@@ -26,7 +26,7 @@ class DistSetupFactorTask : public Task
     {
       arg = user_arg;
       name = string( "PSF" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
     };
 
     void DependencyAnalysis() { arg->DependOnChildren( this ); };
@@ -96,7 +96,7 @@ class DistFactorizeTask : public Task
     {
       arg = user_arg;
       name = string( "PULVF" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       /** We don't know the exact cost here */
       cost = 5.0;
     };
@@ -179,7 +179,7 @@ class DistFactorTreeViewTask : public Task
     {
       arg = user_arg;
       name = string( "PTV" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       /** We don't know the exact cost here */
       cost = 5.0;
     };
@@ -244,7 +244,7 @@ class DistULVForwardSolveTask : public Task
     {
       arg = user_arg;
       name = string( "PULVS1" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       /** We don't know the exact cost here */
       cost = 5.0;
       /** "High" priority */
@@ -300,7 +300,7 @@ class DistULVBackwardSolveTask : public Task
     {
       arg = user_arg;
       name = string( "PULVS2" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
       /** We don't know the exact cost here */
       cost = 5.0;
       /** "High" priority */
@@ -43,6 +43,7 @@
 #include <hmlp_base.hpp>
 /** Use HMLP primitives. */
 #include <primitives/combinatorics.hpp>
+#include <containers/Cache.hpp>
 /** Use STL and HMLP namespaces. */
 using namespace std;
 using namespace hmlp;
@@ -81,6 +82,27 @@ class MortonHelper
       return Recursor( ( r.first << 1 ) + 1, r.second + 1 ); 
     };
 
+    /** 
+     *  @brief Recur to the child-th kid of a node with 2^bits children. 
+     *         The depth of a MortonID counts bits, not tree levels. 
+     */
+    static Recursor RecurChild( Recursor r, size_t child, size_t bits = 1 ) 
+    { 
+      return Recursor( ( r.first << bits ) + child, r.second + bits ); 
+    };
+
+    /** @return the number of bits per level of a tree with n_children. */
+    static constexpr size_t BitsPerLevel( size_t n_children )
+    {
+      return ( n_children > 1 ) ? 1 + BitsPerLevel( n_children >> 1 ) : 0;
+    };
+
+    /** @return the deepest MortonID (in bits) that can be encoded. */
+    static constexpr size_t MaxDepth() 
+    { 
+      return 8 * sizeof(size_t) - LEVELOFFSET - 1; 
+    };
+
     static size_t MortonID( Recursor r )
     {
       /** Compute the correct shift. */
@@ -183,10 +205,11 @@ class MortonHelper
 
     static size_t Shift( size_t depth )
     {
-      return ( 1 << LEVELOFFSET ) - depth + LEVELOFFSET;
+      return MaxDepth() - depth + LEVELOFFSET;
     }; /** end Shift() */
 
-    const static int LEVELOFFSET = 4;
+    /** The depth takes the lowest 6 bits and the path the 57 bits above. */
+    const static int LEVELOFFSET = 6;
 
 }; /** end class MortonHelper */
   
@@ -209,8 +232,9 @@ bool equal_second( const pair<T, size_t> &a, const pair<T, size_t> &b )
   
   
 
+/** @return whether the neighbor list A has changed. */
 template<typename T>
-void MergeNeighbors( size_t k, pair<T, size_t> *A, 
+bool MergeNeighbors( size_t k, pair<T, size_t> *A, 
     pair<T, size_t> *B, vector<pair<T, size_t>> &aux )
 {
   /* Enlarge temporary buffer if it is too small. */
@@ -226,31 +250,53 @@ void MergeNeighbors( size_t k, pair<T, size_t> *A,
   auto last = unique( aux.begin(), aux.end(), equal_second<T> );
   sort( aux.begin(), last, less_first<T> );
 
-  for ( size_t i = 0; i < k; i++ ) A[ i ] = aux[ i ];
+  bool is_changed = false;
+  for ( size_t i = 0; i < k; i++ ) 
+  {
+    if ( A[ i ].second != aux[ i ].second ) is_changed = true;
+    A[ i ] = aux[ i ];
+  }
+  return is_changed;
 }; /** end MergeNeighbors() */
 
 
+/** 
+ *  @brief Merge B into A (k-by-n). n_changed returns the number of 
+ *         neighbor lists in A that have changed.
+ */ 
 template<typename T>
 hmlpError_t MergeNeighbors( size_t k, size_t n,
-  vector<pair<T, size_t>> &A, vector<pair<T, size_t>> &B )
+  vector<pair<T, size_t>> &A, vector<pair<T, size_t>> &B, size_t &n_changed )
 {
+  n_changed = 0;
   if ( A.size() < n * k || B.size() < n * k )
   {
     return HMLP_ERROR_INVALID_VALUE;
   }
-	#pragma omp parallel
+  size_t count = 0;
+	#pragma omp parallel reduction(+:count)
   {
     vector<pair<T, size_t> > aux( 2 * k );
     #pragma omp for
     for( size_t i = 0; i < n; i++ ) 
     {
-      MergeNeighbors( k, &(A[ i * k ]), &(B[ i * k ]), aux );
+      if ( MergeNeighbors( k, &(A[ i * k ]), &(B[ i * k ]), aux ) ) count ++;
     }
   }
+  n_changed = count;
   return HMLP_ERROR_SUCCESS;
 }; /** end MergeNeighbors() */
 
 
+template<typename T>
+hmlpError_t MergeNeighbors( size_t k, size_t n,
+  vector<pair<T, size_t>> &A, vector<pair<T, size_t>> &B )
+{
+  size_t n_changed = 0;
+  return MergeNeighbors( k, n, A, B, n_changed );
+}; /** end MergeNeighbors() */
+
+
 
 
 
@@ -287,8 +333,7 @@ class IndexPermuteTask : public Task
       arg->DependencyAnalysis( RW, this );
       if ( !arg->isleaf )
       {
-        arg->lchild->DependencyAnalysis( R, this );
-        arg->rchild->DependencyAnalysis( R, this );
+        for ( auto *kid : arg->kids ) kid->DependencyAnalysis( R, this );
       }
       this->TryEnqueue();
     };
@@ -297,15 +342,12 @@ class IndexPermuteTask : public Task
     void Execute( Worker* user_worker )
     {
       auto &gids = arg->gids; 
-      auto *lchild = arg->lchild;
-      auto *rchild = arg->rchild;
       
       if ( !arg->isleaf )
       {
-        auto &lgids = lchild->gids;
-        auto &rgids = rchild->gids;
-        gids = lgids;
-        gids.insert( gids.end(), rgids.begin(), rgids.end() );
+        /** Concatenate the gids of all children in order. */
+        gids.clear();
+        for ( auto *kid : arg->kids ) gids.insert( gids.end(), kid->gids.begin(), kid->gids.end() );
       }
     };
 
@@ -598,16 +640,15 @@ class SplitTask : public Task
 /**
  *  @brief 
  */ 
-//template<typename SETUP, int N_CHILDREN, typename NODEDATA>
-template<typename SETUP, typename NODEDATA>
+template<typename SETUP, typename NODEDATA, int ARITY = 2>
 class Node : public ReadWrite
 {
   public:
 
     /** Deduce data type from SETUP. */
     typedef typename SETUP::T T;
-    /** Use binary trees. */
-    static const int N_CHILDREN = 2;
+    /** Binary trees by default; the splitter must return ARITY groups. */
+    static const int N_CHILDREN = ARITY;
 
     Node( SETUP* setup, size_t n, size_t l, 
         Node *parent, unordered_map<size_t, Node*> *morton2node, Lock *treelock )
@@ -674,7 +715,15 @@ class Node : public ReadWrite
         double splitter_time = omp_get_wtime() - beg;
         //printf( "splitter %5.3lfs\n", splitter_time );
 
-        if ( std::abs( (int)split[ 0 ].size() - (int)split[ 1 ].size() ) > 1 )
+        /** All children must be (almost) equally sized. */
+        size_t min_size = gids.size(), max_size = 0;
+        for ( size_t i = 0; i < N_CHILDREN; i ++ )
+        {
+          min_size = std::min( min_size, split[ i ].size() );
+          max_size = std::max( max_size, split[ i ].size() );
+        }
+
+        if ( max_size - min_size > 1 )
         {
           if ( !has_uneven_split )
           {
@@ -682,15 +731,13 @@ class Node : public ReadWrite
                 split[ 0 ].size(), split[ 1 ].size() );
             has_uneven_split = true;
           }
-          //printf( "split[ 0 ].size() %lu split[ 1 ].size() %lu\n", 
-          //  split[ 0 ].size(), split[ 1 ].size() );
-          split[ 0 ].resize( gids.size() / 2 );
-          split[ 1 ].resize( gids.size() - ( gids.size() / 2 ) );
-          //#pragma omp parallel for
-          for ( size_t i = 0; i < gids.size(); i ++ )
+          /** Split gids into N_CHILDREN contiguous chunks. */
+          for ( size_t i = 0; i < N_CHILDREN; i ++ )
           {
-            if ( i < gids.size() / 2 ) split[ 0 ][ i ] = i;
-            else                       split[ 1 ][ i - ( gids.size() / 2 ) ] = i;
+            size_t beg = ( i + 0 ) * gids.size() / N_CHILDREN;
+            size_t end = ( i + 1 ) * gids.size() / N_CHILDREN;
+            split[ i ].resize( end - beg );
+            for ( size_t j = beg; j < end; j ++ ) split[ i ][ j - beg ] = j;
           }
         }
 
@@ -773,8 +820,7 @@ class Node : public ReadWrite
     /** Support dependency analysis. */
     void DependOnChildren( Task *task )
     {
-      if ( this->lchild ) this->lchild->DependencyAnalysis( R, task );
-      if ( this->rchild ) this->rchild->DependencyAnalysis( R, task );
+      for ( auto *kid : kids ) if ( kid ) kid->DependencyAnalysis( R, task );
       this->DependencyAnalysis( RW, task );
       /** Try to enqueue if there is no dependency. */
       task->TryEnqueue();
@@ -783,8 +829,7 @@ class Node : public ReadWrite
     void DependOnParent( Task *task )
     {
       this->DependencyAnalysis( R, task );
-      if ( this->lchild ) this->lchild->DependencyAnalysis( RW, task );
-      if ( this->rchild ) this->rchild->DependencyAnalysis( RW, task );
+      for ( auto *kid : kids ) if ( kid ) kid->DependencyAnalysis( RW, task );
       /** Try to enqueue if there is no dependency. */
       task->TryEnqueue();
     };
@@ -816,6 +861,9 @@ class Node : public ReadWrite
     /** ID in top-down topology order. */
     size_t treelist_id; 
 
+    /** The socket (affinity domain) whose workers run the tasks of this node. */
+    int affinity = -1;
+
     vector<size_t> gids;
 
     /** These two prunning lists are used when no NN pruning. */
@@ -848,8 +896,8 @@ class Node : public ReadWrite
 
 
     /** DistFar[ p ] contains a pair of gid and cached KIJ received from p. */
-    vector<map<size_t, Data<T>>> DistFar;
-    vector<map<size_t, Data<T>>> DistNear;
+    vector<map<size_t, CachedBlock<T>>> DistFar;
+    vector<map<size_t, CachedBlock<T>>> DistNear;
 
 
 
@@ -858,7 +906,7 @@ class Node : public ReadWrite
     Lock *treelock = NULL;
 
     /** All points to other tree nodes.  */ 
-    Node *kids[ N_CHILDREN ];
+    Node *kids[ N_CHILDREN ] = {};
     Node *lchild  = NULL; 
     Node *rchild  = NULL;
     Node *sibling = NULL;
@@ -951,7 +999,7 @@ class Setup
 
 
 /** */
-template<class SETUP, class NODEDATA>
+template<class SETUP, class NODEDATA, int ARITY = 2>
 class Tree
 {
   public:
@@ -959,9 +1007,15 @@ class Tree
     typedef typename SETUP::T T;
     typedef typename std::pair<T, size_t> neigType;
     /** Define our tree node type as NODE. */
-    typedef Node<SETUP, NODEDATA> NODE;
+    typedef Node<SETUP, NODEDATA, ARITY> NODE;
+
+    static const int N_CHILDREN = NODE::N_CHILDREN;
 
-    static const int N_CHILDREN = 2;
+    /** Each level appends log2( N_CHILDREN ) bits to the MortonID. */
+    static const size_t MORTON_BITS = MortonHelper::BitsPerLevel( N_CHILDREN );
+
+    static_assert( N_CHILDREN > 1 && !( N_CHILDREN & ( N_CHILDREN - 1 ) ),
+        "the number of children must be a power of two" );
 
     /* Data shared by all tree nodes. */
     SETUP setup;
@@ -1003,16 +1057,25 @@ class Tree
 
     size_t getDepth() const noexcept { return loc_depth_; };
 
+    /** @return the position of the first node of local level l in treelist. */
+    size_t getLevelBegin( size_t l ) const noexcept { return level_begin_[ l ]; };
+
+    /** @return the number of nodes of local level l. */
+    size_t getLevelSize( size_t l ) const noexcept 
+    { 
+      return level_begin_[ l + 1 ] - level_begin_[ l ]; 
+    };
+
     /** Currently only used in DrawInteraction() */ 
     void Offset( NODE *node, size_t offset )
     {
       if ( node )
       {
         node->offset = offset;
-        if ( node->lchild )
+        for ( int i = 0; i < N_CHILDREN && node->kids[ i ]; i ++ )
         {
-          Offset( node->lchild, offset + 0 );
-          Offset( node->rchild, offset + node->lchild->gids.size() );
+          Offset( node->kids[ i ], offset );
+          offset += node->kids[ i ]->gids.size();
         }
       }
     }; /** end Offset() */
@@ -1025,10 +1088,12 @@ class Tree
       /** Set my MortonID. */
       node->morton = MortonHelper::MortonID( r );
       /** Recur to children. */
-      RecursiveMorton( node->lchild, MortonHelper::RecurLeft( r ) );
-      RecursiveMorton( node->rchild, MortonHelper::RecurRight( r ) );
-      /** Fill the  */
-      if ( !node->lchild )
+      for ( int i = 0; i < N_CHILDREN; i ++ )
+      {
+        RecursiveMorton( node->kids[ i ], MortonHelper::RecurChild( r, i, MORTON_BITS ) );
+      }
+      /** Fill the MortonID of the points in a leaf. */
+      if ( !node->kids[ 0 ] )
       {
         for ( auto it : node->gids ) setup.morton[ it ] = node->morton;
       }
@@ -1089,8 +1154,8 @@ class Tree
 
     vector<size_t> GetPermutation()
     {
-      int n_nodes = 1 << this->getDepth();
-      auto level_beg = this->treelist.begin() + n_nodes - 1;
+      int n_nodes = getLevelSize( getDepth() );
+      auto level_beg = this->treelist.begin() + getLevelBegin( getDepth() );
 
       vector<size_t> perm;
 
@@ -1150,7 +1215,7 @@ class Tree
       } 
 
       /** Sort neighbor pairs in ascending order. */
-      #pragma omp parallel for
+      #pragma omp parallel for num_threads( hmlp_get_num_workers() )
       for ( size_t j = 0; j < neighbors.col(); j ++ )
       {
         sort( neighbors.data() + j * kappa, neighbors.data() + ( j + 1 ) * kappa );
@@ -1228,8 +1293,8 @@ class Tree
       /** Contain at lesat one tree node. */
       assert( this->treelist.size() );
 
-      int n_nodes = 1 << this->getDepth();
-      auto level_beg = this->treelist.begin() + n_nodes - 1;
+      int n_nodes = getLevelSize( getDepth() );
+      auto level_beg = this->treelist.begin() + getLevelBegin( getDepth() );
 
       if ( out_of_order_traversal )
       {
@@ -1275,8 +1340,8 @@ class Tree
       /** traverse level-by-level in sequential */
       for ( int l = this->getDepth(); l >= local_begin_level; l -- )
       {
-        size_t n_nodes = 1 << l;
-        auto level_beg = this->treelist.begin() + n_nodes - 1;
+        size_t n_nodes = getLevelSize( l );
+        auto level_beg = this->treelist.begin() + getLevelBegin( l );
 
 
         if ( out_of_order_traversal )
@@ -1324,8 +1389,8 @@ class Tree
 
       for ( int l = local_begin_level; l <= this->getDepth(); l ++ )
       {
-        size_t n_nodes = 1 << l;
-        auto level_beg = this->treelist.begin() + n_nodes - 1;
+        size_t n_nodes = getLevelSize( l );
+        auto level_beg = this->treelist.begin() + getLevelBegin( l );
 
         if ( out_of_order_traversal )
         {
@@ -1392,12 +1457,10 @@ class Tree
     template<typename SUMMARY>
     void Summary( SUMMARY &summary )
     {
-      assert( N_CHILDREN == 2 );
-
       for ( std::size_t l = 0; l <= getDepth(); l ++ )
       {
-        size_t n_nodes = 1 << l;
-        auto level_beg = treelist.begin() + n_nodes - 1;
+        size_t n_nodes = getLevelSize( l );
+        auto level_beg = treelist.begin() + getLevelBegin( l );
         for ( size_t node_ind = 0; node_ind < n_nodes; node_ind ++ )
         {
           auto *node = *(level_beg + node_ind);
@@ -1420,6 +1483,9 @@ class Tree
 
     vector<size_t> global_indices;
 
+    /** Local level l occupies treelist[ level_begin_[ l ], level_begin_[ l + 1 ] ). */
+    vector<size_t> level_begin_;
+
 
     /**
      *  @brief Allocate the local tree using the local root
@@ -1431,10 +1497,15 @@ class Tree
      */ 
     hmlpError_t allocateNodes( NODE *root )
     {
-      /* Compute the global tree depth using std::log2(). */
-			glb_depth_ = std::ceil( std::log2( (double)n / setup.getLeafNodeSize() ) );
+      /* The global depth is the fewest levels such that leaves hold at most m points. */
+      glb_depth_ = 0;
+      for ( size_t capacity = setup.getLeafNodeSize(); capacity < n; capacity *= N_CHILDREN ) 
+        glb_depth_ ++;
 			/* If the global depth exceeds the limit, then set it to the maximum depth. */
 			if ( glb_depth_ > setup.getMaximumDepth() ) glb_depth_ = setup.getMaximumDepth();
+      /* MortonIDs can not encode deeper trees. */
+      if ( glb_depth_ * MORTON_BITS > MortonHelper::MaxDepth() ) 
+        glb_depth_ = MortonHelper::MaxDepth() / MORTON_BITS;
 			/** Compute the local tree depth. */
 			loc_depth_ = glb_depth_ - root->l;
 
@@ -1443,7 +1514,7 @@ class Tree
       for ( auto node_ptr : treelist ) delete node_ptr;
       treelist.clear();
       morton2node.clear();
-      treelist.reserve( 1 << ( getDepth() + 1 ) );
+      level_begin_.clear();
       deque<NODE*> treequeue;
       /** Push root into the treelist. */
       treequeue.push_back( root );
@@ -1454,6 +1525,8 @@ class Tree
       {
         /** Assign local treenode_id. */
         node->treelist_id = treelist.size();
+        /** BFS visits levels in order; record where each level begins. */
+        if ( node->l - root->l == level_begin_.size() ) level_begin_.push_back( treelist.size() );
         /** Account for the depth of the distributed tree. */
         if ( node->l < glb_depth_ )
         {
@@ -1476,6 +1549,16 @@ class Tree
         treelist.push_back( node );
         treequeue.pop_front();
       }
+      /** Close the last level. */
+      level_begin_.push_back( treelist.size() );
+
+      /** Map subtrees to sockets, such that per-node buffers are first-touched there. */
+      for ( auto *node : treelist )
+      {
+        size_t l = node->l - root->l;
+        node->affinity = numa::getTreeNodeAffinity( getLevelSize( l ),
+            node->treelist_id - getLevelBegin( l ), N_CHILDREN );
+      }
 
       /* Return with no error. */
       return HMLP_ERROR_SUCCESS;
@@ -211,7 +211,7 @@ class DistSplitTask : public Task
     {
       arg = user_arg;
       name = string( "DistSplit" );
-      label = to_string( arg->treelist_id );
+      SetLabel( arg->treelist_id );
 
       double flops = 6.0 * arg->n;
       double  mops = 6.0 * arg->n;
@@ -797,11 +797,17 @@ class Tree : public tree::Tree<SETUP, NODEDATA>,
 
 
 
-    /** Perform approximate kappa neighbor search. */
+    /** 
+     *  @brief Perform approximate kappa neighbor search. Iterations are
+     *         pipelined: the CIDS to CBLK redistribution of iteration t
+     *         is overlapped with the tree partitioning of iteration t + 1.
+     *         The search stops early if the fraction of neighbor lists 
+     *         changed by an iteration is no larger than convergence.
+     */
     template<typename KNNTASK>
     DistData<STAR, CBLK, pair<T, size_t>>
     AllNearestNeighbor( size_t n_tree, size_t n, size_t k,
-      pair<T, size_t> initNN, KNNTASK &dummy )
+      pair<T, size_t> initNN, KNNTASK &dummy, T convergence = 0 )
     {
       mpi::PrintProgress( "[BEG] NeighborSearch ...", this->GetComm() );
 
@@ -846,91 +852,55 @@ class Tree : public tree::Tree<SETUP, NODEDATA>,
       AllocateNodes( gids );
 
 
-      /** Metric tree partitioning. */
+      using Q_CBLK = DistData<STAR, CBLK, pair<T, size_t>>;
+      using ALLOCATOR = typename Q_CBLK::ALLOCATOR;
+
+      /** Metric tree partitioning (the first stage of the pipeline). */
       DistSplitTask<MPINODE> mpisplittask;
       tree::SplitTask<NODE>  seqsplittask;
+      DistTraverseDown( mpisplittask );
+      LocaTraverseDown( seqsplittask );
+      ExecuteAllTasks();
+
       for ( size_t t = 0; t < n_tree; t ++ )
       {
-        DistTraverseDown( mpisplittask );
-        LocaTraverseDown( seqsplittask );
-        ExecuteAllTasks();
-        
-        /** Query neighbors computed in CIDS distribution.  */
-        DistData<STAR, CIDS, pair<T, size_t>> Q_cids( k, this->n, this->treelist[ 0 ]->gids, initNN, this->GetComm() );
+        /** 
+         *  Query neighbors computed in CIDS distribution. Use the private
+         *  communicator such that the nonblocking redistribution will not
+         *  interfere with collectives of the tree partitioning.
+         */
+        DistData<STAR, CIDS, pair<T, size_t>> Q_cids( k, this->n, 
+            this->treelist[ 0 ]->gids, initNN, this->GetPrivateComm() );
         /** Pass in neighbor pointer. */
         this->setup.NN = &Q_cids;
         LocaTraverseLeafs( dummy );
         ExecuteAllTasks();
 
         /** Queries computed in CBLK distribution */
-        DistData<STAR, CBLK, pair<T, size_t>> Q_cblk( k, this->n, this->GetComm() );
-        /** Redistribute from CIDS to CBLK */
-        Q_cblk = Q_cids;
-        /** Merge Q_cblk into NN (sort and remove duplication) */
-        assert( Q_cblk.col_owned() == NN.col_owned() );
-        MergeNeighbors( k, NN.col_owned(), NN, Q_cblk );
-      }
-
-
-
-
+        Q_CBLK Q_cblk( k, this->n, this->GetPrivateComm() );
+        /** Start redistributing from CIDS to CBLK. */
+        RedistributionRequest<pair<T, size_t>, ALLOCATOR> request;
+        Q_cblk.RedistributeBegin( Q_cids, request );
 
+        /** Partition the tree for the next iteration in the meantime. */
+        if ( t + 1 < n_tree )
+        {
+          DistTraverseDown( mpisplittask );
+          LocaTraverseDown( seqsplittask );
+          ExecuteAllTasks();
+        }
 
+        /** Complete the redistribution. */
+        request.Wait();
+        /** Merge Q_cblk into NN (sort and remove duplication) */
+        assert( Q_cblk.col_owned() == NN.col_owned() );
+        size_t n_changed = 0, n_changed_total = 0;
+        HANDLE_ERROR( MergeNeighbors( k, NN.col_owned(), NN, Q_cblk, n_changed ) );
 
-//      /** Metric tree partitioning. */
-//      DistSplitTask<MPINODE> mpisplittask;
-//      tree::SplitTask<NODE>  seqsplittask;
-//      DependencyCleanUp();
-//      DistTraverseDown( mpisplittask );
-//      LocaTraverseDown( seqsplittask );
-//      ExecuteAllTasks();
-//
-//
-//      for ( size_t t = 0; t < n_tree; t ++ )
-//      {
-//        this->Barrier();
-//        //if ( this->GetCommRank() == 0 ) printf( "Iteration #%lu\n", t );
-//
-//        /** Query neighbors computed in CIDS distribution.  */
-//        DistData<STAR, CIDS, pair<T, size_t>> Q_cids( k, this->n, 
-//            this->treelist[ 0 ]->gids, initNN, this->GetComm() );
-//        /** Pass in neighbor pointer. */
-//        this->setup.NN = &Q_cids;
-//        /** Overlap */
-//        if ( t != n_tree - 1 )
-//        {
-//          //DependencyCleanUp();
-//          DistTraverseDown( mpisplittask );
-//          ExecuteAllTasks();
-//        }
-//        mpi::PrintProgress( "[MID] Here ...", this->GetComm() );
-//        DependencyCleanUp();
-//        LocaTraverseLeafs( dummy );
-//        LocaTraverseDown( seqsplittask );
-//        ExecuteAllTasks();
-//        mpi::PrintProgress( "[MID] Here 22...", this->GetComm() );
-//
-//        if ( t == 0 )
-//        {
-//          /** Redistribute from CIDS to CBLK */
-//          NN = Q_cids; 
-//        }
-//        else
-//        {
-//          /** Queries computed in CBLK distribution */
-//          DistData<STAR, CBLK, pair<T, size_t>> Q_cblk( k, this->n, this->GetComm() );
-//          /** Redistribute from CIDS to CBLK */
-//          Q_cblk = Q_cids;
-//          /** Merge Q_cblk into NN (sort and remove duplication) */
-//          assert( Q_cblk.col_owned() == NN.col_owned() );
-//          MergeNeighbors( k, NN.col_owned(), NN, Q_cblk );
-//        }
-//
-//        //double mer_time = omp_get_wtime() - beg;
-//
-//        //if ( rank == 0 )
-//        //printf( "%lfs %lfs %lfs\n", mpi_time, seq_time, mer_time ); fflush( stdout );
-//      }
+        /** Early termination if neighbor lists have converged. */
+        mpi::Allreduce( &n_changed, &n_changed_total, 1, MPI_SUM, this->GetComm() );
+        if ( n_changed_total <= convergence * n ) break;
+      }
 
       /** Check for illegle values. */
       for ( auto &neig : NN )
@@ -1246,8 +1216,8 @@ class Tree : public tree::Tree<SETUP, NODEDATA>,
 
       for ( int l = this->getDepth(); l >= 1; l -- )
       {
-        size_t n_nodes = 1 << l;
-        auto level_beg = this->treelist.begin() + n_nodes - 1;
+        size_t n_nodes = this->getLevelSize( l );
+        auto level_beg = this->treelist.begin() + this->getLevelBegin( l );
 
         /** loop over each node at level-l */
         for ( size_t node_ind = 0; node_ind < n_nodes; node_ind ++ )
@@ -1288,8 +1258,8 @@ class Tree : public tree::Tree<SETUP, NODEDATA>,
        */
       for ( int l = 1; l <= this->getDepth(); l ++ )
       {
-        size_t n_nodes = 1 << l;
-        auto level_beg = this->treelist.begin() + n_nodes - 1;
+        size_t n_nodes = this->getLevelSize( l );
+        auto level_beg = this->treelist.begin() + this->getLevelBegin( l );
 
         for ( size_t node_ind = 0; node_ind < n_nodes; node_ind ++ )
         {
@@ -1326,8 +1296,8 @@ class Tree : public tree::Tree<SETUP, NODEDATA>,
       /** contain at lesat one tree node */
       assert( this->treelist.size() );
 
-      int n_nodes = 1 << this->getDepth();
-      auto level_beg = this->treelist.begin() + n_nodes - 1;
+      int n_nodes = this->getLevelSize( this->getDepth() );
+      auto level_beg = this->treelist.begin() + this->getLevelBegin( this->getDepth() );
 
       for ( int node_ind = 0; node_ind < n_nodes; node_ind ++ )
       {
@@ -54,6 +54,7 @@ hmlpError_t hmlp_init( int *argc, char ***argv, MPI_Comm comm );
 hmlpError_t hmlp_init();
 hmlpError_t hmlp_init( MPI_Comm comm );
 hmlpError_t hmlp_set_num_workers( int n_worker );
+int hmlp_get_num_workers();
 hmlpError_t hmlp_run();
 hmlpError_t hmlp_finalize();
 
@@ -149,56 +150,69 @@ void dconv2d_ref
 
 
 
-//void gsks
-//(
-//  kernel_s<double> *kernel,
-//  int m, int n, int k,
-//  double *u,             int *umap,
-//  double *A, double *A2, int *amap,
-//  double *B, double *B2, int *bmap,
-//  double *w,             int *wmap
-//);
-//
-//void gsks
-//(
-//  kernel_s<float> *kernel,
-//  int m, int n, int k,
-//  float *u,            int *umap,
-//  float *A, float *A2, int *amap,
-//  float *B, float *B2, int *bmap,
-//  float *w,            int *wmap
-//);
-//
-//void dgsks
-//(
-//  kernel_s<double> *kernel,
-//  int m, int n, int k,
-//  double *u,             int *umap,
-//  double *A, double *A2, int *amap,
-//  double *B, double *B2, int *bmap,
-//  double *w,             int *wmap
-//);
-//
-//void sgsks
-//(
-//  kernel_s<float> *kernel,
-//  int m, int n, int k,
-//  float *u,            int *umap,
-//  float *A, float *A2, int *amap,
-//  float *B, float *B2, int *bmap,
-//  float *w,            int *wmap
-//);
-//
-//void dgsks_ref
-//(
-//  kernel_s<double> *kernel,
-//  int m, int n, int k,
-//  double *u,             int *umap,
-//  double *A, double *A2, int *amap,
-//  double *B, double *B2, int *bmap,
-//  double *w,             int *wmap
-//);
-//
+/** Forward declaration of the kernel function (see KernelMatrix.hpp). */
+namespace hmlp { template<typename T, typename TP> struct kernel_s; };
+
+hmlpError_t gsks
+(
+  hmlp::kernel_s<float, float> *kernel,
+  int m, int n, int k,
+  float *u,            int *umap,
+  float *A, float *A2, int *amap,
+  float *B, float *B2, int *bmap,
+  float *w,            int *wmap
+);
+
+hmlpError_t gsks
+(
+  hmlp::kernel_s<double, double> *kernel,
+  int m, int n, int k,
+  double *u,             int *umap,
+  double *A, double *A2, int *amap,
+  double *B, double *B2, int *bmap,
+  double *w,             int *wmap
+);
+
+hmlpError_t sgsks
+(
+  hmlp::kernel_s<float, float> *kernel,
+  int m, int n, int k,
+  float *u,            int *umap,
+  float *A, float *A2, int *amap,
+  float *B, float *B2, int *bmap,
+  float *w,            int *wmap
+);
+
+hmlpError_t dgsks
+(
+  hmlp::kernel_s<double, double> *kernel,
+  int m, int n, int k,
+  double *u,             int *umap,
+  double *A, double *A2, int *amap,
+  double *B, double *B2, int *bmap,
+  double *w,             int *wmap
+);
+
+hmlpError_t sgsks_ref
+(
+  hmlp::kernel_s<float, float> *kernel,
+  int m, int n, int k,
+  float *u,            int *umap,
+  float *A, float *A2, int *amap,
+  float *B, float *B2, int *bmap,
+  float *w,            int *wmap
+);
+
+hmlpError_t dgsks_ref
+(
+  hmlp::kernel_s<double, double> *kernel,
+  int m, int n, int k,
+  double *u,             int *umap,
+  double *A, double *A2, int *amap,
+  double *B, double *B2, int *bmap,
+  double *w,             int *wmap
+);
+
 void dgsknn
 (
   int m, int n, int k, int r,
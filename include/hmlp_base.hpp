@@ -5,6 +5,8 @@
 /** Use matrix view to employ SuperMatrix style task parallelism. */
 #include <base/View.hpp>
 #include <base/thread.hpp>
+#include <base/tuner.hpp>
+#include <base/numa.hpp>
 /** Use Thread Control Interface (TCI). */
 #include <base/tci.hpp>
 #include <base/hmlp_packing.hpp>
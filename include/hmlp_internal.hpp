@@ -30,6 +30,24 @@
 
 #define restrict __restrict__
 
+/**
+ *  In the runtime-dispatch build (HMLP_ARCH_MINOR=dispatch) the packages of
+ *  all x86_64 architectures are linked into one library. Each package is
+ *  compiled with -DHMLP_DISPATCH_ARCH=<arch> such that its symbols move to
+ *  hmlp::<arch>, and package/x86_64/dispatch forwards the public API to the
+ *  package selected at hmlp_init(). HMLP_PACKAGE qualifies calls between
+ *  the functions of the same package.
+ */
+#ifdef HMLP_DISPATCH_ARCH
+#define HMLP_PACKAGE_BEGIN namespace hmlp { namespace HMLP_DISPATCH_ARCH {
+#define HMLP_PACKAGE_END   }; };
+#define HMLP_PACKAGE       hmlp::HMLP_DISPATCH_ARCH
+#else
+#define HMLP_PACKAGE_BEGIN
+#define HMLP_PACKAGE_END
+#define HMLP_PACKAGE
+#endif
+
 
 typedef unsigned long long dim_t;
 typedef unsigned long long inc_t;
@@ -122,10 +140,29 @@ struct aux_s
     aux_s<type, type, type, type> *aux \
   )                                    \
 
+/**
+ *  @brief STRA_OPERATOR of a micro-kernel without a dedicated Strassen
+ *         implementation. The rank-k update a' * b goes to a register tile
+ *         through the GEMM_OPERATOR of the same micro-kernel, and the tile
+ *         is then accumulated to every C in c_list with its own alpha.
+ */
+#define STRA_OPERATOR_BY_GEMM(type)                                    \
+  STRA_OPERATOR(type) const                                            \
+  {                                                                    \
+    type ctmp[ mr * nr ] __attribute__((aligned(64)));                 \
+    aux_s<type, type, type, type> aux_gemm = *aux;                     \
+    aux_gemm.pc = 0;                                                   \
+    (*this)( (dim_t)k, a, b, ctmp, (inc_t)1, (inc_t)mr, &aux_gemm );   \
+    for ( int l = 0; l < len; l ++ )                                   \
+      for ( size_t j = 0; j < nr; j ++ )                               \
+        for ( size_t i = 0; i < mr; i ++ )                             \
+          c_list[ l ][ j * ldc + i ] += alpha_list[ l ] * ctmp[ j * mr + i ]; \
+  }                                                                    \
+
 #define GSKS_OPERATOR(type)            \
   void operator()                      \
   (                                    \
-    kernel_s<type> *ker,               \
+    kernel_s<type, type> *ker,         \
     int k,                             \
     int rhs,                           \
     type *u,                           \
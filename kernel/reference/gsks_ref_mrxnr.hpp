@@ -2,6 +2,7 @@
 #define GSKS_REF_MRXNR_HPP
 
 #include <KernelMatrix.hpp>
+#include <primitives/gsks.hpp>
 
 using namespace std;
 using namespace hmlp;
@@ -46,40 +47,62 @@ struct gsks_ref_mrxnr
           c_reg[ j * MR + i ] += c[ j * ldc + i ];
     }
 
-    switch ( kernel->type )
-    {
-      case GAUSSIAN:
-      {
-        #pragma unroll
-        for ( int j = 0; j < NR; j ++ )
-        {
-          #pragma unroll
-          for ( int i = 0; i < MR; i ++ ) 
-          {
-            c_reg[ j * MR + i ] *= -2.0;
-            c_reg[ j * MR + i ] += a2[ i ] + b2[ j ];
-            c_reg[ j * MR + i ] *= kernel->scal;
-            c_reg[ j * MR + i ]  = std::exp( c_reg[ j * MR + i ] );
-          }
-        }
-        break;
-      }
-      default:
-      {
-        exit( 1 );
-      }
-    }
+    /** c_reg = K( a, b ) */
+    gsks::evaluate_kernel( kernel, aux->ib, aux->jb, c_reg, MR, a2, b2, aux->hi, aux->hj );
 
     /** matrix-vector multiplication */
-    #pragma unroll
-    for ( int j = 0; j < NR; j ++ )
-      #pragma unroll
-      for ( int i = 0; i < MR; i ++ ) 
+    for ( int j = 0; j < aux->jb; j ++ )
+      for ( int i = 0; i < aux->ib; i ++ ) 
         u[ i ] += c_reg[ j * MR + i ] * w[ j ];
 
   }; /** end inline void operator */
 }; /** end struct gsks_ref_mrxnr */
 
+
+/**
+ *  @brief A fused microkernel for all kernel types. The rank-k update is
+ *         delegated to SEMIRINGKERNEL (e.g. the BLIS assembly kernel of
+ *         the architecture), and the kernel evaluation and the weighted
+ *         sum are applied to the MR-by-NR register tile afterwards.
+ */
+template<typename SEMIRINGKERNEL, typename T>
+struct gsks_mrxnr
+{
+  const static size_t mr         = SEMIRINGKERNEL::mr;
+  const static size_t nr         = SEMIRINGKERNEL::nr;
+  const static size_t pack_mr    = SEMIRINGKERNEL::pack_mr;
+  const static size_t pack_nr    = SEMIRINGKERNEL::pack_nr;
+  const static size_t align_size = SEMIRINGKERNEL::align_size;
+  const static bool   row_major  = false;
+
+  SEMIRINGKERNEL semiringkernel;
+
+  inline GSKS_OPERATOR(T) const
+  {
+    T ctmp[ mr * nr ] __attribute__((aligned(64)));
+
+    /** If pc, then c != NULL. We copy c to ctmp. */
+    if ( aux->pc )
+    {
+      for ( int j = 0; j < aux->jb; j ++ )
+        for ( int i = 0; i < aux->ib; i ++ )
+          ctmp[ j * mr + i ] = c[ j * ldc + i ];
+    }
+
+    /** ctmp = a' * b (+ ctmp if pc) */
+    semiringkernel( k, a, b, ctmp, 1, mr, aux );
+
+    /** ctmp = K( a, b ) */
+    gsks::evaluate_kernel( ker, aux->ib, aux->jb, ctmp, (int)mr, aa, bb, aux->hi, aux->hj );
+
+    /** u += K( a, b ) * w */
+    for ( int j = 0; j < aux->jb; j ++ )
+      for ( int i = 0; i < aux->ib; i ++ )
+        u[ i ] += ctmp[ j * mr + i ] * w[ j ];
+  };
+
+}; /** end struct gsks_mrxnr */
+
 }; /** end namespace hmlp */
 
 #endif /** define GSKS_REF_MRXNR_HPP */
@@ -17,11 +17,7 @@ struct rank_k_asm_s16x6
   const static size_t align_size = 32;
   const static bool   row_major  = false;
 
-  inline STRA_OPERATOR(float) const
-  {
-    printf( "no STRA_OPERATOR implementation\n" );
-    exit( 1 );
-  };
+  inline STRA_OPERATOR_BY_GEMM(float)
 
   inline GEMM_OPERATOR(float) const
   {
@@ -102,11 +98,7 @@ struct rank_k_asm_d8x6
   const static size_t align_size = 32;
   const static bool   row_major  = false;
 
-  inline STRA_OPERATOR(double) const
-  {
-    printf( "no STRA_OPERATOR implementation\n" );
-    exit( 1 );
-  };
+  inline STRA_OPERATOR_BY_GEMM(double)
 
   inline GEMM_OPERATOR(double) const
   {
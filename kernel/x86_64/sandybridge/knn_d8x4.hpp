@@ -5,7 +5,7 @@
 #include <immintrin.h> 
 
 #include <hmlp.h>
-#include <hmlp_util.hpp>
+#include <base/util.hpp>
 #include <hmlp_internal.hpp>
 #include <primitives/gsknn.hpp>
 #include <avx_type.h> // self-defined vector type
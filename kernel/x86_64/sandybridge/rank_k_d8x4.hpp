@@ -24,11 +24,7 @@ struct rank_k_asm_s8x8
 
 
   /** defined in hmlp_internal.hpp */
-  inline STRA_OPERATOR(float) const
-  {
-    printf( "no implementation\n" );
-    exit( 1 );
-  };
+  inline STRA_OPERATOR_BY_GEMM(float)
 
   inline GEMM_OPERATOR(float) const
   {
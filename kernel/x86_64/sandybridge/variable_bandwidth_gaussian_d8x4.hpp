@@ -13,7 +13,7 @@ struct variable_bandwidth_gaussian_ref_d8x4
   inline void operator()
   (
     //ks_t *kernel,
-    kernel_s<double> *kernel,
+    kernel_s<double, double> *kernel,
     int k,
     int nrhs,
     double *u,
@@ -100,7 +100,7 @@ struct variable_bandwidth_gaussian_int_d8x4
   inline void operator()
   (
     //ks_t *ker,
-    kernel_s<double> *ker,
+    kernel_s<double, double> *ker,
     int k,
     int rhs,
     double *u,
@@ -22,12 +22,12 @@ struct gsks_gaussian_int_s12x32
 
 struct gsks_gaussian_int_d12x16
 {
-  const size_t mr         = 16;
-  const size_t nr         = 12;
-  const size_t pack_mr    = 16;
-  const size_t pack_nr    = 12;
-  const size_t align_size = 64;
-  const bool   row_major  = false;
+  const static size_t mr         = 16;
+  const static size_t nr         = 12;
+  const static size_t pack_mr    = 16;
+  const static size_t pack_nr    = 12;
+  const static size_t align_size = 64;
+  const static bool   row_major  = false;
 
 
   //inline void operator()
@@ -16,11 +16,7 @@ struct rank_k_opt_s12x32
   const static size_t align_size = 64;
   const static bool   row_major  = true;
 
-  inline STRA_OPERATOR(float) const
-  {
-    printf( "no STRA_OPERATOR implementation\n" );
-    exit( 1 );
-  };
+  inline STRA_OPERATOR_BY_GEMM(float)
 
   inline GEMM_OPERATOR(float) const
   {
@@ -135,11 +131,7 @@ struct rank_k_opt_d6x32
   const static size_t align_size = 64;
   const static bool   row_major  = true;
 
-  inline STRA_OPERATOR(double) const
-  {
-    printf( "no STRA_OPERATOR implementation\n" );
-    exit( 1 );
-  };
+  inline STRA_OPERATOR_BY_GEMM(double)
 
   inline GEMM_OPERATOR(double) const
   {
@@ -0,0 +1,350 @@
+/**
+ *  HMLP (High-Performance Machine Learning Primitives)
+ *
+ *  Copyright (C) 2014-2018, The University of Texas at Austin
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see the LICENSE file.
+ *
+ **/
+
+/**
+ *  Runtime dispatch (HMLP_ARCH_MINOR=dispatch): the sandybridge, haswell and
+ *  skx packages are all linked into the library, each in its own namespace
+ *  (see HMLP_PACKAGE_BEGIN in hmlp_internal.hpp) with its own blocking
+ *  parameters. The public API below forwards every call to the package of
+ *  the architecture selected by hmlp_init() (hmlp::arch::select()). If the
+ *  selected architecture has no package for a primitive, then the package
+ *  of the most capable older architecture is used instead.
+ */
+
+#include <hmlp.h>
+#include <hmlp_internal.hpp>
+#include <base/arch.hpp>
+
+#define CONV2D_ARGS( T ) int w0, int h0, int d0, int s, int p, int batchSize, T *B, int w1, int h1, int d1, T *A, T *C
+#define CONV2D_CALL w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C
+#define GKMX_ARGS( T ) hmlpOperation_t transA, hmlpOperation_t transB, int m, int n, int k, double *A, int lda, double *B, int ldb, T *C, int ldc
+#define GKMX_CALL transA, transB, m, n, k, A, lda, B, ldb, C, ldc
+#define GNBX_ARGS( T ) int m, int n, int k, T *A, int lda, T *B, int ldb, T *C, int ldc
+#define GNBX_CALL m, n, k, A, lda, B, ldb, C, ldc
+#define GSKNN_ARGS( T ) int m, int n, int k, int r, T *A, T *A2, int *amap, T *B, T *B2, int *bmap, T *D, int *I
+#define GSKNN_CALL m, n, k, r, A, A2, amap, B, B2, bmap, D, I
+#define GSKS_ARGS( T ) hmlp::kernel_s<T, T> *kernel, int m, int n, int k, T *u, int *umap, T *A, T *A2, int *amap, T *B, T *B2, int *bmap, T *w, int *wmap
+#define GSKS_CALL kernel, m, n, k, u, umap, A, A2, amap, B, B2, bmap, w, wmap
+#define STRASSEN_ARGS( T ) hmlpOperation_t transA, hmlpOperation_t transB, int m, int n, int k, T *A, int lda, T *B, int ldb, T *C, int ldc
+#define STRASSEN_CALL transA, transB, m, n, k, A, lda, B, ldb, C, ldc
+#define NBODY_ARGS( T ) GNBX_ARGS( T )
+#define NBODY_CALL GNBX_CALL
+
+/** Forward declarations of the packages. */
+namespace hmlp
+{
+namespace sandybridge
+{
+void conv2d( CONV2D_ARGS( float ) );
+void conv2d( CONV2D_ARGS( double ) );
+void dconv2d( CONV2D_ARGS( float ) );
+void dconv2d( CONV2D_ARGS( double ) );
+void dconv2d_ref( CONV2D_ARGS( double ) );
+void gkmx_dfma( GKMX_ARGS( double ) );
+void gkmx_dfma_simple( GKMX_ARGS( double ) );
+void gkmx_mixfma_simple( GKMX_ARGS( float ) );
+void gnbx( GNBX_ARGS( float ) );
+void gnbx( GNBX_ARGS( double ) );
+void gsknn( GSKNN_ARGS( double ) );
+void gsknn( GSKNN_ARGS( float ) );
+void dgsknn_ref( GSKNN_ARGS( double ) );
+hmlpError_t gsks( GSKS_ARGS( float ) );
+hmlpError_t gsks( GSKS_ARGS( double ) );
+hmlpError_t sgsks( GSKS_ARGS( float ) );
+hmlpError_t dgsks( GSKS_ARGS( double ) );
+hmlpError_t sgsks_ref( GSKS_ARGS( float ) );
+hmlpError_t dgsks_ref( GSKS_ARGS( double ) );
+void strassen( STRASSEN_ARGS( float ) );
+void strassen( STRASSEN_ARGS( double ) );
+void sstrassen( STRASSEN_ARGS( float ) );
+void dstrassen( STRASSEN_ARGS( double ) );
+}; /* end namespace sandybridge */
+namespace haswell
+{
+void conv2d( CONV2D_ARGS( float ) );
+void conv2d( CONV2D_ARGS( double ) );
+void dconv2d( CONV2D_ARGS( float ) );
+void dconv2d( CONV2D_ARGS( double ) );
+void dconv2d_ref( CONV2D_ARGS( double ) );
+void gkmx_dfma( GKMX_ARGS( double ) );
+void gkmx_dfma_simple( GKMX_ARGS( double ) );
+void gkmx_mixfma_simple( GKMX_ARGS( float ) );
+void gnbx( GNBX_ARGS( float ) );
+void gnbx( GNBX_ARGS( double ) );
+void gnbx_simple( GNBX_ARGS( double ) );
+hmlpError_t gsks( GSKS_ARGS( float ) );
+hmlpError_t gsks( GSKS_ARGS( double ) );
+hmlpError_t sgsks( GSKS_ARGS( float ) );
+hmlpError_t dgsks( GSKS_ARGS( double ) );
+hmlpError_t sgsks_ref( GSKS_ARGS( float ) );
+hmlpError_t dgsks_ref( GSKS_ARGS( double ) );
+void nbody( NBODY_ARGS( float ) );
+void nbody( NBODY_ARGS( double ) );
+void strassen( STRASSEN_ARGS( float ) );
+void strassen( STRASSEN_ARGS( double ) );
+void sstrassen( STRASSEN_ARGS( float ) );
+void dstrassen( STRASSEN_ARGS( double ) );
+}; /* end namespace haswell */
+namespace skx
+{
+void gnbx( GNBX_ARGS( float ) );
+void gnbx( GNBX_ARGS( double ) );
+hmlpError_t gsks( GSKS_ARGS( float ) );
+hmlpError_t gsks( GSKS_ARGS( double ) );
+hmlpError_t sgsks( GSKS_ARGS( float ) );
+hmlpError_t dgsks( GSKS_ARGS( double ) );
+hmlpError_t sgsks_ref( GSKS_ARGS( float ) );
+hmlpError_t dgsks_ref( GSKS_ARGS( double ) );
+void nbody( NBODY_ARGS( float ) );
+void nbody( NBODY_ARGS( double ) );
+}; /* end namespace skx */
+}; /* end namespace hmlp */
+
+using namespace hmlp;
+
+void conv2d( CONV2D_ARGS( float ) )
+{
+  switch ( arch::getPackage( "conv2d", { HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_HASWELL: return haswell::conv2d( CONV2D_CALL );
+    default:                return sandybridge::conv2d( CONV2D_CALL );
+  }
+};
+
+void conv2d( CONV2D_ARGS( double ) )
+{
+  switch ( arch::getPackage( "conv2d", { HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_HASWELL: return haswell::conv2d( CONV2D_CALL );
+    default:                return sandybridge::conv2d( CONV2D_CALL );
+  }
+};
+
+void dconv2d( CONV2D_ARGS( float ) )
+{
+  switch ( arch::getPackage( "dconv2d", { HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_HASWELL: return haswell::dconv2d( CONV2D_CALL );
+    default:                return sandybridge::dconv2d( CONV2D_CALL );
+  }
+};
+
+void dconv2d( CONV2D_ARGS( double ) )
+{
+  switch ( arch::getPackage( "dconv2d", { HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_HASWELL: return haswell::dconv2d( CONV2D_CALL );
+    default:                return sandybridge::dconv2d( CONV2D_CALL );
+  }
+};
+
+void dconv2d_ref( CONV2D_ARGS( double ) )
+{
+  switch ( arch::getPackage( "dconv2d_ref", { HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_HASWELL: return haswell::dconv2d_ref( CONV2D_CALL );
+    default:                return sandybridge::dconv2d_ref( CONV2D_CALL );
+  }
+};
+
+void gkmx_dfma( GKMX_ARGS( double ) )
+{
+  switch ( arch::getPackage( "gkmx_dfma", { HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_HASWELL: return haswell::gkmx_dfma( GKMX_CALL );
+    default:                return sandybridge::gkmx_dfma( GKMX_CALL );
+  }
+};
+
+void gkmx_dfma_simple( GKMX_ARGS( double ) )
+{
+  switch ( arch::getPackage( "gkmx_dfma_simple", { HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_HASWELL: return haswell::gkmx_dfma_simple( GKMX_CALL );
+    default:                return sandybridge::gkmx_dfma_simple( GKMX_CALL );
+  }
+};
+
+void gkmx_mixfma_simple( GKMX_ARGS( float ) )
+{
+  switch ( arch::getPackage( "gkmx_mixfma_simple", { HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_HASWELL: return haswell::gkmx_mixfma_simple( GKMX_CALL );
+    default:                return sandybridge::gkmx_mixfma_simple( GKMX_CALL );
+  }
+};
+
+void gnbx( GNBX_ARGS( float ) )
+{
+  switch ( arch::getPackage( "gnbx", { HMLP_ARCH_SKX, HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_SKX:     return skx::gnbx( GNBX_CALL );
+    case HMLP_ARCH_HASWELL: return haswell::gnbx( GNBX_CALL );
+    default:                return sandybridge::gnbx( GNBX_CALL );
+  }
+};
+
+void gnbx( GNBX_ARGS( double ) )
+{
+  switch ( arch::getPackage( "gnbx", { HMLP_ARCH_SKX, HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_SKX:     return skx::gnbx( GNBX_CALL );
+    case HMLP_ARCH_HASWELL: return haswell::gnbx( GNBX_CALL );
+    default:                return sandybridge::gnbx( GNBX_CALL );
+  }
+};
+
+void gnbx_simple( GNBX_ARGS( double ) )
+{
+  arch::getPackage( "gnbx_simple", { HMLP_ARCH_HASWELL } );
+  haswell::gnbx_simple( GNBX_CALL );
+};
+
+void gsknn( GSKNN_ARGS( double ) )
+{
+  arch::getPackage( "gsknn", { HMLP_ARCH_SANDYBRIDGE } );
+  sandybridge::gsknn( GSKNN_CALL );
+};
+
+void gsknn( GSKNN_ARGS( float ) )
+{
+  arch::getPackage( "gsknn", { HMLP_ARCH_SANDYBRIDGE } );
+  sandybridge::gsknn( GSKNN_CALL );
+};
+
+void dgsknn_ref( GSKNN_ARGS( double ) )
+{
+  arch::getPackage( "dgsknn_ref", { HMLP_ARCH_SANDYBRIDGE } );
+  sandybridge::dgsknn_ref( GSKNN_CALL );
+};
+
+hmlpError_t gsks( GSKS_ARGS( float ) )
+{
+  switch ( arch::getPackage( "gsks", { HMLP_ARCH_SKX, HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_SKX:     return skx::gsks( GSKS_CALL );
+    case HMLP_ARCH_HASWELL: return haswell::gsks( GSKS_CALL );
+    default:                return sandybridge::gsks( GSKS_CALL );
+  }
+};
+
+hmlpError_t gsks( GSKS_ARGS( double ) )
+{
+  switch ( arch::getPackage( "gsks", { HMLP_ARCH_SKX, HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_SKX:     return skx::gsks( GSKS_CALL );
+    case HMLP_ARCH_HASWELL: return haswell::gsks( GSKS_CALL );
+    default:                return sandybridge::gsks( GSKS_CALL );
+  }
+};
+
+hmlpError_t sgsks( GSKS_ARGS( float ) )
+{
+  switch ( arch::getPackage( "sgsks", { HMLP_ARCH_SKX, HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_SKX:     return skx::sgsks( GSKS_CALL );
+    case HMLP_ARCH_HASWELL: return haswell::sgsks( GSKS_CALL );
+    default:                return sandybridge::sgsks( GSKS_CALL );
+  }
+};
+
+hmlpError_t dgsks( GSKS_ARGS( double ) )
+{
+  switch ( arch::getPackage( "dgsks", { HMLP_ARCH_SKX, HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_SKX:     return skx::dgsks( GSKS_CALL );
+    case HMLP_ARCH_HASWELL: return haswell::dgsks( GSKS_CALL );
+    default:                return sandybridge::dgsks( GSKS_CALL );
+  }
+};
+
+hmlpError_t sgsks_ref( GSKS_ARGS( float ) )
+{
+  switch ( arch::getPackage( "sgsks_ref", { HMLP_ARCH_SKX, HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_SKX:     return skx::sgsks_ref( GSKS_CALL );
+    case HMLP_ARCH_HASWELL: return haswell::sgsks_ref( GSKS_CALL );
+    default:                return sandybridge::sgsks_ref( GSKS_CALL );
+  }
+};
+
+hmlpError_t dgsks_ref( GSKS_ARGS( double ) )
+{
+  switch ( arch::getPackage( "dgsks_ref", { HMLP_ARCH_SKX, HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_SKX:     return skx::dgsks_ref( GSKS_CALL );
+    case HMLP_ARCH_HASWELL: return haswell::dgsks_ref( GSKS_CALL );
+    default:                return sandybridge::dgsks_ref( GSKS_CALL );
+  }
+};
+
+void nbody( NBODY_ARGS( float ) )
+{
+  switch ( arch::getPackage( "nbody", { HMLP_ARCH_SKX, HMLP_ARCH_HASWELL } ) )
+  {
+    case HMLP_ARCH_SKX:     return skx::nbody( NBODY_CALL );
+    default:                return haswell::nbody( NBODY_CALL );
+  }
+};
+
+void nbody( NBODY_ARGS( double ) )
+{
+  switch ( arch::getPackage( "nbody", { HMLP_ARCH_SKX, HMLP_ARCH_HASWELL } ) )
+  {
+    case HMLP_ARCH_SKX:     return skx::nbody( NBODY_CALL );
+    default:                return haswell::nbody( NBODY_CALL );
+  }
+};
+
+void strassen( STRASSEN_ARGS( float ) )
+{
+  switch ( arch::getPackage( "strassen", { HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_HASWELL: return haswell::strassen( STRASSEN_CALL );
+    default:                return sandybridge::strassen( STRASSEN_CALL );
+  }
+};
+
+void strassen( STRASSEN_ARGS( double ) )
+{
+  switch ( arch::getPackage( "strassen", { HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_HASWELL: return haswell::strassen( STRASSEN_CALL );
+    default:                return sandybridge::strassen( STRASSEN_CALL );
+  }
+};
+
+void sstrassen( STRASSEN_ARGS( float ) )
+{
+  switch ( arch::getPackage( "sstrassen", { HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_HASWELL: return haswell::sstrassen( STRASSEN_CALL );
+    default:                return sandybridge::sstrassen( STRASSEN_CALL );
+  }
+};
+
+void dstrassen( STRASSEN_ARGS( double ) )
+{
+  switch ( arch::getPackage( "dstrassen", { HMLP_ARCH_HASWELL, HMLP_ARCH_SANDYBRIDGE } ) )
+  {
+    case HMLP_ARCH_HASWELL: return haswell::dstrassen( STRASSEN_CALL );
+    default:                return sandybridge::dstrassen( STRASSEN_CALL );
+  }
+};
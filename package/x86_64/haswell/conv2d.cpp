@@ -28,6 +28,8 @@
 
 using namespace hmlp::cnn;
 
+HMLP_PACKAGE_BEGIN
+
 
 
 void conv2d
@@ -54,10 +56,10 @@ void conv2d
   rank_k_asm_d8x6 semiringkernel;
   rank_k_asm_d8x6 microkernel;
 
-  conv2d<
+  hmlp::cnn::conv2d<
     72, 960, 256, 8, 6, 
     72, 960,      8, 6, 32,
-    false,
+    true, /** USE_STRASSEN (large k only) */
     rank_k_asm_d8x6, 
     rank_k_asm_d8x6,
     double, double, double, double>
@@ -81,7 +83,7 @@ void dconv2d
 	float *C
 )
 {
-  conv2d( w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
+  HMLP_PACKAGE::conv2d( w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
 };
 
 
@@ -93,7 +95,7 @@ void dconv2d
 	double *C
 )
 {
-  conv2d( w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
+  HMLP_PACKAGE::conv2d( w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
 };
 
 
@@ -118,5 +120,4 @@ void dconv2d_ref
  );
 };
 
-
-
+HMLP_PACKAGE_END
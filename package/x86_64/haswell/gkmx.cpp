@@ -29,6 +29,8 @@
 
 using namespace hmlp;
 
+HMLP_PACKAGE_BEGIN
+
 template<typename T>
 struct identity 
 {
@@ -66,7 +68,7 @@ void gkmx_dfma
   gkmx::gkmx<
     72, 960, 256, 8, 6, 
     72, 960,      8, 6, 32,
-    false, true,
+    true, true, /** USE_STRASSEN, REUSE_C */
     rank_k_asm_d8x6, 
     rank_k_asm_d8x6,
     double, double, double, double>
@@ -145,3 +147,4 @@ void gkmx_mixfma_simple
   //);
 };
 
+HMLP_PACKAGE_END
@@ -28,6 +28,8 @@
 
 using namespace hmlp;
 
+HMLP_PACKAGE_BEGIN
+
 void gsknn
 (
   int m, int n, int k, int r,
@@ -90,3 +92,5 @@ void dgsknn_ref
     D,     I
   );
 }
+
+HMLP_PACKAGE_END
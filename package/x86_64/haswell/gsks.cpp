@@ -29,13 +29,14 @@
 
 /** Haswell kernels */
 #include <rank_k_d8x6.hpp>
-//#include <gsks_d8x6.hpp>
 
 
 using namespace hmlp;
 
+HMLP_PACKAGE_BEGIN
 
-void gsks
+
+hmlpError_t gsks
 (
   kernel_s<float, float> *kernel,
   int m, int n, int k,
@@ -45,13 +46,35 @@ void gsks
   float *w,            int *wmap
 )
 {
-  printf( "gsks() in single precision is not implemented yet\n" );
-  exit( 1 );
-};
-
+  switch ( kernel->type )
+  {
+    case GAUSSIAN_VAR_BANDWIDTH:
+    {
+      return gsks::gsks_fused<96, 960, 256, true, rank_k_asm_s16x6, float>
+        ( kernel, m, n, k, u, umap, A, A2, amap, B, B2, bmap, w, wmap );
+    }
+    case GAUSSIAN:
+    case SIGMOID:
+    case POLYNOMIAL:
+    case LAPLACE:
+    case TANH:
+    case QUARTIC:
+    case MULTIQUADRATIC:
+    case EPANECHNIKOV:
+    {
+      return gsks::gsks_fused<96, 960, 256, false, rank_k_asm_s16x6, float>
+        ( kernel, m, n, k, u, umap, A, A2, amap, B, B2, bmap, w, wmap );
+    }
+    default:
+    {
+      return HMLP_ERROR_INVALID_VALUE;
+    }
+  }
+  return HMLP_ERROR_SUCCESS;
+}; /** end gsks() */
 
 
-void gsks
+hmlpError_t gsks
 (
   kernel_s<double, double> *kernel,
   int m, int n, int k,
@@ -63,80 +86,89 @@ void gsks
 {
   switch ( kernel->type )
   {
-    case GAUSSIAN:
-    {
-      /** kernel instances */
-//      rank_k_asm_d8x6 semiringkernel;
-//      gsks_gaussian_int_d8x6 microkernel;
-//
-//      gsks::gsks<
-//        /** MC, NC, KC, MR, NR */
-//        72, 960, 256, 8, 6, 
-//        /** PACK_MC, PACK_NC, PACK_MR, PACK_NR, SIMD_SIZE */
-//        72, 960,      8, 6, 32,
-//        /** USE_L2NORM, USE_VAR_BANDWIDTH, USE_STRASSEN */
-//        true, false, false,
-//        rank_k_asm_d8x6, gsks_gaussian_int_d8x6,
-//        double, double, double, double>
-//      ( 
-//        kernel,
-//        m, n, k,
-//        u,     umap,
-//        A, A2, amap,
-//        B, B2, bmap,
-//        w,     wmap,
-//        semiringkernel, microkernel 
-//      );
-      break;
-    }
     case GAUSSIAN_VAR_BANDWIDTH:
     {
-      break;
+      return gsks::gsks_fused<72, 960, 256, true, rank_k_asm_d8x6, double>
+        ( kernel, m, n, k, u, umap, A, A2, amap, B, B2, bmap, w, wmap );
     }
+    case GAUSSIAN:
+    case SIGMOID:
     case POLYNOMIAL:
-    {
-//      rank_k_asm_d8x6 semiringkernel;
-//      gsks_polynomial_int_d8x6 microkernel;
-//
-//      gsks::gsks<
-//        72, 960, 256, 8, 6, 
-//        72, 960,      8, 6, 32,
-//        true, false, false,
-//        rank_k_asm_d8x6, gsks_polynomial_int_d8x6,
-//        double, double, double, double>
-//      ( 
-//        kernel,
-//        m, n, k,
-//        u,     umap,
-//        A, A2, amap,
-//        B, B2, bmap,
-//        w,     wmap,
-//        semiringkernel, microkernel 
-//      );
-      break;
-    }
     case LAPLACE:
-      break;
     case TANH:
-      break;
     case QUARTIC:
-      break;
     case MULTIQUADRATIC:
-      break;
     case EPANECHNIKOV:
-      break;
+    {
+      return gsks::gsks_fused<72, 960, 256, false, rank_k_asm_d8x6, double>
+        ( kernel, m, n, k, u, umap, A, A2, amap, B, B2, bmap, w, wmap );
+    }
     default:
-      exit( 1 );
+    {
+      return HMLP_ERROR_INVALID_VALUE;
+    }
   }
-};
-
+  return HMLP_ERROR_SUCCESS;
+}; /** end gsks() */
 
 
+hmlpError_t sgsks
+(
+  kernel_s<float, float> *kernel,
+  int m, int n, int k,
+  float *u,            int *umap,
+  float *A, float *A2, int *amap,
+  float *B, float *B2, int *bmap,
+  float *w,            int *wmap
+)
+{
+  return HMLP_PACKAGE::gsks( kernel, m, n, k,
+      u,     umap,
+      A, A2, amap,
+      B, B2, bmap,
+      w,     wmap );
+};
 
+hmlpError_t dgsks
+(
+  kernel_s<double, double> *kernel,
+  int m, int n, int k,
+  double *u,             int *umap,
+  double *A, double *A2, int *amap,
+  double *B, double *B2, int *bmap,
+  double *w,             int *wmap
+)
+{
+  return HMLP_PACKAGE::gsks( kernel, m, n, k,
+      u,     umap,
+      A, A2, amap,
+      B, B2, bmap,
+      w,     wmap );
+};
 
 
+hmlpError_t sgsks_ref
+(
+  kernel_s<float, float> *kernel,
+  int m, int n, int k,
+  float *u,            int *umap,
+  float *A, float *A2, int *amap,
+  float *B, float *B2, int *bmap,
+  float *w,            int *wmap
+)
+{
+  return gsks::gsks_ref<float>
+  (
+    kernel,
+    m, n, k,
+    u,     umap,
+    A, A2, amap,
+    B, B2, bmap,
+    w,     wmap
+  );
+}
 
-void dgsks_ref
+hmlpError_t dgsks_ref
 (
   kernel_s<double, double> *kernel,
   int m, int n, int k,
@@ -146,7 +178,7 @@ void dgsks_ref
   double *w,             int *wmap
 )
 {
-  gsks::gsks_ref<double>
+  return gsks::gsks_ref<double>
   (
     kernel,
     m, n, k,
@@ -156,3 +188,5 @@ void dgsks_ref
     w,     wmap
   );
 }
+
+HMLP_PACKAGE_END
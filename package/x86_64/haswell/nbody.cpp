@@ -28,6 +28,8 @@
 
 using namespace hmlp;
 
+HMLP_PACKAGE_BEGIN
+
 template<typename T>
 struct identity 
 {
@@ -173,3 +175,5 @@ void nbody
 //  );
 //
 //}; /** end gnbx() */
+
+HMLP_PACKAGE_END
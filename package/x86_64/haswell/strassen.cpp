@@ -29,6 +29,8 @@
 
 using namespace hmlp;
 
+HMLP_PACKAGE_BEGIN
+
 void strassen
 (
   hmlpOperation_t transA, hmlpOperation_t transB,
@@ -38,8 +40,25 @@ void strassen
 	float *C, int ldc
 )
 {
-  printf( "no implementation\n" );
-  exit( 1 );
+  rank_k_asm_s16x6 stra_semiringkernel;
+  rank_k_asm_s16x6 stra_microkernel;
+
+  strassen::strassen<
+    96, 960, 256, 16, 6, 
+    96, 960,      16, 6, 32,
+    false,
+    rank_k_asm_s16x6, 
+    rank_k_asm_s16x6,
+    float, float, float, float>
+	(
+    transA, transB,
+	  m, n, k,
+	  A, lda,
+	  B, ldb,
+	  C, ldc,
+	  stra_semiringkernel,
+	  stra_microkernel
+	);
 };
 
 void strassen
@@ -74,3 +93,29 @@ void strassen
 }; 
 
 
+void sstrassen
+(
+  hmlpOperation_t transA, hmlpOperation_t transB,
+	int m, int n, int k,
+	float *A, int lda,
+	float *B, int ldb,
+	float *C, int ldc
+)
+{
+  HMLP_PACKAGE::strassen( transA, transB, m, n, k, A, lda, B, ldb, C, ldc );
+};
+
+
+void dstrassen
+(
+  hmlpOperation_t transA, hmlpOperation_t transB,
+	int m, int n, int k,
+	double *A, int lda,
+	double *B, int ldb,
+	double *C, int ldc
+)
+{
+  HMLP_PACKAGE::strassen( transA, transB, m, n, k, A, lda, B, ldb, C, ldc );
+};
+
+HMLP_PACKAGE_END
@@ -28,6 +28,8 @@
 
 using namespace hmlp::cnn;
 
+HMLP_PACKAGE_BEGIN
+
 
 
 void conv2d
@@ -54,10 +56,10 @@ void conv2d
   rank_k_asm_d8x4 semiringkernel;
   rank_k_asm_d8x4 microkernel;
 
-  conv2d<
+  hmlp::cnn::conv2d<
     104, 1024, 256, 8, 4, 
     104, 1024,      8, 4, 32,
-    false,
+    true, /** USE_STRASSEN (large k only) */
     rank_k_asm_d8x4, rank_k_asm_d8x4,
     double, double, double, double>
 	(
@@ -80,7 +82,7 @@ void dconv2d
 	float *C
 )
 {
-  conv2d( w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
+  HMLP_PACKAGE::conv2d( w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
 };
 
 
@@ -92,7 +94,7 @@ void dconv2d
 	double *C
 )
 {
-  conv2d( w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
+  HMLP_PACKAGE::conv2d( w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
 };
 
 
@@ -117,5 +119,4 @@ void dconv2d_ref
  );
 };
 
-
-
+HMLP_PACKAGE_END
@@ -27,7 +27,9 @@
 /** Sandy-bridge micro-kernels */
 #include <rank_k_d8x4.hpp>
 
-using namespace hmlp::gkmx;
+using namespace hmlp;
+
+HMLP_PACKAGE_BEGIN
 
 
 template<typename T>
@@ -65,10 +67,10 @@ void gkmx_dfma
   rank_k_asm_d8x4 semiringkernel;
   rank_k_asm_d8x4 microkernel;
 
-  gkmx<
+  gkmx::gkmx<
     104, 4096, 256, 8, 4, 
     104, 4096,      8, 4, 32,
-    false, true,
+    true, true, /** USE_STRASSEN, REUSE_C */
     rank_k_asm_d8x4, 
     rank_k_asm_d8x4,
     double, double, double, double>
@@ -101,7 +103,7 @@ void gkmx_dfma_simple
 
   double initV = 0.0;
 
-  gkmm
+  gkmx::gkmm
   <104, 4096, 256, 8, 4, 104, 4096, 8, 4, 32,
   false, true>
   (
@@ -145,3 +147,4 @@ void gkmx_mixfma_simple
   //);
 };
 
+HMLP_PACKAGE_END
@@ -27,6 +27,8 @@
 
 using namespace hmlp;
 
+HMLP_PACKAGE_BEGIN
+
 
 void gnbx
 (
@@ -117,15 +119,4 @@ void gnbx
 
 }; /** end gnbx() */
 
-
-
-
-
-
-
-
-
-
-
-
-
+HMLP_PACKAGE_END
@@ -26,7 +26,9 @@
 #include <rank_k_d8x4.hpp>
 #include <knn_d8x4.hpp>
 
-using namespace hmlp::gsknn;
+using namespace hmlp;
+
+HMLP_PACKAGE_BEGIN
 
 void gsknn
 (
@@ -40,7 +42,7 @@ void gsknn
 
   rank_k_asm_d8x4 semiringkernel;
   knn_int_d8x4    fusedkernel;
-  gsknn<
+  gsknn::gsknn<
     104, 2048, 256, 8, 4, 
     104, 2048,      8, 4, 32,
     USE_STRASSEN,
@@ -76,7 +78,7 @@ void dgsknn
   double *D,             int *I
 )
 {
-  gsknn( m, n, k, r, A, A2, amap, B, B2, bmap, D, I );
+  HMLP_PACKAGE::gsknn( m, n, k, r, A, A2, amap, B, B2, bmap, D, I );
 };
 
 void sgsknn
@@ -87,7 +89,7 @@ void sgsknn
   float *D,            int *I
 )
 {
-  gsknn( m, n, k, r, A, A2, amap, B, B2, bmap, D, I );
+  HMLP_PACKAGE::gsknn( m, n, k, r, A, A2, amap, B, B2, bmap, D, I );
 };
 
 
@@ -100,7 +102,7 @@ void dgsknn_ref
   double *D,             int *I
 )
 {
-  gsknn_ref<double>
+  gsknn::gsknn_ref<double>
   (
     m, n, k, r,
     A, A2, amap,
@@ -108,3 +110,5 @@ void dgsknn_ref
     D,     I
   );
 }
+
+HMLP_PACKAGE_END
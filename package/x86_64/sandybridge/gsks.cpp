@@ -27,22 +27,20 @@
 /** reference kernels */
 #include <gsks_ref_mrxnr.hpp>
 
-/** sandy-bridge kernels */
+/** Sandy-bridge kernels */
 #include <rank_k_d8x4.hpp>
 #include <gsks_d8x4.hpp>
 #include <variable_bandwidth_gaussian_d8x4.hpp>
 
-// Knights Landing
-// #include <rank_k_int_d24x8.hpp>
-// #include <gaussian_int_d24x8.hpp>
 
-using namespace hmlp::gsks;
+using namespace hmlp;
 
+HMLP_PACKAGE_BEGIN
 
 
-void gsks
+hmlpError_t gsks
 (
-  kernel_s<float> *kernel,
+  kernel_s<float, float> *kernel,
   int m, int n, int k,
   float *u,            int *umap,
   float *A, float *A2, int *amap,
@@ -50,15 +48,37 @@ void gsks
   float *w,            int *wmap
 )
 {
-  printf( "gsks() in single precision is not implemented yet\n" );
-  exit( 1 );
-};
-
+  switch ( kernel->type )
+  {
+    case GAUSSIAN_VAR_BANDWIDTH:
+    {
+      return gsks::gsks_fused<104, 4096, 256, true, rank_k_asm_s8x8, float>
+        ( kernel, m, n, k, u, umap, A, A2, amap, B, B2, bmap, w, wmap );
+    }
+    case GAUSSIAN:
+    case SIGMOID:
+    case POLYNOMIAL:
+    case LAPLACE:
+    case TANH:
+    case QUARTIC:
+    case MULTIQUADRATIC:
+    case EPANECHNIKOV:
+    {
+      return gsks::gsks_fused<104, 4096, 256, false, rank_k_asm_s8x8, float>
+        ( kernel, m, n, k, u, umap, A, A2, amap, B, B2, bmap, w, wmap );
+    }
+    default:
+    {
+      return HMLP_ERROR_INVALID_VALUE;
+    }
+  }
+  return HMLP_ERROR_SUCCESS;
+}; /** end gsks() */
 
 
-void gsks
+hmlpError_t gsks
 (
-  kernel_s<double> *kernel,
+  kernel_s<double, double> *kernel,
   int m, int n, int k,
   double *u,             int *umap,
   double *A, double *A2, int *amap,
@@ -68,117 +88,77 @@ void gsks
 {
   switch ( kernel->type )
   {
+    case GAUSSIAN_VAR_BANDWIDTH:
+    {
+      rank_k_asm_d8x4 semiringkernel;
+      variable_bandwidth_gaussian_int_d8x4 fusedkernel;
+
+      gsks::gsks<
+        104, 4096, 256, 8, 4,
+        104, 4096,      8, 4, 32,
+        true,  /** USE_L2NORM */
+        true,  /** USE_VAR_BANDWIDTH */
+        false, /** USE_STRASSEN */
+        rank_k_asm_d8x4, variable_bandwidth_gaussian_int_d8x4,
+        double, double, double, double>
+      (
+        kernel,
+        m, n, k,
+        u,     umap,
+        A, A2, amap,
+        B, B2, bmap,
+        w,     wmap,
+        semiringkernel, fusedkernel
+      );
+      break;
+    }
     case GAUSSIAN:
     {
       rank_k_asm_d8x4 semiringkernel;
       gsks_gaussian_int_d8x4 fusedkernel;
 
-      gsks<
-        104, 
-        4096, 
-        256, 
-        8, 
-        4, 
-        104, 
-        4096, 
-        8, 
-        4, 
-        32,
+      gsks::gsks<
+        104, 4096, 256, 8, 4,
+        104, 4096,      8, 4, 32,
         true,  /** USE_L2NORM */
         false, /** USE_VAR_BANDWIDTH */
         false, /** USE_STRASSEN */
-        rank_k_asm_d8x4,
-        gsks_gaussian_int_d8x4,
+        rank_k_asm_d8x4, gsks_gaussian_int_d8x4,
         double, double, double, double>
-          ( 
-           kernel,
-           m, n, k,
-           u,     umap,
-           A, A2, amap,
-           B, B2, bmap,
-           w,     wmap,
-           semiringkernel, fusedkernel 
-          );
-
-      // Knights Landing
-      // rank_k_int_d24x8 semiringkernel;
-      // gaussian_int_d24x8 microkernel;
-      // gsks<
-      //   120, 14400, 336, 24, 8, 120, 14400, 24, 8, 64,
-      //   true, false, false,
-      //   rank_k_int_d24x8, gaussian_int_d24x8,
-      //   double, double, double, double>
-      // ( 
-      //   kernel,
-      //   m, n, k,
-      //   u,     umap,
-      //   A, A2, amap,
-      //   B, B2, bmap,
-      //   w,     wmap,
-      //   semiringkernel, microkernel 
-      // );
-
+      (
+        kernel,
+        m, n, k,
+        u,     umap,
+        A, A2, amap,
+        B, B2, bmap,
+        w,     wmap,
+        semiringkernel, fusedkernel
+      );
       break;
     }
-    case GAUSSIAN_VAR_BANDWIDTH:
-      {
-        rank_k_asm_d8x4 semiringkernel;
-        variable_bandwidth_gaussian_int_d8x4 fusedkernel;
-
-        gsks<
-          104, 
-          4096, 
-          256, 
-          8, 
-          4, 
-          104, 
-          4096, 
-          8, 
-          4, 
-          32,
-          true,  // USE_L2NORM
-          true,  // USE_VAR_BANDWIDTH
-          false, // USE_STRASSEN
-          rank_k_asm_d8x4, variable_bandwidth_gaussian_int_d8x4,
-          double, double, double, double>
-        ( 
-          kernel,
-          m, n, k,
-          u,     umap,
-          A, A2, amap,
-          B, B2, bmap,
-          w,     wmap,
-          semiringkernel, fusedkernel 
-        );
-
-        break;
-      }
+    case SIGMOID:
     case POLYNOMIAL:
-      {
-        rank_k_asm_d8x4 semiringkernel;
-
-
-        break;
-      }
     case LAPLACE:
-      break;
     case TANH:
-      break;
     case QUARTIC:
-      break;
     case MULTIQUADRATIC:
-      break;
     case EPANECHNIKOV:
-      break;
+    {
+      return gsks::gsks_fused<104, 4096, 256, false, rank_k_asm_d8x4, double>
+        ( kernel, m, n, k, u, umap, A, A2, amap, B, B2, bmap, w, wmap );
+    }
     default:
-      exit( 1 );
+    {
+      return HMLP_ERROR_INVALID_VALUE;
+    }
   }
-};
+  return HMLP_ERROR_SUCCESS;
+}; /** end gsks() */
 
 
-void sgsks
+hmlpError_t sgsks
 (
-  kernel_s<float> *kernel,
+  kernel_s<float, float> *kernel,
   int m, int n, int k,
   float *u,            int *umap,
   float *A, float *A2, int *amap,
@@ -186,16 +166,16 @@ void sgsks
   float *w,            int *wmap
 )
 {
-  gsks( kernel, m, n, k,
+  return HMLP_PACKAGE::gsks( kernel, m, n, k,
       u,     umap,
       A, A2, amap,
       B, B2, bmap,
       w,     wmap );
 };
 
-void dgsks
+hmlpError_t dgsks
 (
-  kernel_s<double> *kernel,
+  kernel_s<double, double> *kernel,
   int m, int n, int k,
   double *u,             int *umap,
   double *A, double *A2, int *amap,
@@ -203,7 +183,7 @@ void dgsks
   double *w,             int *wmap
 )
 {
-  gsks( kernel, m, n, k,
+  return HMLP_PACKAGE::gsks( kernel, m, n, k,
       u,     umap,
       A, A2, amap,
       B, B2, bmap,
@@ -211,18 +191,30 @@ void dgsks
 };
 
 
+hmlpError_t sgsks_ref
+(
+  kernel_s<float, float> *kernel,
+  int m, int n, int k,
+  float *u,            int *umap,
+  float *A, float *A2, int *amap,
+  float *B, float *B2, int *bmap,
+  float *w,            int *wmap
+)
+{
+  return gsks::gsks_ref<float>
+  (
+    kernel,
+    m, n, k,
+    u,     umap,
+    A, A2, amap,
+    B, B2, bmap,
+    w,     wmap
+  );
+}
 
-
-
-
-
-
-
-
-void dgsks_ref
+hmlpError_t dgsks_ref
 (
-  //ks_t *kernel,
-  kernel_s<double> *kernel,
+  kernel_s<double, double> *kernel,
   int m, int n, int k,
   double *u,             int *umap,
   double *A, double *A2, int *amap,
@@ -230,7 +222,7 @@ void dgsks_ref
   double *w,             int *wmap
 )
 {
-  gsks_ref<double>
+  return gsks::gsks_ref<double>
   (
     kernel,
     m, n, k,
@@ -240,3 +232,5 @@ void dgsks_ref
     w,     wmap
   );
 }
+
+HMLP_PACKAGE_END
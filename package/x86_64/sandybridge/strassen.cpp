@@ -27,7 +27,9 @@
 /** Sandy-bridge micro-kernel */
 #include <rank_k_d8x4.hpp>
 
-using namespace hmlp::strassen;
+using namespace hmlp;
+
+HMLP_PACKAGE_BEGIN
 
 void strassen
 (
@@ -38,8 +40,25 @@ void strassen
 	float *C, int ldc
 )
 {
-  printf( "no implementation\n" );
-  exit( 1 );
+  rank_k_asm_s8x8 stra_semiringkernel;
+  rank_k_asm_s8x8 stra_microkernel;
+
+  strassen::strassen<
+    104, 4096, 256, 8, 8, 
+    104, 4096,      8, 8, 32,
+    false,
+    rank_k_asm_s8x8, 
+    rank_k_asm_s8x8,
+    float, float, float, float>
+	(
+    transA, transB,
+	  m, n, k,
+	  A, lda,
+	  B, ldb,
+	  C, ldc,
+	  stra_semiringkernel,
+	  stra_microkernel
+	);
 };
 
 void strassen
@@ -54,7 +73,7 @@ void strassen
   rank_k_asm_d8x4 stra_semiringkernel;
   rank_k_asm_d8x4 stra_microkernel;
 
-  strassen<
+  strassen::strassen<
     104, 4096, 256, 8, 4, 
     104, 4096,      8, 4, 32,
     false,
@@ -83,7 +102,7 @@ void sstrassen
 	float *C, int ldc
 )
 {
-  strassen( transA, transB, m, n, k, A, lda, B, ldb, C, ldc );
+  HMLP_PACKAGE::strassen( transA, transB, m, n, k, A, lda, B, ldb, C, ldc );
 };
 
 
@@ -96,5 +115,7 @@ void dstrassen
 	double *C, int ldc
 )
 {
-  strassen( transA, transB, m, n, k, A, lda, B, ldb, C, ldc );
+  HMLP_PACKAGE::strassen( transA, transB, m, n, k, A, lda, B, ldb, C, ldc );
 };
+
+HMLP_PACKAGE_END
@@ -27,6 +27,8 @@
 
 using namespace hmlp;
 
+HMLP_PACKAGE_BEGIN
+
 void gnbx
 (
 	int m, int n, int k,
@@ -114,3 +116,5 @@ void gnbx
   );
 
 }; /** end gnbx() */
+
+HMLP_PACKAGE_END
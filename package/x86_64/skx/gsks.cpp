@@ -34,12 +34,14 @@
 #include <gsks_d12x16.hpp>
 
 
-using namespace hmlp::gsks;
+using namespace hmlp;
 
+HMLP_PACKAGE_BEGIN
 
-void gsks
+
+hmlpError_t gsks
 (
-  kernel_s<float> *kernel,
+  kernel_s<float, float> *kernel,
   int m, int n, int k,
   float *u,            int *umap,
   float *A, float *A2, int *amap,
@@ -47,15 +49,38 @@ void gsks
   float *w,            int *wmap
 )
 {
-  printf( "gsks() in single precision is not implemented yet\n" );
-  exit( 1 );
+  switch ( kernel->type )
+  {
+    case GAUSSIAN_VAR_BANDWIDTH:
+    {
+      return gsks::gsks_fused<480, 3072, 384, true, rank_k_opt_s12x32, float>
+        ( kernel, m, n, k, u, umap, A, A2, amap, B, B2, bmap, w, wmap );
+    }
+    case GAUSSIAN:
+    case SIGMOID:
+    case POLYNOMIAL:
+    case LAPLACE:
+    case TANH:
+    case QUARTIC:
+    case MULTIQUADRATIC:
+    case EPANECHNIKOV:
+    {
+      return gsks::gsks_fused<480, 3072, 384, false, rank_k_opt_s12x32, float>
+        ( kernel, m, n, k, u, umap, A, A2, amap, B, B2, bmap, w, wmap );
+    }
+    default:
+    {
+      return HMLP_ERROR_INVALID_VALUE;
+    }
+  }
+  return HMLP_ERROR_SUCCESS;
 };
 
 
 
-void gsks
+hmlpError_t gsks
 (
-  kernel_s<double> *kernel,
+  kernel_s<double, double> *kernel,
   int m, int n, int k,
   double *u,             int *umap,
   double *A, double *A2, int *amap,
@@ -65,7 +90,7 @@ void gsks
 {
   switch ( kernel->type )
   {
-    case KS_GAUSSIAN:
+    case GAUSSIAN:
     {
       //rank_k_opt_d6x32 semiringkernel;
       //gsks_gaussian_int_d6x32 fusedkernel;
@@ -86,7 +111,7 @@ void gsks
       //const size_t ALIGN_SIZE = rank_k_opt_d6x32::align_size;
       const size_t ALIGN_SIZE = rank_k_opt_d12x16::align_size;
 
-      gsks<MC, NC, KC, MR, NR, MC, NC, PACK_MR, PACK_NR, ALIGN_SIZE,
+      gsks::gsks<MC, NC, KC, MR, NR, MC, NC, PACK_MR, PACK_NR, ALIGN_SIZE,
         true,  /** USE_L2NORM */
         false, /** USE_VAR_BANDWIDTH */
         false, /** USE_STRASSEN */
@@ -106,29 +131,34 @@ void gsks
         );
       break;
     }
-    case KS_GAUSSIAN_VAR_BANDWIDTH:
-      break;
-    case KS_POLYNOMIAL:
-      break;
-    case KS_LAPLACE:
-      break;
-    case KS_TANH:
-      break;
-    case KS_QUARTIC:
-      break;
-    case KS_MULTIQUADRATIC:
-      break;
-    case KS_EPANECHNIKOV:
-      break;
+    case GAUSSIAN_VAR_BANDWIDTH:
+    {
+      return gsks::gsks_fused<480, 3072, 384, true, rank_k_opt_d12x16, double>
+        ( kernel, m, n, k, u, umap, A, A2, amap, B, B2, bmap, w, wmap );
+    }
+    case SIGMOID:
+    case POLYNOMIAL:
+    case LAPLACE:
+    case TANH:
+    case QUARTIC:
+    case MULTIQUADRATIC:
+    case EPANECHNIKOV:
+    {
+      return gsks::gsks_fused<480, 3072, 384, false, rank_k_opt_d12x16, double>
+        ( kernel, m, n, k, u, umap, A, A2, amap, B, B2, bmap, w, wmap );
+    }
     default:
-      exit( 1 );
+    {
+      return HMLP_ERROR_INVALID_VALUE;
+    }
   }
+  return HMLP_ERROR_SUCCESS;
 };
 
 
-void sgsks
+hmlpError_t sgsks
 (
-  kernel_s<float> *kernel,
+  kernel_s<float, float> *kernel,
   int m, int n, int k,
   float *u,            int *umap,
   float *A, float *A2, int *amap,
@@ -136,16 +166,16 @@ void sgsks
   float *w,            int *wmap
 )
 {
-  gsks( kernel, m, n, k,
+  return HMLP_PACKAGE::gsks( kernel, m, n, k,
       u,     umap,
       A, A2, amap,
       B, B2, bmap,
       w,     wmap );
 };
 
-void dgsks
+hmlpError_t dgsks
 (
-  kernel_s<double> *kernel,
+  kernel_s<double, double> *kernel,
   int m, int n, int k,
   double *u,             int *umap,
   double *A, double *A2, int *amap,
@@ -153,7 +183,7 @@ void dgsks
   double *w,             int *wmap
 )
 {
-  gsks( kernel, m, n, k,
+  return HMLP_PACKAGE::gsks( kernel, m, n, k,
       u,     umap,
       A, A2, amap,
       B, B2, bmap,
@@ -169,10 +199,30 @@ void dgsks
 
 
 
-void dgsks_ref
+hmlpError_t sgsks_ref
 (
-  //ks_t *kernel,
-  kernel_s<double> *kernel,
+  kernel_s<float, float> *kernel,
+  int m, int n, int k,
+  float *u,            int *umap,
+  float *A, float *A2, int *amap,
+  float *B, float *B2, int *bmap,
+  float *w,            int *wmap
+)
+{
+  return gsks::gsks_ref<float>
+  (
+    kernel,
+    m, n, k,
+    u,     umap,
+    A, A2, amap,
+    B, B2, bmap,
+    w,     wmap
+  );
+}
+
+hmlpError_t dgsks_ref
+(
+  kernel_s<double, double> *kernel,
   int m, int n, int k,
   double *u,             int *umap,
   double *A, double *A2, int *amap,
@@ -180,7 +230,7 @@ void dgsks_ref
   double *w,             int *wmap
 )
 {
-  gsks_ref<double>
+  return gsks::gsks_ref<double>
   (
     kernel,
     m, n, k,
@@ -190,3 +240,5 @@ void dgsks_ref
     w,     wmap
   );
 }
+
+HMLP_PACKAGE_END
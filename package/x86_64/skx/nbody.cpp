@@ -27,6 +27,8 @@
 
 using namespace hmlp;
 
+HMLP_PACKAGE_BEGIN
+
 template<typename T>
 struct identity 
 {
@@ -186,3 +188,5 @@ void nbody
 //  );
 //
 //}; /** end gnbx() */
+
+HMLP_PACKAGE_END
@@ -40,8 +40,11 @@ export HMLP_GPU_ARCH_MINOR=kepler
 
 ## (1) x86_64/sandybridge, 
 ## (2) x86_64/haswell, 
-## (3) arm/armv8a
-## (4) mic/knl
+## (3) x86_64/skx,
+## (4) x86_64/dispatch (all of the above; picked by CPUID at hmlp_init,
+##     HMLP_FORCE_ARCH=sandybridge|haswell|skx overrides it at runtime),
+## (5) arm/armv8a
+## (6) mic/knl
 export HMLP_ARCH_MAJOR=x86_64
 export HMLP_ARCH_MINOR=haswell
 
@@ -72,12 +75,19 @@ export OMP_NESTED=false
 export OMP_PLACES=cores
 export OMP_PROC_BIND=close
 
-## HMLP communicator
+## HMLP communicator (setting any of KS_JC_NT, KS_IC_NT and KS_JR_NT
+## overwrites the tuning file below)
 export KS_JC_NT=1
 export KS_PC_NT=1
 export KS_IC_NT=$OMP_NUM_THREADS
 export KS_JR_NT=1
 
+## Loop partitioning and blocking of each primitive, shape and core count.
+## With HMLP_AUTOTUNE=1, missing entries are searched online and written
+## back to HMLP_TUNING_FILE.
+export HMLP_TUNING_FILE=
+export HMLP_AUTOTUNE=0
+
 
 
 ## DO NOT CHANGE ANYTHING BELOW THIS LINE
@@ -189,4 +199,6 @@ echo "OMP_PLACES = $OMP_PLACES"
 echo "KS_JC_NT = $KS_JC_NT"
 echo "KS_IC_NT = $KS_IC_NT"
 echo "KS_JR_NT = $KS_JR_NT"
+echo "HMLP_TUNING_FILE = $HMLP_TUNING_FILE"
+echo "HMLP_AUTOTUNE = $HMLP_AUTOTUNE"
 
@@ -5,6 +5,7 @@
 #include <hmlp.h>
 /* Internal headers. */
 #include <gofmm.hpp>
+#include <gofmm_flat.hpp>
 /** Use dense SPD matrices. */
 #include <containers/SPDMatrix.hpp>
 /** Use implicit kernel matrices (only coordinates are stored). */
@@ -161,6 +162,682 @@ void fast_matvec_solver()
   HANDLE_ERROR( hmlp_finalize() );
 };
 
+void cached_block()
+{
+  /** Use double as data type, so that downcast is meaningful. */
+  using T = double;
+  /** Block size and number of right-hand sides. */
+  size_t m = 200, n = 300, nrhs = 7;
+  /** A smooth, well-separated block exp( -|xi-yj|^2 ) is numerically low-rank. */
+  Data<T> X( 3, m ); X.rand( 0.0, 1.0 );
+  Data<T> Y( 3, n ); Y.rand( 4.0, 5.0 );
+  Data<T> A( m, n );
+  for ( size_t j = 0; j < n; j ++ )
+    for ( size_t i = 0; i < m; i ++ )
+    {
+      T dist2 = 0;
+      for ( size_t p = 0; p < 3; p ++ ) 
+        dist2 += ( X( p, i ) - Y( p, j ) ) * ( X( p, i ) - Y( p, j ) );
+      A( i, j ) = std::exp( -dist2 / 16.0 );
+    }
+  /** Apply a column slice A( :, offset:offset+k-1 ) to B. */
+  size_t offset = 100, k = 150;
+  Data<T> B( k, nrhs ); B.randn();
+  Data<T> C( m, nrhs, 0 );
+  xgemm( "N", "N", m, nrhs, k, 1.0, A.data() + offset * m, m, 
+      B.data(), k, 0.0, C.data(), m );
+  T nrm2 = 0;
+  for ( auto c : C ) nrm2 += c * c;
+
+  for ( auto format : { CACHE_DENSE, CACHE_DOWNCAST, CACHE_LOWRANK } )
+  {
+    CachedBlock<T> block;
+    block = A;
+    EXPECT_TRUE( block.IsCached( m, n ) );
+    size_t dense_bytes = block.Bytes();
+    if ( format != CACHE_DENSE )
+    {
+      EXPECT_TRUE( block.Compress( format, 1E-8, dense_bytes ) );
+      EXPECT_LT( block.Bytes(), dense_bytes );
+    }
+    EXPECT_EQ( block.Format(), format );
+    Data<T> D( m, nrhs, 0 );
+    block.Multiply( offset, k, nrhs, B.data(), k, D.data(), m );
+    T err2 = 0;
+    for ( size_t i = 0; i < C.size(); i ++ ) err2 += ( C[ i ] - D[ i ] ) * ( C[ i ] - D[ i ] );
+    EXPECT_LT( std::sqrt( err2 / nrm2 ), 1E-5 );
+  }
+
+  /** A manager with no budget keeps nothing. */
+  CacheManager<T> cache( 0 );
+  CachedBlock<T> block;
+  block = A;
+  cache.Admit( block, 1.0 );
+  EXPECT_FALSE( block.IsCached() );
+  EXPECT_EQ( cache.Used(), 0 );
+
+  /** Admitting a block again does not count it twice. */
+  CacheManager<T> room( 2 * m * n * sizeof(T) );
+  CachedBlock<T> first, second;
+  first = A;
+  room.Admit( first, 1.0 );
+  room.Admit( first, 1.0 );
+  EXPECT_EQ( room.Used(), first.Bytes() );
+  /** A destroyed block leaves the manager, so evictions never touch it. */
+  {
+    CachedBlock<T> temporary;
+    temporary = A;
+    room.Admit( temporary, 2.0 );
+    EXPECT_EQ( room.Used(), first.Bytes() + temporary.Bytes() );
+  }
+  EXPECT_EQ( room.Used(), first.Bytes() );
+  second = A;
+  room.Admit( second, 0.5 );
+  EXPECT_EQ( room.Used(), first.Bytes() + second.Bytes() );
+  room.Release( first );
+  room.Release( first );
+  EXPECT_EQ( room.Used(), second.Bytes() );
+  /** Assigning to an admitted block takes it out of the manager. */
+  second = A;
+  EXPECT_TRUE( second.IsCached() );
+  EXPECT_EQ( room.Used(), 0 );
+};
+
+void randomized_skeletonization()
+{
+  using T = double;
+  /** A 2n-by-n numerically low-rank block, like KIJ in Skeletonize(). */
+  size_t m = 400, n = 200, r = 30, maxs = 100;
+  T stol = 1E-8;
+  Data<T> X( m, r ), Y( r, n ), A( m, n );
+  X.randn(); Y.randn();
+  xgemm( "N", "N", m, n, r, 1.0, X.data(), m, Y.data(), r, 0.0, A.data(), m );
+
+  vector<size_t> skels;
+  Data<T> proj;
+  vector<int> jpvt;
+  lowrank::rid( true, true, m, n, maxs, stol, A, skels, proj, jpvt, 16 );
+  /** The rank is revealed, and the layout matches id(). */
+  EXPECT_EQ( skels.size(), r );
+  EXPECT_EQ( proj.row(), r );
+  EXPECT_EQ( proj.col(), n );
+  EXPECT_EQ( jpvt.size(), n );
+  /** The same (default) seed gives the same skeletons. */
+  vector<size_t> skels_again;
+  Data<T> proj_again;
+  vector<int> jpvt_again;
+  lowrank::rid( true, true, m, n, maxs, stol, A, skels_again, proj_again, jpvt_again, 16 );
+  EXPECT_EQ( skels_again, skels );
+
+  /** A ~ A( :, skels ) * P, where P( :, jpvt ) = inv( R11 ) * proj. */
+  Data<T> R1( r, r, 0.0 ), P = proj, Q( r, n ), C( m, r ), E = A;
+  for ( size_t j = 0; j < r; j ++ )
+    for ( size_t i = 0; i <= j; i ++ ) R1( i, j ) = proj( i, j );
+  xtrsm( "L", "U", "N", "N", r, n, 1.0, R1.data(), r, P.data(), r );
+  for ( size_t j = 0; j < n; j ++ )
+    for ( size_t i = 0; i < r; i ++ ) Q( i, jpvt[ j ] ) = P( i, j );
+  for ( size_t j = 0; j < r; j ++ )
+    for ( size_t i = 0; i < m; i ++ ) C( i, j ) = A( i, skels[ j ] );
+  xgemm( "N", "N", m, n, r, -1.0, C.data(), m, Q.data(), r, 1.0, E.data(), m );
+  T err = 0, nrm = 0;
+  for ( size_t i = 0; i < A.size(); i ++ ) { err += E[ i ] * E[ i ]; nrm += A[ i ] * A[ i ]; }
+  EXPECT_LT( std::sqrt( err / nrm ), 1E-8 );
+
+  /** With secure accuracy, a rank above maxs gives up. */
+  lowrank::rid( true, true, m, n, (int)r / 2, stol, A, skels, proj, jpvt, 16 );
+  EXPECT_EQ( skels.size(), 0 );
+};
+
+void sparse_matrix()
+{
+  using T = double;
+  /** A banded symmetric matrix stored in the lower triangle. */
+  size_t n = 500, band = 3;
+  vector<T> vals;
+  vector<size_t> row_ind, col_ptr( 1, 0 );
+  Data<T> A( n, n, 0 );
+  for ( size_t j = 0; j < n; j ++ )
+  {
+    /** Insert rows in reverse order; fromCSC() must sort them. */
+    for ( size_t i = std::min( n - 1, j + band ) + 1; i -- > j; )
+    {
+      T v = ( i == j ) ? 2.0 * band + 1.0 : -1.0 / ( 1.0 + i - j );
+      vals.push_back( v );
+      row_ind.push_back( i );
+      A( i, j ) = v; 
+      A( j, i ) = v;
+    }
+    col_ptr.push_back( row_ind.size() );
+  }
+  SparseSPDMatrix<T> K;
+  K.fromCSC( n, n, vals.size(), true, vals.data(), row_ind.data(), col_ptr.data() );
+  K.EnableDiagonalCache( 4 );
+
+  /** Random I (with duplicates) and J against the dense reference. */
+  vector<size_t> I( 60 ), J( 40 );
+  for ( auto &i : I ) i = rand() % n;
+  for ( auto &j : J ) j = rand() % n;
+  I[ 1 ] = I[ 0 ];
+  for ( size_t j = 0; j < J.size(); j ++ ) I[ j + 2 ] = J[ j ];
+  for ( size_t trial = 0; trial < 2; trial ++ )
+  {
+    auto KIJ = K( I, J );
+    auto KII = K( I, I );
+    for ( size_t j = 0; j < J.size(); j ++ )
+      for ( size_t i = 0; i < I.size(); i ++ ) 
+        EXPECT_EQ( KIJ( i, j ), A( I[ i ], J[ j ] ) );
+    /** The second trial reads K( I, I ) from the cache. */
+    for ( size_t j = 0; j < I.size(); j ++ )
+      for ( size_t i = 0; i < I.size(); i ++ ) 
+        EXPECT_EQ( KII( i, j ), A( I[ i ], I[ j ] ) );
+  }
+
+  /** Round trip through the binary CSC file; a symmetric CSC is also its CSR. */
+  string filename = "hmlp_test_sparse_matrix.bin";
+  EXPECT_EQ( K.CSC().writeCSC( filename ), HMLP_ERROR_SUCCESS );
+  SparseSPDMatrix<T> K1, K2;
+  EXPECT_EQ( K1.readCSC( filename ), HMLP_ERROR_SUCCESS );
+  EXPECT_EQ( K2.readCSR( filename, false ), HMLP_ERROR_SUCCESS );
+  remove( filename.data() );
+  EXPECT_EQ( K1.row(), n );
+  EXPECT_EQ( K2.col(), n );
+  for ( size_t j = 0; j < n; j += 7 )
+    for ( size_t i = 0; i < n; i += 3 )
+    {
+      EXPECT_EQ( K1( i, j ), A( i, j ) );
+      /** K2 is not symmetric, so it holds the upper triangle only. */
+      EXPECT_EQ( K2( i, j ), i > j ? 0.0 : A( i, j ) );
+    }
+  EXPECT_NE( K1.readCSC( "hmlp_test_no_such_file.bin" ), HMLP_ERROR_SUCCESS );
+
+  /** Corrupted files: an index out of range, and offsets that decrease. */
+  auto corrupt = [&] ( size_t word, size_t value )
+  {
+    EXPECT_EQ( K.CSC().writeCSC( filename ), HMLP_ERROR_SUCCESS );
+    fstream file( filename, ios::in | ios::out | ios::binary );
+    file.seekp( word * sizeof(size_t) );
+    file.write( (char*)&value, sizeof(size_t) );
+  };
+  size_t ind_word = 3 + n + 1;
+  corrupt( ind_word, n );
+  EXPECT_EQ( K1.readCSC( filename ), HMLP_ERROR_INVALID_VALUE );
+  EXPECT_EQ( K2.readCSR( filename, false ), HMLP_ERROR_INVALID_VALUE );
+  corrupt( 3 + n / 2, K.CSC().NNZ() + 1 );
+  EXPECT_EQ( K1.readCSC( filename ), HMLP_ERROR_INVALID_VALUE );
+  EXPECT_EQ( K2.readCSR( filename, false ), HMLP_ERROR_INVALID_VALUE );
+  remove( filename.data() );
+
+  /** Each column gets k distinct neighbors (band + random fill). */
+  size_t k = 16;
+  auto NN = gofmm::SparsePattern<true, true, T>( n, k, K.CSC() );
+  for ( size_t j = 0; j < n; j ++ )
+  {
+    std::set<size_t> rows;
+    for ( size_t i = 0; i < k; i ++ ) rows.insert( NN( i, j ).second );
+    EXPECT_EQ( rows.size(), k );
+    EXPECT_LT( *rows.rbegin(), n );
+  }
+};
+
+void spd_matrix_loaders()
+{
+  using T = double;
+  size_t m = 300, n = 200;
+  Data<T> A( m, n ); A.randn();
+  string filename = "hmlp_test_spd_matrix.bin";
+  A.write( filename );
+
+  /** Parallel pread into storage that is not zero-filled. */
+  SPDMatrix<T> K1( m, n, filename );
+  /** An mmap view of the same file. */
+  OOCSPDMatrix<T> K2( m, n, filename );
+  vector<size_t> I( 50 ), J( 30 );
+  for ( auto &i : I ) i = rand() % m;
+  for ( auto &j : J ) j = rand() % n;
+  auto K1IJ = K1( I, J ), K2IJ = K2( I, J );
+  for ( size_t j = 0; j < J.size(); j ++ )
+    for ( size_t i = 0; i < I.size(); i ++ ) 
+    {
+      EXPECT_EQ( K1IJ( i, j ), A( I[ i ], J[ j ] ) );
+      EXPECT_EQ( K2IJ( i, j ), A( I[ i ], J[ j ] ) );
+    }
+  /** The size of the file does not match. */
+  Data<T> B( m, n + 1 );
+  EXPECT_NE( B.read( m, n + 1, filename ), HMLP_ERROR_SUCCESS );
+  remove( filename.data() );
+
+  /** CSV with one leading attribute per line; line j is column j. */
+  filename = "hmlp_test_points.csv";
+  FILE *file = fopen( filename.data(), "w" );
+  for ( size_t j = 0; j < n; j ++ )
+  {
+    fprintf( file, "%lu", j );
+    for ( size_t i = 0; i < m; i ++ ) fprintf( file, ",%.17E", A( i, j ) );
+    fprintf( file, "\n" );
+  }
+  fclose( file );
+  Data<T> X( m, n );
+  EXPECT_EQ( ( X.readmtx<1, true>( m, n, filename ) ), HMLP_ERROR_SUCCESS );
+  for ( size_t i = 0; i < A.size(); i ++ ) EXPECT_EQ( X[ i ], A[ i ] );
+  /** One value per line is missing. */
+  Data<T> Y( m + 2, n );
+  EXPECT_NE( ( Y.readmtx<0, true>( m + 2, n, filename ) ), HMLP_ERROR_SUCCESS );
+  /** The last value ends the file (no newline) exactly at a page boundary. */
+  file = fopen( filename.data(), "w" );
+  fprintf( file, "%4096s", "2.5" );
+  fclose( file );
+  Data<T> Z( 1, 1 );
+  EXPECT_EQ( ( Z.readmtx<0, true>( 1, 1, filename ) ), HMLP_ERROR_SUCCESS );
+  EXPECT_EQ( Z[ 0 ], 2.5 );
+  remove( filename.data() );
+};
+
+/**
+ *  @brief Gaussian points from a fixed seed, the kernel matrix on them,
+ *         and the splitters and neighbors to compress it. The runtime is
+ *         initialized and finalized with the problem.
+ */
+template<typename T>
+struct KernelProblem
+{
+  using SPLITTER = gofmm::centersplit<KernelMatrix<T>, 2, T>;
+  using TREE = tree::Tree<gofmm::Setup<KernelMatrix<T>, SPLITTER, T>, gofmm::NodeData<T>>;
+
+  KernelProblem( size_t d, size_t n, unsigned seed = 2019 )
+    : generator( seed ), X( d, n ), K( X ), rkdtsplitter( K ), splitter( K )
+  {
+    HANDLE_ERROR( hmlp_init() );
+    X = Randn( d, n );
+  };
+
+  ~KernelProblem() { HANDLE_ERROR( hmlp_finalize() ); };
+
+  /** Draw the next m-by-n Gaussian samples. */
+  Data<T> Randn( size_t m, size_t n )
+  {
+    Data<T> A( m, n );
+    for ( auto &a : A ) a = normal( generator );
+    return A;
+  };
+
+  /** Search the neighbors of the current K once, then compress it. */
+  TREE* Compress( gofmm::Configuration<T> &config )
+  {
+    if ( !neighbors.size() ) neighbors = gofmm::FindNeighbors( K, rkdtsplitter, config );
+    return gofmm::Compress( K, neighbors, splitter, rkdtsplitter, config );
+  };
+
+  std::mt19937 generator;
+  std::normal_distribution<T> normal;
+  Data<T> X;
+  KernelMatrix<T> K;
+  gofmm::randomsplit<KernelMatrix<T>, 2, T> rkdtsplitter;
+  SPLITTER splitter;
+  Data<pair<T, size_t>> neighbors;
+};
+
+/** @brief Return || a - b ||_F / || b ||_F. */
+template<typename T>
+T RelativeError( const Data<T> &a, const Data<T> &b )
+{
+  T err = 0, nrm = 0;
+  for ( size_t i = 0; i < b.size(); i ++ )
+  {
+    err += ( a[ i ] - b[ i ] ) * ( a[ i ] - b[ i ] );
+    nrm += b[ i ] * b[ i ];
+  }
+  return std::sqrt( err / nrm );
+};
+
+void flat_evaluate()
+{
+  using T = double;
+  size_t n = 3000, m = 128, k = 32, s = 128, nrhs = 4;
+  KernelProblem<T> problem( 3, n );
+  gofmm::Configuration<T> config( GEOMETRY_DISTANCE, n, m, k, s, 1E-5, 0.05, false );
+  auto *tree = problem.Compress( config );
+  auto w = problem.Randn( n, nrhs );
+  auto u = gofmm::Evaluate( *tree, w );
+  /** The level-synchronous layout computes the same approximation. */
+  auto *flat = gofmm::Flatten( *tree );
+  for ( size_t repeat = 0; repeat < 2; repeat ++ )
+  {
+    EXPECT_LT( RelativeError( flat->Evaluate( w ), u ), 1E-12 );
+  }
+  delete flat;
+  delete tree;
+};
+
+void out_of_sample_queries()
+{
+  using T = double;
+  size_t n = 3000, m = 128, k = 32, s = 256, nrhs = 4, d = 3, q = 200;
+  KernelProblem<T> problem( d, n );
+  auto &X = problem.X;
+  auto &K = problem.K;
+  gofmm::Configuration<T> config( GEOMETRY_DISTANCE, n, m, k, s, 1E-7, 0.05, false );
+  auto *tree = problem.Compress( config );
+  auto w = problem.Randn( n, nrhs );
+  gofmm::Evaluate( *tree, w );
+  /** Half of the queries are perturbed training points, half are new. */
+  auto Q = problem.Randn( d, q );
+  for ( size_t i = 0; i < q / 2; i ++ )
+    for ( size_t p = 0; p < d; p ++ ) Q( p, i ) = X( p, i ) + 1E-3 * Q( p, i );
+  Data<T> potentials;
+  EXPECT_EQ( gofmm::EvaluateQueries( *tree, w, Q, potentials ), HMLP_ERROR_SUCCESS );
+  EXPECT_EQ( potentials.row(), q );
+  EXPECT_EQ( potentials.col(), nrhs );
+  /** Compare with the direct sum (as accurate as the in-sample Evaluate()). */
+  vector<size_t> all( n );
+  for ( size_t j = 0; j < n; j ++ ) all[ j ] = j;
+  auto KQX = K.OutOfSample( Q, all );
+  Data<T> exact( q, nrhs, 0.0 );
+  xgemm( "N", "N", q, nrhs, n, 1.0, KQX.data(), q, w.data(), n, 0.0, exact.data(), q );
+  EXPECT_LT( RelativeError( potentials, exact ), 1E-2 );
+  /** Queries must have the dimension of the training points. */
+  Data<T> R( d + 1, 1 );
+  EXPECT_NE( gofmm::EvaluateQueries( *tree, w, R, potentials ), HMLP_ERROR_SUCCESS );
+  /** w_skel holds nrhs columns, so other weights need another Evaluate(). */
+  auto w1 = problem.Randn( n, nrhs + 1 );
+  EXPECT_EQ( gofmm::EvaluateQueries( *tree, w1, Q, potentials ), HMLP_ERROR_INVALID_VALUE );
+  delete tree;
+};
+
+void dynamic_update()
+{
+  using T = double;
+  size_t n = 3000, m = 128, k = 32, s = 128, nrhs = 4, d = 3, n_new = 400;
+  size_t N = n + n_new;
+  /** The last n_new points arrive later, and half of them crowd one leaf. */
+  KernelProblem<T> problem( d, N );
+  auto &X = problem.X;
+  auto &K = problem.K;
+  for ( size_t i = n; i < n + n_new / 2; i ++ )
+    for ( size_t p = 0; p < d; p ++ ) X( p, i ) = X( p, 0 ) + 1E-2 * X( p, i );
+  K.resize( n, n );
+  gofmm::Configuration<T> config( GEOMETRY_DISTANCE, n, m, k, s, 1E-7, 0.05, false );
+  auto *tree = problem.Compress( config );
+  /** Insert the new points and retire every 10th old point. */
+  vector<size_t> inserted, removed, active, bmap( nrhs );
+  for ( size_t i = n; i < N; i ++ ) inserted.push_back( i );
+  for ( size_t i = 0; i < n; i += 10 ) removed.push_back( i );
+  for ( size_t j = 0; j < nrhs; j ++ ) bmap[ j ] = j;
+  K.resize( N, N );
+  EXPECT_EQ( gofmm::Update( *tree, inserted, removed ), HMLP_ERROR_SUCCESS );
+  /** Each active gid is in exactly one leaf, and leaves stay balanced. */
+  vector<size_t> count( N, 0 );
+  for ( auto *node : tree->treelist )
+  {
+    if ( !node->isleaf ) continue;
+    for ( auto gid : node->gids ) count[ gid ] ++;
+    EXPECT_LE( node->gids.size(), 2 * m );
+    EXPECT_GE( 4 * node->gids.size(), m );
+  }
+  for ( size_t i = 0; i < N; i ++ )
+  {
+    bool is_removed = ( i < n && i % 10 == 0 );
+    EXPECT_EQ( count[ i ], is_removed ? 0 : 1 );
+    if ( !is_removed ) active.push_back( i );
+  }
+  EXPECT_EQ( tree->treelist[ 0 ]->gids.size(), active.size() );
+  /** Compare with the direct sum over the active points. */
+  auto w = problem.Randn( N, nrhs );
+  auto u = gofmm::Evaluate( *tree, w );
+  /** Retired gids keep their (nonzero) weights, but take no part in the product. */
+  for ( auto gid : removed ) for ( size_t j = 0; j < nrhs; j ++ ) EXPECT_EQ( u( gid, j ), 0.0 );
+  /** No neighbor list refers to a retired gid. */
+  auto &NN = *tree->setup.NN;
+  for ( auto gid : active )
+    for ( size_t p = 0; p < NN.row(); p ++ )
+      EXPECT_FALSE( NN( p, gid ).second < n && NN( p, gid ).second % 10 == 0 ) << "gid " << gid;
+  auto Kaa = K( active, active );
+  auto wa = w( active, bmap );
+  auto ua = u( active, bmap );
+  Data<T> exact( active.size(), nrhs, 0.0 );
+  xgemm( "N", "N", active.size(), nrhs, active.size(), 1.0, Kaa.data(), active.size(),
+      wa.data(), active.size(), 0.0, exact.data(), active.size() );
+  EXPECT_LT( RelativeError( ua, exact ), 5E-2 );
+  /** Retired gids cannot be removed again, and active gids cannot be inserted. */
+  EXPECT_NE( gofmm::Update( *tree, vector<size_t>(), removed ), HMLP_ERROR_SUCCESS );
+  EXPECT_NE( gofmm::Update( *tree, inserted, vector<size_t>() ), HMLP_ERROR_SUCCESS );
+  delete tree;
+};
+
+void adaptive_refinement()
+{
+  using T = double;
+  size_t n = 2000, m = 64, k = 32, s = 16, d = 3;
+  T target = 1E-5;
+  KernelProblem<T> problem( d, n );
+  /** A loose tolerance and a small rank that miss the target on their own. */
+  gofmm::Configuration<T> config( GEOMETRY_DISTANCE, n, m, k, s, 1E-2, 0.0, false );
+  auto *coarse = problem.Compress( config );
+  T coarse_error = gofmm::SampledError( *coarse, 100, 4 );
+  EXPECT_GT( coarse_error, target );
+  EXPECT_EQ( gofmm::Refine( *coarse ), HMLP_ERROR_INVALID_VALUE );
+  delete coarse;
+  /** Halving the error is selective: some nodes keep the default tolerance. */
+  HANDLE_ERROR( config.setTargetError( coarse_error / 2 ) );
+  HANDLE_ERROR( config.setMaximumRefinements( 8 ) );
+  auto *tree = problem.Compress( config );
+  EXPECT_LT( gofmm::SampledError( *tree, 100, 4 ), coarse_error / 2 );
+  size_t n_refined = 0;
+  for ( auto *node : tree->treelist ) if ( node->data.tolerance > 0 ) n_refined ++;
+  EXPECT_GT( n_refined, 0 );
+  EXPECT_LT( n_refined, tree->treelist.size() - 1 );
+  delete tree;
+  /** With a tight target, Compress() refines until the sampled error meets it. */
+  HANDLE_ERROR( config.setTargetError( target ) );
+  tree = problem.Compress( config );
+  EXPECT_LT( gofmm::SampledError( *tree, 100, 4 ), 10 * target );
+  EXPECT_NE( config.setTargetError( -1 ), HMLP_ERROR_SUCCESS );
+  delete tree;
+};
+
+void task_graph_replay()
+{
+  using T = double;
+  size_t n = 2000, m = 128, k = 32, s = 128, nrhs = 3, d = 3;
+  KernelProblem<T> problem( d, n );
+  gofmm::Configuration<T> config( GEOMETRY_DISTANCE, n, m, k, s, 1E-7, 0.0, false );
+  auto *tree = problem.Compress( config );
+  /** The first call captures; the others replay with new weights. */
+  TaskGraph evaluate_graph;
+  for ( size_t iter = 0; iter < 3; iter ++ )
+  {
+    auto w = problem.Randn( n, nrhs );
+    auto u = gofmm::Evaluate( *tree, w, &evaluate_graph );
+    EXPECT_EQ( evaluate_graph.NumberOfEpochs(), 1 );
+    EXPECT_LT( RelativeError( u, gofmm::Evaluate( *tree, w ) ), 1E-12 );
+  }
+  /** Solve records two epochs (solve and inverse permutation). */
+  HANDLE_ERROR( gofmm::Factorize( *tree, (T)1.0 ) );
+  TaskGraph solve_graph;
+  for ( size_t iter = 0; iter < 3; iter ++ )
+  {
+    auto x1 = problem.Randn( n, nrhs );
+    auto x2 = x1;
+    EXPECT_EQ( gofmm::Solve( *tree, x1, &solve_graph ), HMLP_ERROR_SUCCESS );
+    EXPECT_EQ( gofmm::Solve( *tree, x2 ), HMLP_ERROR_SUCCESS );
+    EXPECT_EQ( solve_graph.NumberOfEpochs(), 2 );
+    EXPECT_LT( RelativeError( x1, x2 ), 1E-12 );
+  }
+  /** Tasks are freed by the graphs; clearing allows recapturing. */
+  solve_graph.Clear();
+  EXPECT_TRUE( solve_graph.IsEmpty() );
+  delete tree;
+};
+
+void tree_layout()
+{
+  /** MortonIDs encode paths deeper than 15 levels and 2^b-ary trees. */
+  EXPECT_GE( MortonHelper::MaxDepth(), 57 );
+  EXPECT_EQ( MortonHelper::BitsPerLevel( 2 ), 1 );
+  EXPECT_EQ( MortonHelper::BitsPerLevel( 8 ), 3 );
+  auto r = MortonHelper::Root();
+  auto root = MortonHelper::MortonID( r );
+  for ( size_t l = 0; l < 20; l ++ ) r = MortonHelper::RecurChild( r, l % 4, 2 );
+  auto deep = MortonHelper::MortonID( r );
+  auto sibling = MortonHelper::MortonID( MortonHelper::RecurChild( r, 1, 2 ) );
+  auto cousin = MortonHelper::MortonID( MortonHelper::RecurChild( 
+        MortonHelper::RecurChild( MortonHelper::Root(), 1, 2 ), 0, 2 ) );
+  EXPECT_TRUE( MortonHelper::IsMyParent( deep, root ) );
+  EXPECT_TRUE( MortonHelper::IsMyParent( sibling, deep ) );
+  EXPECT_FALSE( MortonHelper::IsMyParent( deep, sibling ) );
+  EXPECT_FALSE( MortonHelper::IsMyParent( deep, cousin ) );
+  /** Levels are contiguous ranges of treelist. */
+  using T = double;
+  size_t n = 1000, m = 64, k = 16, s = 64, d = 3;
+  KernelProblem<T> problem( d, n );
+  gofmm::Configuration<T> config( GEOMETRY_DISTANCE, n, m, k, s, 1E-5, 0.0, false );
+  auto *tree = problem.Compress( config );
+  EXPECT_EQ( tree->getDepth(), 4 );
+  EXPECT_EQ( tree->getLevelBegin( 0 ), 0 );
+  EXPECT_EQ( tree->getLevelBegin( tree->getDepth() + 1 ), tree->treelist.size() );
+  for ( size_t l = 0; l <= tree->getDepth(); l ++ )
+  {
+    for ( size_t i = 0; i < tree->getLevelSize( l ); i ++ )
+    {
+      EXPECT_EQ( tree->treelist[ tree->getLevelBegin( l ) + i ]->l, l );
+    }
+  }
+  delete tree;
+};
+
+void single_epoch_compress()
+{
+  using T = double;
+  size_t n = 2000, m = 64, k = 32, s = 64, d = 3;
+  KernelProblem<T> problem( d, n );
+  auto &K = problem.K;
+  gofmm::Configuration<T> config( GEOMETRY_DISTANCE, n, m, k, s, 1E-5, 0.1, false );
+  auto *tree = problem.Compress( config );
+  using NODE = typename KernelProblem<T>::TREE::NODE;
+  /** Keep the lists of the single epoch and rebuild them phase by phase. */
+  vector<set<NODE*>> near, far;
+  for ( auto *node : tree->treelist )
+  {
+    near.push_back( node->NNNearNodes );
+    far.push_back( node->NNFarNodes );
+    node->NearNodes.clear();
+    node->NNNearNodes.clear();
+    node->NNNearNodeMortonIDs.clear();
+    node->FarNodes.clear();
+    node->NNFarNodes.clear();
+  }
+  size_t n_leaves = tree->getLevelSize( tree->getDepth() );
+  for ( auto *node : tree->treelist ) gofmm::NearSamples<NODE, T>( node, n_leaves );
+  gofmm::SymmetrizeNearInteractions( *tree );
+  gofmm::MergeFarNodes( *tree );
+  size_t n_near = 0, n_far = 0;
+  for ( size_t i = 0; i < tree->treelist.size(); i ++ )
+  {
+    auto *node = tree->treelist[ i ];
+    EXPECT_TRUE( node->NNNearNodes == near[ i ] ) << "node " << i;
+    EXPECT_TRUE( node->NNFarNodes == far[ i ] ) << "node " << i;
+    n_near += near[ i ].size() > 1;
+    n_far += far[ i ].size();
+    /** Kab cached in the epoch is the submatrix of the phased lists. */
+    vector<size_t> amap = node->data.skels, bmap;
+    for ( auto *it : node->NNFarNodes )
+      bmap.insert( bmap.end(), it->data.skels.begin(), it->data.skels.end() );
+    auto FarKab = K( amap, bmap );
+    ASSERT_EQ( node->data.FarKab.size(), FarKab.size() );
+    for ( size_t j = 0; j < FarKab.size(); j ++ ) EXPECT_EQ( node->data.FarKab[ j ], FarKab[ j ] );
+    if ( !node->isleaf ) continue;
+    amap = node->gids; bmap.clear();
+    for ( auto *it : node->NNNearNodes )
+      bmap.insert( bmap.end(), it->gids.begin(), it->gids.end() );
+    auto NearKab = K( amap, bmap );
+    ASSERT_EQ( node->data.NearKab.size(), NearKab.size() );
+    for ( size_t j = 0; j < NearKab.size(); j ++ ) EXPECT_EQ( node->data.NearKab[ j ], NearKab[ j ] );
+  }
+  /** Leaves have near nodes other than themselves, and nodes have far nodes. */
+  EXPECT_GT( n_near, 0 );
+  EXPECT_GT( n_far, 0 );
+  delete tree;
+};
+
+/** Split gids into four equal groups ordered by the first coordinate. */
+template<typename T>
+struct quadsplit
+{
+  Data<T> *X = NULL;
+
+  vector<vector<size_t>> operator() ( vector<size_t> &gids ) const
+  {
+    auto order = gids;
+    sort( order.begin(), order.end(), [ this ] ( size_t a, size_t b ) 
+        { return (*X)( 0, a ) < (*X)( 0, b ); } );
+    vector<vector<size_t>> split( 4 );
+    for ( size_t i = 0; i < order.size(); i ++ )
+    {
+      auto it = find( gids.begin(), gids.end(), order[ i ] );
+      split[ 4 * i / order.size() ].push_back( it - gids.begin() );
+    }
+    return split;
+  };
+};
+
+void quadtree_partition()
+{
+  using T = double;
+  using SPLITTER = quadsplit<T>;
+  using SETUP = gofmm::Setup<KernelMatrix<T>, SPLITTER, T>;
+  size_t n = 1000, m = 64, k = 16, s = 64, d = 2;
+  HANDLE_ERROR( hmlp_init() );
+  gofmm::Configuration<T> config( GEOMETRY_DISTANCE, n, m, k, s, 1E-5, 0.0, false );
+  Data<T> X( d, n ); X.randn();
+  KernelMatrix<T> K( X );
+  SPLITTER splitter; splitter.X = &X;
+  tree::Tree<SETUP, gofmm::NodeData<T>, 4> tree;
+  EXPECT_EQ( tree.setup.FromConfiguration( config, K, splitter, NULL ), HMLP_ERROR_SUCCESS );
+  tree.TreePartition();
+  /** 1000 points with m = 64 need 4^2 leaves of 62 or 63 points. */
+  EXPECT_EQ( tree.getDepth(), 2 );
+  EXPECT_EQ( tree.treelist.size(), 21 );
+  for ( size_t l = 0; l <= tree.getDepth(); l ++ )
+  {
+    EXPECT_EQ( tree.getLevelSize( l ), 1 << ( 2 * l ) );
+    EXPECT_EQ( tree.getLevelBegin( l + 1 ), tree.getLevelBegin( l ) + tree.getLevelSize( l ) );
+  }
+  /** The permutation lists every point once in leaf order. */
+  auto perm = tree.GetPermutation();
+  auto sorted = perm;
+  sort( sorted.begin(), sorted.end() );
+  for ( size_t i = 0; i < n; i ++ ) EXPECT_EQ( sorted[ i ], i );
+  for ( auto *node : tree.treelist )
+  {
+    /** Offset() places each node at its range of the permutation. */
+    ASSERT_LE( node->offset + node->gids.size(), n );
+    for ( size_t i = 0; i < node->gids.size(); i ++ )
+    {
+      EXPECT_EQ( node->gids[ i ], perm[ node->offset + i ] );
+    }
+    if ( node->isleaf ) continue;
+    /** IndexPermuteTask concatenates all four children in order. */
+    size_t offset = node->offset;
+    for ( auto *kid : node->kids )
+    {
+      EXPECT_EQ( kid->parent, node );
+      EXPECT_EQ( kid->offset, offset );
+      EXPECT_TRUE( MortonHelper::IsMyParent( kid->morton, node->morton ) );
+      offset += kid->gids.size();
+    }
+    EXPECT_EQ( offset, node->offset + node->gids.size() );
+    /** Children of the quadsplit are ordered by the first coordinate. */
+    for ( int i = 1; i < 4; i ++ )
+    {
+      auto *prev = node->kids[ i - 1 ], *next = node->kids[ i ];
+      T prev_max = X( 0, prev->gids[ 0 ] ), next_min = X( 0, next->gids[ 0 ] );
+      for ( auto gid : prev->gids ) prev_max = std::max( prev_max, X( 0, gid ) );
+      for ( auto gid : next->gids ) next_min = std::min( next_min, X( 0, gid ) );
+      EXPECT_LE( prev_max, next_min );
+    }
+  }
+  HANDLE_ERROR( hmlp_finalize() );
+};
+
 //void custom_kernel()
 //{
 //  /** Use float as data type. */
@@ -248,6 +925,66 @@ TEST(gofmm, fast_matvec_solver)
   }
 }
 
+TEST(gofmm, cached_block)
+{
+  hmlp::test::cached_block();
+}
+
+TEST(gofmm, randomized_skeletonization)
+{
+  hmlp::test::randomized_skeletonization();
+}
+
+TEST(gofmm, sparse_matrix)
+{
+  hmlp::test::sparse_matrix();
+}
+
+TEST(gofmm, spd_matrix_loaders)
+{
+  hmlp::test::spd_matrix_loaders();
+}
+
+TEST(gofmm, flat_evaluate)
+{
+  hmlp::test::flat_evaluate();
+}
+
+TEST(gofmm, out_of_sample_queries)
+{
+  hmlp::test::out_of_sample_queries();
+}
+
+TEST(gofmm, dynamic_update)
+{
+  hmlp::test::dynamic_update();
+}
+
+TEST(gofmm, adaptive_refinement)
+{
+  hmlp::test::adaptive_refinement();
+}
+
+TEST(gofmm, task_graph_replay)
+{
+  hmlp::test::task_graph_replay();
+}
+
+TEST(gofmm, tree_layout)
+{
+  hmlp::test::tree_layout();
+}
+
+TEST(gofmm, single_epoch_compress)
+{
+  hmlp::test::single_epoch_compress();
+}
+
+TEST(gofmm, quadtree_partition)
+{
+  hmlp::test::quadtree_partition();
+}
+
 /* Put all tests involving MPI here. */
 #ifdef HMLP_USE_MPI
 #endif /* ifdef HMLP_USE_MPI */
@@ -0,0 +1,160 @@
+#ifndef HMLP_TEST_GSKS_HPP
+#define HMLP_TEST_GSKS_HPP
+
+#include <random>
+/* Public headers. */
+#include <hmlp.h>
+/* Internal headers. */
+#include <containers/KernelMatrix.hpp>
+#include <base/arch.hpp>
+#include <base/tuner.hpp>
+
+namespace hmlp
+{
+namespace test
+{
+
+/** Dispatch gsks_ref() by precision. */
+inline void gsks_ref( kernel_s<float, float> *kernel, int m, int n, int k,
+    float *u, int *umap, float *A, float *A2, int *amap, float *B, float *B2, int *bmap, float *w, int *wmap )
+{
+  sgsks_ref( kernel, m, n, k, u, umap, A, A2, amap, B, B2, bmap, w, wmap );
+};
+
+inline void gsks_ref( kernel_s<double, double> *kernel, int m, int n, int k,
+    double *u, int *umap, double *A, double *A2, int *amap, double *B, double *B2, int *bmap, double *w, int *wmap )
+{
+  dgsks_ref( kernel, m, n, k, u, umap, A, A2, amap, B, B2, bmap, w, wmap );
+};
+
+/**
+ *  @brief Compare the fused gsks() against gsks_ref() for all kernel types.
+ *         Points are uniform in [ 0, 1 / sqrt( k ) ]^k such that the squared
+ *         distances (~1/6) exercise the compact support of QUARTIC and
+ *         EPANECHNIKOV. With permute, amap and bmap are reversed.
+ */
+template<typename T>
+void gsks_all_kernels( int m, int n, int k, T tol, bool permute = false )
+{
+  std::mt19937 generator( 2019 );
+  std::uniform_real_distribution<T> uniform( 0.0, 1.0 / std::sqrt( (T)k ) );
+  std::vector<T> A( k * m ), A2( m, 0 ), B( k * n ), B2( n, 0 ), w( n ), hi( m ), hj( n );
+  std::vector<int> amap( m ), bmap( n );
+  for ( int i = 0; i < m; i ++ )
+  {
+    for ( int p = 0; p < k; p ++ )
+    {
+      A[ i * k + p ] = uniform( generator );
+      A2[ i ] += A[ i * k + p ] * A[ i * k + p ];
+    }
+    hi[ i ] = 1.0 + uniform( generator );
+    amap[ i ] = permute ? m - 1 - i : i;
+  }
+  for ( int j = 0; j < n; j ++ )
+  {
+    for ( int p = 0; p < k; p ++ )
+    {
+      B[ j * k + p ] = uniform( generator );
+      B2[ j ] += B[ j * k + p ] * B[ j * k + p ];
+    }
+    hj[ j ] = 1.0 + uniform( generator );
+    w[ j ] = 2.0 * uniform( generator ) * std::sqrt( (T)k ) - 1.0;
+    bmap[ j ] = permute ? n - 1 - j : j;
+  }
+
+  for ( auto type : { GAUSSIAN, SIGMOID, POLYNOMIAL, LAPLACE, GAUSSIAN_VAR_BANDWIDTH,
+        TANH, QUARTIC, MULTIQUADRATIC, EPANECHNIKOV } )
+  {
+    kernel_s<T, T> kernel;
+    kernel.type = type;
+    kernel.scal = ( type == GAUSSIAN ) ? -1.0 : 1.0;
+    kernel.cons = ( type == SIGMOID || type == TANH ) ? 0.0 : 1.0;
+    kernel.powe = 2.0;
+    kernel.hi = hi.data();
+    kernel.hj = hj.data();
+
+    std::vector<T> u( m, 0 ), uref( m, 0 );
+    EXPECT_EQ( ::gsks( &kernel, m, n, k, u.data(), amap.data(),
+        A.data(), A2.data(), amap.data(), B.data(), B2.data(), bmap.data(), w.data(), bmap.data() ),
+        HMLP_ERROR_SUCCESS );
+    gsks_ref( &kernel, m, n, k, uref.data(), amap.data(),
+        A.data(), A2.data(), amap.data(), B.data(), B2.data(), bmap.data(), w.data(), bmap.data() );
+
+    T err = 0, nrm = 0;
+    for ( int i = 0; i < m; i ++ )
+    {
+      err += ( u[ i ] - uref[ i ] ) * ( u[ i ] - uref[ i ] );
+      nrm += uref[ i ] * uref[ i ];
+    }
+    EXPECT_LT( std::sqrt( err / nrm ), tol ) << "kernel type " << type << " k " << k;
+  }
+}; /* end gsks_all_kernels() */
+
+}; /* end namespace test */
+}; /* end namespace hmlp */
+
+TEST(gsks, dgsks)
+{
+  /* One rank-k pass, and multiple passes (k > KC) through the packed C. */
+  hmlp::test::gsks_all_kernels<double>( 501, 433, 37, 1E-12 );
+  hmlp::test::gsks_all_kernels<double>( 257, 301, 419, 1E-12 );
+}
+
+TEST(gsks, sgsks)
+{
+  hmlp::test::gsks_all_kernels<float>( 501, 433, 37, 1E-4 );
+  hmlp::test::gsks_all_kernels<float>( 257, 301, 419, 1E-4 );
+}
+
+TEST(gsks, strassen)
+{
+  /* Large k takes the one-level Strassen; odd m, n and k go through the peeling. */
+  hmlp::test::gsks_all_kernels<double>( 301, 263, 1101, 1E-11, true );
+  hmlp::test::gsks_all_kernels<float>( 301, 263, 1101, 1E-3, true );
+}
+
+TEST(gsks, unsupported_kernel)
+{
+  /* USER_DEFINE has no fused evaluation; report it instead of exiting. */
+  kernel_s<double, double> kernel;
+  kernel.type = USER_DEFINE;
+  std::vector<double> A( 4, 1.0 ), A2( 4, 1.0 ), u( 4, 0.0 ), w( 4, 1.0 );
+  std::vector<int> map = { 0, 1, 2, 3 };
+  EXPECT_EQ( ::gsks( &kernel, 4, 4, 1, u.data(), map.data(), A.data(), A2.data(), map.data(),
+        A.data(), A2.data(), map.data(), w.data(), map.data() ), HMLP_ERROR_INVALID_VALUE );
+  EXPECT_EQ( ::dgsks_ref( &kernel, 4, 4, 1, u.data(), map.data(), A.data(), A2.data(), map.data(),
+        A.data(), A2.data(), map.data(), w.data(), map.data() ), HMLP_ERROR_INVALID_VALUE );
+  for ( auto ui : u ) EXPECT_EQ( ui, 0.0 );
+}
+
+TEST(gsks, autotune)
+{
+  /* Every candidate (partitioning and blocking) must give the same result. */
+  hmlp::tuner::clear();
+  setenv( "HMLP_AUTOTUNE", "1", 1 );
+  for ( int i = 0; i < 64 && !hmlp::tuner::isTuned( "dgsks", 257, 301, 419 ); i ++ )
+  {
+    hmlp::test::gsks_all_kernels<double>( 257, 301, 419, 1E-12 );
+  }
+  unsetenv( "HMLP_AUTOTUNE" );
+  EXPECT_TRUE( hmlp::tuner::isTuned( "dgsks", 257, 301, 419 ) );
+  hmlp::tuner::clear();
+}
+
+#ifdef HMLP_USE_DISPATCH
+TEST(gsks, dispatch)
+{
+  /* Run every package that this CPU supports, and restore the selection. */
+  auto cpu = hmlp::arch::detect();
+  for ( auto arch : { hmlp::HMLP_ARCH_SANDYBRIDGE, hmlp::HMLP_ARCH_HASWELL, hmlp::HMLP_ARCH_SKX } )
+  {
+    if ( arch > cpu ) continue;
+    EXPECT_EQ( hmlp::arch::select( arch ), HMLP_ERROR_SUCCESS );
+    hmlp::test::gsks_all_kernels<double>( 257, 301, 419, 1E-12 );
+    hmlp::test::gsks_all_kernels<float>( 257, 301, 419, 1E-4 );
+  }
+  EXPECT_EQ( hmlp::arch::select(), HMLP_ERROR_SUCCESS );
+}
+#endif
+
+#endif /* define HMLP_TEST_GSKS_HPP */
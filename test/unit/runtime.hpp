@@ -1,16 +1,100 @@
 #ifndef HMLP_TEST_RUNTIME_HPP
 #define HMLP_TEST_RUNTIME_HPP
 
+/* System headers. */
+#include <unistd.h>
+#include <atomic>
+#include <algorithm>
+#include <set>
+#include <pthread.h>
 /* Public headers. */
 #include <hmlp.h>
 /* Internal headers. */
 #include <base/hmlp_mpi.hpp>
+#include <base/arch.hpp>
+#include <base/thread.hpp>
+#include <base/tuner.hpp>
+#include <base/costmodel.hpp>
+#include <base/numa.hpp>
+#include <base/Data.hpp>
 
 namespace hmlp
 {
 namespace test
 {
 
+/** @brief A task that records its execution order. */
+class OrderTask : public Task
+{
+  public:
+
+    atomic<int> *counter = NULL;
+
+    int order = 0;
+
+    int executed_as = -1;
+
+    pthread_t executed_by;
+
+    void Set( atomic<int> *user_counter, int user_order )
+    {
+      name = string( "order" );
+      counter = user_counter;
+      order = user_order;
+    };
+
+    void Execute( Worker* )
+    {
+      /** Long enough for the idle workers to park. */
+      usleep( 2000 );
+      executed_as = counter->fetch_add( 1 );
+      executed_by = pthread_self();
+    };
+}; /* end class OrderTask */
+
+/** @brief An OrderTask that also adds ones to a matrix (ACC access). */
+class AccumulateTask : public OrderTask
+{
+  public:
+
+    Data<double> *A = NULL;
+
+    void Execute( Worker* worker )
+    {
+      std::vector<double> ones( A->size(), 1.0 );
+      for ( int it = 0; it < 100; it ++ )
+        EXPECT_EQ( A->Accumulate( 0, A->row(), 0, A->col(), ones.data(), A->row() ),
+            HMLP_ERROR_SUCCESS );
+      OrderTask::Execute( worker );
+    };
+}; /* end class AccumulateTask */
+
+/** @brief Send a vector (header: its size, payload: its values). */
+class EchoSendTask : public SendTask<double, std::vector<double>>
+{
+  public:
+
+    EchoSendTask( std::vector<double> *arg, int src, int tar, int key )
+      : SendTask<double, std::vector<double>>( arg, src, tar, key ) {};
+
+    void Pack()
+    {
+      send_sizes.assign( 1, arg->size() );
+      send_buffs = *arg;
+    };
+}; /* end class EchoSendTask */
+
+/** @brief Receive the vector sent by EchoSendTask. */
+class EchoRecvTask : public RecvTask<double, std::vector<double>>
+{
+  public:
+
+    EchoRecvTask( std::vector<double> *arg, int src, int tar, int key )
+      : RecvTask<double, std::vector<double>>( arg, src, tar, key ) {};
+
+    void Unpack() { *arg = recv_buffs; };
+}; /* end class EchoRecvTask */
+
 }; /* end namespace test */
 }; /* end namespace hmlp */
 
@@ -93,6 +177,375 @@ TEST(runtime, hmlp_get_mpi_size)
   EXPECT_EQ( hmlp_get_mpi_size(),
       size );
 }
+
+TEST(runtime, mpi_matched_probe)
+{
+  int rank;
+  hmlp::mpi::Comm_rank( MPI_COMM_WORLD, &rank );
+  /* A matched message is received by Mrecv only. */
+  std::vector<size_t> sizes = { 3, 1, 4 }, recv_sizes;
+  hmlp::mpi::Request request;
+  hmlp::mpi::Isend( sizes.data(), sizes.size(), rank, 300, MPI_COMM_WORLD, &request );
+  int flag = 0, cnt = 0;
+  hmlp::mpi::Message message;
+  hmlp::mpi::Status status;
+  while ( !flag ) 
+    hmlp::mpi::Improbe( MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &message, &status );
+  EXPECT_EQ( status.MPI_SOURCE, rank );
+  EXPECT_EQ( status.MPI_TAG, 300 );
+  hmlp::mpi::Get_count( &status, HMLP_MPI_SIZE_T, &cnt );
+  recv_sizes.resize( cnt );
+  hmlp::mpi::Mrecv( recv_sizes.data(), cnt, &message, &status );
+  hmlp::mpi::Wait( &request, MPI_STATUS_IGNORE );
+  EXPECT_EQ( recv_sizes, sizes );
+  /* The progress lock never blocks the caller. */
+  hmlp::Lock lock;
+  EXPECT_TRUE( lock.TryAcquire() );
+  int acquired = 1;
+  #pragma omp parallel num_threads( 2 )
+  {
+    if ( omp_get_thread_num() == 1 ) acquired = lock.TryAcquire();
+  }
+  if ( omp_get_max_threads() > 1 ) EXPECT_FALSE( acquired );
+  EXPECT_EQ( lock.Release(), HMLP_ERROR_SUCCESS );
+}
+
+TEST(runtime, late_listener)
+{
+  EXPECT_EQ( hmlp_init(), HMLP_ERROR_SUCCESS );
+  auto *rt = hmlp_get_runtime_handle();
+  auto *scheduler = rt->scheduler;
+  auto *me = &rt->workers[ 0 ];
+  int rank = hmlp_get_mpi_rank();
+  /* The message arrives before its listener is submitted. */
+  std::vector<double> sent = { 2.0, 7.0, 1.0, 8.0 }, received;
+  hmlp::test::EchoSendTask send( &sent, rank, rank, 300 );
+  send.comm = scheduler->GetPrivateComm();
+  send.payload_comm = scheduler->GetPayloadComm();
+  send.Execute( me );
+  /* Only the header can be matched (and parked) without a listener. */
+  for ( int i = 0; i < 8; i ++ ) EXPECT_FALSE( scheduler->Progress( me ) );
+  auto *recv = new hmlp::test::EchoRecvTask( &received, rank, rank, 300 );
+  recv->Submit();
+  /* The parked header is handed off, and its payload is still receivable. */
+  EXPECT_TRUE( scheduler->Progress( me ) );
+  EXPECT_EQ( recv->recv_buffs, sent );
+  /* The enqueued listener runs (and is freed) in the next epoch. */
+  EXPECT_EQ( hmlp_run(), HMLP_ERROR_SUCCESS );
+  EXPECT_EQ( received, sent );
+  EXPECT_EQ( hmlp_finalize(), HMLP_ERROR_SUCCESS );
+}
 #endif /* ifdef HMLP_USE_MPI */
 
+TEST(runtime, idle_backoff)
+{
+  EXPECT_EQ( hmlp_init(),
+      HMLP_ERROR_SUCCESS );
+  int n_worker = hmlp_get_runtime_handle()->getNumberOfWorkers();
+  EXPECT_EQ( hmlp_set_num_workers( 4 ),
+      HMLP_ERROR_SUCCESS );
+  /* A serial chain keeps all but one worker idle; they must wake up and exit. */
+  std::atomic<int> counter( 0 );
+  std::vector<hmlp::test::OrderTask*> chain( 8 );
+  for ( int i = 0; i < chain.size(); i ++ )
+  {
+    chain[ i ] = new hmlp::test::OrderTask();
+    chain[ i ]->Set( &counter, i );
+    EXPECT_EQ( chain[ i ]->Submit(), HMLP_ERROR_SUCCESS );
+    if ( i ) EXPECT_EQ( hmlp::Scheduler::DependencyAdd( chain[ i - 1 ], chain[ i ] ),
+        HMLP_ERROR_SUCCESS );
+  }
+  /* Record the order before the runtime frees the tasks. */
+  hmlp::TaskGraph graph;
+  chain[ 0 ]->TryEnqueue();
+  EXPECT_EQ( graph.Capture(), HMLP_ERROR_SUCCESS );
+  for ( int i = 0; i < chain.size(); i ++ ) EXPECT_EQ( chain[ i ]->executed_as, i );
+  /* Parked workers are woken up by the enqueues of a replay as well. */
+  EXPECT_EQ( graph.Replay(), HMLP_ERROR_SUCCESS );
+  EXPECT_EQ( counter.load(), 2 * chain.size() );
+  EXPECT_EQ( hmlp_set_num_workers( n_worker ),
+      HMLP_ERROR_SUCCESS );
+}
+
+TEST(runtime, persistent_worker_pool)
+{
+  /* The OpenMP settings of the process are not changed by the runtime. */
+  int max_threads = omp_get_max_threads(), dynamic = omp_get_dynamic();
+  EXPECT_EQ( hmlp_init(),
+      HMLP_ERROR_SUCCESS );
+  int n_worker = hmlp_get_runtime_handle()->getNumberOfWorkers();
+  /* Parallel loops between epochs use as many threads as there are workers. */
+  EXPECT_EQ( hmlp_get_num_workers(), n_worker );
+  std::atomic<int> counter( 0 );
+  std::vector<hmlp::test::OrderTask*> tasks( 16 );
+  for ( auto & task : tasks )
+  {
+    task = new hmlp::test::OrderTask();
+    task->Set( &counter, 0 );
+    EXPECT_EQ( task->Submit(), HMLP_ERROR_SUCCESS );
+    task->TryEnqueue();
+  }
+  /* Keep the tasks alive to read which threads executed them. */
+  hmlp::TaskGraph graph;
+  EXPECT_EQ( graph.Capture(), HMLP_ERROR_SUCCESS );
+  EXPECT_EQ( omp_get_max_threads(), max_threads );
+  EXPECT_EQ( omp_get_dynamic(), dynamic );
+  std::set<pthread_t> team;
+  #pragma omp parallel num_threads( hmlp_get_num_workers() )
+  {
+    #pragma omp critical
+    team.insert( pthread_self() );
+  }
+  EXPECT_EQ( team.size(), n_worker );
+#if defined( __GNUC__ ) && !defined( __clang__ ) && !defined( __INTEL_COMPILER )
+  /* libgomp keeps the threads of a team of the same size; other OpenMP
+   * runtimes may start new ones, so only check the reuse with libgomp. */
+  for ( auto task : tasks ) EXPECT_EQ( team.count( task->executed_by ), 1 );
+#endif
+}
+
+TEST(runtime, cost_model)
+{
+  EXPECT_EQ( hmlp_init(),
+      HMLP_ERROR_SUCCESS );
+  hmlp::costmodel::clear();
+  hmlp::costmodel::enable( true );
+  /* sec = 1E-3 + 2E-3 * gflops, where mops are constant (not determined). */
+  for ( double gflops : { 1.0, 2.0, 4.0, 8.0 } )
+    hmlp::costmodel::record( "linear task", gflops * 1E+9, 1E+6, 1E-3 + 2E-3 * gflops );
+  float sec = -1.0;
+  EXPECT_FALSE( hmlp::costmodel::estimate( "linear task", 5E+9, 1E+6, sec ) );
+  /* A slot resolved before the fit (like Task::Submit()) is refitted in place. */
+  auto *slot = hmlp::costmodel::find( "linear task" );
+  EXPECT_EQ( hmlp::costmodel::find( "linear task" ), slot );
+  EXPECT_FALSE( hmlp::costmodel::estimate( slot, 5E+9, 1E+6, sec ) );
+  hmlp::costmodel::update();
+  EXPECT_TRUE( hmlp::costmodel::estimate( slot, 5E+9, 1E+6, sec ) );
+  EXPECT_NEAR( sec, 1.1E-2, 1E-6 );
+  EXPECT_TRUE( hmlp::costmodel::estimate( "linear task", 5E+9, 1E+6, sec ) );
+  EXPECT_NEAR( sec, 1.1E-2, 1E-6 );
+  /* The models are rebuilt from the saved samples. */
+  char filename[] = "/tmp/hmlp_cost_model_XXXXXX";
+  int fd = mkstemp( filename );
+  EXPECT_GE( fd, 0 );
+  close( fd );
+  EXPECT_EQ( hmlp::costmodel::save( filename ), HMLP_ERROR_SUCCESS );
+  hmlp::costmodel::clear();
+  EXPECT_EQ( hmlp::costmodel::load( filename ), HMLP_ERROR_SUCCESS );
+  hmlp::costmodel::model_s model;
+  EXPECT_TRUE( hmlp::costmodel::get( "linear task", model ) );
+  EXPECT_EQ( model.samples, 4 );
+  EXPECT_NEAR( model.per_gflop, 2E-3, 1E-9 );
+  EXPECT_NEAR( model.per_gmop, 0.0, 1E-12 );
+  unlink( filename );
+  /* The runtime records every executed task under its name. */
+  std::atomic<int> counter( 0 );
+  for ( int i = 0; i < 4; i ++ )
+  {
+    auto *task = new hmlp::test::OrderTask();
+    task->Set( &counter, i );
+    EXPECT_EQ( task->Submit(), HMLP_ERROR_SUCCESS );
+    EXPECT_EQ( task->cost_model, hmlp::costmodel::find( "order" ) );
+    task->TryEnqueue();
+  }
+  EXPECT_EQ( hmlp_run(), HMLP_ERROR_SUCCESS );
+  EXPECT_TRUE( hmlp::costmodel::get( "order", model ) );
+  EXPECT_EQ( model.samples, 4 );
+  EXPECT_GT( model.intercept, 1E-3 );
+  hmlp::costmodel::enable( false );
+  hmlp::costmodel::clear();
+}
+
+TEST(runtime, task_allocation)
+{
+  /* Edges beyond the inline ones spill to the heap in order. */
+  hmlp::InlineList<int, 4> list;
+  for ( int i = 0; i < 10; i ++ ) list.push_back( i );
+  EXPECT_EQ( list.size(), 10 );
+  for ( int i = 0; i < 10; i ++ ) EXPECT_EQ( list[ i ], i );
+  list.clear();
+  EXPECT_TRUE( list.empty() );
+  /* A deleted task is recycled by the next allocation of this thread. */
+  auto *task = new hmlp::test::OrderTask();
+  delete task;
+  auto *recycled = new hmlp::test::OrderTask();
+  EXPECT_EQ( recycled, task );
+  EXPECT_EQ( recycled->GetStatus(), hmlp::NOTREADY );
+  EXPECT_TRUE( recycled->out.empty() );
+  /* Slabs are only freed once no task is alive. */
+  EXPECT_GT( hmlp::Task::GetNumberOfSlabs(), 0 );
+  EXPECT_FALSE( hmlp::Task::ReleaseSlabs() );
+  delete recycled;
+  EXPECT_TRUE( hmlp::Task::ReleaseSlabs() );
+  EXPECT_EQ( hmlp::Task::GetNumberOfSlabs(), 0 );
+  /* The free lists of the freed slabs are dropped. */
+  task = new hmlp::test::OrderTask();
+  EXPECT_EQ( hmlp::Task::GetNumberOfSlabs(), 1 );
+  delete task;
+}
+
+TEST(runtime, region_dependency)
+{
+  EXPECT_EQ( hmlp_init(),
+      HMLP_ERROR_SUCCESS );
+  std::atomic<int> counter( 0 );
+  /* 2-by-2 tiles of 4-by-2. */
+  hmlp::Data<double> A( 8, 4, 0.0 );
+  EXPECT_EQ( A.CreateRegions( 4, 2 ), HMLP_ERROR_SUCCESS );
+  std::vector<hmlp::test::OrderTask*> tasks( 6 );
+  for ( size_t t = 0; t < tasks.size(); t ++ )
+  {
+    if ( t == 3 || t == 4 ) 
+    {
+      auto *task = new hmlp::test::AccumulateTask();
+      task->A = &A;
+      tasks[ t ] = task;
+    }
+    else tasks[ t ] = new hmlp::test::OrderTask();
+    tasks[ t ]->Set( &counter, t );
+    EXPECT_EQ( tasks[ t ]->Submit(), HMLP_ERROR_SUCCESS );
+  }
+  auto depends = []( hmlp::Task *target, hmlp::Task *source )
+  {
+    return std::count( target->in.begin(), target->in.end(), source ) > 0;
+  };
+  /* Writes of disjoint row ranges. */
+  EXPECT_EQ( A.DependencyAnalysis( 0, 4, 0, 4, hmlp::W, tasks[ 0 ] ), HMLP_ERROR_SUCCESS );
+  EXPECT_EQ( A.DependencyAnalysis( 4, 4, 0, 4, hmlp::W, tasks[ 1 ] ), HMLP_ERROR_SUCCESS );
+  EXPECT_TRUE( tasks[ 1 ]->in.empty() );
+  /* A column panel read overlaps both. */
+  EXPECT_EQ( A.DependencyAnalysis( 0, 8, 2, 2, hmlp::R, tasks[ 2 ] ), HMLP_ERROR_SUCCESS );
+  EXPECT_TRUE( depends( tasks[ 2 ], tasks[ 0 ] ) && depends( tasks[ 2 ], tasks[ 1 ] ) );
+  /* Accumulations wait for the read but commute with each other. */
+  EXPECT_EQ( A.DependencyAnalysis( hmlp::ACC, tasks[ 3 ] ), HMLP_ERROR_SUCCESS );
+  EXPECT_EQ( A.DependencyAnalysis( hmlp::ACC, tasks[ 4 ] ), HMLP_ERROR_SUCCESS );
+  EXPECT_TRUE( depends( tasks[ 4 ], tasks[ 2 ] ) );
+  EXPECT_FALSE( depends( tasks[ 4 ], tasks[ 3 ] ) );
+  /* A read waits for all accumulations. */
+  EXPECT_EQ( A.DependencyAnalysis( 6, 1, 0, 1, hmlp::R, tasks[ 5 ] ), HMLP_ERROR_SUCCESS );
+  EXPECT_TRUE( depends( tasks[ 5 ], tasks[ 3 ] ) && depends( tasks[ 5 ], tasks[ 4 ] ) );
+  /* Out of range. */
+  EXPECT_EQ( A.DependencyAnalysis( 6, 4, 0, 1, hmlp::R, tasks[ 5 ] ), HMLP_ERROR_INVALID_VALUE );
+  for ( auto task : tasks ) task->TryEnqueue();
+  /* Keep the tasks alive to read the execution order. */
+  hmlp::TaskGraph graph;
+  EXPECT_EQ( graph.Capture(), HMLP_ERROR_SUCCESS );
+  EXPECT_EQ( A.DependencyCleanUp(), HMLP_ERROR_SUCCESS );
+  EXPECT_GT( tasks[ 2 ]->executed_as, std::max( tasks[ 0 ]->executed_as, tasks[ 1 ]->executed_as ) );
+  EXPECT_GT( std::min( tasks[ 3 ]->executed_as, tasks[ 4 ]->executed_as ), tasks[ 2 ]->executed_as );
+  EXPECT_GT( tasks[ 5 ]->executed_as, std::max( tasks[ 3 ]->executed_as, tasks[ 4 ]->executed_as ) );
+  for ( size_t i = 0; i < A.size(); i ++ ) EXPECT_EQ( A[ i ], 200.0 );
+}
+
+TEST(runtime, arch_select)
+{
+  for ( auto arch : { hmlp::HMLP_ARCH_SANDYBRIDGE, hmlp::HMLP_ARCH_HASWELL, hmlp::HMLP_ARCH_SKX } )
+  {
+    EXPECT_EQ( hmlp::arch::parse( hmlp::arch::getName( arch ) ), arch );
+  }
+  EXPECT_EQ( hmlp::arch::parse( "pentium" ), hmlp::HMLP_ARCH_UNSUPPORTED );
+  /* Negative test. */
+  EXPECT_EQ( hmlp::arch::select( hmlp::HMLP_ARCH_UNSUPPORTED ),
+      HMLP_ERROR_NOT_SUPPORTED );
+  auto cpu = hmlp::arch::detect();
+  if ( cpu != hmlp::HMLP_ARCH_UNSUPPORTED )
+  {
+    /* Positive test. */
+    EXPECT_EQ( hmlp::arch::select( cpu ),
+        HMLP_ERROR_SUCCESS );
+    EXPECT_EQ( hmlp::arch::getSelected(), cpu );
+  }
+}
+
+TEST(runtime, workspace)
+{
+  double *ptr = NULL;
+  {
+    hmlp::Workspace workspace;
+    ptr = workspace.Buffer<32, double>( 100 );
+    auto &comm = workspace.Communicator( 1, 1, 2, 1 );
+    EXPECT_EQ( comm.GetNumThreads(), 2 );
+    /* Nested calls on the same thread must not alias. */
+    hmlp::Workspace nested;
+    EXPECT_NE( ( nested.Buffer<32, double>( 100 ) ), ptr );
+    EXPECT_NE( &nested.Communicator( 1, 1, 2, 1 ), &comm );
+  }
+  {
+    /* Smaller requests reuse the cached buffer. */
+    hmlp::Workspace workspace;
+    EXPECT_EQ( ( workspace.Buffer<32, double>( 10 ) ), ptr );
+  }
+  EXPECT_GE( hmlp::Workspace::GetCachedBytes(), 200 * sizeof(double) );
+  hmlp::Workspace::Release();
+  EXPECT_EQ( hmlp::Workspace::GetCachedBytes(), 0 );
+}
+
+TEST(runtime, tuner)
+{
+  using namespace hmlp::tuner;
+  EXPECT_EQ( classify( 1000, 1000, 8 ), hmlp::HMLP_SHAPE_SQUARE );
+  EXPECT_EQ( classify( 8000, 1000, 8 ), hmlp::HMLP_SHAPE_SKINNY );
+  EXPECT_EQ( classify( 1000, 1000, 2000 ), hmlp::HMLP_SHAPE_LARGE_K );
+  clear();
+  /* Round trip through a tuning file. */
+  tuning_s setting;
+  setting.ic_nt = 2;
+  setting.kc = 128;
+  hmlp::tuner::set( "dtest", hmlp::HMLP_SHAPE_SQUARE, 4, setting, 1.0 );
+  EXPECT_EQ( save( "hmlp_tuning_test.txt" ), HMLP_ERROR_SUCCESS );
+  clear();
+  EXPECT_EQ( load( "hmlp_tuning_test.txt" ), HMLP_ERROR_SUCCESS );
+  tuning_s loaded;
+  EXPECT_TRUE( hmlp::tuner::get( "dtest", hmlp::HMLP_SHAPE_SQUARE, 4, loaded ) );
+  EXPECT_EQ( loaded.ic_nt, 2 );
+  EXPECT_EQ( loaded.kc, 128 );
+  EXPECT_FALSE( hmlp::tuner::get( "dtest", hmlp::HMLP_SHAPE_SKINNY, 4, loaded ) );
+  /* Negative test. */
+  EXPECT_EQ( load( "hmlp_no_such_file.txt" ), HMLP_ERROR_INVALID_VALUE );
+  remove( "hmlp_tuning_test.txt" );
+  /* An online search ends with an entry. */
+  clear();
+  setenv( "HMLP_AUTOTUNE", "1", 1 );
+  for ( int i = 0; i < 100 && !isTuned( "dtest", 100, 100, 10 ); i ++ )
+  {
+    Session session( "dtest", 100, 100, 10, 72, 960, 256, 8, 6 );
+    EXPECT_GE( session.setting.jc_nt * session.setting.ic_nt * session.setting.jr_nt, 1 );
+  }
+  unsetenv( "HMLP_AUTOTUNE" );
+  EXPECT_TRUE( isTuned( "dtest", 100, 100, 10 ) );
+  clear();
+}
+
+TEST(runtime, numa)
+{
+  using namespace hmlp::numa;
+  int n_socket = getNumSockets();
+  EXPECT_GE( n_socket, 1 );
+  EXPECT_LT( getSocketOfCpu( 0 ), n_socket );
+  /* No pinning by default. */
+  unsetenv( "HMLP_PIN_WORKERS" );
+  EXPECT_EQ( getPinning( 4 ).size(), 0 );
+  EXPECT_EQ( getNumAffinityDomains(), 1 );
+  EXPECT_EQ( getTreeNodeAffinity( 8, 5, 2 ), -1 );
+  /* An explicit list is reused cyclically. */
+  setenv( "HMLP_PIN_WORKERS", "0", 1 );
+  auto pinning = getPinning( 3 );
+  EXPECT_EQ( pinning.size(), 3 );
+  for ( auto cpu : pinning ) EXPECT_EQ( cpu, 0 );
+  EXPECT_EQ( pinCurrentThread( -1 ), HMLP_ERROR_INVALID_VALUE );
+  /* Subtrees below the top levels are split evenly over the sockets. */
+  setenv( "HMLP_PIN_WORKERS", "compact", 1 );
+  EXPECT_EQ( getPinning( 2 ).size(), 2 );
+  EXPECT_EQ( getTreeNodeAffinity( 1, 0, 2 ), -1 );
+  if ( n_socket == 2 )
+  {
+    EXPECT_EQ( getTreeNodeAffinity( 4, 1, 2 ), 0 );
+    EXPECT_EQ( getTreeNodeAffinity( 4, 2, 2 ), 1 );
+    /* A 4-ary tree splits at its first level into two pairs of subtrees. */
+    EXPECT_EQ( getTreeNodeAffinity( 16, 7, 4 ), 0 );
+    EXPECT_EQ( getTreeNodeAffinity( 16, 8, 4 ), 1 );
+  }
+  unsetenv( "HMLP_PIN_WORKERS" );
+}
+
 #endif /* define HMLP_TEST_RUNTIME_HPP */
@@ -6,6 +6,9 @@
 /* GOFMM and MPI-GOFMM */
 #include "unit/gofmm.hpp"
 
+/* Kernel summation (GSKS) */
+#include "unit/gsks.hpp"
+
 /* [INTERNAL] Runtime */
 #include "unit/runtime.hpp"
 